@@ -0,0 +1,276 @@
+#include "AsyncSceneLoader.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <iostream>
+#include <set>
+
+AsyncSceneLoader::AsyncSceneLoader(unsigned int nThreads) : pendingJobs(0), unitsDone(0), unitsTotal(0), meshJobs(0)
+{
+	pool = new ThreadPool(nThreads);
+}
+
+AsyncSceneLoader::~AsyncSceneLoader()
+{
+	// Finish the queued jobs first, as they still write to the loader.
+	delete pool;
+
+	for (Mesh * m : meshes)
+		delete m;
+	for (PendingImage & image : images) {
+		if (image.data) SOIL_free_image_data(image.data);
+	}
+	if (!textures.empty()) {
+		glDeleteTextures(textures.size(), &textures[0]);
+		Utils::ClearPreloadedTextures();
+	}
+}
+
+void AsyncSceneLoader::load(const std::string & path, unsigned int flags, bool ambientFromDiffuse)
+{
+	if (state != SCENE_LOAD_IDLE) {
+		std::cerr << "AsyncSceneLoader.cpp: ERROR when loading " << path << ". The loader has already been used." << std::endl;
+		return;
+	}
+	this->ambientFromDiffuse = ambientFromDiffuse;
+	state = SCENE_LOAD_RUNNING;
+	start = std::chrono::high_resolution_clock::now();
+	pendingJobs = 1;
+	pool->submit([this, path, flags] { parse(path, flags); });
+}
+
+void AsyncSceneLoader::setUseCache(bool enabled)
+{
+	useCache = enabled;
+}
+
+void AsyncSceneLoader::parse(const std::string & path, unsigned int flags)
+{
+	unsigned long long sourceHash = 0, settingsHash = 0;
+	if (useCache) {
+		sourceHash = SceneCache::hashFile(path);
+		settingsHash = SceneCache::hashSettings(flags, ambientFromDiffuse);
+		fromCache = sourceHash != 0 && cache.open(SceneCache::getCachePath(path), sourceHash, settingsHash);
+	}
+	if (!fromCache) {
+		source = importer.ReadFile(path, flags);
+		if (source == NULL) {
+			parseTime = elapsed();
+			error = importer.GetErrorString();
+			pendingJobs--;
+			return;
+		}
+	}
+	parseTime = elapsed();
+
+	// The texture files of the materials, named like Material::loadFromAiMaterial() does.
+	// Every file is decoded once, even if several materials use it.
+	std::set<std::string> paths;
+	if (fromCache) {
+		for (unsigned int i = 0; i < cache.getNumMaterials(); i++) {
+			aiMaterial * mat = cache.createMaterial(i);
+			addTexturePaths(mat, paths);
+			delete mat;
+		}
+	}
+	else {
+		for (unsigned int i = 0; i < source->mNumMaterials; i++)
+			addTexturePaths(source->mMaterials[i], paths);
+	}
+	images.resize(paths.size());
+	unsigned int n = 0;
+	for (const std::string & p : paths)
+		images[n++].path = p;
+	meshes.assign(fromCache ? cache.getNumMeshes() : source->mNumMeshes, NULL);
+	bool baking = useCache && !fromCache;
+
+	// Parsing, a job and an upload per mesh and image, baking, and creating the scene.
+	unitsTotal = 2 + 2 * (meshes.size() + images.size()) + (baking ? 1 : 0);
+	unitsDone = 1;
+	pendingJobs += meshes.size() + images.size();
+	meshJobs = meshes.size();
+
+	for (unsigned int i = 0; i < meshes.size(); i++) {
+		pool->submit([this, i, baking, path, sourceHash, settingsHash] {
+			meshes[i] = fromCache ? new Mesh(cache, i, false) : new Mesh(source->mMeshes[i], false);
+			unitsDone++;
+			queueUpload([this, i] { meshes[i]->updateBuffers(); });
+			// The last conversion bakes the cache (counted as pending before this job ends).
+			if (--meshJobs == 0 && baking) {
+				pendingJobs++;
+				pool->submit([this, path, sourceHash, settingsHash] { bake(path, sourceHash, settingsHash); });
+			}
+			pendingJobs--;
+		});
+	}
+	for (unsigned int i = 0; i < images.size(); i++) {
+		pool->submit([this, i] {
+			PendingImage & image = images[i];
+			image.data = SOIL_load_image(image.path.c_str(), &image.width, &image.height, &image.channels, SOIL_LOAD_AUTO);
+			unitsDone++;
+			queueUpload([this, i] { uploadImage(i); });
+			pendingJobs--;
+		});
+	}
+	// A scene without meshes is baked right away.
+	if (baking && meshes.empty()) {
+		pendingJobs++;
+		pool->submit([this, path, sourceHash, settingsHash] { bake(path, sourceHash, settingsHash); });
+	}
+	pendingJobs--;
+}
+
+void AsyncSceneLoader::addTexturePaths(const aiMaterial * material, std::set<std::string> & paths)
+{
+	const aiTextureType types[] = { aiTextureType_AMBIENT, aiTextureType_DIFFUSE, aiTextureType_SPECULAR, aiTextureType_NORMALS, aiTextureType_HEIGHT };
+	for (aiTextureType type : types) {
+		// The ambient texture is not loaded if it is taken from the diffuse one.
+		if (type == aiTextureType_AMBIENT && ambientFromDiffuse) continue;
+		if (material->GetTextureCount(type) == 0) continue;
+		aiString str;
+		material->GetTexture(type, 0, &str);
+		paths.insert(std::string("res\\").append(str.C_Str()));
+	}
+}
+
+void AsyncSceneLoader::bake(const std::string & path, unsigned long long sourceHash, unsigned long long settingsHash)
+{
+	// Only reads the meshes, so it runs alongside their uploads.
+	std::chrono::high_resolution_clock::time_point begin = std::chrono::high_resolution_clock::now();
+	SceneCache::bake(SceneCache::getCachePath(path), source, meshes, sourceHash, settingsHash);
+	bakeTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - begin).count();
+	unitsDone++;
+	pendingJobs--;
+}
+
+void AsyncSceneLoader::queueUpload(std::function<void()> upload)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	uploads.push_back(upload);
+}
+
+void AsyncSceneLoader::uploadImage(unsigned int i)
+{
+	PendingImage & image = images[i];
+	if (image.data == NULL) {
+		// The material tries to load it again and falls back to its default texture.
+		std::cerr << "AsyncSceneLoader.cpp: ERROR when decoding " << image.path << "." << std::endl;
+		return;
+	}
+	GLuint tex;
+	Utils::LoadTextureFromImageData(&tex, image.data, image.width, image.height, image.channels);
+	SOIL_free_image_data(image.data);
+	image.data = NULL;
+	textures.push_back(tex);
+	Utils::AddPreloadedTexture(image.path, tex);
+}
+
+bool AsyncSceneLoader::pump(double budgetMs)
+{
+	if (state != SCENE_LOAD_RUNNING) return state != SCENE_LOAD_IDLE;
+
+	std::chrono::high_resolution_clock::time_point begin = std::chrono::high_resolution_clock::now();
+	double used = 0.0;
+	bool first = true;
+	while (first || used < budgetMs) {
+		std::function<void()> upload;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if (uploads.empty()) break;
+			upload = uploads.front();
+			uploads.pop_front();
+		}
+		upload();
+		unitsDone++;
+		first = false;
+		used = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - begin).count();
+	}
+
+	// No job queues uploads anymore once none is pending.
+	if (pendingJobs > 0) return false;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (!uploads.empty()) return false;
+	}
+	if (source == NULL && !fromCache) {
+		state = SCENE_LOAD_FAILED;
+		return true;
+	}
+	// Creating the scene compiles its shaders, so it waits for a frame with budget left.
+	if (used < budgetMs) createScene();
+	return state != SCENE_LOAD_RUNNING;
+}
+
+void AsyncSceneLoader::createScene()
+{
+	if (fromCache) scene = new Scene(cache, ambientFromDiffuse, meshes);
+	else scene = new Scene(source, ambientFromDiffuse, meshes);
+	// The meshes belong to the scene now and the textures to its materials.
+	meshes.clear();
+	textures.clear();
+	images.clear();
+	Utils::ClearPreloadedTextures();
+	// The scene does not reference the aiScene or the cache (its meshes are uploaded).
+	importer.FreeScene();
+	source = NULL;
+	cache.close();
+
+	unitsDone++;
+	loadTime = elapsed();
+	state = SCENE_LOAD_DONE;
+	// The workers are not needed anymore.
+	delete pool;
+	pool = NULL;
+}
+
+SceneLoadState AsyncSceneLoader::getState()
+{
+	return state;
+}
+
+bool AsyncSceneLoader::isDone()
+{
+	return state == SCENE_LOAD_DONE;
+}
+
+float AsyncSceneLoader::getProgress()
+{
+	unsigned int total = unitsTotal;
+	if (total == 0) return 0.0f;
+	return std::min(float(unitsDone) / float(total), 1.0f);
+}
+
+std::string AsyncSceneLoader::getError()
+{
+	return error;
+}
+
+Scene * AsyncSceneLoader::getScene()
+{
+	return scene;
+}
+
+double AsyncSceneLoader::getParseTime()
+{
+	return parseTime;
+}
+
+double AsyncSceneLoader::getLoadTime()
+{
+	return loadTime;
+}
+
+bool AsyncSceneLoader::isFromCache()
+{
+	return fromCache;
+}
+
+double AsyncSceneLoader::getBakeTime()
+{
+	return bakeTime;
+}
+
+double AsyncSceneLoader::elapsed()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
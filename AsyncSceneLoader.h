@@ -0,0 +1,131 @@
+#pragma once
+
+#include "assimp\Importer.hpp"
+#include "assimp\scene.h"
+#include "assimp\postprocess.h"
+
+#include "Scene.h"
+#include "SceneCache.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+// Default time in milliseconds that AsyncSceneLoader::pump() spends per call (i.e. per frame).
+#define SCENE_LOAD_BUDGET_MS 4.0
+
+enum SceneLoadState {
+	SCENE_LOAD_IDLE = 0,
+	SCENE_LOAD_RUNNING = 1,
+	SCENE_LOAD_DONE = 2,
+	SCENE_LOAD_FAILED = 3
+};
+
+// Loads a scene file in the background while the render thread keeps drawing frames.
+// Parsing and post-processing with assimp, converting the meshes (including their
+// optimization and LODs) and decoding the images of the materials' textures run as jobs on
+// the loader's thread pool. Everything that needs the GL context (creating the textures and
+// the buffers of the meshes, and finally the Scene itself) is queued for the render thread,
+// which drains the queue with pump() within a time budget per frame. Single uploads are not
+// split, so a large texture can exceed the budget.
+// Unless disabled with setUseCache(), the loaded scene is baked into a SceneCache next to the
+// file, and later loads of the unchanged file with the same settings skip assimp and map the
+// cache instead.
+class AsyncSceneLoader
+{
+public:
+	// Load with nThreads worker threads (see ThreadPool).
+	AsyncSceneLoader(unsigned int nThreads = 0);
+	// Waits for the running jobs and deletes everything loaded but not handed to a Scene.
+	~AsyncSceneLoader();
+
+	// Start loading the file, post-processed with the aiPostProcessSteps in flags.
+	// ambientFromDiffuse is passed on to the Scene. A loader loads a single file.
+	void load(const std::string & path, unsigned int flags, bool ambientFromDiffuse = false);
+	// Whether to load from and bake the scene cache (default). Set before load().
+	void setUseCache(bool enabled);
+	// Run queued uploads on the calling thread, which must own the GL context, for up to
+	// budgetMs milliseconds (but at least one). Creates the Scene once all other work is
+	// done. Returns true once the loading is done or has failed.
+	bool pump(double budgetMs = SCENE_LOAD_BUDGET_MS);
+
+	SceneLoadState getState();
+	bool isDone();
+	// Fraction of the jobs and uploads done, from 0 to 1. Stays 0 until the file is parsed,
+	// since the amount of work is unknown until then.
+	float getProgress();
+	// Error message of assimp if the loading failed.
+	std::string getError();
+	// The loaded scene, or NULL until the loading is done. The caller takes ownership.
+	Scene * getScene();
+	// Time in milliseconds from load() until the file was parsed, and until the scene was
+	// created. Valid once the loading is done.
+	double getParseTime();
+	double getLoadTime();
+	// Whether the scene was loaded from its cache, and the time in milliseconds it took to
+	// bake the cache otherwise (0 if it was not baked).
+	bool isFromCache();
+	double getBakeTime();
+
+private:
+	// Image of a texture, decoded by a job and uploaded by the render thread.
+	struct PendingImage {
+		std::string path;
+		unsigned char * data = NULL;
+		int width = 0;
+		int height = 0;
+		int channels = 0;
+	};
+
+	ThreadPool * pool = NULL;
+	Assimp::Importer importer;
+	const aiScene * source = NULL;
+	bool ambientFromDiffuse = false;
+	SceneLoadState state = SCENE_LOAD_IDLE;
+	Scene * scene = NULL;
+	std::string error;
+	bool useCache = true;
+	// The cache of the file if it was valid, used instead of source.
+	SceneCache cache;
+	bool fromCache = false;
+	double bakeTime = 0.0;
+
+	// Converted meshes (one per aiMesh) and images, written by the jobs, and the textures
+	// uploaded so far. All of them belong to the scene once it is created.
+	std::vector<Mesh *> meshes;
+	std::vector<PendingImage> images;
+	std::vector<GLuint> textures;
+
+	// Work for the render thread, queued by the jobs whose results it uploads.
+	std::mutex mutex;
+	std::deque<std::function<void()>> uploads;
+	// Jobs queued or running, and units of work (jobs and uploads) done and in total.
+	std::atomic<unsigned int> pendingJobs;
+	std::atomic<unsigned int> unitsDone;
+	std::atomic<unsigned int> unitsTotal;
+	// Mesh conversions left before the cache can be baked.
+	std::atomic<unsigned int> meshJobs;
+
+	std::chrono::high_resolution_clock::time_point start;
+	double parseTime = 0.0;
+	double loadTime = 0.0;
+
+	// Job: parse the file (or open its cache) and queue the jobs converting its meshes and
+	// decoding its images.
+	void parse(const std::string & path, unsigned int flags);
+	// Job: bake the cache once all meshes are converted.
+	void bake(const std::string & path, unsigned long long sourceHash, unsigned long long settingsHash);
+	// Add the texture files of the material to paths.
+	void addTexturePaths(const aiMaterial * material, std::set<std::string> & paths);
+	void queueUpload(std::function<void()> upload);
+	void uploadImage(unsigned int i);
+	void createScene();
+	// Milliseconds since load().
+	double elapsed();
+};
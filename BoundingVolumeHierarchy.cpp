@@ -0,0 +1,158 @@
+#include "BoundingVolumeHierarchy.h"
+
+#include <algorithm>
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy()
+{
+}
+
+BoundingVolumeHierarchy::~BoundingVolumeHierarchy()
+{
+}
+
+void BoundingVolumeHierarchy::build(const std::vector<AABB> & boxes)
+{
+	clear();
+	if (boxes.empty()) return;
+
+	mins.resize(boxes.size());
+	maxs.resize(boxes.size());
+	centers.resize(boxes.size());
+	indices.resize(boxes.size());
+	for (unsigned int i = 0; i < boxes.size(); i++) {
+		mins[i] = boxes[i].min;
+		maxs[i] = boxes[i].max;
+		centers[i] = boxes[i].getCenter();
+		indices[i] = i;
+	}
+
+	// A binary tree with leaves of at least one box has less than 2 * n nodes.
+	nodes.reserve(2 * boxes.size());
+	Node root;
+	root.first = 0;
+	root.count = boxes.size();
+	root.children = 0;
+	nodes.push_back(root);
+	buildNode(0);
+
+	centers.clear();
+}
+
+void BoundingVolumeHierarchy::refit(const std::vector<AABB> & boxes)
+{
+	if (boxes.size() != indices.size()) {
+		build(boxes);
+		return;
+	}
+
+	for (unsigned int i = 0; i < boxes.size(); i++) {
+		mins[i] = boxes[i].min;
+		maxs[i] = boxes[i].max;
+	}
+	// Children are always stored after their parent, so going backwards visits them first.
+	for (unsigned int node = nodes.size(); node-- > 0;) {
+		Node & n = nodes[node];
+		if (n.children == 0) {
+			n.min = mins[indices[n.first]];
+			n.max = maxs[indices[n.first]];
+			for (unsigned int i = n.first + 1; i < n.first + n.count; i++) {
+				n.min = glm::min(n.min, mins[indices[i]]);
+				n.max = glm::max(n.max, maxs[indices[i]]);
+			}
+		}
+		else {
+			n.min = glm::min(nodes[n.children].min, nodes[n.children + 1].min);
+			n.max = glm::max(nodes[n.children].max, nodes[n.children + 1].max);
+		}
+	}
+}
+
+void BoundingVolumeHierarchy::cull(const Frustum & frustum, std::vector<unsigned int> & visible) const
+{
+	if (!nodes.empty()) cullNode(0, frustum, visible);
+}
+
+void BoundingVolumeHierarchy::clear()
+{
+	nodes.clear();
+	indices.clear();
+	mins.clear();
+	maxs.clear();
+}
+
+unsigned int BoundingVolumeHierarchy::getNumNodes()
+{
+	return nodes.size();
+}
+
+unsigned int BoundingVolumeHierarchy::getNumBoxes()
+{
+	return indices.size();
+}
+
+void BoundingVolumeHierarchy::buildNode(unsigned int node)
+{
+	unsigned int first = nodes[node].first;
+	unsigned int count = nodes[node].count;
+
+	glm::fvec3 min = mins[indices[first]];
+	glm::fvec3 max = maxs[indices[first]];
+	glm::fvec3 centerMin = centers[indices[first]];
+	glm::fvec3 centerMax = centerMin;
+	for (unsigned int i = first + 1; i < first + count; i++) {
+		min = glm::min(min, mins[indices[i]]);
+		max = glm::max(max, maxs[indices[i]]);
+		centerMin = glm::min(centerMin, centers[indices[i]]);
+		centerMax = glm::max(centerMax, centers[indices[i]]);
+	}
+	nodes[node].min = min;
+	nodes[node].max = max;
+
+	if (count <= BVH_MAX_LEAF_SIZE) return;
+
+	// Split at the median center along the axis with the largest spread of centers:
+	glm::fvec3 spread = centerMax - centerMin;
+	int axis = 0;
+	if (spread.y > spread[axis]) axis = 1;
+	if (spread.z > spread[axis]) axis = 2;
+
+	unsigned int half = count / 2;
+	std::nth_element(indices.begin() + first, indices.begin() + first + half, indices.begin() + first + count,
+		[this, axis](unsigned int a, unsigned int b) { return centers[a][axis] < centers[b][axis]; });
+
+	Node left, right;
+	left.first = first;
+	left.count = half;
+	left.children = 0;
+	right.first = first + half;
+	right.count = count - half;
+	right.children = 0;
+
+	unsigned int children = nodes.size();
+	nodes[node].children = children;
+	nodes.push_back(left);
+	nodes.push_back(right);
+	buildNode(children);
+	buildNode(children + 1);
+}
+
+void BoundingVolumeHierarchy::cullNode(unsigned int node, const Frustum & frustum, std::vector<unsigned int> & visible) const
+{
+	const Node & n = nodes[node];
+	FrustumTest res = frustum.test(n.min, n.max);
+	if (res == FRUSTUM_OUTSIDE) return;
+
+	if (res == FRUSTUM_INSIDE) {
+		visible.insert(visible.end(), indices.begin() + n.first, indices.begin() + n.first + n.count);
+		return;
+	}
+	if (n.children == 0) {
+		for (unsigned int i = n.first; i < n.first + n.count; i++) {
+			if (frustum.test(mins[indices[i]], maxs[indices[i]]) != FRUSTUM_OUTSIDE) visible.push_back(indices[i]);
+		}
+		return;
+	}
+
+	cullNode(n.children, frustum, visible);
+	cullNode(n.children + 1, frustum, visible);
+}
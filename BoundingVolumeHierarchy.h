@@ -0,0 +1,54 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include "Bounds.h"
+#include "Frustum.h"
+
+#include <vector>
+
+// Maximum number of boxes in a leaf of a BoundingVolumeHierarchy.
+#define BVH_MAX_LEAF_SIZE 4
+
+// Binary tree of axis-aligned boxes over a set of objects, used to frustum cull large
+// groups of objects with a single test. Subtrees completely inside the frustum are accepted
+// without testing their boxes, subtrees outside are skipped. When objects move, refit() the
+// hierarchy to their new boxes; build it again when objects are added or removed.
+class BoundingVolumeHierarchy
+{
+public:
+	BoundingVolumeHierarchy();
+	~BoundingVolumeHierarchy();
+
+	// Build the hierarchy over the boxes. Objects are referred to by their index in boxes.
+	void build(const std::vector<AABB> & boxes);
+	// Update the bounds of all nodes to new boxes of the same objects, keeping the tree. This
+	// is much cheaper than build(), but the tree gets less tight the more the objects move.
+	void refit(const std::vector<AABB> & boxes);
+	// Append the indices of all boxes intersecting the frustum to visible.
+	void cull(const Frustum & frustum, std::vector<unsigned int> & visible) const;
+	void clear();
+
+	unsigned int getNumNodes();
+	// Number of boxes the hierarchy was built over.
+	unsigned int getNumBoxes();
+
+private:
+	struct Node {
+		glm::fvec3 min;
+		glm::fvec3 max;
+		// Range in indices of the boxes below this node.
+		unsigned int first;
+		unsigned int count;
+		// Index of the first child (the second one follows it), or 0 for leaves.
+		unsigned int children;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<unsigned int> indices;
+	// Bounds of the boxes, and their centers while building.
+	std::vector<glm::fvec3> mins, maxs, centers;
+
+	void buildNode(unsigned int node);
+	void cullNode(unsigned int node, const Frustum & frustum, std::vector<unsigned int> & visible) const;
+};
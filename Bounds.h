@@ -0,0 +1,44 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+// Axis-aligned box given by its minimum and maximum corners. Used for culling; see
+// Colliders.h for the collision shapes.
+struct AABB {
+	glm::fvec3 min = glm::fvec3(0.0f);
+	glm::fvec3 max = glm::fvec3(0.0f);
+
+	glm::fvec3 getCenter() const { return (min + max) * 0.5f; }
+	glm::fvec3 getHalfSize() const { return (max - min) * 0.5f; }
+
+	// Bounds of the box transformed by m. The extent along each axis is the sum of the
+	// absolute contributions of the box's half sizes (Arvo).
+	AABB transform(const glm::fmat4 & m) const
+	{
+		glm::fvec3 halfSize = getHalfSize();
+		glm::fvec3 extent = glm::abs(glm::fvec3(m[0])) * halfSize.x + glm::abs(glm::fvec3(m[1])) * halfSize.y
+			+ glm::abs(glm::fvec3(m[2])) * halfSize.z;
+		glm::fvec3 center = glm::fvec3(m * glm::fvec4(getCenter(), 1.0f));
+		AABB res;
+		res.min = center - extent;
+		res.max = center + extent;
+		return res;
+	}
+};
+
+struct BoundingSphere {
+	glm::fvec3 center = glm::fvec3(0.0f);
+	float radius = 0.0f;
+
+	// Bounds of the sphere transformed by m. The radius is scaled by the largest scale
+	// factor, so non-uniform scaling stays conservative.
+	BoundingSphere transform(const glm::fmat4 & m) const
+	{
+		float scale2 = glm::max(glm::dot(glm::fvec3(m[0]), glm::fvec3(m[0])),
+			glm::max(glm::dot(glm::fvec3(m[1]), glm::fvec3(m[1])), glm::dot(glm::fvec3(m[2]), glm::fvec3(m[2]))));
+		BoundingSphere res;
+		res.center = glm::fvec3(m * glm::fvec4(center, 1.0f));
+		res.radius = radius * glm::sqrt(scale2);
+		return res;
+	}
+};
@@ -41,6 +41,33 @@ glm::fmat4 Camera::getProjectionMatrix()
 	return projection;
 }
 
+float Camera::getNearPlane()
+{
+	// Solve z_ndc(-d) = -1 for the view space depth d. This works for perspective
+	// (projection[2][3] = -1) as well as orthographic (projection[2][3] = 0) projections.
+	return (projection[3][2] + projection[3][3]) / (projection[2][2] + projection[2][3]);
+}
+
+float Camera::getFarPlane()
+{
+	return (projection[3][2] - projection[3][3]) / (projection[2][2] - projection[2][3]);
+}
+
+void Camera::getFrustumCorners(float nearDepth, float farDepth, glm::fvec3 corners[8])
+{
+	glm::fmat4 inv = glm::inverse(projection * transform.getTransformInverted());
+	float depths[2] = { nearDepth, farDepth };
+	for (int i = 0; i < 2; i++) {
+		// NDC depth of the view space depth -depths[i]:
+		glm::fvec4 clip = projection * glm::fvec4(0.0f, 0.0f, -depths[i], 1.0f);
+		float z = clip.z / clip.w;
+		for (int j = 0; j < 4; j++) {
+			glm::fvec4 p = inv * glm::fvec4((j & 1) ? 1.0f : -1.0f, (j & 2) ? 1.0f : -1.0f, z, 1.0f);
+			corners[4 * i + j] = glm::fvec3(p) / p.w;
+		}
+	}
+}
+
 void Camera::setView(glm::fmat4 view)
 {
 	transform.setTransformGlobalInverted(view);
@@ -70,7 +97,15 @@ void Camera::translate(float x, float y, float z)
 void Camera::setShaderMatrices(Shader * s)
 {
 	s->use();
-	s->setVec3("cameraPos", transform.getPositionGlobal());
-	s->setMat4("projection", projection);
-	s->setMat4("view", transform.getTransformInverted());
-}
\ No newline at end of file
+	s->set(s->uniforms.cameraPos, transform.getPositionGlobal());
+	s->set(s->uniforms.projection, projection);
+	s->set(s->uniforms.view, transform.getTransformInverted());
+}
+
+void Camera::writeUniformBlock(CameraBlock & block)
+{
+	block.projection = projection;
+	block.view = transform.getTransformInverted();
+	block.cameraPos = transform.getPositionGlobal();
+	block.padding = 0.0f;
+}
@@ -5,6 +5,16 @@
 #include "Transform3D.h"
 #include "Shader.h"
 
+// std140 layout of the "CameraBlock" uniform block. Must match the shaders.
+struct CameraBlock {
+	glm::fmat4 projection;
+	glm::fmat4 view;
+	glm::fvec3 cameraPos;
+	float padding;
+};
+
+static_assert(sizeof(CameraBlock) == 144, "CameraBlock does not match the std140 layout");
+
 class Camera
 {
 public:
@@ -16,6 +26,12 @@ public:
 	void setProjection(float rad, float aspectRatio);
 	void setProjection(float rad, float aspectRatio, float zNear, float zFar);
 	glm::fmat4 getProjectionMatrix();
+	// Distance of the near and far plane to the camera (taken from the projection matrix).
+	float getNearPlane();
+	float getFarPlane();
+	// Get the world space corners of the part of the view frustum between the distances
+	// nearDepth and farDepth: first the four corners at nearDepth, then those at farDepth.
+	void getFrustumCorners(float nearDepth, float farDepth, glm::fvec3 corners[8]);
 
 	void setView(glm::fmat4 view);
 	void lookAt(glm::fvec3 eye, glm::fvec3 tgt, glm::fvec3 up);
@@ -25,7 +41,10 @@ public:
 	void translate(glm::fvec3 v);
 	void translate(float x, float y, float z);
 
+	// Set the camera uniforms of a shader that does not use the camera uniform block.
 	void setShaderMatrices(Shader * s);
+	// Write the camera data for the camera uniform block.
+	void writeUniformBlock(CameraBlock & block);
 
 private:
 	Transform3D transform;
@@ -0,0 +1,117 @@
+#include "CommandBuffer.h"
+#include "Scene.h"
+
+CommandBuffer::CommandBuffer()
+{
+}
+
+CommandBuffer::~CommandBuffer()
+{
+	clear();
+}
+
+void CommandBuffer::createEntity3D(std::function<void(Scene*, EntityHandle)> init)
+{
+	Command cmd;
+	cmd.type = CMD_CREATE_ENTITY;
+	cmd.init = init;
+	commands.push_back(cmd);
+}
+
+void CommandBuffer::destroyEntity3D(EntityHandle h)
+{
+	Command cmd;
+	cmd.type = CMD_DESTROY_ENTITY;
+	cmd.entity = h;
+	commands.push_back(cmd);
+}
+
+void CommandBuffer::addComponent(EntityHandle h, Component * c)
+{
+	if (c == NULL) return;
+	Command cmd;
+	cmd.type = CMD_ADD_COMPONENT;
+	cmd.entity = h;
+	cmd.component = c;
+	commands.push_back(cmd);
+}
+
+void CommandBuffer::removeComponent(EntityHandle h, Component * c)
+{
+	if (c == NULL) return;
+	Command cmd;
+	cmd.type = CMD_REMOVE_COMPONENT;
+	cmd.entity = h;
+	cmd.component = c;
+	commands.push_back(cmd);
+}
+
+void CommandBuffer::record(std::function<void(Scene*)> command)
+{
+	Command cmd;
+	cmd.type = CMD_CUSTOM;
+	cmd.custom = command;
+	commands.push_back(cmd);
+}
+
+void CommandBuffer::execute(Scene * scene)
+{
+	// The commands may record further commands into this buffer (e.g. from an init function
+	// or an entity created callback). They go to a fresh list, which is executed next.
+	std::vector<Command> executing;
+	while (!commands.empty()) {
+		executing.swap(commands);
+		for (Command & cmd : executing)
+			execute(scene, cmd);
+		executing.clear();
+	}
+}
+
+void CommandBuffer::execute(Scene * scene, Command & cmd)
+{
+	switch (cmd.type) {
+	case CMD_CREATE_ENTITY: {
+		EntityHandle h = scene->createEntity3D();
+		if (cmd.init) cmd.init(scene, h);
+		break;
+	}
+	case CMD_DESTROY_ENTITY:
+		scene->destroyEntity3D(cmd.entity);
+		break;
+	case CMD_ADD_COMPONENT:
+		if (Entity3D * e = scene->getEntity3D(cmd.entity))
+			e->addComponent(cmd.component);
+		else
+			Component::destroy(cmd.component);
+		break;
+	case CMD_REMOVE_COMPONENT:
+		if (Entity3D * e = scene->getEntity3D(cmd.entity)) {
+			if (e->removeComponent(cmd.component))
+				Component::destroy(cmd.component);
+		}
+		break;
+	case CMD_CUSTOM:
+		if (cmd.custom) cmd.custom(scene);
+		break;
+	}
+	cmd.component = NULL;
+}
+
+void CommandBuffer::clear()
+{
+	for (Command & cmd : commands) {
+		if (cmd.type == CMD_ADD_COMPONENT)
+			Component::destroy(cmd.component);
+	}
+	commands.clear();
+}
+
+unsigned int CommandBuffer::size()
+{
+	return commands.size();
+}
+
+bool CommandBuffer::empty()
+{
+	return commands.empty();
+}
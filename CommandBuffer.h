@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Pool.h"
+#include "Component.h"
+
+#include <vector>
+#include <functional>
+
+class Scene;
+
+// Records structural changes of a Scene (creating and destroying entities, adding and
+// removing components) so that they can be applied later at a sync point, e.g. after all
+// Systems of a frame are done. This makes it safe to request such changes while iterating
+// over the scene or from worker threads, as long as every thread records into its own
+// CommandBuffer.
+class CommandBuffer
+{
+public:
+	CommandBuffer();
+	~CommandBuffer();
+
+	// Record the creation of an empty entity. If a function is passed, it is called with the
+	// handle of the new entity as soon as the entity has been created.
+	void createEntity3D(std::function<void(Scene *, EntityHandle)> init = nullptr);
+	// Record the destruction of an entity and all of its components.
+	void destroyEntity3D(EntityHandle h);
+	// Record attaching a component to an entity. The entity takes ownership of the component
+	// once the command is executed. If the entity no longer exists by then, the component is
+	// destroyed.
+	void addComponent(EntityHandle h, Component * c);
+	// Record detaching a component from an entity. The component is destroyed afterwards.
+	void removeComponent(EntityHandle h, Component * c);
+	// Record an arbitrary change to the scene.
+	void record(std::function<void(Scene *)> command);
+
+	// Apply all recorded commands to the scene in the order they were recorded, then clear
+	// the buffer. Commands recorded while executing are executed afterwards, until the
+	// buffer stays empty. Only call this from the thread that owns the scene.
+	void execute(Scene * scene);
+
+	// Discard all recorded commands. Components of pending addComponent commands are destroyed.
+	void clear();
+
+	unsigned int size();
+	bool empty();
+
+private:
+	enum CommandType {
+		CMD_CREATE_ENTITY,
+		CMD_DESTROY_ENTITY,
+		CMD_ADD_COMPONENT,
+		CMD_REMOVE_COMPONENT,
+		CMD_CUSTOM
+	};
+
+	struct Command {
+		CommandType type;
+		EntityHandle entity;
+		Component * component = NULL;
+		std::function<void(Scene *, EntityHandle)> init;
+		std::function<void(Scene *)> custom;
+	};
+
+	std::vector<Command> commands;
+
+	void execute(Scene * scene, Command & cmd);
+};
@@ -9,3 +9,21 @@ Transform3D * Component::getTransform()
 {
 	return parentTF;
 }
+
+void Component::setPool(PoolBase * pool, ComponentHandle handle)
+{
+	this->pool = pool;
+	this->handle = handle;
+}
+
+ComponentHandle Component::getHandle()
+{
+	return handle;
+}
+
+void Component::destroy(Component * c)
+{
+	if (c == NULL) return;
+	if (c->pool) c->pool->destroy(c->handle);
+	else delete c;
+}
@@ -1,17 +1,76 @@
 #pragma once
 
 #include "Transform3D.h"
+#include "Pool.h"
+#include "ComponentType.h"
+
+class Entity3D;
 
 class Component {
 public:
+	virtual ~Component() {};
+
 	virtual void update(double delta) = 0;
 
 	virtual void draw() { };
 
+	// Called after the component has been attached to an entity.
+	virtual void onAdd(Entity3D * /*entity*/) { };
+	// Called before the component is detached from an entity or destroyed together with it.
+	virtual void onRemove(Entity3D * /*entity*/) { };
+
+	// Returns the ID of the component's type. Implemented via the COMPONENT_TYPE macro.
+	virtual ComponentTypeID getTypeID() const = 0;
+
 	void setParentTransform(Transform3D * parent);
 
 	Transform3D * getTransform();
 
+	// Assign the pool this component is stored in. Components created by a Scene are
+	// pooled; all other components are allocated with new.
+	void setPool(PoolBase * pool, ComponentHandle handle);
+	// Returns the component's handle within its pool (null handle if not pooled).
+	ComponentHandle getHandle();
+
+	// Destroy the component. Pooled components are returned to their pool, all others
+	// are deleted.
+	static void destroy(Component * c);
+
 private:
 	Transform3D * parentTF = NULL;
-};
\ No newline at end of file
+
+	PoolBase * pool = NULL;
+	ComponentHandle handle;
+};
+
+// Non-allocating view of all components of type T attached to an entity. The view is
+// invalidated when components are added to or removed from the entity.
+template <typename T>
+class ComponentSpan
+{
+public:
+	class iterator {
+	public:
+		iterator(Component * const * ptr) : ptr(ptr) {};
+		T * operator*() const { return static_cast<T *>(*ptr); }
+		iterator & operator++() { ptr++; return *this; }
+		bool operator==(const iterator & it) const { return ptr == it.ptr; }
+		bool operator!=(const iterator & it) const { return ptr != it.ptr; }
+	private:
+		Component * const * ptr;
+	};
+
+	ComponentSpan() : first(NULL), count(0) {};
+	ComponentSpan(Component * const * first, unsigned int count) : first(first), count(count) {};
+
+	T * operator[](unsigned int i) const { return static_cast<T *>(first[i]); }
+	unsigned int size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	iterator begin() const { return iterator(first); }
+	iterator end() const { return iterator(first + count); }
+
+private:
+	Component * const * first;
+	unsigned int count;
+};
@@ -0,0 +1,17 @@
+#include "ComponentType.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+
+ComponentTypeID ComponentType::next()
+{
+	static std::atomic<unsigned int> counter(0);
+	ComponentTypeID id = counter++;
+	if (id >= MAX_COMPONENT_TYPES) {
+		// The ID would be out of range of ComponentMask and of the per-type arrays.
+		std::cerr << "ComponentType.cpp: ERROR when registering component type. MAX_COMPONENT_TYPES exceeded." << std::endl;
+		std::abort();
+	}
+	return id;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+// Maximum number of distinct component types. Every type used with ComponentType::get<T>()
+// occupies one bit of a ComponentMask.
+#define MAX_COMPONENT_TYPES 64
+
+typedef unsigned int ComponentTypeID;
+typedef unsigned long long ComponentMask;
+
+// Generates a unique, dense ID for every type it is instantiated with. The IDs are assigned
+// from a counter on first use and are stable for the lifetime of the program, so they can
+// be used as bit indices and array indices without any RTTI. Registering more than
+// MAX_COMPONENT_TYPES types aborts the program.
+class ComponentType
+{
+public:
+	// Returns the ID of type T.
+	template <typename T>
+	static ComponentTypeID get() {
+		static const ComponentTypeID id = next();
+		return id;
+	}
+
+	// Returns a mask with only the bit of type T set.
+	template <typename T>
+	static ComponentMask mask() {
+		return ComponentMask(1) << get<T>();
+	}
+
+	// Returns the number of bits set in the mask.
+	static unsigned int popcount(ComponentMask m) {
+#if defined(__GNUC__) || defined(__clang__)
+		return __builtin_popcountll(m);
+#else
+		m = m - ((m >> 1) & 0x5555555555555555ULL);
+		m = (m & 0x3333333333333333ULL) + ((m >> 2) & 0x3333333333333333ULL);
+		m = (m + (m >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+		return (unsigned int) ((m * 0x0101010101010101ULL) >> 56);
+#endif
+	}
+
+private:
+	static ComponentTypeID next();
+};
+
+// Implements Component::getTypeID() for a component class. Place this in the declaration of
+// every component class that should be retrievable via Entity3D::getComponent<T>(). Classes
+// derived from a component without their own COMPONENT_TYPE are found as their base class.
+#define COMPONENT_TYPE(T) \
+	public: \
+	virtual ComponentTypeID getTypeID() const { return ComponentType::get<T>(); } \
+	private:
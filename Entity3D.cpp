@@ -1,6 +1,8 @@
 #include "Entity3D.h"
 #include "PolygonModel.h"
 
+#include <algorithm>
+
 
 Entity3D::Entity3D()
 {
@@ -9,8 +11,10 @@ Entity3D::Entity3D()
 
 Entity3D::~Entity3D()
 {
-	for (Component * c : components)
-		delete c;
+	for (Component * c : components) {
+		c->onRemove(this);
+		Component::destroy(c);
+	}
 	components.clear();
 }
 
@@ -39,10 +43,41 @@ Transform3D * Entity3D::getTransform()
 	return &transform;
 }
 
+EntityHandle Entity3D::getHandle()
+{
+	return handle;
+}
+
+void Entity3D::setHandle(EntityHandle h)
+{
+	handle = h;
+}
+
+void Entity3D::setName(std::string name)
+{
+	this->name = name;
+}
+
+std::string Entity3D::getName()
+{
+	return name;
+}
+
 void Entity3D::addComponent(Component * c)
 {
-	components.push_back(c);
+	if (c == NULL) return;
+
+	// Insert behind the last component with the same or a lower type ID to keep the
+	// components grouped by type:
+	ComponentTypeID id = c->getTypeID();
+	std::vector<Component *>::iterator it = components.begin();
+	while (it != components.end() && (*it)->getTypeID() <= id)
+		it++;
+	components.insert(it, c);
 	c->setParentTransform(&transform);
+
+	rebuildTypeRanges();
+	c->onAdd(this);
 }
 
 Component * Entity3D::getComponent(unsigned int i)
@@ -64,7 +99,9 @@ Component * Entity3D::removeComponent(unsigned int i)
 		return NULL;
 	}
 	Component * ret = components[i];
+	ret->onRemove(this);
 	components.erase(components.begin() + i);
+	rebuildTypeRanges();
 	return ret;
 }
 
@@ -74,7 +111,9 @@ Component * Entity3D::removeComponent(Component * c)
 
 	std::vector<Component *>::iterator it = std::find(components.begin(), components.end(), c);
 	if (it != components.end()) {
+		c->onRemove(this);
 		components.erase(it);
+		rebuildTypeRanges();
 		return c;
 	}
 	return NULL;
@@ -82,7 +121,46 @@ Component * Entity3D::removeComponent(Component * c)
 
 void Entity3D::deleteComponents()
 {
-	for (Component * c : components)
-		delete c;
+	for (Component * c : components) {
+		c->onRemove(this);
+		Component::destroy(c);
+	}
 	components.clear();
+	rebuildTypeRanges();
+}
+
+ComponentMask Entity3D::getComponentMask()
+{
+	return componentMask;
+}
+
+bool Entity3D::hasComponents(ComponentMask mask)
+{
+	return (componentMask & mask) == mask;
+}
+
+void Entity3D::rebuildTypeRanges()
+{
+	componentMask = 0;
+	typeRanges.clear();
+	for (unsigned int i = 0; i < components.size(); i++) {
+		ComponentTypeID id = components[i]->getTypeID();
+		if (componentMask & (ComponentMask(1) << id)) {
+			typeRanges.back().count++;
+		}
+		else {
+			componentMask |= ComponentMask(1) << id;
+			TypeRange r;
+			r.first = i;
+			r.count = 1;
+			typeRanges.push_back(r);
+		}
+	}
+}
+
+const Entity3D::TypeRange * Entity3D::findTypeRange(ComponentTypeID id) const
+{
+	ComponentMask bit = ComponentMask(1) << id;
+	if (!(componentMask & bit)) return NULL;
+	return &typeRanges[ComponentType::popcount(componentMask & (bit - 1))];
 }
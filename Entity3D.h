@@ -1,15 +1,34 @@
 #pragma once
 
 #include "Component.h"
+#include "ComponentType.h"
 #include "Transform3D.h"
+#include "Pool.h"
 
 #include <vector>
+#include <string>
 
 class Entity3D
 {
 private:
+	// Components, grouped by type ID in ascending order.
 	std::vector<Component*> components;
 	Transform3D transform = Transform3D();
+	EntityHandle handle;
+	std::string name;
+
+	// One bit per component type attached to this entity.
+	ComponentMask componentMask = 0;
+	// Position of the first component and number of components of every type in the mask,
+	// ordered by type ID. The entry of a type is found by counting the mask bits below it.
+	struct TypeRange {
+		unsigned short first;
+		unsigned short count;
+	};
+	std::vector<TypeRange> typeRanges;
+
+	void rebuildTypeRanges();
+	const TypeRange * findTypeRange(ComponentTypeID id) const;
 
 public:
 	Entity3D();
@@ -22,48 +41,51 @@ public:
 
 	Transform3D * getTransform();
 
+	// Returns the entity's handle within the Scene's entity pool (null handle if the
+	// entity was not created by a Scene).
+	EntityHandle getHandle();
+	void setHandle(EntityHandle h);
+
+	void setName(std::string name);
+	std::string getName();
+
 	void addComponent(Component * c);
 	Component * getComponent(unsigned int i);
 	unsigned int getNumComponents();
 
+	// Detach a component without destroying it. Adding or removing components invalidates
+	// ComponentSpans of the entity, so record such changes in a CommandBuffer while iterating.
 	Component * removeComponent(unsigned int i);
 	Component * removeComponent(Component * c);
 	void deleteComponents();
 
+	// Returns the mask of all component types attached to this entity.
+	ComponentMask getComponentMask();
+	// Returns whether components of all types in the mask are attached to this entity.
+	bool hasComponents(ComponentMask mask);
 
+	// Returns the first component of type T, or NULL. O(1), no RTTI involved.
 	template <typename T>
 	T * getComponent() {
-		for (Component * c : components) {
-			if (T * ret = dynamic_cast<T*>(c))
-				return ret;
-		}
-		return NULL;
+		const TypeRange * r = findTypeRange(ComponentType::get<T>());
+		if (r == NULL) return NULL;
+		return static_cast<T*>(components[r->first]);
 	}
 
+	// Returns the number of components of type T. O(1).
 	template <typename T>
 	int getNumComponentsOfType() {
-		int i = 0;
-		for (Component * c : components) {
-			if (dynamic_cast<T>(c))
-				i++;
-		}
-		return i;
+		const TypeRange * r = findTypeRange(ComponentType::get<T>());
+		if (r == NULL) return 0;
+		return r->count;
 	}
 
+	// Returns a view of all components of type T. O(1), nothing is allocated.
 	template <typename T>
-	T * getComponents(int * outNComponentsOfT = NULL) {
-		int c = getNumComponentsOfType<T>();
-		if (outNComponentsOfT) *outNComponentsOfT = c;
-		T ret[c];
-		int i = 0;
-		for (Component * c : components) {
-			if (T * t = dynamic_cast<T>(c)) {
-				ret[i] = t;
-				i++;
-			}
-		}
-		return ret;
+	ComponentSpan<T> getComponents() {
+		const TypeRange * r = findTypeRange(ComponentType::get<T>());
+		if (r == NULL) return ComponentSpan<T>();
+		return ComponentSpan<T>(&components[r->first], r->count);
 	}
 
 };
-
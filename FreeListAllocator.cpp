@@ -0,0 +1,86 @@
+#include "FreeListAllocator.h"
+
+FreeListAllocator::FreeListAllocator(unsigned int capacity)
+{
+	grow(capacity);
+}
+
+unsigned int FreeListAllocator::allocate(unsigned int size, unsigned int alignment)
+{
+	if (size == 0) return FREE_LIST_INVALID;
+	if (alignment == 0) alignment = 1;
+
+	for (std::map<unsigned int, unsigned int>::iterator it = freeBlocks.begin(); it != freeBlocks.end(); it++) {
+		unsigned int blockOffset = it->first, blockSize = it->second;
+		unsigned int offset = (blockOffset + alignment - 1) / alignment * alignment;
+		unsigned int padding = offset - blockOffset;
+		if (padding >= blockSize || blockSize - padding < size) continue;
+
+		// The padding in front stays a free block, the rest after the range becomes one.
+		if (padding > 0) it->second = padding;
+		else freeBlocks.erase(it);
+		unsigned int rest = blockSize - padding - size;
+		if (rest > 0) freeBlocks[offset + size] = rest;
+		used += size;
+		return offset;
+	}
+	return FREE_LIST_INVALID;
+}
+
+void FreeListAllocator::free(unsigned int offset, unsigned int size)
+{
+	if (size == 0 || offset == FREE_LIST_INVALID) return;
+	used -= size;
+
+	// Merge with the free block after the range:
+	std::map<unsigned int, unsigned int>::iterator next = freeBlocks.lower_bound(offset);
+	if (next != freeBlocks.end() && next->first == offset + size) {
+		size += next->second;
+		next = freeBlocks.erase(next);
+	}
+	// and with the one before it:
+	if (next != freeBlocks.begin()) {
+		std::map<unsigned int, unsigned int>::iterator prev = next;
+		prev--;
+		if (prev->first + prev->second == offset) {
+			prev->second += size;
+			return;
+		}
+	}
+	freeBlocks.insert(next, std::make_pair(offset, size));
+}
+
+void FreeListAllocator::grow(unsigned int capacity)
+{
+	if (capacity <= this->capacity) return;
+	unsigned int added = capacity - this->capacity;
+	unsigned int offset = this->capacity;
+	this->capacity = capacity;
+	// Hand the new units to free(), which merges them with a free block at the old end.
+	used += added;
+	free(offset, added);
+}
+
+unsigned int FreeListAllocator::getCapacity()
+{
+	return capacity;
+}
+
+unsigned int FreeListAllocator::getUsed()
+{
+	return used;
+}
+
+unsigned int FreeListAllocator::getLargestFreeBlock()
+{
+	unsigned int largest = 0;
+	for (const std::pair<const unsigned int, unsigned int> & block : freeBlocks) {
+		if (block.second > largest) largest = block.second;
+	}
+	return largest;
+}
+
+unsigned int FreeListAllocator::getNumFreeBlocks()
+{
+	return freeBlocks.size();
+}
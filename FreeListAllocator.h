@@ -0,0 +1,36 @@
+#pragma once
+
+#include <map>
+
+// Returned by FreeListAllocator::allocate() if no free block is large enough.
+#define FREE_LIST_INVALID 0xFFFFFFFFu
+
+// Sub-allocates ranges of [0, capacity) (in arbitrary units, e.g. vertices or bytes of a
+// buffer object). The free blocks are kept sorted by offset: allocations take the first
+// block that fits, and freed ranges are merged with their free neighbours, so the free list
+// stays short as long as allocations and frees roughly balance.
+class FreeListAllocator
+{
+public:
+	FreeListAllocator(unsigned int capacity = 0);
+
+	// Allocate size units at a multiple of alignment. Returns the offset, or
+	// FREE_LIST_INVALID if no free block is large enough (see grow()).
+	unsigned int allocate(unsigned int size, unsigned int alignment = 1);
+	// Free a range returned by allocate(), with the size passed to it.
+	void free(unsigned int offset, unsigned int size);
+	// Increase the capacity. The new units at the end are free.
+	void grow(unsigned int capacity);
+
+	unsigned int getCapacity();
+	// Number of allocated units (without the alignment padding, which stays free).
+	unsigned int getUsed();
+	unsigned int getLargestFreeBlock();
+	unsigned int getNumFreeBlocks();
+
+private:
+	// Offset -> size of the free blocks.
+	std::map<unsigned int, unsigned int> freeBlocks;
+	unsigned int capacity = 0;
+	unsigned int used = 0;
+};
@@ -0,0 +1,139 @@
+#include "Frustum.h"
+
+#ifdef FRUSTUM_SSE
+#include <xmmintrin.h>
+#endif
+
+Frustum::Frustum()
+{
+	setMatrix(glm::fmat4(1.0f));
+}
+
+Frustum::Frustum(const glm::fmat4 & projectionView, bool nearPlane)
+{
+	setMatrix(projectionView, nearPlane);
+}
+
+void Frustum::setMatrix(const glm::fmat4 & projectionView, bool nearPlane)
+{
+	// Gribb/Hartmann: each plane is the sum or difference of the fourth and another row of
+	// the matrix (glm matrices are column-major, so row i is m[0][i], ..., m[3][i]).
+	glm::fvec4 rows[4];
+	for (int i = 0; i < 4; i++)
+		rows[i] = glm::fvec4(projectionView[0][i], projectionView[1][i], projectionView[2][i], projectionView[3][i]);
+
+	planes[FRUSTUM_PLANE_LEFT] = rows[3] + rows[0];
+	planes[FRUSTUM_PLANE_RIGHT] = rows[3] - rows[0];
+	planes[FRUSTUM_PLANE_BOTTOM] = rows[3] + rows[1];
+	planes[FRUSTUM_PLANE_TOP] = rows[3] - rows[1];
+	planes[FRUSTUM_PLANE_NEAR] = rows[3] + rows[2];
+	planes[FRUSTUM_PLANE_FAR] = rows[3] - rows[2];
+
+	// Normalize, so the plane equation yields distances (needed for the sphere tests):
+	for (int i = 0; i < 6; i++) {
+		float len = glm::length(glm::fvec3(planes[i]));
+		if (len > 0.0f) planes[i] /= len;
+	}
+
+	// A plane every point is in front of:
+	if (!nearPlane) planes[FRUSTUM_PLANE_NEAR] = glm::fvec4(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+glm::fvec4 Frustum::getPlane(unsigned int i) const
+{
+	return planes[i];
+}
+
+bool Frustum::intersects(const BoundingSphere & sphere) const
+{
+	return intersects(sphere.center, sphere.radius);
+}
+
+bool Frustum::intersects(glm::fvec3 center, float radius) const
+{
+	for (int i = 0; i < 6; i++) {
+		if (glm::dot(glm::fvec3(planes[i]), center) + planes[i].w < -radius) return false;
+	}
+	return true;
+}
+
+bool Frustum::intersects(const AABB & box) const
+{
+	return test(box) != FRUSTUM_OUTSIDE;
+}
+
+FrustumTest Frustum::test(glm::fvec3 min, glm::fvec3 max) const
+{
+	FrustumTest res = FRUSTUM_INSIDE;
+	for (int i = 0; i < 6; i++) {
+		glm::fvec3 n = glm::fvec3(planes[i]);
+		// Corner furthest along the normal and the opposite corner:
+		glm::fvec3 p(n.x >= 0.0f ? max.x : min.x, n.y >= 0.0f ? max.y : min.y, n.z >= 0.0f ? max.z : min.z);
+		glm::fvec3 q(n.x >= 0.0f ? min.x : max.x, n.y >= 0.0f ? min.y : max.y, n.z >= 0.0f ? min.z : max.z);
+		if (glm::dot(n, p) + planes[i].w < 0.0f) return FRUSTUM_OUTSIDE;
+		if (glm::dot(n, q) + planes[i].w < 0.0f) res = FRUSTUM_INTERSECTS;
+	}
+	return res;
+}
+
+FrustumTest Frustum::test(const AABB & box) const
+{
+	return test(box.min, box.max);
+}
+
+unsigned int Frustum::cullSpheres(const float * x, const float * y, const float * z, const float * radius,
+	unsigned int count, unsigned char * visible) const
+{
+#ifdef FRUSTUM_SSE
+	__m128 px[6], py[6], pz[6], pw[6];
+	for (int i = 0; i < 6; i++) {
+		px[i] = _mm_set1_ps(planes[i].x);
+		py[i] = _mm_set1_ps(planes[i].y);
+		pz[i] = _mm_set1_ps(planes[i].z);
+		pw[i] = _mm_set1_ps(planes[i].w);
+	}
+	const __m128 zero = _mm_setzero_ps();
+
+	unsigned int nVisible = 0;
+	unsigned int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 sx = _mm_loadu_ps(x + i);
+		__m128 sy = _mm_loadu_ps(y + i);
+		__m128 sz = _mm_loadu_ps(z + i);
+		__m128 negRadius = _mm_sub_ps(zero, _mm_loadu_ps(radius + i));
+
+		// A sphere is visible if its signed distance to every plane is at least -radius.
+		__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(px[0], sx), _mm_mul_ps(py[0], sy)),
+			_mm_add_ps(_mm_mul_ps(pz[0], sz), pw[0])), negRadius);
+		for (int j = 1; j < 6; j++) {
+			__m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[j], sx), _mm_mul_ps(py[j], sy)),
+				_mm_add_ps(_mm_mul_ps(pz[j], sz), pw[j]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, negRadius));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for (int j = 0; j < 4; j++) {
+			visible[i + j] = (mask >> j) & 1;
+			nVisible += visible[i + j];
+		}
+	}
+
+	// Remaining spheres:
+	if (i < count)
+		nVisible += cullSpheresScalar(x + i, y + i, z + i, radius + i, count - i, visible + i);
+	return nVisible;
+#else
+	return cullSpheresScalar(x, y, z, radius, count, visible);
+#endif
+}
+
+unsigned int Frustum::cullSpheresScalar(const float * x, const float * y, const float * z, const float * radius,
+	unsigned int count, unsigned char * visible) const
+{
+	unsigned int nVisible = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		visible[i] = intersects(glm::fvec3(x[i], y[i], z[i]), radius[i]) ? 1 : 0;
+		nVisible += visible[i];
+	}
+	return nVisible;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include "Bounds.h"
+
+// SSE is available on all x64 targets and on x86 if enabled by the compiler.
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_SSE
+#endif
+
+#define FRUSTUM_PLANE_LEFT 0
+#define FRUSTUM_PLANE_RIGHT 1
+#define FRUSTUM_PLANE_BOTTOM 2
+#define FRUSTUM_PLANE_TOP 3
+#define FRUSTUM_PLANE_NEAR 4
+#define FRUSTUM_PLANE_FAR 5
+
+// Result of testing a bounding volume against a Frustum.
+enum FrustumTest {
+	FRUSTUM_OUTSIDE = 0,
+	FRUSTUM_INTERSECTS = 1,
+	FRUSTUM_INSIDE = 2
+};
+
+// View frustum given by the 6 planes of a projection * view matrix. The tests are
+// conservative: a volume is only reported as outside if it is completely behind one of the
+// planes.
+class Frustum
+{
+public:
+	Frustum();
+	Frustum(const glm::fmat4 & projectionView, bool nearPlane = true);
+
+	// Extract the planes from a projection * view matrix. If nearPlane is false, nothing is
+	// culled by the near plane, e.g. for shadow casters between the light and the shadow
+	// volume, whose depth is clamped to the near plane ("pancaking").
+	void setMatrix(const glm::fmat4 & projectionView, bool nearPlane = true);
+	// Plane i as (normal, d), where dot(normal, p) + d >= 0 for points p inside.
+	glm::fvec4 getPlane(unsigned int i) const;
+
+	bool intersects(const BoundingSphere & sphere) const;
+	bool intersects(glm::fvec3 center, float radius) const;
+	bool intersects(const AABB & box) const;
+	// Test the box given by its minimum and maximum corners.
+	FrustumTest test(glm::fvec3 min, glm::fvec3 max) const;
+	FrustumTest test(const AABB & box) const;
+
+	// Test count spheres given as packed arrays of their centers and radii. visible[i] is
+	// set to 1 if sphere i intersects the frustum and to 0 otherwise. Four spheres are
+	// tested at once if SSE is available. Returns the number of visible spheres.
+	unsigned int cullSpheres(const float * x, const float * y, const float * z, const float * radius,
+		unsigned int count, unsigned char * visible) const;
+	// Scalar version of cullSpheres().
+	unsigned int cullSpheresScalar(const float * x, const float * y, const float * z, const float * radius,
+		unsigned int count, unsigned char * visible) const;
+
+private:
+	glm::fvec4 planes[6];
+};
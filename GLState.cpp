@@ -0,0 +1,81 @@
+#include "GLState.h"
+#include "RenderStats.h"
+
+GLuint GLState::program = 0;
+GLuint GLState::vao = 0;
+GLuint GLState::activeUnit = 0;
+GLuint GLState::textures[GLSTATE_MAX_TEXTURE_UNITS] = {};
+GLenum GLState::targets[GLSTATE_MAX_TEXTURE_UNITS] = {};
+glm::fvec4 GLState::attribs[GLSTATE_MAX_VERTEX_ATTRIBS];
+bool GLState::attribsValid[GLSTATE_MAX_VERTEX_ATTRIBS] = {};
+bool GLState::valid = false;
+
+void GLState::useProgram(GLuint program)
+{
+	if (!valid) invalidate();
+	if (GLState::program == program) return;
+	glUseProgram(program);
+	GLState::program = program;
+	renderStats.programBinds++;
+}
+
+void GLState::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	if (!valid) invalidate();
+	if (unit >= GLSTATE_MAX_TEXTURE_UNITS) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(target, texture);
+		activeUnit = unit;
+		renderStats.textureBinds++;
+		return;
+	}
+	if (textures[unit] == texture && targets[unit] == target) return;
+	if (activeUnit != unit) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		activeUnit = unit;
+	}
+	glBindTexture(target, texture);
+	textures[unit] = texture;
+	targets[unit] = target;
+	renderStats.textureBinds++;
+}
+
+void GLState::bindVertexArray(GLuint vao)
+{
+	if (!valid) invalidate();
+	if (GLState::vao == vao) return;
+	glBindVertexArray(vao);
+	GLState::vao = vao;
+}
+
+void GLState::setVertexAttrib(GLuint index, const glm::fvec4 & value)
+{
+	if (!valid) invalidate();
+	if (index < GLSTATE_MAX_VERTEX_ATTRIBS) {
+		if (attribsValid[index] && attribs[index] == value) return;
+		attribs[index] = value;
+		attribsValid[index] = true;
+	}
+	glVertexAttrib4f(index, value.x, value.y, value.z, value.w);
+}
+
+void GLState::invalidate()
+{
+	// Query the current bindings instead of guessing them, so that the cache is valid
+	// again right away.
+	GLint value;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &value);
+	program = value;
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &value);
+	vao = value;
+	glGetIntegerv(GL_ACTIVE_TEXTURE, &value);
+	activeUnit = value - GL_TEXTURE0;
+	// Texture bindings depend on the target, so they are not queried.
+	for (unsigned int i = 0; i < GLSTATE_MAX_TEXTURE_UNITS; i++) {
+		textures[i] = 0xFFFFFFFF;
+		targets[i] = 0;
+	}
+	for (unsigned int i = 0; i < GLSTATE_MAX_VERTEX_ATTRIBS; i++)
+		attribsValid[i] = false;
+	valid = true;
+}
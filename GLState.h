@@ -0,0 +1,38 @@
+#pragma once
+
+#include <glad\glad.h>
+#include <glm\glm.hpp>
+
+// Number of texture units tracked by GLState.
+#define GLSTATE_MAX_TEXTURE_UNITS 32
+// Number of generic vertex attributes whose constant values are tracked by GLState.
+#define GLSTATE_MAX_VERTEX_ATTRIBS 16
+
+// Cache of the GL bindings that change most often while drawing (program, textures and
+// vertex array). Binds of objects that are already bound are skipped. The cache is only
+// valid as long as these bindings are changed through GLState, so call invalidate() after
+// code that binds them directly (e.g. at the beginning of every frame).
+class GLState
+{
+public:
+	static void useProgram(GLuint program);
+	// Bind a texture to the given texture unit (0 = GL_TEXTURE0).
+	static void bindTexture(GLuint unit, GLenum target, GLuint texture);
+	static void bindVertexArray(GLuint vao);
+	// Set the constant value of a generic vertex attribute, used by shaders when the bound
+	// vertex array does not source the attribute from a buffer.
+	static void setVertexAttrib(GLuint index, const glm::fvec4 & value);
+
+	// Forget all cached bindings, so the next bind of every kind is executed.
+	static void invalidate();
+
+private:
+	static GLuint program;
+	static GLuint vao;
+	static GLuint activeUnit;
+	static GLuint textures[GLSTATE_MAX_TEXTURE_UNITS];
+	static GLenum targets[GLSTATE_MAX_TEXTURE_UNITS];
+	static glm::fvec4 attribs[GLSTATE_MAX_VERTEX_ATTRIBS];
+	static bool attribsValid[GLSTATE_MAX_VERTEX_ATTRIBS];
+	static bool valid;
+};
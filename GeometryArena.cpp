@@ -0,0 +1,221 @@
+#include "GeometryArena.h"
+#include "GLState.h"
+#include "Mesh.h"
+#include "RenderStats.h"
+
+#include <algorithm>
+
+// Alignment of the index ranges in bytes, enough for every index type.
+#define INDEX_ALIGNMENT 4
+
+std::vector<GeometryArena *> GeometryArena::arenas;
+
+GeometryArena * GeometryArena::get(const VertexLayout & layout)
+{
+	for (GeometryArena * arena : arenas) {
+		if (arena->layout == layout) return arena;
+	}
+	GeometryArena * arena = new GeometryArena(layout);
+	arenas.push_back(arena);
+	return arena;
+}
+
+void GeometryArena::deleteAll()
+{
+	for (GeometryArena * arena : arenas)
+		delete arena;
+	arenas.clear();
+}
+
+void GeometryArena::printStats(std::ostream & out)
+{
+	for (GeometryArena * arena : arenas) {
+		out << "Geometry arena (" << arena->layout.getStride() << " bytes per vertex): vertices "
+			<< arena->vertices.getUsed() << " / " << arena->vertices.getCapacity()
+			<< ", index bytes " << arena->indices.getUsed() << " / " << arena->indices.getCapacity()
+			<< ", free blocks " << arena->vertices.getNumFreeBlocks() << " / " << arena->indices.getNumFreeBlocks() << std::endl;
+	}
+}
+
+GeometryArena::GeometryArena(const VertexLayout & layout)
+{
+	this->layout = layout;
+	vertices.grow(GEOMETRY_ARENA_INITIAL_VERTICES);
+	indices.grow(GEOMETRY_ARENA_INITIAL_INDEX_BYTES);
+
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &VBO);
+	glGenBuffers(1, &EBO);
+
+	GLState::bindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertices.getCapacity() * layout.getStride(), NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.getCapacity(), NULL, GL_STATIC_DRAW);
+	layout.setupAttributes();
+	GLState::bindVertexArray(0);
+}
+
+GeometryArena::~GeometryArena()
+{
+	GLState::bindVertexArray(0);
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &VBO);
+	glDeleteBuffers(1, &EBO);
+}
+
+GeometryRange GeometryArena::allocate(unsigned int vertexCount, unsigned int indexBytes)
+{
+	GeometryRange range;
+	range.vertexCount = vertexCount;
+	range.indexBytes = indexBytes;
+
+	range.firstVertex = vertices.allocate(vertexCount);
+	if (range.firstVertex == FREE_LIST_INVALID) {
+		// The new space follows the last free block, so together they always fit the range.
+		growVertices(vertices.getCapacity() + vertexCount);
+		range.firstVertex = vertices.allocate(vertexCount);
+	}
+	range.indexOffset = indices.allocate(indexBytes, INDEX_ALIGNMENT);
+	if (range.indexOffset == FREE_LIST_INVALID) {
+		growIndices(indices.getCapacity() + indexBytes + INDEX_ALIGNMENT);
+		range.indexOffset = indices.allocate(indexBytes, INDEX_ALIGNMENT);
+	}
+	return range;
+}
+
+void GeometryArena::free(GeometryRange & range)
+{
+	vertices.free(range.firstVertex, range.vertexCount);
+	indices.free(range.indexOffset, range.indexBytes);
+	range = GeometryRange();
+}
+
+void GeometryArena::uploadVertices(const GeometryRange & range, const void * data)
+{
+	GLsizeiptr size = (GLsizeiptr)range.vertexCount * layout.getStride();
+	glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)range.firstVertex * layout.getStride(), size, data);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	renderStats.bufferBytesUploaded += size;
+}
+
+void GeometryArena::uploadIndices(const GeometryRange & range, const void * data)
+{
+	glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, range.indexOffset, range.indexBytes, data);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	renderStats.bufferBytesUploaded += range.indexBytes;
+}
+
+void GeometryArena::setInstanceBuffer(GLuint buffer, GLintptr offset, GLuint divisor)
+{
+	if (buffer == instanceBuffer && offset == instanceOffset && divisor == instanceDivisor) return;
+
+	GLState::bindVertexArray(VAO);
+	Mesh::setupInstanceAttributes(buffer, offset, divisor);
+	instanceBuffer = buffer;
+	instanceOffset = offset;
+	instanceDivisor = divisor;
+}
+
+void GeometryArena::multiDraw(GLenum indexType, const DrawElementsIndirectCommand * commands, unsigned int count,
+	GLintptr indirectOffset, GLuint instanceBuffer, GLuint divisor)
+{
+	if (count == 0) return;
+	unsigned int indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+
+	GLState::bindVertexArray(VAO);
+	if (hasMultiDrawIndirect()) {
+		setInstanceBuffer(instanceBuffer, 0, divisor);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (void*)indirectOffset, count, 0);
+		renderStats.drawCalls++;
+	}
+	else if (GLAD_GL_ARB_base_instance) {
+		setInstanceBuffer(instanceBuffer, 0, divisor);
+		for (unsigned int i = 0; i < count; i++) {
+			const DrawElementsIndirectCommand & c = commands[i];
+			glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, c.count, indexType, (void*)((size_t)c.firstIndex * indexSize),
+				c.instanceCount, c.baseVertex, c.baseInstance);
+		}
+		renderStats.drawCalls += count;
+	}
+	else {
+		for (unsigned int i = 0; i < count; i++) {
+			const DrawElementsIndirectCommand & c = commands[i];
+			setInstanceBuffer(instanceBuffer, (GLintptr)c.baseInstance * sizeof(InstanceData), divisor);
+			glDrawElementsInstancedBaseVertex(GL_TRIANGLES, c.count, indexType, (void*)((size_t)c.firstIndex * indexSize),
+				c.instanceCount, c.baseVertex);
+		}
+		renderStats.drawCalls += count;
+	}
+	for (unsigned int i = 0; i < count; i++)
+		renderStats.trianglesDrawn += (unsigned long long)commands[i].count / 3 * commands[i].instanceCount;
+	renderStats.multiDrawCalls++;
+	renderStats.multiDrawCommands += count;
+}
+
+bool GeometryArena::hasMultiDrawIndirect()
+{
+	return GLAD_GL_ARB_multi_draw_indirect && GLAD_GL_ARB_draw_indirect && GLAD_GL_ARB_base_instance;
+}
+
+const VertexLayout & GeometryArena::getLayout()
+{
+	return layout;
+}
+
+GLuint GeometryArena::getVAO()
+{
+	return VAO;
+}
+
+GLuint GeometryArena::getVertexBuffer()
+{
+	return VBO;
+}
+
+GLuint GeometryArena::getIndexBuffer()
+{
+	return EBO;
+}
+
+GLuint GeometryArena::resize(GLuint buffer, GLsizeiptr size, GLsizeiptr newSize)
+{
+	GLuint res;
+	glGenBuffers(1, &res);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, res);
+	glBufferData(GL_COPY_WRITE_BUFFER, newSize, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glDeleteBuffers(1, &buffer);
+	return res;
+}
+
+void GeometryArena::growVertices(unsigned int minCapacity)
+{
+	unsigned int capacity = vertices.getCapacity();
+	unsigned int newCapacity = std::max(capacity * 2, minCapacity);
+	VBO = resize(VBO, (GLsizeiptr)capacity * layout.getStride(), (GLsizeiptr)newCapacity * layout.getStride());
+	vertices.grow(newCapacity);
+
+	// The attributes still reference the old buffer.
+	GLState::bindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	layout.setupAttributes();
+	GLState::bindVertexArray(0);
+}
+
+void GeometryArena::growIndices(unsigned int minCapacity)
+{
+	unsigned int capacity = indices.getCapacity();
+	unsigned int newCapacity = std::max(capacity * 2, minCapacity);
+	EBO = resize(EBO, capacity, newCapacity);
+	indices.grow(newCapacity);
+
+	GLState::bindVertexArray(VAO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	GLState::bindVertexArray(0);
+}
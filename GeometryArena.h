@@ -0,0 +1,101 @@
+#pragma once
+
+#include <glad\glad.h>
+
+#include "VertexLayout.h"
+#include "FreeListAllocator.h"
+
+#include <ostream>
+#include <vector>
+
+// Initial capacity of the vertex buffer of an arena in vertices, and of its element buffer
+// in bytes. Both double whenever they are full.
+#define GEOMETRY_ARENA_INITIAL_VERTICES 65536
+#define GEOMETRY_ARENA_INITIAL_INDEX_BYTES (1 << 20)
+
+// Layout of the commands read by glMultiDrawElementsIndirect(). firstIndex is in indices
+// (not bytes) from the start of the element buffer.
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+// Location of a mesh's geometry in a GeometryArena: the first vertex (passed as base vertex
+// to the draws, so the indices stay relative to the mesh) and the byte offset of the
+// indices in the element buffer.
+struct GeometryRange {
+	unsigned int firstVertex = FREE_LIST_INVALID;
+	unsigned int vertexCount = 0;
+	unsigned int indexOffset = FREE_LIST_INVALID;
+	unsigned int indexBytes = 0;
+};
+
+// Vertex and element buffer shared by all static meshes with the same vertex layout, with
+// a single vertex array. Meshes in the arena are drawn with glDrawElementsBaseVertex() and
+// never change the vertex array binding between each other.
+// The ranges of the meshes are sub-allocated with FreeListAllocators. When an allocation
+// does not fit, the buffer grows: its contents are copied to a new buffer on the GPU with
+// glCopyBufferSubData(), so the ranges handed out stay valid. Indices of different types
+// can share the element buffer; their ranges are aligned to 4 bytes.
+class GeometryArena
+{
+public:
+	// The arena of the layout, created on first use.
+	static GeometryArena * get(const VertexLayout & layout);
+	// Delete all arenas. The meshes in them have to be deleted first.
+	static void deleteAll();
+	// Print the memory use of all arenas.
+	static void printStats(std::ostream & out);
+
+	// Allocate space for vertexCount vertices and indexBytes bytes of indices, growing the
+	// buffers if necessary.
+	GeometryRange allocate(unsigned int vertexCount, unsigned int indexBytes);
+	void free(GeometryRange & range);
+	// Upload the vertices (range.vertexCount * stride bytes, encoded with the layout) or
+	// the indices (range.indexBytes bytes) of a range.
+	void uploadVertices(const GeometryRange & range, const void * data);
+	void uploadIndices(const GeometryRange & range, const void * data);
+
+	// Source the per-instance attributes from the buffer (see Mesh::setInstanceBuffer()).
+	void setInstanceBuffer(GLuint buffer, GLintptr offset, GLuint divisor);
+	// Draw count commands with indices of the given type, reading the per-instance data
+	// (InstanceData) from instanceBuffer at the commands' base instances. The commands are
+	// read from the bound GL_DRAW_INDIRECT_BUFFER at indirectOffset bytes, and must also be
+	// passed in commands, for the fallbacks:
+	// - with GL_ARB_multi_draw_indirect, all commands are drawn by one call;
+	// - with GL_ARB_base_instance, by one glDrawElementsInstancedBaseVertexBaseInstance each;
+	// - otherwise (plain GL 3.3), the instance attributes are moved to every command's base
+	//   instance before its glDrawElementsInstancedBaseVertex.
+	void multiDraw(GLenum indexType, const DrawElementsIndirectCommand * commands, unsigned int count,
+		GLintptr indirectOffset, GLuint instanceBuffer, GLuint divisor);
+	// Whether multiDraw() submits all commands with a single call.
+	static bool hasMultiDrawIndirect();
+
+	const VertexLayout & getLayout();
+	GLuint getVAO();
+	GLuint getVertexBuffer();
+	GLuint getIndexBuffer();
+
+private:
+	GeometryArena(const VertexLayout & layout);
+	~GeometryArena();
+
+	static std::vector<GeometryArena *> arenas;
+
+	VertexLayout layout;
+	GLuint VAO = 0, VBO = 0, EBO = 0;
+	FreeListAllocator vertices;
+	FreeListAllocator indices;
+
+	GLuint instanceBuffer = 0;
+	GLintptr instanceOffset = -1;
+	GLuint instanceDivisor = 0;
+
+	// Replace the buffer with one of newSize bytes and the same contents (up to size bytes).
+	static GLuint resize(GLuint buffer, GLsizeiptr size, GLsizeiptr newSize);
+	void growVertices(unsigned int minCapacity);
+	void growIndices(unsigned int minCapacity);
+};
@@ -0,0 +1,50 @@
+#include "GpuTimer.h"
+
+GpuTimer::GpuTimer()
+{
+}
+
+GpuTimer::~GpuTimer()
+{
+	if (queries[0] != 0) glDeleteQueries(GPU_TIMER_QUERIES, queries);
+}
+
+void GpuTimer::begin()
+{
+	if (active) return;
+	if (queries[0] == 0) glGenQueries(GPU_TIMER_QUERIES, queries);
+
+	// A query still waiting for its result cannot be restarted; its result is dropped.
+	current = (current + 1) % GPU_TIMER_QUERIES;
+	pending[current] = false;
+	glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+	active = true;
+}
+
+void GpuTimer::end()
+{
+	if (!active) return;
+	glEndQuery(GL_TIME_ELAPSED);
+	pending[current] = true;
+	active = false;
+}
+
+double GpuTimer::getResult()
+{
+	// Check the oldest queries first:
+	for (unsigned int i = 1; i <= GPU_TIMER_QUERIES; i++) {
+		unsigned int q = (current + i) % GPU_TIMER_QUERIES;
+		if (!pending[q]) continue;
+
+		// Queries finish in order, so no later result is available either.
+		GLint available = 0;
+		glGetQueryObjectiv(queries[q], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) return -1.0;
+
+		GLuint64 ns = 0;
+		glGetQueryObjectui64v(queries[q], GL_QUERY_RESULT, &ns);
+		pending[q] = false;
+		return ns / 1000000.0;
+	}
+	return -1.0;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <glad\glad.h>
+
+// Number of queries a GpuTimer cycles through. Results are read this many frames late, so
+// reading them does not stall the pipeline.
+#define GPU_TIMER_QUERIES 4
+
+// Measures the GPU time of the commands between begin() and end() with GL_TIME_ELAPSED
+// queries. Only one GpuTimer may be active at a time (GL does not nest time queries).
+class GpuTimer
+{
+public:
+	GpuTimer();
+	~GpuTimer();
+
+	void begin();
+	void end();
+
+	// Returns the time in milliseconds of the oldest measurement whose result is available,
+	// or a negative value if there is none. Every result is only returned once, so call it
+	// until it returns a negative value to collect all finished measurements.
+	double getResult();
+
+private:
+	GLuint queries[GPU_TIMER_QUERIES] = {};
+	// Whether a query was started and its result has not been read yet.
+	bool pending[GPU_TIMER_QUERIES] = {};
+	unsigned int current = 0;
+	bool active = false;
+};
@@ -1,6 +1,13 @@
 #include "Light.h"
 #include "Scene.h"
 #include "Utils.h"
+#include "Frustum.h"
+#include "RenderStats.h"
+#include "PointShadowArray.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
 
 Light::Light()
 {
@@ -28,6 +35,16 @@ Light::Light(bool shadows, unsigned int width, unsigned int height)
 	}
 }
 
+Light::Light(bool shadows, unsigned int width, unsigned int height, bool shadowTexArray)
+{
+	castShadows = shadows;
+	shadowWidth = width;
+	shadowHeight = height;
+	if (castShadows && shadowTexArray) {
+		generateShadowTexArray(shadowWidth, shadowHeight);
+	}
+}
+
 Light::~Light()
 {
 	if(FBO) glDeleteFramebuffers(1, &FBO);
@@ -71,21 +88,12 @@ GLuint Light::getShadowMap()
 	return texFBO;
 }
 
-bool Light::generateShadowTexArray(unsigned int width, unsigned int height)
+GLuint Light::createShadowTexArray(unsigned int width, unsigned int height)
 {
-	GLint framebufferOld;
-	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebufferOld);
-
-	// Create Framebuffer Object.
-	glGenFramebuffers(1, &FBO);
-	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
-	
-	// Create Texture.
-	glGenTextures(1, &texFBO);
-	glBindTexture(GL_TEXTURE_2D_ARRAY, texFBO);
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
 	glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT24, width, height, NUM_SHADOW_LAYERS);
-	GLint success;
-	glGetTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_IMMUTABLE_FORMAT, &success);
 	// Configure Texture.
 	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -94,6 +102,20 @@ bool Light::generateShadowTexArray(unsigned int width, unsigned int height)
 	//glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_BORDER);
 	float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
 	glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColor);
+	return texture;
+}
+
+bool Light::generateShadowTexArray(unsigned int width, unsigned int height)
+{
+	GLint framebufferOld;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebufferOld);
+
+	// Create Framebuffer Object.
+	glGenFramebuffers(1, &FBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	
+	// Create Texture.
+	texFBO = createShadowTexArray(width, height);
 
 	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texFBO, 0);
 
@@ -107,7 +129,8 @@ bool Light::generateShadowTexArray(unsigned int width, unsigned int height)
 	return true;
 }
 
-void Light::drawShadowMapDirectional(Scene * scene, Shader * depthShader, glm::fmat4 projection, int layer)
+void Light::drawShadowMapDirectional(RenderQueue * casters, Shader * depthShader, glm::fmat4 projection, int layer,
+	bool clear, GLuint texture)
 {
 
 	GLint viewport[4];
@@ -120,22 +143,17 @@ void Light::drawShadowMapDirectional(Scene * scene, Shader * depthShader, glm::f
 	glCullFace(GL_FRONT);
 	
 	depthShader->use();
-	depthShader->setMat4("projectionView", projection);
+	depthShader->set(depthShader->uniforms.projectionView, projection);
 
 	glViewport(0, 0, shadowWidth, shadowHeight);
 
 	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
-	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texFBO, 0, layer);
-	glClear(GL_DEPTH_BUFFER_BIT);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture ? texture : texFBO, 0, layer);
+	if (clear) glClear(GL_DEPTH_BUFFER_BIT);
 
 	//depthShader->setInt("layer", layer);
 
-	for (int i = 0; i < scene->getNumEntities(); i++) {
-		if (PolygonModel * model = scene->getEntity3D(i)->getComponent<PolygonModel>()) {
-			if(model->castsShadows()) 
-				model->draw(depthShader);
-		}
-	}
+	casters->draw();
 
 	// Reset state:
 	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fboDrawOld);
@@ -145,18 +163,55 @@ void Light::drawShadowMapDirectional(Scene * scene, Shader * depthShader, glm::f
 	glCullFace(GL_BACK);
 }
 
-PointLight::PointLight() : Light()
+void Light::drawShadowMapLayered(RenderQueue * casters, Shader * depthShader, const glm::fmat4 * projections,
+	ShadowRenderMode mode, bool clear, GLuint texture)
+{
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	GLint fboReadOld, fboDrawOld;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &fboDrawOld);
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &fboReadOld);
+
+	glCullFace(GL_FRONT);
+
+	depthShader->use();
+	depthShader->set(depthShader->uniforms.layerProjectionView, projections, NUM_SHADOW_LAYERS);
+
+	glViewport(0, 0, shadowWidth, shadowHeight);
+
+	// Attach the whole texture array, so the shader can select the layer:
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture ? texture : texFBO, 0);
+	if (clear) glClear(GL_DEPTH_BUFFER_BIT);
+
+	casters->draw(mode == SHADOW_RENDER_VERTEX_LAYER ? NUM_SHADOW_LAYERS : 1);
+
+	// Reset state:
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fboDrawOld);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, fboReadOld);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+	glCullFace(GL_BACK);
+}
+
+PointLight::PointLight() : Light(true, 1024, 1024, false)
 {
 }
 
-PointLight::PointLight(unsigned int width, unsigned int height) : Light(width, height)
+PointLight::PointLight(unsigned int width, unsigned int height) : Light(true, width, height, false)
 {
 }
 
-PointLight::PointLight(bool shadows, unsigned int width, unsigned int height) : Light(shadows, width, height)
+PointLight::PointLight(bool shadows, unsigned int width, unsigned int height) : Light(shadows, width, height, false)
 {
 }
 
+PointLight::~PointLight()
+{
+	if (shadowArray) shadowArray->release(shadowSlot);
+}
+
 void PointLight::setPosition(glm::fvec3 pos)
 {
 	position = pos;
@@ -174,32 +229,144 @@ glm::fvec3 PointLight::getPosition()
 	return position;
 }
 
-void PointLight::configureShader(Shader * s, unsigned int i)
+void PointLight::setShadowRange(float nearPlane, float farPlane)
+{
+	shadowNear = nearPlane;
+	shadowFar = farPlane;
+}
+
+float PointLight::getShadowNear()
+{
+	return shadowNear;
+}
+
+float PointLight::getShadowFar()
+{
+	return shadowFar;
+}
+
+void PointLight::setRange(float range)
+{
+	this->range = range;
+}
+
+float PointLight::getRange()
+{
+	if (range > 0.0f) return std::max(range, MIN_POINT_LIGHT_RANGE);
+	// intensity / d^2 = 1 / 256:
+	return std::max(16.0f * std::sqrt(std::max(intensity, 0.0f)), MIN_POINT_LIGHT_RANGE);
+}
+
+void PointLight::writeUniformBlock(LightBlock & block)
+{
+	block.nPointLights++;
+}
+
+void PointLight::writeLightData(PointLightData & data)
+{
+	data.pos = position;
+	data.intensity = intensity;
+	data.color = color;
+	data.shadowLayer = castShadows && shadowValid ? shadowSlot * POINT_SHADOW_FACES : -1;
+	data.shadowNear = shadowNear;
+	data.shadowFar = shadowFar;
+	data.range = getRange();
+	data.padding = 0.0f;
+}
+
+void PointLight::drawShadows(Scene * scene, Shader * depthShader)
 {
-	s->use();
-	if (i >= MAX_NUM_POINT_LIGHTS) {
-		std::cerr << "Light.cpp: Unable to configure shader. MAX_NUM_LIGHTS exceeded." << std::endl;
+	PointShadowArray * array = scene->getPointShadows();
+	if (shadowSlot < 0) {
+		shadowSlot = array->allocate();
+		if (shadowSlot < 0) return;
+		shadowArray = array;
+	}
+	Shader * cubeShader = scene->getMaterialManager()->getShader("depthShaderCube");
+	if (cubeShader == NULL) return;
+
+	// Find the faces whose casters or matrix changed:
+	ShadowCasterList * casters = scene->getShadowCasters();
+	glm::fmat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, shadowNear, shadowFar);
+	glm::fmat4 faces[POINT_SHADOW_FACES];
+	Frustum frustums[POINT_SHADOW_FACES];
+	unsigned long long signatures[POINT_SHADOW_FACES];
+	unsigned int faceMask = 0, nFaces = 0;
+	for (unsigned int i = 0; i < POINT_SHADOW_FACES; i++) {
+		faces[i] = projection * PointShadowArray::getFaceView(position, i);
+		frustums[i].setMatrix(faces[i]);
+		signatures[i] = casters->cull(frustums[i], cubeShader, NULL);
+		signatures[i] = Utils::HashFNV1a(&faces[i], sizeof(glm::fmat4), signatures[i]);
+		signatures[i] = Utils::HashFNV1a(&cubeShader->ID, sizeof(GLuint), signatures[i]);
+		if (!shadowValid || signatures[i] != faceSignatures[i]) {
+			faceMask |= 1 << i;
+			nFaces++;
+		}
+	}
+	renderStats.pointShadowFacesSkipped += POINT_SHADOW_FACES - nFaces;
+	if (faceMask == 0) return;
+	if (!array->consumeBudget(nFaces)) {
+		renderStats.pointShadowLightsDeferred++;
 		return;
 	}
-	std::string pLight = "pLight[";
-	pLight.append(std::to_string(i));
-	pLight.append("]");
-	std::string tmp(pLight);
-	s->setVec3(tmp.append(".pos"), position);
-	tmp = pLight;
-	s->setVec3(tmp.append(".color"), color);
-	tmp = pLight;
-	s->setFloat(tmp.append(".intensity"), intensity);
+
+	// Only the casters of the changed faces are needed:
+	Frustum dirty[POINT_SHADOW_FACES];
+	unsigned int nDirty = 0;
+	for (unsigned int i = 0; i < POINT_SHADOW_FACES; i++)
+		if (faceMask & (1 << i)) dirty[nDirty++] = frustums[i];
+	casterQueue.clear();
+	casters->cullUnion(dirty, nDirty, cubeShader, casterQueue);
+	casterQueue.sort();
+
+	drawShadowMapCube(&casterQueue, cubeShader, faces, faceMask);
+	for (unsigned int i = 0; i < POINT_SHADOW_FACES; i++)
+		faceSignatures[i] = signatures[i];
+	shadowValid = true;
+	renderStats.pointShadowFacesDrawn += nFaces;
 }
 
-void PointLight::drawShadows(Scene * scene, Shader * depthShader)
+void PointLight::drawShadowMapCube(RenderQueue * casters, Shader * cubeShader, const glm::fmat4 * faces, unsigned int faceMask)
 {
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	GLint fboReadOld, fboDrawOld;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &fboDrawOld);
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &fboReadOld);
+
+	glCullFace(GL_FRONT);
+	glViewport(0, 0, shadowArray->getSize(), shadowArray->getSize());
+
+	// Clear only the faces that are redrawn, the others keep their contents:
+	unsigned int firstLayer = shadowSlot * POINT_SHADOW_FACES;
+	glBindFramebuffer(GL_FRAMEBUFFER, shadowArray->getFramebuffer());
+	for (unsigned int i = 0; i < POINT_SHADOW_FACES; i++) {
+		if (!(faceMask & (1 << i))) continue;
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowArray->getTexture(), 0, firstLayer + i);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowArray->getTexture(), 0);
+
+	cubeShader->use();
+	cubeShader->set(cubeShader->uniforms.layerProjectionView, faces, POINT_SHADOW_FACES);
+	cubeShader->set(cubeShader->uniforms.layerMask, (int)faceMask);
+	cubeShader->set(cubeShader->uniforms.layerOffset, (int)firstLayer);
+	casters->draw();
+
+	// Reset state:
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fboDrawOld);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, fboReadOld);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+	glCullFace(GL_BACK);
 }
 
 DirectionalLight::DirectionalLight() : Light(2048U, 2048U)
 {
 	for (int i = 0; i < NUM_SHADOW_LAYERS; ++i) {
 		lightSpace[i] = glm::fmat4(1.0f);
+		cascadeSplits[i] = 0.0f;
 	}
 }
 
@@ -207,6 +374,7 @@ DirectionalLight::DirectionalLight(unsigned int width, unsigned int height) : Li
 {
 	for (int i = 0; i < NUM_SHADOW_LAYERS; ++i) {
 		lightSpace[i] = glm::fmat4(1.0f);
+		cascadeSplits[i] = 0.0f;
 	}
 }
 
@@ -214,9 +382,16 @@ DirectionalLight::DirectionalLight(bool shadows, unsigned int width, unsigned in
 {
 	for (int i = 0; i < NUM_SHADOW_LAYERS; ++i) {
 		lightSpace[i] = glm::fmat4(1.0f);
+		cascadeSplits[i] = 0.0f;
 	}
 }
 
+DirectionalLight::~DirectionalLight()
+{
+	if (copyFBO) glDeleteFramebuffers(1, &copyFBO);
+	if (staticTex) glDeleteTextures(1, &staticTex);
+}
+
 void DirectionalLight::setDirection(glm::fvec3 dir)
 {
 	direction = glm::normalize(dir);
@@ -242,53 +417,240 @@ float DirectionalLight::getAmbientIntensity()
 	return ambientIntesity;
 }
 
-void DirectionalLight::configureShader(Shader * s, unsigned int i)
+void DirectionalLight::setCascadeSplitLambda(float lambda)
+{
+	cascadeSplitLambda = glm::clamp(lambda, 0.0f, 1.0f);
+}
+
+float DirectionalLight::getCascadeSplitLambda()
+{
+	return cascadeSplitLambda;
+}
+
+void DirectionalLight::setShadowDistance(float distance)
+{
+	shadowDistance = distance;
+}
+
+float DirectionalLight::getShadowDistance()
 {
-	s->use();
-	if (i >= MAX_NUM_DIR_LIGHTS) {
-		std::cerr << "Light.cpp: Unable to configure shader. MAX_NUM_LIGHTS exceeded." << std::endl;
+	return shadowDistance;
+}
+
+void DirectionalLight::setStaticShadowCache(bool enabled)
+{
+	if (enabled == staticCache) return;
+	staticCache = enabled;
+	// The shadow map holds either all casters or only the moving ones, so redraw it:
+	for (int i = 0; i < NUM_SHADOW_LAYERS; i++) {
+		layerSignatures[i] = 0;
+		staticSignatures[i] = 0;
+	}
+}
+
+bool DirectionalLight::getStaticShadowCache()
+{
+	return staticCache;
+}
+
+void DirectionalLight::writeUniformBlock(LightBlock & block)
+{
+	if (block.nDirLights >= MAX_NUM_DIR_LIGHTS) {
+		std::cerr << "Light.cpp: Unable to add light to uniform block. MAX_NUM_DIR_LIGHTS exceeded." << std::endl;
 		return;
 	}
-	std::string pLight = "dLight[";
-	pLight.append(std::to_string(i));
-	pLight.append("]");
-	std::string tmp(pLight);
-	s->setVec3(tmp.append(".dir"), direction);
-	tmp = pLight;
-	s->setVec3(tmp.append(".color"), color);
-	tmp = pLight;
-	s->setFloat(tmp.append(".intensity"), intensity);
-	tmp = pLight;
-	s->setFloat(tmp.append(".ambientIntensity"), ambientIntesity);
-	tmp = pLight;
-	s->setFloat(tmp.append(".index"), i);
+	int i = block.nDirLights++;
+	DirLightData & data = block.dLight[i];
+	data.dir = direction;
+	data.intensity = intensity;
+	data.color = color;
+	data.ambientIntensity = ambientIntesity;
+	for (int j = 0; j < NUM_SHADOW_LAYERS; j++)
+		data.lightSpace[j] = lightSpace[j];
+	data.index = i;
+	data.castShadows = castShadows ? 1 : 0;
+	data.texelSize = glm::fvec2(1.0f / shadowWidth, 1.0f / shadowHeight);
+	data.cascadeSplits = glm::fvec4(FLT_MAX);
+	for (int j = 0; j < NUM_SHADOW_LAYERS; j++)
+		data.cascadeSplits[j] = cascadeSplits[j];
 
 	if (castShadows) {
-		for (int j = 0; j < NUM_SHADOW_LAYERS; j++) {
-			tmp = pLight;
-			tmp.append(".lightSpace");
-			if (NUM_SHADOW_LAYERS > 1) tmp.append("[").append(std::to_string(j)).append("]");
-			s->setMat4(tmp, lightSpace[j]);
+		GLState::bindTexture(SHADOW_MAP_TEXTURE_UNIT + i, GL_TEXTURE_2D_ARRAY, texFBO);
+	}
+}
+
+void DirectionalLight::drawShadows(Scene * scene, Shader * depthShader)
+{
+	fitCascades(scene->getCamera());
+
+	ShadowCasterList * casters = scene->getShadowCasters();
+	ShadowRenderMode mode = scene->getShadowRenderMode();
+	Shader * layeredShader = scene->getLayeredDepthShader();
+	// With the cache, the static casters are drawn into staticTex and the shadow map only gets
+	// the moving ones on top of a copy of it. Each part is only redrawn if its signature changed.
+	bool cached = staticCache && (staticTex != 0 || generateStaticCache());
+	ShadowCasterFilter filter = cached ? SHADOW_CASTERS_DYNAMIC : SHADOW_CASTERS_ALL;
+
+	if (mode != SHADOW_RENDER_MULTI_PASS && layeredShader != NULL) {
+		// The layers are cleared and drawn together, so they are redrawn if any changed.
+		Frustum frustums[NUM_SHADOW_LAYERS];
+		unsigned long long signatures[NUM_SHADOW_LAYERS];
+		unsigned long long staticSigs[NUM_SHADOW_LAYERS];
+		bool changed = false, staticChanged = false;
+		for (int i = 0; i < NUM_SHADOW_LAYERS; i++) {
+			frustums[i].setMatrix(lightSpace[i], false);
+			unsigned long long layerSig = Utils::HashFNV1a(&lightSpace[i], sizeof(glm::fmat4));
+			layerSig = Utils::HashFNV1a(&layeredShader->ID, sizeof(GLuint), layerSig);
+			if (cached) {
+				staticSigs[i] = casters->cull(frustums[i], layeredShader, NULL, SHADOW_CASTERS_STATIC);
+				staticSigs[i] = Utils::HashFNV1a(&layerSig, sizeof(layerSig), staticSigs[i]);
+				staticChanged |= staticSigs[i] != staticSignatures[i];
+			}
+			signatures[i] = casters->cull(frustums[i], layeredShader, NULL, filter);
+			signatures[i] = Utils::HashFNV1a(&layerSig, sizeof(layerSig), signatures[i]);
+			changed |= signatures[i] != layerSignatures[i];
+		}
+		if (!changed && !staticChanged) {
+			renderStats.shadowLayersSkipped += NUM_SHADOW_LAYERS;
+			return;
+		}
+
+		if (staticChanged) {
+			layeredQueue.clear();
+			casters->cullUnion(frustums, NUM_SHADOW_LAYERS, layeredShader, layeredQueue, SHADOW_CASTERS_STATIC);
+			layeredQueue.sort();
+			drawShadowMapLayered(&layeredQueue, layeredShader, lightSpace, mode, true, staticTex);
+			for (int i = 0; i < NUM_SHADOW_LAYERS; i++)
+				staticSignatures[i] = staticSigs[i];
+			renderStats.shadowStaticLayersDrawn += NUM_SHADOW_LAYERS;
+		}
+
+		layeredQueue.clear();
+		casters->cullUnion(frustums, NUM_SHADOW_LAYERS, layeredShader, layeredQueue, filter);
+		layeredQueue.sort();
+		if (cached) copyStaticLayers(0, NUM_SHADOW_LAYERS);
+		drawShadowMapLayered(&layeredQueue, layeredShader, lightSpace, mode, !cached);
+		for (int i = 0; i < NUM_SHADOW_LAYERS; i++)
+			layerSignatures[i] = signatures[i];
+		renderStats.shadowLayersDrawn += NUM_SHADOW_LAYERS;
+		return;
+	}
+
+	for (int i = 0; i < NUM_SHADOW_LAYERS; i++) {
+		// Casters between the light and the layer's volume still cast shadows into it (the
+		// depth shader clamps them to the near plane), so only the other planes cull.
+		Frustum frustum(lightSpace[i], false);
+		unsigned long long layerSig = Utils::HashFNV1a(&lightSpace[i], sizeof(glm::fmat4));
+		layerSig = Utils::HashFNV1a(&depthShader->ID, sizeof(GLuint), layerSig);
+
+		bool staticChanged = false;
+		unsigned long long staticSig = 0;
+		if (cached) {
+			staticSig = casters->cull(frustum, depthShader, NULL, SHADOW_CASTERS_STATIC);
+			staticSig = Utils::HashFNV1a(&layerSig, sizeof(layerSig), staticSig);
+			staticChanged = staticSig != staticSignatures[i];
+		}
+		casterQueues[i].clear();
+		unsigned long long signature = casters->cull(frustum, depthShader, &casterQueues[i], filter);
+		signature = Utils::HashFNV1a(&layerSig, sizeof(layerSig), signature);
+		if (signature == layerSignatures[i] && !staticChanged) {
+			renderStats.shadowLayersSkipped++;
+			continue;
+		}
+
+		if (staticChanged) {
+			staticQueue.clear();
+			casters->cull(frustum, depthShader, &staticQueue, SHADOW_CASTERS_STATIC);
+			staticQueue.sort();
+			drawShadowMapDirectional(&staticQueue, depthShader, lightSpace[i], i, true, staticTex);
+			staticSignatures[i] = staticSig;
+			renderStats.shadowStaticLayersDrawn++;
 		}
 
-		tmp = pLight;
-		tmp = tmp.append(".shadowMap");
-		s->setInt(tmp, 5 + i);
-		glActiveTexture(GL_TEXTURE5 + i);
-		glBindTexture(GL_TEXTURE_2D_ARRAY, texFBO);
+		casterQueues[i].sort();
+		if (cached) copyStaticLayers(i, 1);
+		drawShadowMapDirectional(&casterQueues[i], depthShader, lightSpace[i], i, !cached);
+		layerSignatures[i] = signature;
+		renderStats.shadowLayersDrawn++;
 	}
 }
 
-void DirectionalLight::drawShadows(Scene * scene, Shader * depthShader)
+bool DirectionalLight::generateStaticCache()
 {
-	Camera * c = scene->getCamera();
-	
+	if (!castShadows || FBO == 0) return false;
+	staticTex = createShadowTexArray(shadowWidth, shadowHeight);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	if (!GLAD_GL_ARB_copy_image) glGenFramebuffers(1, &copyFBO);
+	return true;
+}
+
+void DirectionalLight::copyStaticLayers(int firstLayer, int count)
+{
+	if (GLAD_GL_ARB_copy_image) {
+		glCopyImageSubData(staticTex, GL_TEXTURE_2D_ARRAY, 0, 0, 0, firstLayer,
+			texFBO, GL_TEXTURE_2D_ARRAY, 0, 0, 0, firstLayer, shadowWidth, shadowHeight, count);
+		return;
+	}
+
+	// Without GL_ARB_copy_image, blit the depth of each layer:
+	GLint readOld, drawOld;
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readOld);
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawOld);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, copyFBO);
+	glReadBuffer(GL_NONE);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, FBO);
+	for (int layer = firstLayer; layer < firstLayer + count; layer++) {
+		glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, staticTex, 0, layer);
+		glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texFBO, 0, layer);
+		glBlitFramebuffer(0, 0, shadowWidth, shadowHeight, 0, 0, shadowWidth, shadowHeight,
+			GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	}
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, readOld);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawOld);
+}
+
+void DirectionalLight::fitCascades(Camera * camera)
+{
+	float zNear = camera->getNearPlane();
+	float zFar = glm::min(camera->getFarPlane(), shadowDistance);
+
+	// Rotation into light space. The origin stays fixed, so the texel grid of a layer only
+	// moves when the layer is snapped to the next texel.
+	glm::fvec3 up = glm::abs(direction.y) > 0.99f ? glm::fvec3(0.0f, 0.0f, 1.0f) : glm::fvec3(0.0f, 1.0f, 0.0f);
+	glm::fmat4 lightView = glm::lookAt(glm::fvec3(0.0f), direction, up);
+
+	float sliceNear = zNear;
 	for (int i = 0; i < NUM_SHADOW_LAYERS; i++) {
-		glm::fvec3 lightPos = -3.0f * powf(10.0f, i) * direction;
-		lightSpace[i] = glm::ortho(-2.0f * powf(10.0f, i), 2.0f * powf(10.0f, i), -2.0f * powf(10.0f, i), 2.0f * powf(10.0f, i), 0.0625f, 6.0f * powf(10.0f, i)) * glm::lookAt(lightPos, lightPos + direction, glm::fvec3(0.0f, 1.0f, 0.0f));
+		float t = (float)(i + 1) / NUM_SHADOW_LAYERS;
+		float splitLog = zNear * powf(zFar / zNear, t);
+		float splitUniform = zNear + (zFar - zNear) * t;
+		cascadeSplits[i] = cascadeSplitLambda * splitLog + (1.0f - cascadeSplitLambda) * splitUniform;
+
+		glm::fvec3 corners[8];
+		camera->getFrustumCorners(sliceNear, cascadeSplits[i], corners);
+		sliceNear = cascadeSplits[i];
+
+		// Bound the slice by a sphere: unlike a box, its size does not change when the camera
+		// rotates. The radius is rounded up, so it does not flicker with rounding errors.
+		glm::fvec3 center = glm::fvec3(0.0f);
+		for (int j = 0; j < 8; j++) center += corners[j];
+		center /= 8.0f;
+		float radius = 0.0f;
+		for (int j = 0; j < 8; j++) radius = glm::max(radius, glm::length(corners[j] - center));
+		radius = ceilf(radius * 16.0f) / 16.0f;
+
+		// Snap the center to whole texels, so the shadow edges do not shimmer while the
+		// camera moves.
+		glm::fvec3 centerLS = glm::fvec3(lightView * glm::fvec4(center, 1.0f));
+		glm::fvec2 texel = glm::fvec2(2.0f * radius / shadowWidth, 2.0f * radius / shadowHeight);
+		centerLS.x = floorf(centerLS.x / texel.x) * texel.x;
+		centerLS.y = floorf(centerLS.y / texel.y) * texel.y;
+
+		// The light looks down the negative z axis of its space. Casters in front of the near
+		// plane are clamped to it by the depth shader.
+		lightSpace[i] = glm::ortho(centerLS.x - radius, centerLS.x + radius, centerLS.y - radius, centerLS.y + radius,
+			-centerLS.z - radius, -centerLS.z + radius) * lightView;
 	}
-	for (int i = 0; i < NUM_SHADOW_LAYERS; i++)
-		drawShadowMapDirectional(scene, depthShader, lightSpace[i], i);
 }
 
 Flashlight::Flashlight() : DirectionalLight()
@@ -303,7 +665,7 @@ Flashlight::Flashlight(bool shadows, unsigned int width, unsigned int height) :
 {
 }
 
-void Flashlight::configureShader(Shader * s, unsigned int i)
+void Flashlight::writeUniformBlock(LightBlock & block)
 {
 }
 
@@ -2,14 +2,82 @@
 
 #include <glm\glm.hpp>
 #include "Shader.h"
+#include "RenderQueue.h"
 
-#define MAX_NUM_POINT_LIGHTS 16
 #define MAX_NUM_DIR_LIGHTS 4
 
+// Smallest range of a PointLight, so that the attenuation never divides by 0.
+#define MIN_POINT_LIGHT_RANGE 0.01f
+
 // Number of definition layers each shadow map should have (must be the same as in the shaders)
 #define NUM_SHADOW_LAYERS 3
 
+static_assert(MAX_NUM_DIR_LIGHTS == POINT_SHADOW_MAP_TEXTURE_UNIT - SHADOW_MAP_TEXTURE_UNIT,
+	"The point shadow array must use the texture unit after the directional shadow maps");
+
 class Scene;
+class Camera;
+class PointShadowArray;
+
+// How the layers of a directional shadow map are rendered:
+enum ShadowRenderMode {
+	// One pass per layer with the plain depth shader. Always supported.
+	SHADOW_RENDER_MULTI_PASS = 0,
+	// All layers in one pass; a geometry shader emits each triangle to the layers it covers.
+	SHADOW_RENDER_GEOMETRY_SHADER = 1,
+	// All layers in one pass; every object is drawn once per layer as instances and the
+	// vertex shader writes gl_Layer (needs GL_ARB_shader_viewport_layer_array or
+	// GL_AMD_vertex_shader_layer).
+	SHADOW_RENDER_VERTEX_LAYER = 2
+};
+
+// Data of a point light as read by the shaders from a buffer texture (three RGBA32F texels
+// per light, see Shader/phongShader_LayeredShadows.fs).
+struct PointLightData {
+	glm::fvec3 pos;
+	float intensity;
+	glm::fvec3 color;
+	// First layer of the light's faces in the point shadow array, or -1 without shadows.
+	// The shader reads the bits of the texel as an int.
+	int shadowLayer;
+	// Near and far plane of the shadow map faces.
+	float shadowNear;
+	float shadowFar;
+	// Distance at which the light's contribution is faded out completely.
+	float range;
+	float padding;
+};
+
+// std140 layouts of the "LightBlock" uniform block. They must match the light structs in
+// the shaders (see Shader/phongShader_LayeredShadows.*).
+
+struct DirLightData {
+	glm::fvec3 dir;
+	float intensity;
+	glm::fvec3 color;
+	float ambientIntensity;
+	glm::fmat4 lightSpace[NUM_SHADOW_LAYERS];
+	int index;
+	int castShadows;
+	glm::fvec2 texelSize;
+	// View space depth where each shadow map layer ends. Unused components are FLT_MAX.
+	glm::fvec4 cascadeSplits;
+};
+
+// The point lights are not stored in the block, but assigned to clusters of the view frustum
+// (see LightClusterer).
+struct LightBlock {
+	int nPointLights;
+	int nDirLights;
+	// The cluster slice of a view space depth d is floor(log(d) * clusterSliceScale + clusterSliceBias).
+	float clusterSliceScale;
+	float clusterSliceBias;
+	DirLightData dLight[MAX_NUM_DIR_LIGHTS];
+};
+
+static_assert(sizeof(PointLightData) == 48, "PointLightData does not match three RGBA32F texels");
+static_assert(sizeof(DirLightData) == 64 + 64 * NUM_SHADOW_LAYERS, "DirLightData does not match the std140 layout");
+static_assert(NUM_SHADOW_LAYERS <= 4, "The cascade splits are passed to the shaders as a vec4");
 
 class Light
 {
@@ -17,7 +85,7 @@ public:
 	Light();
 	Light(unsigned int width, unsigned int height);
 	Light(bool shadows, unsigned int width = 1024, unsigned int height = 1024);
-	~Light();
+	virtual ~Light();
 
 	// Set the Light's color by passing a glm::fvec3 containing the RGB components.
 	void setColor(glm::fvec3 color);
@@ -36,18 +104,31 @@ public:
 
 	GLuint getShadowMap();
 
-	// Abstract function prototype that is implemented based on the kind of Light.
-	virtual void configureShader(Shader * s, unsigned int i) = 0;
+	// Append the Light to the light uniform block. Implemented based on the kind of Light.
+	virtual void writeUniformBlock(LightBlock & block) = 0;
 	// Abstract function prototype that is implemented based on the kind of Light.
 	virtual void drawShadows(Scene * scene, Shader * depthShader) = 0;
 
 protected:
 	bool castShadows;
+
+	// For lights that store their shadows elsewhere: shadowTexArray = false skips creating
+	// the shadow map texture array.
+	Light(bool shadows, unsigned int width, unsigned int height, bool shadowTexArray);
 	GLuint FBO = 0;
 	GLuint texFBO = 0;
 	
 	bool generateShadowTexArray(unsigned int width, unsigned int height);
-	void drawShadowMapDirectional(Scene * scene, Shader * depthShader, glm::fmat4 projection, int layer);
+	// Create a depth texture array with NUM_SHADOW_LAYERS layers, configured as shadow map.
+	GLuint createShadowTexArray(unsigned int width, unsigned int height);
+	// Draw the casters into the given layer of the shadow map, or of texture if it is not 0.
+	// With clear = false, the casters are drawn on top of the layer's contents.
+	void drawShadowMapDirectional(RenderQueue * casters, Shader * depthShader, glm::fmat4 projection, int layer,
+		bool clear = true, GLuint texture = 0);
+	// Draw the casters into all layers of the shadow map (or of texture) in one pass with a
+	// layered depth shader (see ShadowRenderMode). projections holds one matrix per layer.
+	void drawShadowMapLayered(RenderQueue * casters, Shader * depthShader, const glm::fmat4 * projections,
+		ShadowRenderMode mode, bool clear = true, GLuint texture = 0);
 
 	glm::fvec3 color;
 	float intensity;
@@ -61,7 +142,10 @@ class PointLight : public Light
 public:
 	PointLight();
 	PointLight(unsigned int width, unsigned int height);
+	// The shadow maps are stored in the Scene's PointShadowArray, so their size is that of the
+	// array; width and height are ignored.
 	PointLight(bool shadows, unsigned int width = 1024, unsigned int height = 1024);
+	~PointLight();
 
 	// Set the position of the PointLight by passing a glm::fvec3.
 	void setPosition(glm::fvec3 pos);
@@ -70,25 +154,50 @@ public:
 	// Get the position of the PointLight. The return type is glm::fvec3.
 	glm::fvec3 getPosition();
 
-	// Configure the shader uniforms to prepare them for drawing. The lights should be 
-	// arranged in a struct array. For PointLights specifically, the array containing all the
-	// PointLights should be named 'pLight'. The PointLight struct in the shader has
+	// Distances from the light between which shadows are cast.
+	void setShadowRange(float nearPlane, float farPlane);
+	float getShadowNear();
+	float getShadowFar();
+	// Distance beyond which the light has no effect. The light is only evaluated for the
+	// clusters its range reaches. If it is 0 (the default), the distance at which the
+	// attenuated intensity drops below 1/256 is used. It is at least MIN_POINT_LIGHT_RANGE.
+	void setRange(float range);
+	float getRange();
+
+	// Point lights are not stored in the light uniform block, so this only counts them.
+	virtual void writeUniformBlock(LightBlock & block);
+	// Write the data of the light for the shaders. The PointLight struct in the shader has
 	// the following attributes:
 	// .pos (the light's position)
 	// .color (the light's color)
 	// .intensity (the light's brightness)
-	// The necessary parameters are a pointer to the Shader to configure as well as the
-	// index of the light.
-	virtual void configureShader(Shader * s, unsigned int i);
+	// .shadowLayer (the first layer of the light's faces in the point shadow array, or -1)
+	// .shadowNear, .shadowFar (the shadow range)
+	// .range (the light's range)
+	void writeLightData(PointLightData & data);
 
-	// Render the shadow maps to the corresponding texture layers. This action should be performed
-	// BEFORE drawing the actual scene, since otherwise the shadow maps might be outdated.
-	// The necessary parameters are a pointer to the Scene object which casts the shadows as well
-	// as a pointer to the depth shader which is used for rendering the shadows.
+	// Render the faces of the light's shadow cube map that changed into the Scene's
+	// PointShadowArray. All changed faces are drawn in one pass; the depth shader is not used
+	// (the Scene's "depthShaderCube" routes the triangles to the faces). Lights are skipped
+	// once the array's face budget for the frame is used up and drawn in a later frame.
 	virtual void drawShadows(Scene * scene, Shader * depthShader);
 
 protected:
 	glm::fvec3 position;
+	float shadowNear = 0.05f;
+	float shadowFar = 32.0f;
+	float range = 0.0f;
+
+	// Slot in the shadow array (-1 if none was assigned yet) and whether it was drawn.
+	PointShadowArray * shadowArray = NULL;
+	int shadowSlot = -1;
+	bool shadowValid = false;
+	// Signature of each face's matrix and casters when it was last drawn.
+	unsigned long long faceSignatures[6] = {};
+	RenderQueue casterQueue;
+
+	// Clear the faces in faceMask and draw the casters into them.
+	void drawShadowMapCube(RenderQueue * casters, Shader * cubeShader, const glm::fmat4 * faces, unsigned int faceMask);
 };
 
 // Light that is not emitted from a point but rather illuminates the scene from a certain direction
@@ -98,6 +207,7 @@ public:
 	DirectionalLight();
 	DirectionalLight(unsigned int width, unsigned int height);
 	DirectionalLight(bool shadows, unsigned int width = 1024, unsigned int height = 1024);
+	~DirectionalLight();
 
 	// Set the direction of the DirectionalLight by passing a glm::fvec3.
 	void setDirection(glm::fvec3 dir);
@@ -116,18 +226,33 @@ public:
 	// Returns the ambient light intensity of the DirectionalLight. The return type is float.
 	float getAmbientIntensity();
 
-	// Configure the shader uniforms to prepare them for drawing. The lights should be 
-	// arranged in a struct array. For DirectionalLights specifically, the array containing all
-	// the DirectionalLights should be named 'dLight'. The DirectionalLight struct in the 
-	// shader has the following attributes:
+	// The shadow map layers (cascades) cover consecutive slices of the camera's view frustum.
+	// The slices are split at a blend of logarithmic (lambda = 1) and uniform (lambda = 0)
+	// distances between the camera's near plane and the shadow distance.
+	void setCascadeSplitLambda(float lambda);
+	float getCascadeSplitLambda();
+	// Maximum distance to the camera up to which shadows are drawn. The camera's far plane
+	// is used if it is closer.
+	void setShadowDistance(float distance);
+	float getShadowDistance();
+	// Keep the depth of the static shadow casters (see ShadowCasterList) in a cache, so
+	// only the moving casters are drawn when nothing else changed: the cached layer is
+	// copied to the shadow map and the moving casters are drawn on top (enabled by default).
+	// The cache doubles the memory of the shadow map.
+	void setStaticShadowCache(bool enabled);
+	bool getStaticShadowCache();
+
+	// Append the DirectionalLight to the 'dLight' array of the light uniform block and bind
+	// its shadow map to texture unit SHADOW_MAP_TEXTURE_UNIT + index. The DirectionalLight
+	// struct in the shader has the following attributes:
 	// .dir (the light's direction)
 	// .color (the light's color)
 	// .intensity (the light's brightness)
 	// .ambientIntensity (the global illumination provided by the light)
+	// .lightSpace (the light space matrices of the shadow map layers)
 	// .index (the light's index)
-	// The necessary parameters are a pointer to the Shader to configure as well as the
-	// index of the light.
-	virtual void configureShader(Shader * s, unsigned int i);
+	// Lights beyond MAX_NUM_DIR_LIGHTS are skipped.
+	virtual void writeUniformBlock(LightBlock & block);
 
 	// Render the shadow maps to the corresponding texture layers. This action should be performed
 	// BEFORE drawing the actual scene, since otherwise the shadow maps might be outdated.
@@ -140,6 +265,32 @@ protected:
 	float ambientIntesity = 0.2f;
 
 	glm::fmat4 lightSpace[NUM_SHADOW_LAYERS];
+	float cascadeSplits[NUM_SHADOW_LAYERS];
+	float cascadeSplitLambda = 0.75f;
+	float shadowDistance = 128.0f;
+
+	// Fit the light space matrices of the layers to the slices of the camera's frustum.
+	void fitCascades(Camera * camera);
+
+	// Casters inside the volume of each layer, and the signature of the layer's matrix and
+	// casters when the layer was last drawn. Layers whose signature did not change keep
+	// their contents.
+	RenderQueue casterQueues[NUM_SHADOW_LAYERS];
+	unsigned long long layerSignatures[NUM_SHADOW_LAYERS] = {};
+	// Casters of all layers, for the single pass modes.
+	RenderQueue layeredQueue;
+
+	// Depth of the static casters of each layer, and the signature of the layer's matrix
+	// and static casters when it was drawn. Created on first use.
+	bool staticCache = true;
+	GLuint staticTex = 0;
+	GLuint copyFBO = 0;
+	unsigned long long staticSignatures[NUM_SHADOW_LAYERS] = {};
+	// Static casters of one layer, for the multi pass mode.
+	RenderQueue staticQueue;
+	bool generateStaticCache();
+	// Copy layers of the static cache to the shadow map.
+	void copyStaticLayers(int firstLayer, int count);
 };
 
 // Directional Light, but with attenuation, starting at a certain position
@@ -150,7 +301,7 @@ public:
 	Flashlight(unsigned int width, unsigned int height);
 	Flashlight(bool shadows, unsigned int width = 1024, unsigned int height = 1024);
 
-	virtual void configureShader(Shader * s, unsigned int i);
+	virtual void writeUniformBlock(LightBlock & block);
 	virtual void drawShadows(Scene * scene, Shader * depthShader);
 };
 
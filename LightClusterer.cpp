@@ -0,0 +1,206 @@
+#include "LightClusterer.h"
+
+#include <cmath>
+#include <algorithm>
+
+#ifdef FRUSTUM_SSE
+#include <xmmintrin.h>
+#endif
+
+// Number of lights whose ranges are computed by one job.
+#define CLUSTER_JOB_SIZE 256
+
+namespace {
+	// Test a sphere against planes through the eye with normals (a[j], z[j]) (a is the x or
+	// y component). Bit j of inFront is set if the sphere reaches in front of plane j, bit j
+	// of behind if it reaches behind it.
+	void testPlanes(const float * a, const float * z, unsigned int nPlanes, float ca, float cz, float r,
+		unsigned int & inFront, unsigned int & behind)
+	{
+		inFront = 0;
+		behind = 0;
+#ifdef FRUSTUM_SSE
+		__m128 sa = _mm_set1_ps(ca);
+		__m128 sz = _mm_set1_ps(cz);
+		__m128 sr = _mm_set1_ps(r);
+		__m128 negR = _mm_set1_ps(-r);
+		for (unsigned int j = 0; j < nPlanes; j += 4) {
+			__m128 dist = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a + j), sa), _mm_mul_ps(_mm_loadu_ps(z + j), sz));
+			inFront |= (unsigned int)_mm_movemask_ps(_mm_cmpge_ps(dist, negR)) << j;
+			behind |= (unsigned int)_mm_movemask_ps(_mm_cmple_ps(dist, sr)) << j;
+		}
+#else
+		for (unsigned int j = 0; j < nPlanes; j++) {
+			float dist = a[j] * ca + z[j] * cz;
+			if (dist >= -r) inFront |= 1u << j;
+			if (dist <= r) behind |= 1u << j;
+		}
+#endif
+	}
+
+	// Returns the range of set bits of a non-zero mask.
+	void bitRange(unsigned int mask, unsigned char & first, unsigned char & last)
+	{
+		unsigned int i = 0;
+		while (!(mask & (1u << i))) i++;
+		first = (unsigned char)i;
+		while (mask >> (i + 1)) i++;
+		last = (unsigned char)i;
+	}
+}
+
+LightClusterer::LightClusterer()
+{
+	clusterLights.resize(CLUSTER_COUNT);
+	sliceLights.resize(CLUSTER_GRID_Z);
+	clusters.resize(2 * CLUSTER_COUNT, 0);
+	setProjection(glm::fmat4(1.0f), nearPlane, farPlane);
+}
+
+LightClusterer::~LightClusterer()
+{
+}
+
+void LightClusterer::setProjection(const glm::fmat4 & projection, float nearPlane, float farPlane)
+{
+	p00 = projection[0][0];
+	p11 = projection[1][1];
+	this->nearPlane = nearPlane;
+	this->farPlane = farPlane;
+	sliceScale = CLUSTER_GRID_Z / std::log(farPlane / nearPlane);
+	sliceBias = -std::log(nearPlane) * sliceScale;
+
+	// A view space point is right of the boundary at x_ndc if p00 * x / -z > x_ndc, i.e. in
+	// front of the plane with normal (p00, 0, x_ndc).
+	for (unsigned int j = 0; j < 20; j++) {
+		float ndc = -1.0f + 2.0f * std::min(j, (unsigned int)CLUSTER_GRID_X) / CLUSTER_GRID_X;
+		float len = std::sqrt(p00 * p00 + ndc * ndc);
+		colX[j] = p00 / len;
+		colZ[j] = ndc / len;
+	}
+	for (unsigned int j = 0; j < 12; j++) {
+		float ndc = -1.0f + 2.0f * std::min(j, (unsigned int)CLUSTER_GRID_Y) / CLUSTER_GRID_Y;
+		float len = std::sqrt(p11 * p11 + ndc * ndc);
+		rowY[j] = p11 / len;
+		rowZ[j] = ndc / len;
+	}
+}
+
+void LightClusterer::assign(const float * x, const float * y, const float * z, const float * radius,
+	unsigned int count, ThreadPool * pool)
+{
+	ranges.resize(count);
+	unsigned int nJobs = (count + CLUSTER_JOB_SIZE - 1) / CLUSTER_JOB_SIZE;
+	ThreadPool::parallelFor(pool, nJobs, [&](unsigned int job) {
+		unsigned int first = job * CLUSTER_JOB_SIZE;
+		computeRanges(x, y, z, radius, first, std::min(count - first, (unsigned int)CLUSTER_JOB_SIZE));
+	});
+
+	for (unsigned int s = 0; s < CLUSTER_GRID_Z; s++)
+		sliceLights[s].clear();
+	for (unsigned int i = 0; i < count; i++) {
+		for (unsigned int s = ranges[i].z0; s <= ranges[i].z1; s++)
+			sliceLights[s].push_back(i);
+	}
+
+	// Every slice is filled by one job, so no two jobs write the same cluster's list:
+	ThreadPool::parallelFor(pool, CLUSTER_GRID_Z, [&](unsigned int slice) {
+		fillSlice(slice);
+	});
+
+	// Pack the lists:
+	indices.clear();
+	for (unsigned int i = 0; i < CLUSTER_COUNT; i++) {
+		clusters[2 * i] = indices.size();
+		clusters[2 * i + 1] = clusterLights[i].size();
+		indices.insert(indices.end(), clusterLights[i].begin(), clusterLights[i].end());
+	}
+}
+
+const std::vector<unsigned int> & LightClusterer::getClusters()
+{
+	return clusters;
+}
+
+const std::vector<unsigned int> & LightClusterer::getIndices()
+{
+	return indices;
+}
+
+unsigned int LightClusterer::getClusterIndex(unsigned int x, unsigned int y, unsigned int z)
+{
+	return (z * CLUSTER_GRID_Y + y) * CLUSTER_GRID_X + x;
+}
+
+int LightClusterer::findCluster(glm::fvec3 viewPos)
+{
+	float depth = -viewPos.z;
+	if (depth < nearPlane || depth > farPlane) return -1;
+	float ndcX = p00 * viewPos.x / depth;
+	float ndcY = p11 * viewPos.y / depth;
+	if (std::abs(ndcX) > 1.0f || std::abs(ndcY) > 1.0f) return -1;
+
+	unsigned int x = std::min((unsigned int)((ndcX * 0.5f + 0.5f) * CLUSTER_GRID_X), (unsigned int)CLUSTER_GRID_X - 1);
+	unsigned int y = std::min((unsigned int)((ndcY * 0.5f + 0.5f) * CLUSTER_GRID_Y), (unsigned int)CLUSTER_GRID_Y - 1);
+	return getClusterIndex(x, y, getSlice(depth));
+}
+
+float LightClusterer::getSliceScale()
+{
+	return sliceScale;
+}
+
+float LightClusterer::getSliceBias()
+{
+	return sliceBias;
+}
+
+unsigned int LightClusterer::getSlice(float depth)
+{
+	float slice = std::floor(std::log(depth) * sliceScale + sliceBias);
+	if (slice < 0.0f) return 0;
+	return std::min((unsigned int)slice, (unsigned int)CLUSTER_GRID_Z - 1);
+}
+
+void LightClusterer::computeRanges(const float * x, const float * y, const float * z, const float * radius,
+	unsigned int first, unsigned int count)
+{
+	const Range empty = { 1, 0, 1, 0, 1, 0 };
+	for (unsigned int i = first; i < first + count; i++) {
+		ranges[i] = empty;
+		float r = radius[i];
+		float minDepth = -z[i] - r, maxDepth = -z[i] + r;
+		if (maxDepth < nearPlane || minDepth > farPlane) continue;
+
+		// Column i contains points in front of plane i and behind plane i + 1:
+		unsigned int inFront, behind;
+		testPlanes(colX, colZ, 20, x[i], z[i], r, inFront, behind);
+		unsigned int columns = inFront & (behind >> 1) & ((1u << CLUSTER_GRID_X) - 1);
+		testPlanes(rowY, rowZ, 12, y[i], z[i], r, inFront, behind);
+		unsigned int rows = inFront & (behind >> 1) & ((1u << CLUSTER_GRID_Y) - 1);
+		if (columns == 0 || rows == 0) continue;
+
+		Range & range = ranges[i];
+		bitRange(columns, range.x0, range.x1);
+		bitRange(rows, range.y0, range.y1);
+		range.z0 = (unsigned char)getSlice(std::max(minDepth, nearPlane));
+		range.z1 = (unsigned char)getSlice(std::min(maxDepth, farPlane));
+	}
+}
+
+void LightClusterer::fillSlice(unsigned int slice)
+{
+	unsigned int firstCluster = getClusterIndex(0, 0, slice);
+	for (unsigned int c = firstCluster; c < firstCluster + CLUSTER_GRID_X * CLUSTER_GRID_Y; c++)
+		clusterLights[c].clear();
+
+	for (unsigned int i : sliceLights[slice]) {
+		const Range & range = ranges[i];
+		for (unsigned int y = range.y0; y <= range.y1; y++) {
+			for (unsigned int x = range.x0; x <= range.x1; x++) {
+				std::vector<unsigned int> & lights = clusterLights[getClusterIndex(x, y, slice)];
+				if (lights.size() < CLUSTER_MAX_LIGHTS) lights.push_back(i);
+			}
+		}
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include "Frustum.h"
+#include "ThreadPool.h"
+
+#include <vector>
+
+// Size of the cluster grid: screen tiles in x and y, and exponential depth slices in z.
+// Must be the same as in the shaders.
+#define CLUSTER_GRID_X 16
+#define CLUSTER_GRID_Y 9
+#define CLUSTER_GRID_Z 24
+#define CLUSTER_COUNT (CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z)
+// Maximum number of lights in one cluster. Further lights are dropped from the cluster.
+#define CLUSTER_MAX_LIGHTS 256
+
+// Assigns lights to the clusters (froxels) of the view frustum for clustered forward shading:
+// every cluster gets the list of lights whose sphere of influence may reach into it, so a
+// fragment only evaluates the lights of its cluster. Slices split the depth range
+// exponentially, so clusters are roughly cubic.
+// The tests are conservative: a light may be listed in clusters it does not reach, but
+// never misses one it does.
+class LightClusterer
+{
+public:
+	LightClusterer();
+	~LightClusterer();
+
+	// Set the camera's (symmetric) perspective projection and the depth range of the slices.
+	void setProjection(const glm::fmat4 & projection, float nearPlane, float farPlane);
+
+	// Assign the lights, given as view space spheres, to the clusters. The lights are split
+	// between the threads of pool, if one is passed.
+	void assign(const float * x, const float * y, const float * z, const float * radius,
+		unsigned int count, ThreadPool * pool = NULL);
+
+	// Offset into getIndices() and number of lights of every cluster (two values per
+	// cluster, see getClusterIndex()).
+	const std::vector<unsigned int> & getClusters();
+	// Light indices of all clusters.
+	const std::vector<unsigned int> & getIndices();
+
+	static unsigned int getClusterIndex(unsigned int x, unsigned int y, unsigned int z);
+	// Returns the index of the cluster containing a view space position, or -1 if it is
+	// outside of the view frustum.
+	int findCluster(glm::fvec3 viewPos);
+
+	// The slice of a view space depth d is floor(log(d) * sliceScale + sliceBias).
+	float getSliceScale();
+	float getSliceBias();
+
+private:
+	float p00 = 1.0f, p11 = 1.0f;
+	float nearPlane = 0.1f, farPlane = 100.0f;
+	float sliceScale = 1.0f, sliceBias = 0.0f;
+
+	// Planes through the eye between the columns (normal.x, normal.z) and rows (normal.y,
+	// normal.z), padded to multiples of 4. Points right of / above boundary j are in front of
+	// plane j.
+	float colX[20], colZ[20];
+	float rowY[12], rowZ[12];
+
+	// Cluster range of every light, empty (x0 > x1) if it is outside of the frustum.
+	struct Range {
+		unsigned char x0, x1, y0, y1, z0, z1;
+	};
+	std::vector<Range> ranges;
+	// Lights overlapping each slice.
+	std::vector<std::vector<unsigned int>> sliceLights;
+	std::vector<std::vector<unsigned int>> clusterLights;
+	std::vector<unsigned int> clusters;
+	std::vector<unsigned int> indices;
+
+	unsigned int getSlice(float depth);
+	// Compute ranges[first] to ranges[first + count - 1].
+	void computeRanges(const float * x, const float * y, const float * z, const float * radius,
+		unsigned int first, unsigned int count);
+	// Fill the light lists of the clusters in slice.
+	void fillSlice(unsigned int slice);
+};
@@ -0,0 +1,113 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string & path)
+{
+	close();
+	HANDLE f = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (f == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(f, &fileSize)) {
+		CloseHandle(f);
+		return false;
+	}
+	file = f;
+	opened = true;
+	size = (size_t)fileSize.QuadPart;
+	// Files of size 0 cannot be mapped.
+	if (size == 0) return true;
+
+	mapping = CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping != NULL) data = (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data == NULL) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (data != NULL) UnmapViewOfFile(data);
+	if (mapping != NULL) CloseHandle(mapping);
+	if (file != NULL) CloseHandle(file);
+	data = NULL;
+	mapping = NULL;
+	file = NULL;
+	size = 0;
+	opened = false;
+}
+
+#else
+
+bool MappedFile::open(const std::string & path)
+{
+	close();
+	fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close();
+		return false;
+	}
+	opened = true;
+	size = (size_t)st.st_size;
+	// Files of size 0 cannot be mapped.
+	if (size == 0) return true;
+
+	void * p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED) {
+		close();
+		return false;
+	}
+	data = (const unsigned char *)p;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (data != NULL) munmap((void *)data, size);
+	if (fd >= 0) ::close(fd);
+	data = NULL;
+	fd = -1;
+	size = 0;
+	opened = false;
+}
+
+#endif
+
+bool MappedFile::isOpen()
+{
+	return opened;
+}
+
+const unsigned char * MappedFile::getData()
+{
+	return data;
+}
+
+size_t MappedFile::getSize()
+{
+	return size;
+}
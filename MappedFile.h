@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only mapping of a whole file into memory (CreateFileMapping() on Windows, mmap()
+// elsewhere). Pages are only read from disk when they are first accessed, so opening is
+// cheap and the data can be used in place without copying it.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	// Map the file. Returns false if it cannot be opened. An empty file maps to NULL.
+	bool open(const std::string & path);
+	void close();
+	bool isOpen();
+
+	const unsigned char * getData();
+	size_t getSize();
+
+private:
+	const unsigned char * data = NULL;
+	size_t size = 0;
+	bool opened = false;
+#ifdef _WIN32
+	// HANDLEs of the file and the mapping, kept as void * to keep windows.h out of the header.
+	void * file = NULL;
+	void * mapping = NULL;
+#else
+	int fd = -1;
+#endif
+};
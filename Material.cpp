@@ -2,6 +2,8 @@
 
 #include "Utils.h"
 
+#include <atomic>
+
 static GLuint defaultTex, defaultNormal, defaultHeight;
 
 Material::Material()
@@ -52,6 +54,12 @@ Material::~Material()
 {
 }
 
+unsigned int Material::generateID()
+{
+	static std::atomic<unsigned int> counter(1);
+	return counter++;
+}
+
 void Material::setupDefaultTextures()
 {
 	glGenTextures(1, &defaultTex);
@@ -220,57 +228,33 @@ void Material::prepare(Shader * shader)
 	}
 	shader->use();
 
-	shader->setInt("mat.texAmbient", 0);
-	shader->setInt("mat.texDiffuse", 1);
-	shader->setInt("mat.texSpecular", 2);
-	shader->setInt("mat.normalMap", 3);
-	shader->setInt("mat.parallaxMap", 4);
-
-	shader->setVec3("mat.ambientColor", colorAmbient);
-	shader->setVec3("mat.diffuseColor", colorDiffuse);
-	shader->setVec3("mat.specularColor", colorSpecular);
-	shader->setFloat("mat.specularIntensity", intensitySpecular);
+	// The sampler uniforms are assigned to their texture units when the shader is linked.
+	const ShaderUniforms & u = shader->uniforms;
+	shader->set(u.matAmbientColor, colorAmbient);
+	shader->set(u.matDiffuseColor, colorDiffuse);
+	shader->set(u.matSpecularColor, colorSpecular);
+	shader->set(u.matSpecularIntensity, intensitySpecular);
 
 	// Is there a normal map?
 	if (mapNormal) {
-		shader->setBool("mat.normalMapping", true);
-		glActiveTexture(GL_TEXTURE3);
-		glBindTexture(GL_TEXTURE_2D, mapNormal);
+		shader->set(u.matNormalMapping, true);
+		GLState::bindTexture(MATERIAL_TEXTURE_UNIT + 3, GL_TEXTURE_2D, mapNormal);
 	}
 	else
-		shader->setBool("mat.normalMapping", false);
+		shader->set(u.matNormalMapping, false);
 
 	// Is there a displacement map?
 	if (mapDisplacement) {
-		shader->setBool("mat.parallaxMapping", true);
-		glActiveTexture(GL_TEXTURE4);
-		glBindTexture(GL_TEXTURE_2D, mapDisplacement);
+		shader->set(u.matParallaxMapping, true);
+		GLState::bindTexture(MATERIAL_TEXTURE_UNIT + 4, GL_TEXTURE_2D, mapDisplacement);
 	}
 	else
-		shader->setBool("mat.parallaxMapping", false);
+		shader->set(u.matParallaxMapping, false);
 
 	// Set up texture samplers
-	glActiveTexture(GL_TEXTURE0);
-	if (texAmbient) {
-		glBindTexture(GL_TEXTURE_2D, texAmbient);
-	}
-	else {
-		glBindTexture(GL_TEXTURE_2D, defaultTex);
-	}
-	glActiveTexture(GL_TEXTURE1);
-	if (texDiffuse) {
-		glBindTexture(GL_TEXTURE_2D, texDiffuse);
-	}
-	else {
-		glBindTexture(GL_TEXTURE_2D, defaultTex);
-	}
-	glActiveTexture(GL_TEXTURE2);
-	if (texSpecular) {
-		glBindTexture(GL_TEXTURE_2D, texSpecular);
-	}
-	else {
-		glBindTexture(GL_TEXTURE_2D, defaultTex);
-	}
+	GLState::bindTexture(MATERIAL_TEXTURE_UNIT + 0, GL_TEXTURE_2D, texAmbient ? texAmbient : defaultTex);
+	GLState::bindTexture(MATERIAL_TEXTURE_UNIT + 1, GL_TEXTURE_2D, texDiffuse ? texDiffuse : defaultTex);
+	GLState::bindTexture(MATERIAL_TEXTURE_UNIT + 2, GL_TEXTURE_2D, texSpecular ? texSpecular : defaultTex);
 }
 
 void Material::setColorAmbient(glm::fvec3 color)
@@ -369,6 +353,11 @@ const std::string Material::getName()
 	return name;
 }
 
+unsigned int Material::getID()
+{
+	return id;
+}
+
 void Material::deleteResources()
 {
 	glDeleteTextures(1, &texAmbient);
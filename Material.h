@@ -83,6 +83,9 @@ public:
 	void setName(const std::string name);
 	const std::string getName();
 
+	// Returns the material's unique ID (e.g. for sorting draws by material).
+	unsigned int getID();
+
 	// Use this method ONLY IF this material was NOT created from a MaterialManager!
 	// This deletes all textures in use freeing up the graphics memory, meaning other 
 	// materials can no longer access them.
@@ -105,6 +108,9 @@ public:
 private:
 	std::string name;
 
+	static unsigned int generateID();
+	unsigned int id = generateID();
+
 	glm::fvec3 colorAmbient;
 	glm::fvec3 colorDiffuse;
 	glm::fvec3 colorSpecular;
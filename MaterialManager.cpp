@@ -6,8 +6,12 @@ MaterialManager::MaterialManager()
 	//Create a default shader to use whenever no shader is available
 	addShader("default", new Shader("Shader\\phongShader_LayeredShadows.vs", "Shader\\phongShader_LayeredShadows.fs"));
 	//addShader("default", new Shader("Shader\\basicShader.vs", "Shader\\basicShader.fs"));
-	//addShader("depthShader", new Shader("Shader\\depthShader_multilevel.vs", "Shader\\depthShader_multilevel.fs", "Shader\\depthShader_multilevel.gs"));
 	addShader("depthShader", new Shader("Shader\\depthShader_multilevel.vs", "Shader\\depthShader_multilevel.fs"));
+	// Shaders rendering all layers of a shadow map in one pass (see ShadowRenderMode and PointLight):
+	addShader("depthShaderLayered", new Shader("Shader\\depthShader_layered.vs", "Shader\\depthShader_multilevel.fs", "Shader\\depthShader_layered.gs"));
+	addShader("depthShaderCube", new Shader("Shader\\depthShader_layered.vs", "Shader\\depthShader_multilevel.fs", "Shader\\depthShader_cube.gs"));
+	if (GLAD_GL_ARB_shader_viewport_layer_array || GLAD_GL_AMD_vertex_shader_layer)
+		addShader("depthShaderVertexLayer", new Shader("Shader\\depthShader_vertexLayer.vs", "Shader\\depthShader_multilevel.fs"));
 
 	//Create a default material to use when no other material is specified
 	Material * defaultMat = new Material();
@@ -83,16 +87,21 @@ Material * MaterialManager::loadFromAiMaterial(std::string name, aiMaterial * ma
 
 void MaterialManager::updateShaders(Camera * c)
 {
-	for(std::map<std::string, Shader *>::iterator it = shaders.begin(); it != shaders.end(); it++)
-		c->setShaderMatrices(it->second);
+	// Shaders using the camera uniform block have no such uniforms and are skipped.
+	for (std::map<std::string, Shader *>::iterator it = shaders.begin(); it != shaders.end(); it++) {
+		const ShaderUniforms & u = it->second->uniforms;
+		if (u.projection.isValid() || u.view.isValid() || u.cameraPos.isValid())
+			c->setShaderMatrices(it->second);
+	}
 }
 
 void MaterialManager::updateShaders(glm::fmat4 projection, glm::fmat4 view)
 {
 	for (std::map<std::string, Shader *>::iterator it = shaders.begin(); it != shaders.end(); it++) {
 		Shader * s = (*it).second;
-		s->setMat4("projection", projection);
-		s->setMat4("view", view);
+		s->use();
+		s->set(s->uniforms.projection, projection);
+		s->set(s->uniforms.view, view);
 	}
 }
 
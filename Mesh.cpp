@@ -0,0 +1,721 @@
+#include "Mesh.h"
+#include "GLState.h"
+#include "RenderStats.h"
+#include "MeshSimplifier.h"
+#include "SceneCache.h"
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstddef>
+
+// Padding of the bounds that the packed positions of streamed meshes are relative to, in
+// parts of the bounds' half size. Vertices moving within the padding only change themselves.
+#define STREAM_BOUNDS_PADDING 0.25f
+
+namespace {
+	AABB padBounds(const AABB & bounds)
+	{
+		glm::fvec3 padding = bounds.getHalfSize() * STREAM_BOUNDS_PADDING;
+		AABB res;
+		res.min = bounds.min - padding;
+		res.max = bounds.max + padding;
+		return res;
+	}
+}
+
+std::atomic<unsigned int> Mesh::nextVersion(1);
+std::atomic<unsigned int> Mesh::nextID(1);
+VertexLayout Mesh::defaultLayout;
+bool Mesh::optimizeOnImport = true;
+bool Mesh::buildLodsOnImport = true;
+bool Mesh::useGeometryArena = true;
+
+Mesh::Mesh()
+{
+}
+
+Mesh::Mesh(aiMesh * mesh, bool upload)
+{
+	name = mesh->mName.C_Str();
+	loadVertices(mesh->mVertices, mesh->mNormals, mesh->mTextureCoords[0], mesh->mColors[0], mesh->mTangents, mesh->mBitangents, mesh->mNumVertices);
+	loadFaces(mesh->mFaces, mesh->mNumFaces);
+	if (optimizeOnImport) optimize();
+	if (buildLodsOnImport) buildLods();
+
+	if (upload) setupBuffers();
+}
+
+Mesh::Mesh(SceneCache & cache, unsigned int index, bool upload)
+{
+	const SceneCacheMesh & m = cache.getMesh(index);
+	name = cache.getString(m.name);
+	if (m.vertexCount > 0) {
+		vertices.resize(m.vertexCount);
+		memcpy(&vertices[0], cache.getData(m.vertices), m.vertexCount * sizeof(Vertex));
+	}
+	//The indices of the full mesh, followed by the LODs:
+	indices.resize(m.indexCount);
+	lodIndices.resize(m.lodIndexCount);
+	if (m.indexType == GL_UNSIGNED_SHORT) {
+		const unsigned short * in = (const unsigned short *)cache.getData(m.encodedIndices);
+		for (unsigned int & i : indices) i = *in++;
+		for (unsigned int & i : lodIndices) i = *in++;
+	}
+	else {
+		const unsigned int * in = (const unsigned int *)cache.getData(m.encodedIndices);
+		if (m.indexCount > 0) memcpy(&indices[0], in, m.indexCount * sizeof(unsigned int));
+		if (m.lodIndexCount > 0) memcpy(&lodIndices[0], in + m.indexCount, m.lodIndexCount * sizeof(unsigned int));
+	}
+	if (m.numLods > 0) {
+		const MeshLod * in = (const MeshLod *)cache.getData(m.lods);
+		lods.assign(in, in + m.numLods);
+	}
+	indexType = m.indexType;
+	bounds = m.bounds;
+	boundingSphere = m.boundingSphere;
+	optimizationStats = m.optimizationStats;
+
+	//The baked buffers are encoded with the default layout (see SceneCache::hashSettings()):
+	if (m.encodedVertexBytes > 0 && m.encodedIndexBytes > 0) {
+		bakedVertices = cache.getData(m.encodedVertices);
+		bakedIndices = cache.getData(m.encodedIndices);
+		bakedIndexBytes = m.encodedIndexBytes;
+	}
+
+	if (upload) setupBuffers();
+}
+
+Mesh::~Mesh()
+{
+	deleteResources();
+	vertices.clear();
+	indices.clear();
+}
+
+Mesh * Mesh::createQuad()
+{
+	Mesh * res = new Mesh();
+
+	res->name = "Plane";
+
+	Vertex v;
+	v.color = glm::fvec4(1.0f, 1.0f, 1.0f, 1.0f);
+	v.normal = glm::fvec3(0.0f, 1.0f, 0.0f);
+	v.tangent = glm::fvec3(1.0f, 0.0f, 0.0f);
+	v.bitangent = glm::fvec3(0.0f, 0.0f, 1.0f);
+
+	// Bottom-left vertex (0)
+	v.position = glm::fvec3(-1.0f, -1.0f, 0.0f);
+	v.uv = glm::fvec2(0.0f, 0.0f);
+	res->vertices.push_back(v);
+
+	// Bottom-right vertex (1)
+	v.position = glm::fvec3(1.0f, -1.0f, 0.0f);
+	v.uv = glm::fvec2(1.0f, 0.0f);
+	res->vertices.push_back(v);
+
+	// Upper-right vertex (2)
+	v.position = glm::fvec3(1.0f, 1.0f, 0.0f);
+	v.uv = glm::fvec2(1.0f, 1.0f);
+	res->vertices.push_back(v);
+
+	// Upper-left vertex (3)
+	v.position = glm::fvec3(-1.0f, 1.0f, 0.0f);
+	v.uv = glm::fvec2(0.0f, 1.0f);
+	res->vertices.push_back(v);
+
+	res->indices.push_back(0);
+	res->indices.push_back(1);
+	res->indices.push_back(2);
+	res->indices.push_back(0);
+	res->indices.push_back(2);
+	res->indices.push_back(3);
+
+	res->computeBounds();
+	res->setupBuffers();
+
+	return res;
+}
+
+void Mesh::draw(unsigned int lod)
+{
+	if (!updateBuffers()) return;
+
+	MeshLod range = getLod(lod);
+	unsigned int indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+	bind();
+	glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, indexType, (void*)(getIndexOffset() + (size_t)range.firstIndex * indexSize), getBaseVertex());
+	renderStats.drawCalls++;
+	renderStats.trianglesDrawn += range.indexCount / 3;
+}
+
+void Mesh::drawInstanced(unsigned int count, unsigned int lod)
+{
+	if (count == 0 || !updateBuffers()) return;
+
+	MeshLod range = getLod(lod);
+	unsigned int indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+	bind();
+	glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, indexType, (void*)(getIndexOffset() + (size_t)range.firstIndex * indexSize), count, getBaseVertex());
+	renderStats.drawCalls++;
+	renderStats.trianglesDrawn += (unsigned long long)range.indexCount / 3 * count;
+	renderStats.instancedDrawCalls++;
+	renderStats.instancedObjects += count;
+}
+
+void Mesh::setInstanceBuffer(GLuint buffer, GLintptr offset, GLuint divisor)
+{
+	if (!updateBuffers()) return;
+	if (arena) {
+		arena->setInstanceBuffer(buffer, offset, divisor);
+		return;
+	}
+	if (buffer == instanceBuffer && offset == instanceOffset && divisor == instanceDivisor) return;
+
+	GLState::bindVertexArray(VAO);
+	setupInstanceAttributes(buffer, offset, divisor);
+	instanceBuffer = buffer;
+	instanceOffset = offset;
+	instanceDivisor = divisor;
+}
+
+void Mesh::setupInstanceAttributes(GLuint buffer, GLintptr offset, GLuint divisor)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	for (unsigned int i = 0; i < 4; i++) {
+		glEnableVertexAttribArray(INSTANCE_ATTRIB_LOCATION + i);
+		glVertexAttribPointer(INSTANCE_ATTRIB_LOCATION + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offset + offsetof(InstanceData, model) + i * sizeof(glm::fvec4)));
+		glVertexAttribDivisor(INSTANCE_ATTRIB_LOCATION + i, divisor);
+	}
+	glEnableVertexAttribArray(INSTANCE_DECODE_ATTRIB_LOCATION);
+	glVertexAttribPointer(INSTANCE_DECODE_ATTRIB_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offset + offsetof(InstanceData, posScale)));
+	glVertexAttribDivisor(INSTANCE_DECODE_ATTRIB_LOCATION, divisor);
+	glEnableVertexAttribArray(INSTANCE_DECODE_ATTRIB_LOCATION + 1);
+	glVertexAttribPointer(INSTANCE_DECODE_ATTRIB_LOCATION + 1, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offset + offsetof(InstanceData, posOffset)));
+	glVertexAttribDivisor(INSTANCE_DECODE_ATTRIB_LOCATION + 1, divisor);
+}
+
+bool Mesh::getDrawCommand(unsigned int lod, unsigned int instanceCount, unsigned int baseInstance,
+	DrawElementsIndirectCommand & command)
+{
+	if (arena == NULL) return false;
+	MeshLod range = getLod(lod);
+	unsigned int indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+	command.count = range.indexCount;
+	command.instanceCount = instanceCount;
+	// The index ranges of the arena are aligned to 4 bytes, so this is exact.
+	command.firstIndex = arenaRange.indexOffset / indexSize + range.firstIndex;
+	command.baseVertex = arenaRange.firstVertex;
+	command.baseInstance = baseInstance;
+	return true;
+}
+
+bool Mesh::updateBuffers()
+{
+	if (VAO == 0) {
+		setupBuffers();
+	}
+	else if (!valid) {
+		if (streaming && stream != NULL && stream->getSize() == (GLsizeiptr)(vertices.size() * layout.getStride())) {
+			streamVertices();
+			valid = true;
+		}
+		else if (forceStatic && uploadedVertices == vertices.size()) {
+			// Static by request (see setStreaming()): overwrite the buffer in place.
+			updateStaticVertices();
+			valid = true;
+		}
+		else {
+			// The vertices change after their first upload (or their number changed): stream
+			// them from now on, instead of reallocating the vertex buffer on every change.
+			if (!forceStatic) streaming = true;
+			deleteResources();
+			setupBuffers();
+		}
+	}
+	return VAO != 0;
+}
+
+void Mesh::updateStaticVertices()
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	// Packed positions are relative to the bounds, so all vertices are encoded again.
+	std::vector<unsigned char> vertexData;
+	encodedBounds = bounds;
+	encodeVertices(vertexData);
+	if (arena) {
+		arena->uploadVertices(arenaRange, &vertexData[0]);
+	}
+	else {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, 0, vertexData.size(), &vertexData[0]);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		renderStats.bufferBytesUploaded += vertexData.size();
+	}
+	dirtyBegin = dirtyEnd = 0;
+	renderStats.bufferUploadTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void Mesh::encodeVertices(std::vector<unsigned char> & data)
+{
+	data.resize(vertices.size() * layout.getStride());
+	layout.encode(&vertices[0], vertices.size(), encodedBounds, &data[0]);
+	layout.getPositionDecode(encodedBounds, posScale, posOffset);
+}
+
+void Mesh::streamVertices()
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	unsigned int stride = layout.getStride();
+	// Packed positions are relative to the encoded bounds, so all vertices are encoded again
+	// when one leaves them.
+	if (layout.isPacked() && (glm::any(glm::lessThan(bounds.min, encodedBounds.min)) || glm::any(glm::greaterThan(bounds.max, encodedBounds.max)))) {
+		encodedBounds = padBounds(bounds);
+		layout.getPositionDecode(encodedBounds, posScale, posOffset);
+		dirtyBegin = 0;
+		dirtyEnd = vertices.size();
+	}
+	if (dirtyEnd > dirtyBegin) {
+		layout.encode(&vertices[dirtyBegin], dirtyEnd - dirtyBegin, encodedBounds, &streamData[(size_t)dirtyBegin * stride]);
+		stream->invalidate((GLintptr)dirtyBegin * stride, (GLsizeiptr)(dirtyEnd - dirtyBegin) * stride);
+	}
+	dirtyBegin = dirtyEnd = 0;
+	renderStats.bufferUploadTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	stream->update(&streamData[0]);
+}
+
+GLint Mesh::getBaseVertex()
+{
+	if (arena) return arenaRange.firstVertex;
+	return stream ? (GLint)(stream->getRegion() * vertices.size()) : 0;
+}
+
+GLintptr Mesh::getIndexOffset()
+{
+	return arena ? arenaRange.indexOffset : 0;
+}
+
+GLenum Mesh::getEncodedData(std::vector<unsigned char> & vertexData, std::vector<unsigned char> & indexData)
+{
+	vertexData.clear();
+	indexData.clear();
+	if (vertices.empty() || indices.empty()) return GL_UNSIGNED_INT;
+	vertexData.resize(vertices.size() * layout.getStride());
+	layout.encode(&vertices[0], vertices.size(), bounds, &vertexData[0]);
+	return encodeIndices(indexData);
+}
+
+GLenum Mesh::encodeIndices(std::vector<unsigned char> & data)
+{
+	//All triangles, followed by the LODs:
+	unsigned int count = indices.size() + lodIndices.size();
+	if (vertices.size() <= 65536) {
+		data.resize(count * sizeof(unsigned short));
+		unsigned short * out = (unsigned short *)&data[0];
+		for (unsigned int i : indices) *out++ = (unsigned short)i;
+		for (unsigned int i : lodIndices) *out++ = (unsigned short)i;
+		return GL_UNSIGNED_SHORT;
+	}
+	data.resize(count * sizeof(unsigned int));
+	memcpy(&data[0], &indices[0], indices.size() * sizeof(unsigned int));
+	if (!lodIndices.empty())
+		memcpy(&data[indices.size() * sizeof(unsigned int)], &lodIndices[0], lodIndices.size() * sizeof(unsigned int));
+	return GL_UNSIGNED_INT;
+}
+
+void Mesh::bind()
+{
+	glm::fvec4 scale, offset;
+	getPositionDecode(scale, offset);
+	GLState::bindVertexArray(VAO);
+	GLState::setVertexAttrib(POSITION_SCALE_ATTRIB_LOCATION, scale);
+	GLState::setVertexAttrib(POSITION_OFFSET_ATTRIB_LOCATION, offset);
+}
+
+void Mesh::getPositionDecode(glm::fvec4 & scale, glm::fvec4 & offset)
+{
+	scale = glm::fvec4(posScale, layout.isPacked() ? 1.0f : 0.0f);
+	offset = glm::fvec4(posOffset, 1.0f);
+}
+
+std::vector<Vertex> & Mesh::getVertices()
+{
+	return vertices;
+}
+
+std::vector<unsigned int> & Mesh::getIndices()
+{
+	return indices;
+}
+
+unsigned int Mesh::getNumVertices()
+{
+	return vertices.size();
+}
+
+unsigned int Mesh::getNumIndices()
+{
+	return indices.size();
+}
+
+GLuint Mesh::getVAO()
+{
+	return VAO;
+}
+
+unsigned int Mesh::getID()
+{
+	return id;
+}
+
+GLenum Mesh::getIndexType()
+{
+	return indexType;
+}
+
+MeshOptimizationStats Mesh::optimize()
+{
+	optimizationStats = MeshOptimizer::optimize(vertices, indices);
+	// Unreferenced vertices were removed, and the buffers hold the old order.
+	lods.clear();
+	lodIndices.clear();
+	computeBounds();
+	deleteResources();
+	return optimizationStats;
+}
+
+const MeshOptimizationStats & Mesh::getOptimizationStats()
+{
+	return optimizationStats;
+}
+
+void Mesh::setOptimizeOnImport(bool enabled)
+{
+	optimizeOnImport = enabled;
+}
+
+bool Mesh::getOptimizeOnImport()
+{
+	return optimizeOnImport;
+}
+
+unsigned int Mesh::buildLods(unsigned int maxLods)
+{
+	lods.clear();
+	lodIndices.clear();
+	float radius = boundingSphere.radius;
+	if (indices.size() < 6 || radius <= 0.0f) return getNumLods();
+
+	// Every level is simplified from the previous one, so the errors add up.
+	std::vector<unsigned int> source(indices);
+	std::vector<unsigned int> lod;
+	float error = 0.0f;
+	for (unsigned int level = 1; level < maxLods; level++) {
+		unsigned int target = source.size() / 6 * 3;
+		float maxError = radius * MESH_LOD_MAX_ERROR - error;
+		if (maxError <= 0.0f) break;
+		error += MeshSimplifier::simplify(&vertices[0], vertices.size(), &source[0], source.size(), target, maxError, lod);
+		// Not worth the memory if the level is barely smaller than the previous one:
+		if (lod.empty() || lod.size() * 10 > source.size() * 9) break;
+
+		MeshOptimizer::optimizeVertexCache(&lod[0], lod.size(), vertices.size());
+		MeshLod l = { (unsigned int)(indices.size() + lodIndices.size()), (unsigned int)lod.size(), error / radius };
+		lods.push_back(l);
+		lodIndices.insert(lodIndices.end(), lod.begin(), lod.end());
+		source.swap(lod);
+	}
+
+	// The element buffer has to include the new levels.
+	deleteResources();
+	return getNumLods();
+}
+
+unsigned int Mesh::getNumLods()
+{
+	return 1 + lods.size();
+}
+
+MeshLod Mesh::getLod(unsigned int lod)
+{
+	if (lod == 0 || lods.empty()) {
+		MeshLod full = { 0, (unsigned int)indices.size(), 0.0f };
+		return full;
+	}
+	return lods[std::min(lod, (unsigned int)lods.size()) - 1];
+}
+
+unsigned int Mesh::selectLod(float screenRadius, float pixelError, unsigned int current, float hysteresis)
+{
+	// The errors grow with the level, so the first level above the limit ends the search.
+	unsigned int lod = 0;
+	for (unsigned int i = 1; i <= lods.size(); i++) {
+		float limit = i > current ? pixelError * (1.0f - hysteresis) : pixelError;
+		if (lods[i - 1].error * screenRadius > limit) break;
+		lod = i;
+	}
+	return lod;
+}
+
+void Mesh::setBuildLodsOnImport(bool enabled)
+{
+	buildLodsOnImport = enabled;
+}
+
+bool Mesh::getBuildLodsOnImport()
+{
+	return buildLodsOnImport;
+}
+
+void Mesh::setVertexLayout(const VertexLayout & layout)
+{
+	if (layout == this->layout) return;
+	this->layout = layout;
+	deleteResources();
+}
+
+const VertexLayout & Mesh::getVertexLayout()
+{
+	return layout;
+}
+
+void Mesh::setDefaultVertexLayout(const VertexLayout & layout)
+{
+	defaultLayout = layout;
+}
+
+const VertexLayout & Mesh::getDefaultVertexLayout()
+{
+	return defaultLayout;
+}
+
+unsigned int Mesh::getVertexBufferSize()
+{
+	return vertices.size() * layout.getStride();
+}
+
+void Mesh::setUseGeometryArena(bool enabled)
+{
+	useGeometryArena = enabled;
+}
+
+bool Mesh::getUseGeometryArena()
+{
+	return useGeometryArena;
+}
+
+GeometryArena * Mesh::getGeometryArena()
+{
+	return arena;
+}
+
+const AABB & Mesh::getBounds()
+{
+	return bounds;
+}
+
+const BoundingSphere & Mesh::getBoundingSphere()
+{
+	return boundingSphere;
+}
+
+void Mesh::setName(std::string name)
+{
+	this->name = name;
+}
+
+std::string Mesh::getName()
+{
+	return name;
+}
+
+void Mesh::invalidate()
+{
+	invalidate(0, vertices.size());
+}
+
+void Mesh::invalidate(unsigned int firstVertex, unsigned int count)
+{
+	unsigned int end = std::min(firstVertex + count, (unsigned int)vertices.size());
+	if (firstVertex < end) {
+		if (dirtyEnd > dirtyBegin) {
+			dirtyBegin = std::min(dirtyBegin, firstVertex);
+			dirtyEnd = std::max(dirtyEnd, end);
+		}
+		else {
+			dirtyBegin = firstVertex;
+			dirtyEnd = end;
+		}
+	}
+	valid = false;
+	version = nextVersion++;
+	bakedVertices = bakedIndices = NULL;
+	computeBounds();
+}
+
+void Mesh::setStreaming(bool enabled)
+{
+	forceStatic = !enabled;
+	if (enabled == streaming) return;
+	streaming = enabled;
+	deleteResources();
+}
+
+bool Mesh::isStreaming()
+{
+	return streaming;
+}
+
+unsigned int Mesh::getVersion()
+{
+	return version;
+}
+
+void Mesh::deleteResources()
+{
+	// The baked buffers do not match anymore once the vertices, indices or layout change.
+	bakedVertices = bakedIndices = NULL;
+	if (VAO == 0) return;
+	valid = false;
+	if (arena) {
+		// The vertex array belongs to the arena.
+		arena->free(arenaRange);
+		arena = NULL;
+		VAO = 0;
+		return;
+	}
+	// Unbind first, so GLState does not consider a later VAO with the same name bound.
+	GLState::bindVertexArray(0);
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &VBO);
+	glDeleteBuffers(1, &EBO);
+	VAO = VBO = EBO = 0;
+	delete stream;
+	stream = NULL;
+	instanceBuffer = 0;
+	instanceOffset = -1;
+	instanceDivisor = 0;
+}
+
+void Mesh::setupBuffers()
+{
+	if (vertices.empty() || indices.empty()) return;
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	std::vector<unsigned char> vertexData, indexData;
+	const void * vertexPtr = bakedVertices;
+	const void * indexPtr = bakedIndices;
+	unsigned int indexBytes = bakedIndexBytes;
+	bakedVertices = bakedIndices = NULL;
+	encodedBounds = streaming ? padBounds(bounds) : bounds;
+	if (vertexPtr != NULL && !streaming) {
+		//Upload the baked buffers straight from the cache:
+		layout.getPositionDecode(encodedBounds, posScale, posOffset);
+	}
+	else {
+		encodeVertices(vertexData);
+		indexType = encodeIndices(indexData);
+		vertexPtr = &vertexData[0];
+		indexPtr = &indexData[0];
+		indexBytes = indexData.size();
+	}
+	unsigned int vertexBytes = vertices.size() * layout.getStride();
+	uploadedVertices = vertices.size();
+	dirtyBegin = dirtyEnd = 0;
+	valid = true;
+
+	if (!streaming && useGeometryArena) {
+		arena = GeometryArena::get(layout);
+		arenaRange = arena->allocate(vertices.size(), indexBytes);
+		arena->uploadVertices(arenaRange, vertexPtr);
+		arena->uploadIndices(arenaRange, indexPtr);
+		VAO = arena->getVAO();
+		renderStats.bufferUploadTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		return;
+	}
+
+	//Setup buffers:
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &EBO);
+
+	GLState::bindVertexArray(VAO);
+	if (streaming) {
+		streamData.swap(vertexData);
+		stream = new StreamBuffer(streamData.size(), &streamData[0]);
+		glBindBuffer(GL_ARRAY_BUFFER, stream->getBuffer());
+	}
+	else {
+		//Array buffer for all vertices:
+		glGenBuffers(1, &VBO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertexPtr, GL_STATIC_DRAW);
+		renderStats.bufferBytesUploaded += vertexBytes;
+	}
+
+	//Element buffer for all triangles:
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, indexPtr, GL_STATIC_DRAW);
+	renderStats.bufferBytesUploaded += indexBytes;
+
+	layout.setupAttributes();
+
+	GLState::bindVertexArray(0);
+	renderStats.bufferUploadTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void Mesh::loadVertices(aiVector3D * vertices, aiVector3D * normals, aiVector3D * uvs, aiColor4D * colors, aiVector3D * tangents, aiVector3D * bitangents, unsigned int nVertices)
+{
+	this->vertices.reserve(this->vertices.size() + nVertices);
+	for (unsigned int i = 0; i < nVertices; i++) {
+		Vertex v = Vertex();
+		v.position = glm::fvec3(vertices[i].x, vertices[i].y, vertices[i].z);
+		if (normals) v.normal = glm::fvec3(normals[i].x, normals[i].y, normals[i].z);
+		if (uvs) v.uv = glm::fvec2(uvs[i].x, uvs[i].y);
+		if (colors) v.color = glm::fvec4(colors[i].r, colors[i].g, colors[i].b, colors[i].a);
+		if (tangents) v.tangent = glm::fvec3(tangents[i].x, tangents[i].y, tangents[i].z);
+		if (bitangents) v.bitangent = glm::fvec3(bitangents[i].x, bitangents[i].y, bitangents[i].z);
+
+		this->vertices.push_back(v);
+	}
+
+	computeBounds();
+}
+
+void Mesh::loadFaces(aiFace * faces, unsigned int nFaces)
+{
+	indices.reserve(indices.size() + 3 * nFaces);
+	for (unsigned int i = 0; i < nFaces; i++) {
+		if (faces[i].mNumIndices != 3) {
+			std::cerr << "Mesh.cpp: ERROR while loading faces. Some faces are not triangles" << std::endl;
+			continue;
+		}
+		for (unsigned int j = 0; j < 3; j++) {
+			indices.push_back(faces[i].mIndices[j]);
+		}
+	}
+}
+
+void Mesh::computeBounds()
+{
+	bounds = AABB();
+	boundingSphere = BoundingSphere();
+	if (vertices.empty()) return;
+
+	bounds.min = bounds.max = vertices[0].position;
+	for (Vertex & v : vertices) {
+		bounds.min = glm::min(bounds.min, v.position);
+		bounds.max = glm::max(bounds.max, v.position);
+	}
+
+	// Centered on the box, but only as large as the vertices require (usually smaller
+	// than the box's circumsphere).
+	boundingSphere.center = bounds.getCenter();
+	float radius2 = 0.0f;
+	for (Vertex & v : vertices) {
+		glm::fvec3 d = v.position - boundingSphere.center;
+		radius2 = glm::max(radius2, glm::dot(d, d));
+	}
+	boundingSphere.radius = glm::sqrt(radius2);
+}
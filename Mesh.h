@@ -0,0 +1,249 @@
+#pragma once
+
+#include "assimp\Importer.hpp"
+#include "assimp\scene.h"
+#include "assimp\postprocess.h"
+
+#include <glm/glm.hpp>
+#include <glad\glad.h>
+
+#include "Bounds.h"
+#include "VertexLayout.h"
+#include "MeshOptimizer.h"
+#include "StreamBuffer.h"
+#include "GeometryArena.h"
+
+#include <vector>
+#include <string>
+#include <atomic>
+
+class SceneCache;
+
+// First attribute location of the per-instance model matrix (uses 4 locations), and of
+// the per-instance position decoding (2 locations, see InstanceData).
+#define INSTANCE_ATTRIB_LOCATION 6
+#define INSTANCE_DECODE_ATTRIB_LOCATION 12
+// Maximum number of levels of detail of a mesh, including the full mesh.
+#define MESH_MAX_LODS 5
+// Largest error of the coarsest LOD, relative to the radius of the mesh's bounding sphere.
+#define MESH_LOD_MAX_ERROR 0.25f
+
+// Per-instance data of instanced draws. Besides the model matrix, it holds the position
+// decoding of the instance's mesh (see VertexLayout.h), so that one multi-draw can cover
+// meshes with different bounds.
+struct InstanceData {
+	glm::fmat4 model;
+	glm::fvec4 posScale;
+	glm::fvec4 posOffset;
+};
+
+// A level of detail: a range of the element buffer (in indices) and the largest distance
+// between its surface and the full mesh, relative to the radius of the bounding sphere.
+struct MeshLod {
+	unsigned int firstIndex;
+	unsigned int indexCount;
+	float error;
+};
+
+// Geometry stored on the GPU (vertex array, vertex buffer and element buffer). A Mesh can
+// be shared by any number of PolygonModels, so geometry referenced by several nodes of a
+// scene is only uploaded once.
+// Static meshes are stored in the GeometryArena of their vertex layout by default, so they
+// share its buffers and vertex array. Streamed meshes have buffers of their own.
+class Mesh
+{
+public:
+	Mesh();
+	// Convert the aiMesh (optimizing it and building its LODs, see setOptimizeOnImport() and
+	// setBuildLodsOnImport()). If upload is false, no GL calls are made, so this can run on
+	// a thread without the context, and the buffers are created by the first updateBuffers().
+	Mesh(aiMesh * mesh, bool upload = true);
+	// Restore the mesh baked into the cache at index (see SceneCache). Its buffers are
+	// uploaded straight from the mapped file, so the cache has to stay open until the first
+	// updateBuffers() (made here if upload is true).
+	Mesh(SceneCache & cache, unsigned int index, bool upload = true);
+	~Mesh();
+
+	static Mesh * createQuad();
+
+	// Bind the vertex array and draw all triangles of the given LOD. Uploads the changed
+	// vertices first if the mesh was invalidated.
+	void draw(unsigned int lod = 0);
+	// Draw count instances. The per-instance data is read from the buffer set via
+	// setInstanceBuffer().
+	void drawInstanced(unsigned int count, unsigned int lod = 0);
+	// Source the per-instance attributes (one InstanceData per instance, at the locations
+	// INSTANCE_ATTRIB_LOCATION to INSTANCE_ATTRIB_LOCATION + 3 and
+	// INSTANCE_DECODE_ATTRIB_LOCATION to INSTANCE_DECODE_ATTRIB_LOCATION + 1) from the
+	// buffer, starting offset bytes into it. The attributes advance every divisor instances.
+	void setInstanceBuffer(GLuint buffer, GLintptr offset, GLuint divisor = 1);
+	// Set up the per-instance attributes of the bound vertex array (see setInstanceBuffer()).
+	static void setupInstanceAttributes(GLuint buffer, GLintptr offset, GLuint divisor);
+	// Fill an indirect draw command for instanceCount instances of the LOD, reading their
+	// per-instance data from baseInstance on. Only meshes in a GeometryArena can be drawn
+	// indirectly; returns false for others.
+	bool getDrawCommand(unsigned int lod, unsigned int instanceCount, unsigned int baseInstance,
+		DrawElementsIndirectCommand & command);
+	// Create or update the buffers if necessary. Returns false if there is nothing to draw.
+	bool updateBuffers();
+
+	std::vector<Vertex> & getVertices();
+	std::vector<unsigned int> & getIndices();
+	unsigned int getNumVertices();
+	unsigned int getNumIndices();
+	GLuint getVAO();
+	// Unique number of the mesh, e.g. to sort draws by mesh.
+	unsigned int getID();
+	// Type of the indices in the element buffer: GL_UNSIGNED_SHORT if the mesh has at most
+	// 65536 vertices, GL_UNSIGNED_INT otherwise.
+	GLenum getIndexType();
+
+	// Reorder the triangles and vertices for the vertex cache, overdraw and vertex fetch (see
+	// MeshOptimizer). Meshes loaded from assimp are optimized when they are created, unless
+	// disabled with setOptimizeOnImport().
+	MeshOptimizationStats optimize();
+	// Statistics of the last optimize().
+	const MeshOptimizationStats & getOptimizationStats();
+	static void setOptimizeOnImport(bool enabled);
+	static bool getOptimizeOnImport();
+
+	// Build coarser levels of detail with quadric error simplification (see MeshSimplifier),
+	// each with about half the triangles of the previous one, up to maxLods levels including
+	// the full mesh. Stops early when the error would exceed MESH_LOD_MAX_ERROR or a level
+	// does not get significantly smaller. All levels share the vertex buffer and are stored
+	// one after the other in the element buffer. Meshes loaded from assimp build their LODs
+	// when they are created, unless disabled with setBuildLodsOnImport().
+	// Returns the number of levels.
+	unsigned int buildLods(unsigned int maxLods = MESH_MAX_LODS);
+	unsigned int getNumLods();
+	MeshLod getLod(unsigned int lod);
+	// Select the coarsest LOD whose error, projected to screen, is at most pixelError.
+	// screenRadius is the radius of the bounding sphere in pixels. To avoid popping back and
+	// forth, switching to a LOD coarser than current requires the error to be below
+	// pixelError * (1 - hysteresis).
+	unsigned int selectLod(float screenRadius, float pixelError, unsigned int current, float hysteresis);
+	static void setBuildLodsOnImport(bool enabled);
+	static bool getBuildLodsOnImport();
+
+	// Layout of the vertex buffer. Changing it recreates the buffers on the next draw.
+	void setVertexLayout(const VertexLayout & layout);
+	const VertexLayout & getVertexLayout();
+	// Layout of meshes created from now on (the full precision layout by default).
+	static void setDefaultVertexLayout(const VertexLayout & layout);
+	static const VertexLayout & getDefaultVertexLayout();
+	// Size of the vertex buffer in bytes.
+	unsigned int getVertexBufferSize();
+	// The contents of the buffers of a static mesh: the vertices encoded with the layout
+	// (relative to the bounds) and the indices of all LODs. Returns their index type. Does not
+	// change the mesh, so it can run while the mesh is uploaded.
+	GLenum getEncodedData(std::vector<unsigned char> & vertexData, std::vector<unsigned char> & indexData);
+	// Store static meshes uploaded from now on in the GeometryArenas (enabled by default).
+	static void setUseGeometryArena(bool enabled);
+	static bool getUseGeometryArena();
+	// The arena the mesh is stored in, or NULL.
+	GeometryArena * getGeometryArena();
+
+	// Decoding of the stored positions into model space (see VertexLayout::getPositionDecode()),
+	// as used by the shaders: scale.w is 1 for packed layouts. Valid after updateBuffers().
+	void getPositionDecode(glm::fvec4 & scale, glm::fvec4 & offset);
+
+	// Bounds of the vertices in model space. They are updated when the vertices are loaded
+	// and when the mesh is invalidated.
+	const AABB & getBounds();
+	const BoundingSphere & getBoundingSphere();
+
+	void setName(std::string name);
+	std::string getName();
+
+	// Mark the vertices as changed, e.g. after modifying them via getVertices().
+	void invalidate();
+	// Mark count vertices starting at firstVertex as changed. Streamed meshes only upload
+	// the changed vertices.
+	void invalidate(unsigned int firstVertex, unsigned int count);
+	// Keep the vertices in a StreamBuffer, for vertices that change often (see
+	// StreamBuffer). Meshes whose vertices change after they were first uploaded are
+	// streamed automatically, unless streaming was disabled with setStreaming(false): their
+	// buffers are then overwritten in place on every change.
+	void setStreaming(bool enabled);
+	bool isStreaming();
+	// Version of the vertices, changed by invalidate(). Like the Transform3D versions, it is
+	// unique across all meshes.
+	unsigned int getVersion();
+	// Delete the GPU buffers. They are recreated on the next draw.
+	void deleteResources();
+
+private:
+	GLuint VAO = 0, VBO = 0, EBO = 0;
+	bool valid = false;
+	// Streamed vertices replace the VBO. streamData holds the encoded vertices, and
+	// [dirtyBegin, dirtyEnd) are the vertices changed since the last upload.
+	bool streaming = false;
+	// Set by setStreaming(false), so changes do not switch the mesh to streaming.
+	bool forceStatic = false;
+	StreamBuffer * stream = NULL;
+	std::vector<unsigned char> streamData;
+	unsigned int dirtyBegin = 0, dirtyEnd = 0;
+	// Static meshes in an arena use its VAO instead of their own buffers.
+	GeometryArena * arena = NULL;
+	GeometryRange arenaRange;
+	static bool useGeometryArena;
+	VertexLayout layout = defaultLayout;
+	static VertexLayout defaultLayout;
+	GLenum indexType = GL_UNSIGNED_INT;
+	MeshOptimizationStats optimizationStats;
+	static bool optimizeOnImport;
+	// Levels 1 and up, with their indices stored in lodIndices. In the element buffer, they
+	// follow the indices of the full mesh.
+	std::vector<MeshLod> lods;
+	std::vector<unsigned int> lodIndices;
+	static bool buildLodsOnImport;
+	// Bounds the stored positions are relative to, and their decoding (see
+	// VertexLayout::getPositionDecode()).
+	AABB encodedBounds;
+	glm::fvec3 posScale = glm::fvec3(1.0f);
+	glm::fvec3 posOffset = glm::fvec3(0.0f);
+	unsigned int version = nextVersion++;
+	static std::atomic<unsigned int> nextVersion;
+	unsigned int id = nextID++;
+	static std::atomic<unsigned int> nextID;
+	// Encoded vertices and indices of a mesh restored from a SceneCache, in the mapped file.
+	// Only valid for the first upload.
+	const void * bakedVertices = NULL;
+	const void * bakedIndices = NULL;
+	unsigned int bakedIndexBytes = 0;
+	void setupBuffers();
+	// Number of vertices in the buffers made by setupBuffers().
+	unsigned int uploadedVertices = 0;
+	// Encode all vertices again and overwrite the static vertex buffer (or arena range).
+	void updateStaticVertices();
+	// Encode all vertices with the layout, relative to encodedBounds.
+	void encodeVertices(std::vector<unsigned char> & data);
+	// Indices of the full mesh followed by the LODs, with the smallest index type (returned).
+	GLenum encodeIndices(std::vector<unsigned char> & data);
+	// Encode the changed vertices and upload them to the next region of the stream.
+	void streamVertices();
+	// First vertex of the mesh in the vertex buffer: of the stream region to draw, or of the
+	// range in the arena.
+	GLint getBaseVertex();
+	// Offset of the indices of the mesh in the element buffer in bytes.
+	GLintptr getIndexOffset();
+	// Bind the vertex array and set the constant attributes decoding its vertices.
+	void bind();
+
+	GLuint instanceBuffer = 0;
+	GLintptr instanceOffset = -1;
+	GLuint instanceDivisor = 0;
+
+	std::string name;
+
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+
+	AABB bounds;
+	BoundingSphere boundingSphere;
+	void computeBounds();
+
+	void loadVertices(aiVector3D* vertices, aiVector3D* normals, aiVector3D* uvs,
+						aiColor4D* color, aiVector3D* tangents, aiVector3D* bitangents, unsigned int nVertices);
+	void loadFaces(aiFace* faces, unsigned int nFaces);
+};
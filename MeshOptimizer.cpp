@@ -0,0 +1,305 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	const float CACHE_DECAY_POWER = 1.5f;
+	const float LAST_TRIANGLE_SCORE = 0.75f;
+	const float VALENCE_BOOST_SCALE = 2.0f;
+	const float VALENCE_BOOST_POWER = 0.5f;
+
+	// Score of a vertex at the given position of the LRU cache (-1 = not cached) with
+	// valence triangles left to draw (Forsyth).
+	float vertexScore(int cachePosition, unsigned int valence)
+	{
+		if (valence == 0) return -1.0f;
+		float score = 0.0f;
+		if (cachePosition >= 0) {
+			// The vertices of the last triangle get a fixed score, so the next triangle does
+			// not simply reuse its edge.
+			if (cachePosition < 3) score = LAST_TRIANGLE_SCORE;
+			else score = std::pow(1.0f - (float)(cachePosition - 3) / (MESH_OPT_SCORE_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+		}
+		// Prefer vertices with few triangles left, so no lone triangles are left behind.
+		return score + VALENCE_BOOST_SCALE * std::pow((float)valence, -VALENCE_BOOST_POWER);
+	}
+
+	struct Cluster {
+		unsigned int first;
+		unsigned int count;
+		float key;
+	};
+}
+
+MeshOptimizationStats MeshOptimizer::optimize(std::vector<Vertex> & vertices, std::vector<unsigned int> & indices)
+{
+	MeshOptimizationStats stats;
+	if (vertices.empty() || indices.size() < 3) return stats;
+	stats.triangles = indices.size() / 3;
+	stats.acmrBefore = computeACMR(&indices[0], indices.size(), vertices.size());
+	stats.atvrBefore = computeATVR(&indices[0], indices.size(), vertices.size());
+
+	optimizeVertexCache(&indices[0], indices.size(), vertices.size());
+	optimizeOverdraw(&indices[0], indices.size(), &vertices[0], vertices.size());
+	optimizeVertexFetch(vertices, indices);
+
+	stats.vertices = vertices.size();
+	stats.acmrAfter = computeACMR(&indices[0], indices.size(), vertices.size());
+	stats.atvrAfter = computeATVR(&indices[0], indices.size(), vertices.size());
+	return stats;
+}
+
+void MeshOptimizer::optimizeVertexCache(unsigned int * indices, unsigned int indexCount, unsigned int vertexCount)
+{
+	unsigned int triangleCount = indexCount / 3;
+	if (triangleCount == 0) return;
+
+	// Triangles of every vertex. The first valence[v] entries of a vertex's list are the
+	// triangles not drawn yet.
+	std::vector<unsigned int> valence(vertexCount, 0);
+	for (unsigned int i = 0; i < triangleCount * 3; i++)
+		valence[indices[i]]++;
+	std::vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+	for (unsigned int v = 0; v < vertexCount; v++)
+		adjacencyOffset[v + 1] = adjacencyOffset[v] + valence[v];
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+	for (unsigned int t = 0; t < triangleCount; t++) {
+		for (unsigned int k = 0; k < 3; k++)
+			adjacency[fill[indices[3 * t + k]]++] = t;
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> score(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+		score[v] = vertexScore(-1, valence[v]);
+	std::vector<bool> emitted(triangleCount, false);
+
+	// LRU cache, with room for the three vertices of the next triangle.
+	unsigned int cache[MESH_OPT_SCORE_CACHE_SIZE + 3];
+	unsigned int cacheSize = 0;
+
+	std::vector<unsigned int> result;
+	result.reserve(triangleCount * 3);
+	unsigned int nextCandidate = 0;
+	int best = -1;
+	for (unsigned int n = 0; n < triangleCount; n++) {
+		if (best < 0) {
+			// No cached vertex has triangles left: continue with the next triangle in the
+			// input order.
+			while (emitted[nextCandidate]) nextCandidate++;
+			best = nextCandidate;
+		}
+
+		unsigned int tri[3] = { indices[3 * best], indices[3 * best + 1], indices[3 * best + 2] };
+		result.insert(result.end(), tri, tri + 3);
+		emitted[best] = true;
+
+		// Remove the triangle from the lists of its vertices:
+		for (unsigned int k = 0; k < 3; k++) {
+			unsigned int v = tri[k];
+			unsigned int * list = &adjacency[adjacencyOffset[v]];
+			for (unsigned int j = 0; j < valence[v]; j++) {
+				if (list[j] != (unsigned int)best) continue;
+				list[j] = list[valence[v] - 1];
+				break;
+			}
+			valence[v]--;
+		}
+
+		// Move the vertices to the front of the cache:
+		unsigned int newCache[MESH_OPT_SCORE_CACHE_SIZE + 3];
+		unsigned int newSize = 0;
+		for (unsigned int k = 0; k < 3; k++)
+			newCache[newSize++] = tri[k];
+		for (unsigned int j = 0; j < cacheSize; j++) {
+			unsigned int v = cache[j];
+			if (v != tri[0] && v != tri[1] && v != tri[2]) newCache[newSize++] = v;
+		}
+
+		// Update the scores of all vertices that were or are in the cache, and pick the best
+		// triangle among theirs.
+		best = -1;
+		float bestScore = -1.0f;
+		for (unsigned int j = 0; j < newSize; j++) {
+			unsigned int v = newCache[j];
+			cachePosition[v] = j < MESH_OPT_SCORE_CACHE_SIZE ? (int)j : -1;
+			score[v] = vertexScore(cachePosition[v], valence[v]);
+		}
+		for (unsigned int j = 0; j < newSize; j++) {
+			unsigned int v = newCache[j];
+			const unsigned int * list = &adjacency[adjacencyOffset[v]];
+			for (unsigned int k = 0; k < valence[v]; k++) {
+				unsigned int t = list[k];
+				float s = score[indices[3 * t]] + score[indices[3 * t + 1]] + score[indices[3 * t + 2]];
+				if (s > bestScore) {
+					bestScore = s;
+					best = t;
+				}
+			}
+		}
+
+		cacheSize = std::min(newSize, (unsigned int)MESH_OPT_SCORE_CACHE_SIZE);
+		std::copy(newCache, newCache + cacheSize, cache);
+	}
+
+	std::copy(result.begin(), result.end(), indices);
+}
+
+void MeshOptimizer::optimizeOverdraw(unsigned int * indices, unsigned int indexCount, const Vertex * vertices,
+	unsigned int vertexCount, float threshold)
+{
+	unsigned int triangleCount = indexCount / 3;
+	if (triangleCount < 2) return;
+
+	// FIFO cache simulation shared by both passes; advancing the timestamp by more than the
+	// cache size empties the cache.
+	std::vector<unsigned int> cacheTime(vertexCount, 0);
+	unsigned int timestamp = MESH_OPT_CACHE_SIZE + 1;
+	auto countMisses = [&](unsigned int t) {
+		unsigned int misses = 0;
+		for (unsigned int k = 0; k < 3; k++) {
+			unsigned int v = indices[3 * t + k];
+			if (timestamp - cacheTime[v] > MESH_OPT_CACHE_SIZE) {
+				cacheTime[v] = timestamp++;
+				misses++;
+			}
+		}
+		return misses;
+	};
+
+	// Hard boundaries: triangles of which all vertices miss the cache start new clusters,
+	// since they would not profit from the previous triangles anyway.
+	std::vector<unsigned int> hardBoundaries;
+	std::vector<unsigned int> hardMisses;
+	for (unsigned int t = 0; t < triangleCount; t++) {
+		unsigned int misses = countMisses(t);
+		if (t == 0 || misses == 3) {
+			hardBoundaries.push_back(t);
+			hardMisses.push_back(0);
+		}
+		hardMisses.back() += misses;
+	}
+	hardBoundaries.push_back(triangleCount);
+
+	// Soft boundaries: split a hard cluster further wherever the ACMR of the part so far
+	// is already within threshold of the ACMR of the whole cluster.
+	std::vector<Cluster> clusters;
+	for (unsigned int h = 0; h + 1 < hardBoundaries.size(); h++) {
+		unsigned int start = hardBoundaries[h], end = hardBoundaries[h + 1];
+		float clusterACMR = (float)hardMisses[h] / (end - start);
+
+		// Every cluster starts with an empty cache, as it may be drawn after any other.
+		timestamp += MESH_OPT_CACHE_SIZE + 1;
+		unsigned int first = start, misses = 0;
+		for (unsigned int t = start; t < end; t++) {
+			misses += countMisses(t);
+			if (t + 1 < end && (float)misses / (t - first + 1) <= clusterACMR * threshold) {
+				Cluster c = { first, t + 1 - first, 0.0f };
+				clusters.push_back(c);
+				first = t + 1;
+				misses = 0;
+				timestamp += MESH_OPT_CACHE_SIZE + 1;
+			}
+		}
+		Cluster c = { first, end - first, 0.0f };
+		clusters.push_back(c);
+	}
+	if (clusters.size() < 2) return;
+
+	// Sort the clusters by how far they face outwards: the dot product of the cluster's
+	// normal with its centroid relative to the mesh's centroid. Centroids are weighted by
+	// triangle area.
+	std::vector<glm::fvec3> centroids(clusters.size(), glm::fvec3(0.0f));
+	std::vector<glm::fvec3> normals(clusters.size(), glm::fvec3(0.0f));
+	std::vector<float> areas(clusters.size(), 0.0f);
+	glm::fvec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	for (unsigned int i = 0; i < clusters.size(); i++) {
+		for (unsigned int t = clusters[i].first; t < clusters[i].first + clusters[i].count; t++) {
+			const glm::fvec3 & a = vertices[indices[3 * t]].position;
+			const glm::fvec3 & b = vertices[indices[3 * t + 1]].position;
+			const glm::fvec3 & d = vertices[indices[3 * t + 2]].position;
+			glm::fvec3 n = glm::cross(b - a, d - a);
+			float area = glm::length(n);
+			centroids[i] += (a + b + d) * (area / 3.0f);
+			normals[i] += n;
+			areas[i] += area;
+		}
+		meshCentroid += centroids[i];
+		meshArea += areas[i];
+	}
+	if (meshArea <= 0.0f) return;
+	meshCentroid /= meshArea;
+
+	for (unsigned int i = 0; i < clusters.size(); i++) {
+		float length = glm::length(normals[i]);
+		if (areas[i] <= 0.0f || length <= 0.0f) continue;
+		clusters[i].key = glm::dot(centroids[i] / areas[i] - meshCentroid, normals[i] / length);
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster & a, const Cluster & b) {
+		return a.key > b.key;
+	});
+
+	std::vector<unsigned int> result;
+	result.reserve(triangleCount * 3);
+	for (const Cluster & c : clusters)
+		result.insert(result.end(), indices + 3 * c.first, indices + 3 * (c.first + c.count));
+	std::copy(result.begin(), result.end(), indices);
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<Vertex> & vertices, std::vector<unsigned int> & indices)
+{
+	const unsigned int unused = 0xFFFFFFFF;
+	std::vector<unsigned int> remap(vertices.size(), unused);
+	std::vector<Vertex> result;
+	result.reserve(vertices.size());
+	for (unsigned int & index : indices) {
+		if (remap[index] == unused) {
+			remap[index] = result.size();
+			result.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices.swap(result);
+}
+
+float MeshOptimizer::computeACMR(const unsigned int * indices, unsigned int indexCount, unsigned int vertexCount,
+	unsigned int cacheSize)
+{
+	if (indexCount < 3) return 0.0f;
+	return (float)countCacheMisses(indices, indexCount, vertexCount, cacheSize) / (indexCount / 3);
+}
+
+float MeshOptimizer::computeATVR(const unsigned int * indices, unsigned int indexCount, unsigned int vertexCount,
+	unsigned int cacheSize)
+{
+	std::vector<bool> used(vertexCount, false);
+	unsigned int usedCount = 0;
+	for (unsigned int i = 0; i < indexCount; i++) {
+		if (used[indices[i]]) continue;
+		used[indices[i]] = true;
+		usedCount++;
+	}
+	if (usedCount == 0) return 0.0f;
+	return (float)countCacheMisses(indices, indexCount, vertexCount, cacheSize) / usedCount;
+}
+
+unsigned int MeshOptimizer::countCacheMisses(const unsigned int * indices, unsigned int indexCount,
+	unsigned int vertexCount, unsigned int cacheSize)
+{
+	// A vertex is in the FIFO cache if fewer than cacheSize vertices were added after it.
+	std::vector<unsigned int> cacheTime(vertexCount, 0);
+	unsigned int timestamp = cacheSize + 1;
+	unsigned int misses = 0;
+	for (unsigned int i = 0; i < indexCount; i++) {
+		unsigned int v = indices[i];
+		if (timestamp - cacheTime[v] > cacheSize) {
+			cacheTime[v] = timestamp++;
+			misses++;
+		}
+	}
+	return misses;
+}
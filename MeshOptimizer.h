@@ -0,0 +1,57 @@
+#pragma once
+
+#include "VertexLayout.h"
+
+#include <vector>
+
+// Size of the FIFO post-transform cache simulated to measure ACMR and ATVR.
+#define MESH_OPT_CACHE_SIZE 16
+// Size of the LRU cache modeled by the vertex cache optimization.
+#define MESH_OPT_SCORE_CACHE_SIZE 32
+// Largest increase of the ACMR the overdraw optimization may cause (relative).
+#define MESH_OPT_OVERDRAW_THRESHOLD 1.05f
+
+// Vertex cache efficiency of a mesh before and after MeshOptimizer::optimize().
+// ACMR: transformed vertices per triangle (0.5 is ideal for large regular meshes, 3 the worst).
+// ATVR: transformed vertices per vertex (1 is ideal).
+struct MeshOptimizationStats {
+	unsigned int triangles = 0;
+	unsigned int vertices = 0;
+	float acmrBefore = 0.0f;
+	float acmrAfter = 0.0f;
+	float atvrBefore = 0.0f;
+	float atvrAfter = 0.0f;
+};
+
+// Reorders the triangles and vertices of indexed triangle lists for the GPU:
+// - optimizeVertexCache() orders the triangles for the post-transform vertex cache
+//   (Forsyth, "Linear-Speed Vertex Cache Optimisation").
+// - optimizeOverdraw() splits that order into clusters and sorts them so that outward
+//   facing clusters are drawn first, which reduces overdraw from any direction, while
+//   keeping most of the cache efficiency (Sander et al., "Fast Triangle Reordering for
+//   Vertex Locality and Reduced Overdraw").
+// - optimizeVertexFetch() stores the vertices in the order of their first use and drops
+//   unreferenced ones.
+// All functions work in place.
+class MeshOptimizer
+{
+public:
+	// Run all stages and return the cache statistics before and after.
+	static MeshOptimizationStats optimize(std::vector<Vertex> & vertices, std::vector<unsigned int> & indices);
+
+	static void optimizeVertexCache(unsigned int * indices, unsigned int indexCount, unsigned int vertexCount);
+	static void optimizeOverdraw(unsigned int * indices, unsigned int indexCount, const Vertex * vertices,
+		unsigned int vertexCount, float threshold = MESH_OPT_OVERDRAW_THRESHOLD);
+	static void optimizeVertexFetch(std::vector<Vertex> & vertices, std::vector<unsigned int> & indices);
+
+	// Average cache miss ratio and average transformed vertex ratio of a FIFO cache.
+	static float computeACMR(const unsigned int * indices, unsigned int indexCount, unsigned int vertexCount,
+		unsigned int cacheSize = MESH_OPT_CACHE_SIZE);
+	static float computeATVR(const unsigned int * indices, unsigned int indexCount, unsigned int vertexCount,
+		unsigned int cacheSize = MESH_OPT_CACHE_SIZE);
+
+private:
+	// Number of vertices transformed by a FIFO cache of cacheSize.
+	static unsigned int countCacheMisses(const unsigned int * indices, unsigned int indexCount,
+		unsigned int vertexCount, unsigned int cacheSize);
+};
@@ -0,0 +1,235 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+// Weight of the quadrics keeping open borders in place, relative to the surface quadrics.
+#define BORDER_WEIGHT 10.0
+
+namespace {
+	// Symmetric 4x4 matrix of the squared distances to a set of planes, and the summed weight
+	// of the planes. Error of p: p^T A p + 2 b^T p + c.
+	struct Quadric {
+		double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+		double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+		double c = 0.0;
+		double weight = 0.0;
+
+		void addPlane(glm::dvec3 n, double d, double w)
+		{
+			a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z;
+			a11 += w * n.y * n.y; a12 += w * n.y * n.z; a22 += w * n.z * n.z;
+			b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+			c += w * d * d;
+			weight += w;
+		}
+
+		void add(const Quadric & q)
+		{
+			a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+			b0 += q.b0; b1 += q.b1; b2 += q.b2;
+			c += q.c;
+			weight += q.weight;
+		}
+
+		// Weighted sum of the squared distances of p to the planes.
+		double error(glm::dvec3 p) const
+		{
+			double e = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z
+				+ 2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z)
+				+ 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+			return std::max(e, 0.0);
+		}
+	};
+
+	struct Collapse {
+		unsigned int from;
+		unsigned int to;
+		// Mean squared distance of the merged quadric at the target position.
+		double cost;
+	};
+
+	struct PositionHash {
+		size_t operator()(const glm::fvec3 & p) const
+		{
+			unsigned int bits[3];
+			memcpy(bits, &p, sizeof(bits));
+			return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+		}
+	};
+
+	glm::dvec3 triangleNormal(const glm::dvec3 & a, const glm::dvec3 & b, const glm::dvec3 & c)
+	{
+		return glm::cross(b - a, c - a);
+	}
+}
+
+float MeshSimplifier::simplify(const Vertex * vertices, unsigned int vertexCount, const unsigned int * indices,
+	unsigned int indexCount, unsigned int targetIndexCount, float maxError, std::vector<unsigned int> & result)
+{
+	result.assign(indices, indices + indexCount - indexCount % 3);
+	if (result.size() <= targetIndexCount || vertexCount == 0) return 0.0f;
+
+	std::vector<glm::dvec3> positions(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+		positions[v] = glm::dvec3(vertices[v].position);
+
+	// Vertices sharing their position with others lie on attribute seams and stay in place.
+	std::vector<bool> locked(vertexCount, false);
+	std::unordered_map<glm::fvec3, unsigned int, PositionHash> firstAtPosition;
+	for (unsigned int i = 0; i < result.size(); i++) {
+		unsigned int v = result[i];
+		std::pair<std::unordered_map<glm::fvec3, unsigned int, PositionHash>::iterator, bool> it =
+			firstAtPosition.insert(std::make_pair(vertices[v].position, v));
+		if (!it.second && it.first->second != v) {
+			locked[v] = true;
+			locked[it.first->second] = true;
+		}
+	}
+
+	// Quadrics of the triangle planes, weighted by area:
+	std::vector<Quadric> quadrics(vertexCount);
+	std::unordered_map<unsigned long long, unsigned int> edgeCount;
+	for (unsigned int t = 0; t < result.size(); t += 3) {
+		const glm::dvec3 & a = positions[result[t]];
+		const glm::dvec3 & b = positions[result[t + 1]];
+		const glm::dvec3 & c = positions[result[t + 2]];
+		glm::dvec3 n = triangleNormal(a, b, c);
+		double area = glm::length(n);
+		if (area <= 0.0) continue;
+		n /= area;
+		for (unsigned int k = 0; k < 3; k++)
+			quadrics[result[t + k]].addPlane(n, -glm::dot(n, a), area);
+		for (unsigned int k = 0; k < 3; k++) {
+			unsigned long long v0 = result[t + k], v1 = result[t + (k + 1) % 3];
+			edgeCount[std::min(v0, v1) << 32 | std::max(v0, v1)]++;
+		}
+	}
+	// Edges of a single triangle are borders: add planes through them, perpendicular to the
+	// triangle, so border vertices only move along the border.
+	for (unsigned int t = 0; t < result.size(); t += 3) {
+		const glm::dvec3 & a = positions[result[t]];
+		const glm::dvec3 & b = positions[result[t + 1]];
+		const glm::dvec3 & c = positions[result[t + 2]];
+		glm::dvec3 n = triangleNormal(a, b, c);
+		if (glm::length(n) <= 0.0) continue;
+		n = glm::normalize(n);
+		for (unsigned int k = 0; k < 3; k++) {
+			unsigned long long v0 = result[t + k], v1 = result[t + (k + 1) % 3];
+			if (edgeCount[std::min(v0, v1) << 32 | std::max(v0, v1)] != 1) continue;
+			glm::dvec3 edge = positions[v1] - positions[v0];
+			double length2 = glm::dot(edge, edge);
+			if (length2 <= 0.0) continue;
+			glm::dvec3 m = glm::normalize(glm::cross(edge, n));
+			double d = -glm::dot(m, positions[v0]);
+			quadrics[v0].addPlane(m, d, length2 * BORDER_WEIGHT);
+			quadrics[v1].addPlane(m, d, length2 * BORDER_WEIGHT);
+		}
+	}
+
+	double maxCost = (double)maxError * maxError;
+	double largestCost = 0.0;
+	std::vector<unsigned int> adjacencyOffset(vertexCount + 1);
+	std::vector<unsigned int> adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<bool> touched(vertexCount);
+
+	// Every pass collapses the cheapest edges whose vertices were not changed yet in the pass,
+	// then removes the degenerate triangles.
+	while (result.size() > targetIndexCount) {
+		// Triangles of every vertex:
+		std::fill(adjacencyOffset.begin(), adjacencyOffset.end(), 0);
+		for (unsigned int i = 0; i < result.size(); i++)
+			adjacencyOffset[result[i] + 1]++;
+		for (unsigned int v = 0; v < vertexCount; v++)
+			adjacencyOffset[v + 1] += adjacencyOffset[v];
+		adjacency.resize(result.size());
+		std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+		for (unsigned int i = 0; i < result.size(); i++)
+			adjacency[fill[result[i]]++] = i / 3;
+
+		collapses.clear();
+		for (unsigned int t = 0; t < result.size(); t += 3) {
+			for (unsigned int k = 0; k < 3; k++) {
+				unsigned int v0 = result[t + k], v1 = result[t + (k + 1) % 3];
+				for (unsigned int dir = 0; dir < 2; dir++) {
+					unsigned int from = dir ? v1 : v0, to = dir ? v0 : v1;
+					if (locked[from]) continue;
+					Quadric q = quadrics[from];
+					q.add(quadrics[to]);
+					Collapse collapse = { from, to, q.weight > 0.0 ? q.error(positions[to]) / q.weight : 0.0 };
+					if (collapse.cost <= maxCost) collapses.push_back(collapse);
+				}
+			}
+		}
+		if (collapses.empty()) break;
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse & a, const Collapse & b) {
+			return a.cost < b.cost;
+		});
+
+		std::fill(touched.begin(), touched.end(), false);
+		unsigned int triangles = result.size() / 3;
+		unsigned int target = targetIndexCount / 3;
+		unsigned int done = 0;
+		for (const Collapse & c : collapses) {
+			if (triangles <= target) break;
+			if (touched[c.from] || touched[c.to]) continue;
+
+			// Reject collapses that flip a remaining triangle of the vertex:
+			bool flips = false;
+			unsigned int removed = 0;
+			for (unsigned int j = adjacencyOffset[c.from]; j < adjacencyOffset[c.from + 1] && !flips; j++) {
+				unsigned int * tri = &result[3 * adjacency[j]];
+				if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2]) continue;
+				if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) {
+					removed++;
+					continue;
+				}
+				glm::dvec3 p[3], q[3];
+				for (unsigned int k = 0; k < 3; k++) {
+					p[k] = positions[tri[k]];
+					q[k] = tri[k] == c.from ? positions[c.to] : p[k];
+				}
+				glm::dvec3 before = triangleNormal(p[0], p[1], p[2]);
+				glm::dvec3 after = triangleNormal(q[0], q[1], q[2]);
+				flips = glm::dot(before, after) <= 0.0;
+			}
+			if (flips) continue;
+
+			for (unsigned int j = adjacencyOffset[c.from]; j < adjacencyOffset[c.from + 1]; j++) {
+				unsigned int * tri = &result[3 * adjacency[j]];
+				for (unsigned int k = 0; k < 3; k++) {
+					if (tri[k] == c.from) tri[k] = c.to;
+				}
+			}
+			quadrics[c.to].add(quadrics[c.from]);
+			// The neighbours' triangles changed, so their adjacency is only valid again in the
+			// next pass.
+			touched[c.from] = true;
+			touched[c.to] = true;
+			for (unsigned int j = adjacencyOffset[c.from]; j < adjacencyOffset[c.from + 1]; j++) {
+				const unsigned int * tri = &result[3 * adjacency[j]];
+				for (unsigned int k = 0; k < 3; k++)
+					touched[tri[k]] = true;
+			}
+			triangles -= removed;
+			largestCost = std::max(largestCost, c.cost);
+			done++;
+		}
+		if (done == 0) break;
+
+		// Remove the degenerate triangles:
+		unsigned int write = 0;
+		for (unsigned int t = 0; t < result.size(); t += 3) {
+			if (result[t] == result[t + 1] || result[t + 1] == result[t + 2] || result[t] == result[t + 2]) continue;
+			for (unsigned int k = 0; k < 3; k++)
+				result[write + k] = result[t + k];
+			write += 3;
+		}
+		result.resize(write);
+	}
+
+	return (float)std::sqrt(largestCost);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "VertexLayout.h"
+
+#include <vector>
+
+// Quadric error simplification of indexed triangle lists (Garland and Heckbert, "Surface
+// Simplification Using Quadric Error Metrics"), used to build the LODs of a Mesh.
+// Edges are collapsed into one of their vertices, so the result references the same
+// vertices as the input and all LODs of a mesh can share its vertex buffer. Vertices on
+// attribute seams (several vertices at the same position) never move, and open borders are
+// held in place by additional quadrics.
+class MeshSimplifier
+{
+public:
+	// Simplify the triangles until at most targetIndexCount indices are left, or until a
+	// further collapse would move the surface by more than maxError (in model units). The
+	// indices of the simplified mesh are written to result. Returns the largest distance
+	// error of the collapses done.
+	static float simplify(const Vertex * vertices, unsigned int vertexCount, const unsigned int * indices,
+		unsigned int indexCount, unsigned int targetIndexCount, float maxError, std::vector<unsigned int> & result);
+};
@@ -26,8 +26,13 @@ void ModifierVertexGroup::loadModelData(TriangleModel * obj, float defaultWeight
 void ModifierVertexGroup::transform(glm::fmat4 transformation)
 {
 	glm::fmat4 T = transformation * modifierMatrix;
-	for (int i = 0; i < vertices->size(); i++) {
-		if (weights.at(0) == 0.0f) continue;
+	// Range of the vertices that move, so only those are uploaded again:
+	unsigned int first = vertices->size(), last = 0;
+	for (unsigned int i = 0; i < vertices->size(); i++) {
+		std::map<unsigned int, float>::iterator it = weights.find(i);
+		if (it == weights.end() || it->second == 0.0f) continue;
+		if (i < first) first = i;
+		last = i;
 
 		glm::fvec3 oldPos = vertices->at(i).pos;
 		glm::fvec3 oldNormal = vertices->at(i).normal;
@@ -38,10 +43,10 @@ void ModifierVertexGroup::transform(glm::fmat4 transformation)
 		glm::fvec4 newPos = T * v;
 		glm::fvec4 newNormal = T * n;
 
-		vertices->at(i).pos = oldPos + weights.at(i) * (glm::fvec3(newPos.x, newPos.y, newPos.z) - oldPos);
-		vertices->at(i).normal = oldNormal + weights.at(i) * (glm::fvec3(newNormal.x, newNormal.y, newNormal.z) - oldNormal);
+		vertices->at(i).pos = oldPos + it->second * (glm::fvec3(newPos.x, newPos.y, newPos.z) - oldPos);
+		vertices->at(i).normal = oldNormal + it->second * (glm::fvec3(newNormal.x, newNormal.y, newNormal.z) - oldNormal);
 	}
-	obj->invalidate();
+	if (first <= last) obj->invalidate(first, last - first + 1);
 }
 
 void ModifierVertexGroup::setWeight(unsigned int vertexID, float weight)
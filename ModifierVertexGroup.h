@@ -2,6 +2,9 @@
 
 #include "TriangleModel.h"
 #include "ModelModifier.h"
+
+#include <map>
+
 class ModifierVertexGroup :
 	public ModelModifier
 {
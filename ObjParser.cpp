@@ -0,0 +1,421 @@
+#include "ObjParser.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+	const double powersOf10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	// Digits of the mantissa that fit into 64 bits. Further digits only change the exponent.
+	const int maxMantissaDigits = 19;
+	// Index of a corner attribute that is 0, which OBJ does not allow. Out of range even after
+	// adding the offset of a chunk.
+	const int invalidIndex = INT_MIN;
+	// End of a chain of welded vertices.
+	const unsigned int weldEnd = 0xFFFFFFFFu;
+
+	inline bool isBlank(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	inline bool isDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	// Parse an integer (an index of a face corner). Returns p if there is none.
+	const char * parseIndex(const char * p, const char * end, int & value)
+	{
+		const char * start = p;
+		bool negative = false;
+		if (p < end && *p == '-') {
+			negative = true;
+			p++;
+		}
+		long long res = 0;
+		const char * digits = p;
+		while (p < end && isDigit(*p)) {
+			// Indices beyond the range of int are out of range anyway.
+			if (res <= INT_MAX) res = res * 10 + (*p - '0');
+			p++;
+		}
+		if (p == digits) return start;
+		res = std::min(res, (long long)INT_MAX);
+		value = int(negative ? -res : res);
+		return p;
+	}
+
+	inline bool inRange(int index, unsigned int count, bool optional)
+	{
+		if (index == OBJ_NONE) return optional;
+		return index >= 0 && (unsigned int)index < count;
+	}
+}
+
+ObjParser::ObjParser()
+{
+}
+
+ObjParser::~ObjParser()
+{
+}
+
+bool ObjParser::parse(const std::string & path, ThreadPool * pool)
+{
+	MappedFile file;
+	if (!file.open(path)) {
+		vertices.clear();
+		indices.clear();
+		error = "Cannot open " + path + ".";
+		return false;
+	}
+	return parse((const char *)file.getData(), file.getSize(), pool);
+}
+
+bool ObjParser::parse(const char * data, size_t size, ThreadPool * pool)
+{
+	vertices.clear();
+	indices.clear();
+	error.clear();
+
+	// Split into chunks of whole lines, a few per thread to balance uneven lines:
+	unsigned int nChunks = 1;
+	if (pool != NULL) {
+		size_t maxChunks = (size_t)pool->getNumThreads() * 4;
+		nChunks = (unsigned int)std::max((size_t)1, std::min(size / OBJ_PARSE_CHUNK_SIZE, maxChunks));
+	}
+	std::vector<Chunk> chunks(nChunks);
+	const char * begin = data;
+	const char * fileEnd = data + size;
+	for (unsigned int i = 0; i < nChunks; i++) {
+		const char * end = fileEnd;
+		if (i + 1 < nChunks) {
+			end = std::max(begin, data + size / nChunks * (i + 1));
+			const char * newline = (const char *)memchr(end, '\n', fileEnd - end);
+			end = newline ? newline + 1 : fileEnd;
+		}
+		chunks[i].begin = begin;
+		chunks[i].end = end;
+		begin = end;
+	}
+
+	ThreadPool::parallelFor(pool, nChunks, [&chunks](unsigned int i) { parseChunk(chunks[i]); });
+	return weld(chunks);
+}
+
+const char * ObjParser::parseFloat(const char * p, const char * end, float & value)
+{
+	value = 0.0f;
+	while (p < end && isBlank(*p)) p++;
+	const char * start = p;
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+	unsigned long long mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	bool any = false;
+	while (p < end && isDigit(*p)) {
+		if (digits < maxMantissaDigits) {
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa != 0) digits++;
+		}
+		else exponent++;
+		any = true;
+		p++;
+	}
+	if (p < end && *p == '.') {
+		p++;
+		while (p < end && isDigit(*p)) {
+			if (digits < maxMantissaDigits) {
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa != 0) digits++;
+				exponent--;
+			}
+			any = true;
+			p++;
+		}
+	}
+	if (!any) {
+		// Rare spellings like "nan" and "inf". strtof() needs a terminated string.
+		char buffer[32];
+		size_t n = 0;
+		while (start + n < end && n + 1 < sizeof(buffer) && !isBlank(start[n]) && start[n] != '\n') {
+			buffer[n] = start[n];
+			n++;
+		}
+		buffer[n] = '\0';
+		char * parsed;
+		value = strtof(buffer, &parsed);
+		return start + (parsed - buffer);
+	}
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		const char * q = p + 1;
+		bool negativeExponent = false;
+		if (q < end && (*q == '-' || *q == '+')) {
+			negativeExponent = *q == '-';
+			q++;
+		}
+		if (q < end && isDigit(*q)) {
+			int e = 0;
+			while (q < end && isDigit(*q)) {
+				if (e < 10000) e = e * 10 + (*q - '0');
+				q++;
+			}
+			exponent += negativeExponent ? -e : e;
+			p = q;
+		}
+	}
+
+	double res = (double)mantissa;
+	if (res != 0.0) {
+		while (exponent > 22) {
+			res *= 1e22;
+			exponent -= 22;
+		}
+		while (exponent < -22) {
+			res /= 1e22;
+			exponent += 22;
+		}
+		if (exponent >= 0) res *= powersOf10[exponent];
+		else res /= powersOf10[-exponent];
+	}
+	value = (float)(negative ? -res : res);
+	return p;
+}
+
+void ObjParser::parseChunk(Chunk & chunk)
+{
+	const char * p = chunk.begin;
+	while (p < chunk.end) {
+		const char * lineEnd = (const char *)memchr(p, '\n', chunk.end - p);
+		if (lineEnd == NULL) lineEnd = chunk.end;
+		while (p < lineEnd && isBlank(*p)) p++;
+
+		if (lineEnd - p >= 2) {
+			if (p[0] == 'v' && isBlank(p[1])) {
+				glm::fvec3 v;
+				p = parseFloat(p + 1, lineEnd, v.x);
+				p = parseFloat(p, lineEnd, v.y);
+				parseFloat(p, lineEnd, v.z);
+				chunk.positions.push_back(v);
+			}
+			else if (p[0] == 'v' && p[1] == 't') {
+				// A third (w) coordinate is ignored.
+				glm::fvec2 v;
+				p = parseFloat(p + 2, lineEnd, v.x);
+				parseFloat(p, lineEnd, v.y);
+				chunk.texCoords.push_back(v);
+			}
+			else if (p[0] == 'v' && p[1] == 'n') {
+				glm::fvec3 v;
+				p = parseFloat(p + 2, lineEnd, v.x);
+				p = parseFloat(p, lineEnd, v.y);
+				parseFloat(p, lineEnd, v.z);
+				chunk.normals.push_back(v);
+			}
+			else if (p[0] == 'f' && isBlank(p[1])) {
+				parseFace(p + 1, lineEnd, chunk);
+			}
+		}
+		p = lineEnd + 1;
+	}
+}
+
+void ObjParser::parseFace(const char * p, const char * end, Chunk & chunk)
+{
+	// OBJ face format: f [Vertex]/[TexCoord]/[Normal] ..., with optional TexCoord and Normal.
+	unsigned int counts[3] = { (unsigned int)chunk.positions.size(), (unsigned int)chunk.texCoords.size(), (unsigned int)chunk.normals.size() };
+	Corner first, prev;
+	unsigned int firstRelative = 0, prevRelative = 0;
+	unsigned int n = 0;
+	while (true) {
+		while (p < end && isBlank(*p)) p++;
+		if (p >= end || *p == '#') break;
+
+		Corner c;
+		c.attrib[0] = c.attrib[1] = c.attrib[2] = OBJ_NONE;
+		unsigned int relative = 0;
+		for (int a = 0; a < 3; a++) {
+			if (a > 0) {
+				if (p >= end || *p != '/') break;
+				p++;
+			}
+			int index;
+			const char * q = parseIndex(p, end, index);
+			// Empty texture coordinate index (v//n):
+			if (q == p) continue;
+			p = q;
+			if (index > 0) c.attrib[a] = index - 1;
+			else if (index < 0) {
+				c.attrib[a] = (int)counts[a] + index;
+				relative |= 1 << a;
+			}
+			else c.attrib[a] = invalidIndex;
+		}
+		// Skip anything malformed up to the next corner.
+		while (p < end && !isBlank(*p)) {
+			c.attrib[0] = invalidIndex;
+			p++;
+		}
+
+		if (n == 0) {
+			first = c;
+			firstRelative = relative;
+		}
+		else if (n >= 2) {
+			// Triangulate as a fan around the first corner.
+			const Corner * corners[3] = { &first, &prev, &c };
+			unsigned int relatives[3] = { firstRelative, prevRelative, relative };
+			for (int i = 0; i < 3; i++) {
+				unsigned int k = chunk.corners.size();
+				chunk.corners.push_back(*corners[i]);
+				for (int a = 0; a < 3; a++) {
+					if (relatives[i] & (1 << a)) chunk.relative.push_back(k * 3 + a);
+				}
+			}
+		}
+		prev = c;
+		prevRelative = relative;
+		n++;
+	}
+	if (n >= 3) chunk.faces++;
+}
+
+bool ObjParser::weld(std::vector<Chunk> & chunks)
+{
+	// Concatenate the attributes and resolve the relative indices:
+	std::vector<glm::fvec3> positions;
+	std::vector<glm::fvec2> texCoords;
+	std::vector<glm::fvec3> normals;
+	numPositions = numTexCoords = numNormals = numFaces = 0;
+	size_t numCorners = 0;
+	for (Chunk & chunk : chunks) {
+		numPositions += chunk.positions.size();
+		numTexCoords += chunk.texCoords.size();
+		numNormals += chunk.normals.size();
+		numFaces += chunk.faces;
+		numCorners += chunk.corners.size();
+	}
+	positions.reserve(numPositions);
+	texCoords.reserve(numTexCoords);
+	normals.reserve(numNormals);
+	for (Chunk & chunk : chunks) {
+		int offsets[3] = { (int)positions.size(), (int)texCoords.size(), (int)normals.size() };
+		for (unsigned int r : chunk.relative) {
+			int & index = chunk.corners[r / 3].attrib[r % 3];
+			index += offsets[r % 3];
+			// Before the first attribute (not to be mistaken for OBJ_NONE):
+			if (index < 0) index = invalidIndex;
+		}
+		positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+		texCoords.insert(texCoords.end(), chunk.texCoords.begin(), chunk.texCoords.end());
+		normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+		std::vector<glm::fvec3>().swap(chunk.positions);
+		std::vector<glm::fvec2>().swap(chunk.texCoords);
+		std::vector<glm::fvec3>().swap(chunk.normals);
+	}
+
+	// Weld equal corners. The hash table is bucketed by position index: head holds the first
+	// vertex of every position and next chains the further vertices of the same position
+	// (with other texture coordinates or normals). Faces mostly refer to nearby positions, so
+	// unlike with a hash of the whole corner, lookups stay within the cache.
+	std::vector<unsigned int> head(numPositions, weldEnd);
+	std::vector<unsigned int> next;
+	std::vector<Corner> keys;
+	next.reserve(numPositions);
+	keys.reserve(numPositions);
+	vertices.reserve(numPositions);
+	indices.reserve(numCorners);
+	bool missingNormals = false;
+	for (Chunk & chunk : chunks) {
+		for (const Corner & c : chunk.corners) {
+			if (!inRange(c.attrib[0], numPositions, false) || !inRange(c.attrib[1], numTexCoords, true) || !inRange(c.attrib[2], numNormals, true)) {
+				vertices.clear();
+				indices.clear();
+				error = "A face refers to a vertex, texture coordinate or normal that does not exist.";
+				return false;
+			}
+			unsigned int v = head[c.attrib[0]];
+			while (v != weldEnd && (keys[v].attrib[1] != c.attrib[1] || keys[v].attrib[2] != c.attrib[2]))
+				v = next[v];
+			if (v == weldEnd) {
+				v = keys.size();
+				keys.push_back(c);
+				next.push_back(head[c.attrib[0]]);
+				head[c.attrib[0]] = v;
+				Vertex3D vertex;
+				vertex.pos = positions[c.attrib[0]];
+				vertex.tex = c.attrib[1] != OBJ_NONE ? texCoords[c.attrib[1]] : glm::fvec2(0.0f);
+				vertex.normal = c.attrib[2] != OBJ_NONE ? normals[c.attrib[2]] : glm::fvec3(0.0f);
+				missingNormals |= c.attrib[2] == OBJ_NONE;
+				vertices.push_back(vertex);
+			}
+			indices.push_back(v);
+		}
+		std::vector<Corner>().swap(chunk.corners);
+	}
+
+	// Smooth normals for the vertices without one (the cross product is weighted by area):
+	if (missingNormals) {
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			Vertex3D & a = vertices[indices[i]];
+			Vertex3D & b = vertices[indices[i + 1]];
+			Vertex3D & c = vertices[indices[i + 2]];
+			glm::fvec3 normal = glm::cross(b.pos - a.pos, c.pos - a.pos);
+			for (int k = 0; k < 3; k++) {
+				unsigned int v = indices[i + k];
+				if (keys[v].attrib[2] == OBJ_NONE) vertices[v].normal += normal;
+			}
+		}
+		for (unsigned int v = 0; v < vertices.size(); v++) {
+			float length = glm::length(vertices[v].normal);
+			if (keys[v].attrib[2] == OBJ_NONE && length > 0.0f) vertices[v].normal /= length;
+		}
+	}
+	return true;
+}
+
+std::vector<Vertex3D> & ObjParser::getVertices()
+{
+	return vertices;
+}
+
+std::vector<unsigned int> & ObjParser::getIndices()
+{
+	return indices;
+}
+
+unsigned int ObjParser::getNumPositions()
+{
+	return numPositions;
+}
+
+unsigned int ObjParser::getNumTexCoords()
+{
+	return numTexCoords;
+}
+
+unsigned int ObjParser::getNumNormals()
+{
+	return numNormals;
+}
+
+unsigned int ObjParser::getNumFaces()
+{
+	return numFaces;
+}
+
+std::string ObjParser::getError()
+{
+	return error;
+}
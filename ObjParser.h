@@ -0,0 +1,97 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+#include "ThreadPool.h"
+
+struct Vertex3D {
+	glm::fvec3 pos;
+	glm::fvec3 normal;
+	glm::fvec2 tex;
+
+	inline bool operator==(const Vertex3D & u) const {
+		bool comparison = (u.pos == pos && u.normal == normal && u.tex == tex);
+		return comparison;
+	}
+};
+
+// Files are split into chunks of about this many bytes to be parsed in parallel. Smaller
+// files are parsed in one piece.
+#define OBJ_PARSE_CHUNK_SIZE (1 << 20)
+// Index of an attribute that a face corner does not have.
+#define OBJ_NONE -1
+
+// Parser for the geometry of Wavefront OBJ files (v, vt, vn and f; everything else is
+// skipped). The file is mapped (see MappedFile) and scanned in place, with numbers parsed by
+// hand instead of through streams, and all data is kept in vectors. With a ThreadPool, the
+// file is split at line boundaries into chunks that are parsed in parallel.
+// Faces may be polygons (triangulated as fans) and use negative (relative) indices, and may
+// lack texture coordinates or normals. Corners referring to the same position, texture
+// coordinate and normal are welded into one vertex with a hash table. Vertices without a
+// normal get the area-weighted average of the normals of their faces, vertices without
+// texture coordinates get (0, 0).
+class ObjParser
+{
+public:
+	ObjParser();
+	~ObjParser();
+
+	// Parse the file. Returns false (see getError()) if it cannot be read or refers to
+	// vertex data that does not exist.
+	bool parse(const std::string & path, ThreadPool * pool = NULL);
+	// Parse the contents of a file in memory.
+	bool parse(const char * data, size_t size, ThreadPool * pool = NULL);
+
+	// The welded vertices and the indices of the triangles. They may be swapped out.
+	std::vector<Vertex3D> & getVertices();
+	std::vector<unsigned int> & getIndices();
+	// Number of v, vt and vn lines and of f lines with at least three corners.
+	unsigned int getNumPositions();
+	unsigned int getNumTexCoords();
+	unsigned int getNumNormals();
+	unsigned int getNumFaces();
+	std::string getError();
+
+	// Parse a float from [p, end) after skipping blanks (like strtof(), but faster and
+	// without locale). Returns the end of the number, or p if there is none (value is 0).
+	static const char * parseFloat(const char * p, const char * end, float & value);
+
+private:
+	// Indices of the position, texture coordinate and normal of a face corner (0-based, or
+	// OBJ_NONE).
+	struct Corner {
+		int attrib[3];
+	};
+
+	// A range of lines and everything parsed from it. Positive indices are absolute already;
+	// negative ones can only be resolved relative to the attributes of the chunk, and are
+	// offset by the attributes of the preceding chunks once they are known.
+	struct Chunk {
+		const char * begin = NULL;
+		const char * end = NULL;
+		std::vector<glm::fvec3> positions;
+		std::vector<glm::fvec2> texCoords;
+		std::vector<glm::fvec3> normals;
+		// Three per triangle.
+		std::vector<Corner> corners;
+		// Corner * 3 + attribute of the relative indices.
+		std::vector<unsigned int> relative;
+		unsigned int faces = 0;
+	};
+
+	std::vector<Vertex3D> vertices;
+	std::vector<unsigned int> indices;
+	unsigned int numPositions = 0;
+	unsigned int numTexCoords = 0;
+	unsigned int numNormals = 0;
+	unsigned int numFaces = 0;
+	std::string error;
+
+	static void parseChunk(Chunk & chunk);
+	static void parseFace(const char * p, const char * end, Chunk & chunk);
+	// Weld the corners of all chunks into vertices and indices.
+	bool weld(std::vector<Chunk> & chunks);
+};
@@ -0,0 +1,129 @@
+#include "PointShadowArray.h"
+
+#include <glm\gtc\matrix_transform.hpp>
+#include <iostream>
+
+PointShadowArray::PointShadowArray(unsigned int size)
+{
+	this->size = size;
+	used.resize(MAX_NUM_POINT_SHADOWS, false);
+}
+
+PointShadowArray::~PointShadowArray()
+{
+	if (FBO) glDeleteFramebuffers(1, &FBO);
+	if (texture) glDeleteTextures(1, &texture);
+}
+
+int PointShadowArray::allocate()
+{
+	if (texture == 0 && !create()) return -1;
+	for (unsigned int i = 0; i < used.size(); i++) {
+		if (used[i]) continue;
+		used[i] = true;
+		return i;
+	}
+	return -1;
+}
+
+void PointShadowArray::release(int slot)
+{
+	if (slot >= 0 && slot < (int)used.size()) used[slot] = false;
+}
+
+GLuint PointShadowArray::getTexture()
+{
+	return texture;
+}
+
+GLenum PointShadowArray::getTarget()
+{
+	return target;
+}
+
+GLuint PointShadowArray::getFramebuffer()
+{
+	return FBO;
+}
+
+unsigned int PointShadowArray::getSize()
+{
+	return size;
+}
+
+glm::fmat4 PointShadowArray::getFaceView(glm::fvec3 position, unsigned int face)
+{
+	// Directions and up vectors of the faces as defined for cube map lookups:
+	static const glm::fvec3 dirs[POINT_SHADOW_FACES] = {
+		glm::fvec3(1.0f, 0.0f, 0.0f), glm::fvec3(-1.0f, 0.0f, 0.0f),
+		glm::fvec3(0.0f, 1.0f, 0.0f), glm::fvec3(0.0f, -1.0f, 0.0f),
+		glm::fvec3(0.0f, 0.0f, 1.0f), glm::fvec3(0.0f, 0.0f, -1.0f)
+	};
+	static const glm::fvec3 ups[POINT_SHADOW_FACES] = {
+		glm::fvec3(0.0f, -1.0f, 0.0f), glm::fvec3(0.0f, -1.0f, 0.0f),
+		glm::fvec3(0.0f, 0.0f, 1.0f), glm::fvec3(0.0f, 0.0f, -1.0f),
+		glm::fvec3(0.0f, -1.0f, 0.0f), glm::fvec3(0.0f, -1.0f, 0.0f)
+	};
+	return glm::lookAt(position, position + dirs[face], ups[face]);
+}
+
+void PointShadowArray::setFaceBudget(unsigned int faces)
+{
+	faceBudget = faces;
+}
+
+unsigned int PointShadowArray::getFaceBudget()
+{
+	return faceBudget;
+}
+
+void PointShadowArray::beginFrame()
+{
+	remainingBudget = faceBudget;
+}
+
+bool PointShadowArray::consumeBudget(unsigned int faces)
+{
+	if (faceBudget == 0) return true;
+	if (remainingBudget == 0) return false;
+	remainingBudget = faces < remainingBudget ? remainingBudget - faces : 0;
+	return true;
+}
+
+bool PointShadowArray::create()
+{
+	GLint framebufferOld;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebufferOld);
+
+	// The shaders sample cube map arrays if the extension is available (see
+	// Shader/phongShader_LayeredShadows.fs), so the same check decides the texture type.
+	target = GLAD_GL_ARB_texture_cube_map_array ? GL_TEXTURE_CUBE_MAP_ARRAY : GL_TEXTURE_2D_ARRAY;
+
+	glGenTextures(1, &texture);
+	glBindTexture(target, texture);
+	glTexStorage3D(target, 1, GL_DEPTH_COMPONENT24, size, size, MAX_NUM_POINT_SHADOWS * POINT_SHADOW_FACES);
+	glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+	glGenFramebuffers(1, &FBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, framebufferOld);
+	glBindTexture(target, 0);
+	if (!complete) {
+		std::cerr << "PointShadowArray.cpp: ERROR Framebuffer of the point light shadow maps is not complete." << std::endl;
+		glDeleteFramebuffers(1, &FBO);
+		glDeleteTextures(1, &texture);
+		FBO = 0;
+		texture = 0;
+		return false;
+	}
+	return true;
+}
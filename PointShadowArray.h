@@ -0,0 +1,60 @@
+#pragma once
+
+#include <glad\glad.h>
+#include <glm\glm.hpp>
+
+#include <vector>
+
+// Maximum number of point lights with shadows. Each of them uses six layers of the array.
+#define MAX_NUM_POINT_SHADOWS 8
+#define POINT_SHADOW_FACES 6
+
+// Shadow maps of all point lights, stored in one cube map array: the faces of the light in
+// slot i are the layers 6 * i to 6 * i + 5, in the order +X, -X, +Y, -Y, +Z, -Z. Without
+// GL_ARB_texture_cube_map_array a 2D texture array with the same layout is used instead, and
+// the shaders select the face themselves (see Shader/phongShader_LayeredShadows.fs).
+// The lights share a budget of faces that may be redrawn per frame, so many moving lights
+// spread their updates over several frames instead of stalling a single one.
+class PointShadowArray
+{
+public:
+	PointShadowArray(unsigned int size = 512);
+	~PointShadowArray();
+
+	// Reserve a slot for a light. Returns -1 if all slots are in use. The texture is created
+	// on the first call.
+	int allocate();
+	void release(int slot);
+
+	GLuint getTexture();
+	// GL_TEXTURE_CUBE_MAP_ARRAY or GL_TEXTURE_2D_ARRAY.
+	GLenum getTarget();
+	// Framebuffer with the array's texture attached as its depth buffer.
+	GLuint getFramebuffer();
+	// Width and height of each face.
+	unsigned int getSize();
+
+	// View matrix of a light at position looking through the given face.
+	static glm::fmat4 getFaceView(glm::fvec3 position, unsigned int face);
+
+	// Maximum number of faces redrawn per frame (0 = unlimited).
+	void setFaceBudget(unsigned int faces);
+	unsigned int getFaceBudget();
+	// Reset the budget. Called by the Scene at the beginning of every frame.
+	void beginFrame();
+	// Take faces from this frame's budget. Fails only if the budget is already used up, so a
+	// light whose update is larger than the remaining budget is still drawn completely.
+	bool consumeBudget(unsigned int faces);
+
+private:
+	unsigned int size;
+	GLuint texture = 0;
+	GLuint FBO = 0;
+	GLenum target = GL_TEXTURE_2D_ARRAY;
+	std::vector<bool> used;
+
+	unsigned int faceBudget = 24;
+	unsigned int remainingBudget = 0;
+
+	bool create();
+};
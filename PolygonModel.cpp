@@ -1,5 +1,7 @@
 #include "PolygonModel.h"
 
+#include <algorithm>
+
 PolygonModel::PolygonModel()
 {
 	mat = new Material();
@@ -9,12 +11,10 @@ PolygonModel::PolygonModel()
 PolygonModel::PolygonModel(aiMesh * mesh)
 {
 	name = mesh->mName.C_Str();
-	loadVertices(mesh->mVertices, mesh->mNormals, mesh->mTextureCoords[0], mesh->mColors[0], mesh->mTangents, mesh->mBitangents, mesh->mNumVertices);
-	loadFaces(mesh->mFaces, mesh->mNumFaces);
+	this->mesh = new Mesh(mesh);
+	customMesh = true;
 
 	mat = NULL;
-
-	setupBuffers();
 }
 
 PolygonModel::PolygonModel(aiMesh * mesh, aiMaterial * mat) : PolygonModel(mesh)
@@ -35,11 +35,20 @@ PolygonModel::PolygonModel(aiMesh * mesh, aiMaterial * mat, MaterialManager * ma
 	customMat = false;
 }
 
+PolygonModel::PolygonModel(Mesh * mesh, Material * mat)
+{
+	name = mesh->getName();
+	this->mesh = mesh;
+	customMesh = false;
+
+	this->mat = mat;
+	customMat = false;
+}
+
 PolygonModel::~PolygonModel()
 {
 	if (customMat && this->mat != NULL) delete this->mat;
-	vertices.clear();
-	indices.clear();
+	if (customMesh && this->mesh != NULL) delete this->mesh;
 }
 
 PolygonModel * PolygonModel::createQuad()
@@ -47,41 +56,8 @@ PolygonModel * PolygonModel::createQuad()
 	PolygonModel * res = new PolygonModel();
 
 	res->name = "Plane";
-
-	Vertex v;
-	v.color = glm::fvec4(1.0f, 1.0f, 1.0f, 1.0f);
-	v.normal = glm::fvec3(0.0f, 1.0f, 0.0f);
-	v.tangent = glm::fvec3(1.0f, 0.0f, 0.0f);
-	v.bitangent = glm::fvec3(0.0f, 0.0f, 1.0f);
-
-	// Bottom-left vertex (0)
-	v.position = glm::fvec3(-1.0f, -1.0f, 0.0f);
-	v.uv = glm::fvec2(0.0f, 0.0f);
-	res->vertices.push_back(v);
-
-	// Bottom-right vertex (1)
-	v.position = glm::fvec3(1.0f, -1.0f, 0.0f);
-	v.uv = glm::fvec2(1.0f, 0.0f);
-	res->vertices.push_back(v);
-
-	// Upper-right vertex (2)
-	v.position = glm::fvec3(1.0f, 1.0f, 0.0f);
-	v.uv = glm::fvec2(1.0f, 1.0f);
-	res->vertices.push_back(v);
-
-	// Upper-left vertex (3)
-	v.position = glm::fvec3(-1.0f, 1.0f, 0.0f);
-	v.uv = glm::fvec2(0.0f, 1.0f);
-	res->vertices.push_back(v);
-
-	res->indices.push_back(0);
-	res->indices.push_back(1);
-	res->indices.push_back(2);
-	res->indices.push_back(0);
-	res->indices.push_back(2);
-	res->indices.push_back(3);
-
-	res->setupBuffers();
+	res->mesh = Mesh::createQuad();
+	res->customMesh = true;
 
 	return res;
 }
@@ -106,20 +82,11 @@ void PolygonModel::draw(Material * mat)
 
 	mat->prepare(s);
 
-	if (getTransform()) s->setMat4("model", getTransform()->getTransform());
-	else s->setMat4("model", glm::fmat4(1.0f));
+	if (getTransform()) s->set(s->uniforms.model, getTransform()->getTransform());
+	else s->set(s->uniforms.model, glm::fmat4(1.0f));
+	s->set(s->uniforms.instanced, false);
 
-	if (!valid) {
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		//Array buffer for all vertices:
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-		valid = true;
-	}
-
-	glBindVertexArray(VAO);
-	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+	if (mesh) mesh->draw();
 }
 
 void PolygonModel::draw(Shader * s)
@@ -134,35 +101,16 @@ void PolygonModel::draw(Shader * s)
 	}
 	mat->prepare(s);
 
-	if (getTransform()) s->setMat4("model", getTransform()->getTransform());
-	else s->setMat4("model", glm::fmat4(1.0f));
-
-	if (!valid) {
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		//Array buffer for all vertices:
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+	if (getTransform()) s->set(s->uniforms.model, getTransform()->getTransform());
+	else s->set(s->uniforms.model, glm::fmat4(1.0f));
+	s->set(s->uniforms.instanced, false);
 
-		valid = true;
-	}
-
-	glBindVertexArray(VAO);
-	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+	if (mesh) mesh->draw();
 }
 
 void PolygonModel::drawRaw()
 {
-	if (!valid) {
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		//Array buffer for all vertices:
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-		valid = true;
-	}
-
-	glBindVertexArray(VAO);
-	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+	if (mesh) mesh->draw();
 }
 
 bool PolygonModel::castsShadows()
@@ -198,91 +146,74 @@ Material * PolygonModel::getMaterial()
 	return mat;
 }
 
-void PolygonModel::setName(std::string name)
+bool PolygonModel::isMeshUnique()
 {
-	this->name = name;
+	return customMesh;
 }
 
-std::string PolygonModel::getName()
+void PolygonModel::setMesh(Mesh * mesh, bool unique)
 {
-	return name;
+	if (customMesh && this->mesh != NULL && this->mesh != mesh) delete this->mesh;
+	this->mesh = mesh;
+	customMesh = unique;
+	lod = 0;
+	shadowLod = 0;
 }
 
-void PolygonModel::invalidate()
+Mesh * PolygonModel::getMesh()
 {
-	valid = false;
+	return mesh;
 }
 
-void PolygonModel::deleteResources()
+void PolygonModel::updateLod(float screenRadius, float pixelError, float hysteresis, unsigned int shadowBias)
 {
-	mat->deleteResources();
-
-	delete mat;
+	if (mesh == NULL) return;
+	lod = mesh->selectLod(screenRadius, pixelError, lod, hysteresis);
+	shadowLod = std::min(lod + shadowBias, mesh->getNumLods() - 1);
 }
 
-void PolygonModel::setupBuffers()
+unsigned int PolygonModel::getLod()
 {
-	//Setup buffers:
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glGenBuffers(1, &EBO);
-
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-
-	//Array buffer for all vertices:
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-	//Element buffer for all triangles:
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
-
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, uv));
+	return lod;
+}
 
-	glEnableVertexAttribArray(3);
-	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, color));
+unsigned int PolygonModel::getShadowLod()
+{
+	return shadowLod;
+}
 
-	glEnableVertexAttribArray(4);
-	glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tangent));
+AABB PolygonModel::getWorldBounds()
+{
+	if (mesh == NULL) return AABB();
+	if (getTransform() == NULL) return mesh->getBounds();
+	return mesh->getBounds().transform(getTransform()->getTransform());
+}
 
-	glEnableVertexAttribArray(5);
-	glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, bitangent));
+BoundingSphere PolygonModel::getWorldBoundingSphere()
+{
+	if (mesh == NULL) return BoundingSphere();
+	if (getTransform() == NULL) return mesh->getBoundingSphere();
+	return mesh->getBoundingSphere().transform(getTransform()->getTransform());
+}
 
-	glBindVertexArray(0);
+void PolygonModel::setName(std::string name)
+{
+	this->name = name;
+}
 
-	valid = true;
+std::string PolygonModel::getName()
+{
+	return name;
 }
 
-void PolygonModel::loadVertices(aiVector3D * vertices, aiVector3D * normals, aiVector3D * uvs, aiColor4D * colors, aiVector3D * tangents, aiVector3D * bitangents, unsigned int nVertices)
+void PolygonModel::invalidate()
 {
-	for (unsigned int i = 0; i < nVertices; i++) {
-		Vertex v = Vertex();
-		v.position = glm::fvec3(vertices[i].x, vertices[i].y, vertices[i].z);
-		if (normals) v.normal = glm::fvec3(normals[i].x, normals[i].y, normals[i].z);
-		if (uvs) v.uv = glm::fvec2(uvs[i].x, uvs[i].y);
-		if (colors) v.color = glm::fvec4(colors[i].r, colors[i].g, colors[i].b, colors[i].a);
-		if (tangents) v.tangent = glm::fvec3(tangents[i].x, tangents[i].y, tangents[i].z);
-		if (bitangents) v.bitangent = glm::fvec3(bitangents[i].x, bitangents[i].y, bitangents[i].z);
-
-		this->vertices.push_back(v);
-	}
+	if (mesh) mesh->invalidate();
 }
 
-void PolygonModel::loadFaces(aiFace * faces, unsigned int nFaces)
+void PolygonModel::deleteResources()
 {
-	for (unsigned int i = 0; i < nFaces; i++) {
-		if (faces[i].mNumIndices != 3) {
-			std::cerr << "PolygonModel.cpp: ERROR while loading faces. Some faces are not triangles" << std::endl;
-		}
-		for (unsigned int j = 0; j < 3; j++) {
-			indices.push_back(faces[i].mIndices[j]);
-		}
-	}
+	mat->deleteResources();
+
+	delete mat;
 }
@@ -5,6 +5,7 @@
 #include "assimp\postprocess.h"
 
 #include "Component.h"
+#include "Mesh.h"
 
 #include "Material.h"
 #include "MaterialManager.h"
@@ -15,23 +16,18 @@
 #include <vector>
 #include <string>
 
-struct Vertex {
-	glm::fvec3 position;
-	glm::fvec3 normal;
-	glm::fvec2 uv;
-	glm::fvec4 color;
-	glm::fvec3 tangent;
-	glm::fvec3 bitangent;
-};
-
+// Instance of a Mesh drawn with a Material. Many PolygonModels can share the same Mesh.
 class PolygonModel : public Component
 {
+	COMPONENT_TYPE(PolygonModel)
 public:
 	PolygonModel();
 	PolygonModel(aiMesh * mesh);
 	PolygonModel(aiMesh * mesh, aiMaterial * mat);
 	PolygonModel(aiMesh * mesh, Material * mat);
 	PolygonModel(aiMesh * mesh, aiMaterial * mat, MaterialManager * matManager);
+	// Create an instance of a shared mesh. The mesh is not deleted with the PolygonModel.
+	PolygonModel(Mesh * mesh, Material * mat);
 	~PolygonModel();
 
 	static PolygonModel * createQuad();
@@ -50,28 +46,38 @@ public:
 	void setMaterial(Material * mat, bool unique = false);
 	Material * getMaterial();
 
+	// Returns whether the mesh belongs to this PolygonModel alone (and is deleted with it).
+	bool isMeshUnique();
+	void setMesh(Mesh * mesh, bool unique = false);
+	Mesh * getMesh();
+
+	// Select the LOD of the mesh (see Mesh::selectLod()) for a bounding sphere radius of
+	// screenRadius pixels. Shadow passes draw shadowBias levels coarser.
+	void updateLod(float screenRadius, float pixelError, float hysteresis, unsigned int shadowBias);
+	unsigned int getLod();
+	unsigned int getShadowLod();
+
+	// Bounds of the mesh in world space (i.e. transformed by the global transform).
+	AABB getWorldBounds();
+	BoundingSphere getWorldBoundingSphere();
+
 	void setName(std::string name);
 	std::string getName();
 
+	// Mark the mesh's vertices as changed.
 	void invalidate();
 	void deleteResources();
 
 private:
 	bool shadows = true;
 
-	GLuint VAO, VBO, EBO;
-	bool valid = false;
-	void setupBuffers();
+	bool customMesh = false;
+	Mesh * mesh = NULL;
+	unsigned int lod = 0;
+	unsigned int shadowLod = 0;
 
 	bool customMat;
 	Material * mat;
 	std::string name;
-
-	std::vector<Vertex> vertices;
-	std::vector<unsigned int> indices;
-
-	void loadVertices(aiVector3D* vertices, aiVector3D* normals, aiVector3D* uvs,
-						aiColor4D* color, aiVector3D* tangents, aiVector3D* bitangents, unsigned int nVertices);
-	void loadFaces(aiFace* faces, unsigned int nFaces);
 };
 
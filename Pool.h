@@ -0,0 +1,165 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+// Generational handle to an object stored in a Pool. A handle becomes stale as soon as
+// the object it refers to is destroyed, even if the slot is reused by another object.
+struct Handle {
+	unsigned int index = 0xFFFFFFFF;
+	unsigned int generation = 0;
+
+	// Returns whether the handle was ever assigned. This does NOT check whether the
+	// object still exists; use Pool::isAlive() for that.
+	bool isNull() const { return index == 0xFFFFFFFF; }
+
+	bool operator==(const Handle & h) const { return index == h.index && generation == h.generation; }
+	bool operator!=(const Handle & h) const { return !(*this == h); }
+	bool operator<(const Handle & h) const { return index < h.index || (index == h.index && generation < h.generation); }
+};
+
+typedef Handle EntityHandle;
+typedef Handle ComponentHandle;
+
+// Type-erased interface of a Pool, so that objects can be returned to their pool without
+// knowing its element type.
+class PoolBase
+{
+public:
+	virtual ~PoolBase() {};
+
+	// Destroy the object referred to by the handle. Stale handles are ignored.
+	virtual void destroy(Handle h) = 0;
+	// Returns whether the handle refers to an existing object.
+	virtual bool isAlive(Handle h) const = 0;
+	// Returns the number of existing objects.
+	virtual unsigned int size() const = 0;
+};
+
+// Pool of objects of type T with O(1) creation and destruction. The objects are stored in
+// chunks of ChunkSize elements which are never moved or released before the pool is
+// destroyed, so pointers to existing objects stay valid and memory usage stays constant when
+// objects are repeatedly created and destroyed (e.g. particles). Freed slots are reused in
+// LIFO order. Existing objects can be iterated densely via at(i), 0 <= i < size().
+template <typename T, unsigned int ChunkSize = 256>
+class Pool : public PoolBase
+{
+public:
+	Pool() {};
+	Pool(const Pool &) = delete;
+	Pool & operator=(const Pool &) = delete;
+
+	virtual ~Pool() {
+		clear();
+		for (Storage * chunk : chunks)
+			delete[] chunk;
+		chunks.clear();
+	}
+
+	// Construct a new object from the passed arguments and return its handle.
+	template <typename... Args>
+	Handle create(Args&&... args) {
+		unsigned int index;
+		if (!freeList.empty()) {
+			index = freeList.back();
+			freeList.pop_back();
+		}
+		else {
+			index = slots.size();
+			if (index % ChunkSize == 0)
+				chunks.push_back(new Storage[ChunkSize]);
+			slots.push_back(Slot());
+		}
+
+		new (address(index)) T(std::forward<Args>(args)...);
+
+		Slot & slot = slots[index];
+		slot.alive = true;
+		slot.dense = dense.size();
+		dense.push_back(index);
+
+		Handle h;
+		h.index = index;
+		h.generation = slot.generation;
+		return h;
+	}
+
+	virtual void destroy(Handle h) {
+		if (!isAlive(h)) return;
+		Slot & slot = slots[h.index];
+
+		address(h.index)->~T();
+		slot.alive = false;
+		slot.generation++;
+
+		// Keep the dense array packed by moving the last element into the gap:
+		unsigned int last = dense.back();
+		dense[slot.dense] = last;
+		slots[last].dense = slot.dense;
+		dense.pop_back();
+
+		freeList.push_back(h.index);
+	}
+
+	virtual bool isAlive(Handle h) const {
+		return h.index < slots.size() && slots[h.index].alive && slots[h.index].generation == h.generation;
+	}
+
+	virtual unsigned int size() const {
+		return dense.size();
+	}
+
+	// Returns a pointer to the object referred to by the handle, or NULL if the handle is stale.
+	T * get(Handle h) {
+		if (!isAlive(h)) return NULL;
+		return address(h.index);
+	}
+
+	// Returns the i-th existing object (dense iteration). The order changes whenever an
+	// object is destroyed.
+	T * at(unsigned int i) {
+		if (i >= dense.size()) return NULL;
+		return address(dense[i]);
+	}
+
+	// Returns the handle of the i-th existing object (dense iteration).
+	Handle handleAt(unsigned int i) const {
+		Handle h;
+		if (i >= dense.size()) return h;
+		h.index = dense[i];
+		h.generation = slots[dense[i]].generation;
+		return h;
+	}
+
+	// Destroy all objects. The memory is kept for reuse.
+	void clear() {
+		while (!dense.empty())
+			destroy(handleAt(dense.size() - 1));
+	}
+
+	// Returns the number of slots allocated (existing and free).
+	unsigned int capacity() const {
+		return chunks.size() * ChunkSize;
+	}
+
+private:
+	typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Storage;
+
+	struct Slot {
+		unsigned int generation = 0;
+		unsigned int dense = 0;
+		bool alive = false;
+	};
+
+	std::vector<Storage *> chunks;
+	std::vector<Slot> slots;
+	std::vector<unsigned int> dense;
+	std::vector<unsigned int> freeList;
+
+	T * address(unsigned int index) const {
+		return reinterpret_cast<T *>(&chunks[index / ChunkSize][index % ChunkSize]);
+	}
+};
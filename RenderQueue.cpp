@@ -0,0 +1,304 @@
+#include "RenderQueue.h"
+#include "RenderStats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+// Bits of the sort key, from most to least significant.
+#define KEY_BITS_PASS 4
+#define KEY_BITS_SHADER 10
+#define KEY_BITS_MATERIAL 16
+#define KEY_BITS_MESH 14
+#define KEY_BITS_DEPTH 20
+
+// Number of items whose instance data, and of batches whose draw commands, one job builds.
+#define INSTANCE_JOB_SIZE 256
+#define COMMAND_JOB_SIZE 16
+
+RenderQueue::RenderQueue()
+{
+}
+
+RenderQueue::~RenderQueue()
+{
+	if (instanceBuffer != 0) glDeleteBuffers(1, &instanceBuffer);
+	if (indirectBuffer != 0) glDeleteBuffers(1, &indirectBuffer);
+}
+
+unsigned long long RenderQueue::makeKey(RenderPass pass, GLuint shader, unsigned int material, unsigned int mesh, float depth)
+{
+	// For non-negative floats, the order of the bit patterns equals the order of the values,
+	// so the upper bits of the pattern are a monotonic depth value.
+	if (!(depth > 0.0f)) depth = 0.0f;
+	unsigned int depthBits;
+	std::memcpy(&depthBits, &depth, sizeof(float));
+	unsigned long long d = (depthBits >> (31 - KEY_BITS_DEPTH)) & ((1ULL << KEY_BITS_DEPTH) - 1);
+	if (pass == RENDER_PASS_TRANSPARENT)
+		d = ((1ULL << KEY_BITS_DEPTH) - 1) - d;
+
+	unsigned long long key = (unsigned long long) pass & ((1ULL << KEY_BITS_PASS) - 1);
+	key = (key << KEY_BITS_SHADER) | (shader & ((1ULL << KEY_BITS_SHADER) - 1));
+	key = (key << KEY_BITS_MATERIAL) | (material & ((1ULL << KEY_BITS_MATERIAL) - 1));
+	key = (key << KEY_BITS_MESH) | (mesh & ((1ULL << KEY_BITS_MESH) - 1));
+	key = (key << KEY_BITS_DEPTH) | d;
+	return key;
+}
+
+void RenderQueue::add(PolygonModel * model, float depth, RenderPass pass)
+{
+	Material * mat = model->getMaterial();
+	if (mat == NULL || mat->getShader() == NULL || model->getMesh() == NULL) return;
+
+	RenderItem item;
+	item.model = model;
+	item.material = mat;
+	item.shader = mat->getShader();
+	item.lod = model->getLod();
+	item.key = makeKey(pass, item.shader->ID, mat->getID(), model->getMesh()->getID(), depth);
+	items.push_back(item);
+	batchesValid = false;
+}
+
+void RenderQueue::add(PolygonModel * model, Shader * shader, float depth, RenderPass pass)
+{
+	if (shader == NULL || model->getMesh() == NULL) return;
+
+	RenderItem item;
+	item.model = model;
+	item.material = NULL;
+	item.shader = shader;
+	item.lod = model->getShadowLod();
+	item.key = makeKey(pass, shader->ID, 0, model->getMesh()->getID(), depth);
+	items.push_back(item);
+	batchesValid = false;
+}
+
+void RenderQueue::sort()
+{
+	std::sort(items.begin(), items.end(), [](const RenderItem & a, const RenderItem & b) { return a.key < b.key; });
+	batchesValid = false;
+}
+
+void RenderQueue::draw(unsigned int layers)
+{
+	if (layers == 0) return;
+	if (!batchesValid || layers != batchLayers) buildBatches(layers);
+	// Other queues may have bound their own commands since the last draw.
+	if (indirectBuffer != 0) glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+
+	Shader * lastShader = NULL;
+	Material * lastMaterial = NULL;
+	bool lastInstanced = false;
+
+	for (Batch & batch : batches) {
+		RenderItem & item = items[batch.first];
+		Shader * s = item.shader;
+		bool instanced = batch.instanceOffset >= 0;
+		if (s != lastShader) {
+			s->use();
+			lastShader = s;
+			lastMaterial = NULL;
+			// The value of instanced is unknown after switching the shader.
+			s->set(s->uniforms.instanced, instanced);
+			lastInstanced = instanced;
+		}
+		else if (instanced != lastInstanced) {
+			s->set(s->uniforms.instanced, instanced);
+			lastInstanced = instanced;
+		}
+		if (item.material && item.material != lastMaterial) {
+			item.material->prepare(s);
+			lastMaterial = item.material;
+		}
+
+		Mesh * mesh = item.model->getMesh();
+		if (batch.multiDraw) {
+			mesh->getGeometryArena()->multiDraw(mesh->getIndexType(), &commands[batch.first], batch.commandCount,
+				batch.first * sizeof(DrawElementsIndirectCommand), instanceBuffer, layers);
+		}
+		else if (instanced) {
+			mesh->setInstanceBuffer(instanceBuffer, batch.instanceOffset, layers);
+			mesh->drawInstanced(batch.count * layers, item.lod);
+		}
+		else {
+			Transform3D * tf = item.model->getTransform();
+			s->set(s->uniforms.model, tf ? tf->getTransform() : glm::fmat4(1.0f));
+			if (layers > 1) mesh->drawInstanced(layers, item.lod);
+			else mesh->draw(item.lod);
+		}
+	}
+}
+
+void RenderQueue::clear()
+{
+	items.clear();
+	batches.clear();
+	batchesValid = false;
+}
+
+void RenderQueue::setInstancing(bool enabled)
+{
+	instancing = enabled;
+	batchesValid = false;
+}
+
+bool RenderQueue::getInstancing()
+{
+	return instancing;
+}
+
+void RenderQueue::setMultiDraw(bool enabled)
+{
+	multiDraw = enabled;
+	batchesValid = false;
+}
+
+bool RenderQueue::getMultiDraw()
+{
+	return multiDraw;
+}
+
+void RenderQueue::setThreadPool(ThreadPool * pool)
+{
+	this->pool = pool;
+}
+
+void RenderQueue::buildBatches(unsigned int layers)
+{
+	batches.clear();
+	bool anyInstanced = false, anyMultiDraw = false;
+
+	// Group the items on this thread, since updating the buffers of the meshes needs the context.
+	unsigned int i = 0;
+	while (i < items.size()) {
+		RenderItem & first = items[i];
+		Mesh * mesh = first.model->getMesh();
+		bool instanceable = instancing && first.shader->uniforms.instanced.isValid();
+		bool multi = false;
+		unsigned int end = i + 1;
+		if (instanceable && multiDraw && mesh->updateBuffers() && mesh->getGeometryArena() != NULL) {
+			// Meshes in the same arena with the same index type can share a multi-draw.
+			multi = true;
+			while (end < items.size() && items[end].shader == first.shader && items[end].material == first.material) {
+				Mesh * m = items[end].model->getMesh();
+				if (m != mesh && (!m->updateBuffers() || m->getGeometryArena() != mesh->getGeometryArena()
+					|| m->getIndexType() != mesh->getIndexType())) {
+					break;
+				}
+				end++;
+			}
+		}
+		else if (instanceable) {
+			// The position decoding in the instance data is only valid after the update.
+			mesh->updateBuffers();
+			// The items are sorted by shader, material and mesh, so draws of the same mesh are
+			// adjacent. Draws of different LODs are split.
+			while (end < items.size() && items[end].shader == first.shader && items[end].material == first.material
+				&& items[end].model->getMesh() == mesh && items[end].lod == first.lod) {
+				end++;
+			}
+		}
+
+		Batch batch;
+		batch.first = i;
+		batch.count = end - i;
+		batch.instanceOffset = -1;
+		batch.multiDraw = false;
+		batch.commandCount = 0;
+		if (batch.count >= MIN_INSTANCED_BATCH_SIZE) {
+			batch.instanceOffset = i * sizeof(InstanceData);
+			batch.multiDraw = multi;
+			anyInstanced = true;
+			anyMultiDraw |= multi;
+			batches.push_back(batch);
+		}
+		else {
+			// Too few draws for instancing, draw them one by one.
+			for (unsigned int j = i; j < end; j++) {
+				batch.first = j;
+				batch.count = 1;
+				batches.push_back(batch);
+			}
+		}
+		i = end;
+	}
+
+	if (anyInstanced) {
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+		// The data of item i is at index i, so every job writes its own part.
+		instanceData.resize(items.size());
+		ThreadPool::parallelFor(pool, (items.size() + INSTANCE_JOB_SIZE - 1) / INSTANCE_JOB_SIZE, [this](unsigned int job) {
+			unsigned int end = std::min((job + 1) * INSTANCE_JOB_SIZE, (unsigned int)items.size());
+			for (unsigned int j = job * INSTANCE_JOB_SIZE; j < end; j++) {
+				Transform3D * tf = items[j].model->getTransform();
+				InstanceData & data = instanceData[j];
+				data.model = tf ? tf->getTransform() : glm::fmat4(1.0f);
+				items[j].model->getMesh()->getPositionDecode(data.posScale, data.posOffset);
+			}
+		});
+
+		if (anyMultiDraw) {
+			// One command per run of the same mesh and LOD, starting at the batch's first item.
+			commands.resize(items.size());
+			ThreadPool::parallelFor(pool, (batches.size() + COMMAND_JOB_SIZE - 1) / COMMAND_JOB_SIZE, [this, layers](unsigned int job) {
+				unsigned int last = std::min((job + 1) * COMMAND_JOB_SIZE, (unsigned int)batches.size());
+				for (unsigned int b = job * COMMAND_JOB_SIZE; b < last; b++) {
+					Batch & batch = batches[b];
+					if (!batch.multiDraw) continue;
+					unsigned int j = batch.first, end = batch.first + batch.count;
+					while (j < end) {
+						Mesh * mesh = items[j].model->getMesh();
+						unsigned int run = j + 1;
+						while (run < end && items[run].model->getMesh() == mesh && items[run].lod == items[j].lod)
+							run++;
+						mesh->getDrawCommand(items[j].lod, (run - j) * layers, j, commands[batch.first + batch.commandCount]);
+						batch.commandCount++;
+						j = run;
+					}
+				}
+			});
+		}
+
+		renderStats.drawCommandBuildTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		if (instanceBuffer == 0) glGenBuffers(1, &instanceBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		upload(GL_ARRAY_BUFFER, instanceBufferSize, instanceData.size() * sizeof(InstanceData), &instanceData[0]);
+
+		// The fallbacks of GeometryArena::multiDraw() read the commands from memory.
+		if (anyMultiDraw && GeometryArena::hasMultiDrawIndirect()) {
+			if (indirectBuffer == 0) glGenBuffers(1, &indirectBuffer);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+			upload(GL_DRAW_INDIRECT_BUFFER, indirectBufferSize, commands.size() * sizeof(DrawElementsIndirectCommand), &commands[0]);
+		}
+	}
+
+	batchesValid = true;
+	batchLayers = layers;
+}
+
+void RenderQueue::upload(GLenum target, GLsizeiptr & bufferSize, GLsizeiptr size, const void * data)
+{
+	if (size > bufferSize) {
+		bufferSize = size;
+		glBufferData(target, bufferSize, data, GL_STREAM_DRAW);
+	}
+	else {
+		// Orphan the old storage, so the upload does not wait for draws still using it.
+		glBufferData(target, bufferSize, NULL, GL_STREAM_DRAW);
+		glBufferSubData(target, 0, size, data);
+	}
+	renderStats.bufferBytesUploaded += size;
+}
+
+unsigned int RenderQueue::size()
+{
+	return items.size();
+}
+
+bool RenderQueue::empty()
+{
+	return items.empty();
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "PolygonModel.h"
+#include "Shader.h"
+#include "GeometryArena.h"
+#include "ThreadPool.h"
+
+#include <vector>
+
+// Passes of the render queue. Draws are sorted by pass first.
+enum RenderPass {
+	RENDER_PASS_SHADOW = 0,
+	RENDER_PASS_OPAQUE = 1,
+	RENDER_PASS_TRANSPARENT = 2,
+	RENDER_PASS_OVERLAY = 3
+};
+
+// Minimum number of consecutive draws of the same mesh, shader and material that are
+// drawn with one instanced draw call.
+#define MIN_INSTANCED_BATCH_SIZE 2
+
+// A single draw in a RenderQueue.
+struct RenderItem {
+	unsigned long long key;
+	PolygonModel * model;
+	Shader * shader;
+	// NULL if the draw does not need material data (e.g. depth-only passes).
+	Material * material;
+	// Level of detail of the mesh.
+	unsigned int lod;
+};
+
+// Collects the PolygonModels to draw in a frame and draws them sorted by a 64-bit key made
+// of (from most to least significant) pass, shader, material, mesh and depth.
+// Consecutive draws with the same shader or material therefore only bind them once. Meshes
+// in the same GeometryArena share their vertex array, so the vertex array does not need a
+// place in the key.
+// Opaque draws are sorted front to back within a state group, transparent draws back to
+// front.
+// Consecutive draws of the same mesh and LOD with the same shader and material are merged
+// into a single instanced draw call if the shader supports it (i.e. has an "instanced" uniform
+// and reads the model matrix from the per-instance attributes, see Mesh).
+// With multi-draw enabled, consecutive draws with the same shader and material whose meshes
+// are in the same GeometryArena are merged further into one multi-draw (see
+// GeometryArena::multiDraw()), with one indirect command per run of the same mesh and LOD.
+// The per-draw data (model matrix and position decoding) is read from the instance buffer
+// at each command's base instance. The instance data and the commands are built by the
+// thread pool, if one is set.
+class RenderQueue
+{
+public:
+	RenderQueue();
+	~RenderQueue();
+
+	// Build the sort key of a draw. mesh is the Mesh's ID. depth is the (non-negative)
+	// distance to the camera.
+	static unsigned long long makeKey(RenderPass pass, GLuint shader, unsigned int material, unsigned int mesh, float depth);
+
+	// Add a draw of the model using its material, at the model's LOD.
+	void add(PolygonModel * model, float depth, RenderPass pass = RENDER_PASS_OPAQUE);
+	// Add a draw of the model with the given shader and without material data (e.g. for
+	// depth-only passes), at the model's shadow LOD.
+	void add(PolygonModel * model, Shader * shader, float depth, RenderPass pass = RENDER_PASS_SHADOW);
+
+	// Sort the draws by their keys.
+	void sort();
+	// Draw everything in the queue in its current order. The queue is not cleared, so it
+	// can be drawn several times (e.g. once per shadow map layer). The transforms of the
+	// models have to be valid (see Transform3D::getTransform()), as they may be read by
+	// other threads.
+	// With layers > 1, every object is drawn as that many consecutive instances (e.g. one
+	// per shadow map layer, with the layer selected in the vertex shader).
+	void draw(unsigned int layers = 1);
+	void clear();
+
+	// Enable or disable merging draws into instanced draw calls (enabled by default).
+	void setInstancing(bool enabled);
+	bool getInstancing();
+	// Enable or disable merging instanced draws of meshes in the same GeometryArena into
+	// multi-draws (enabled by default). Requires instancing.
+	void setMultiDraw(bool enabled);
+	bool getMultiDraw();
+	// Pool building the instance data and draw commands, or NULL to build them on the
+	// calling thread.
+	void setThreadPool(ThreadPool * pool);
+
+	unsigned int size();
+	bool empty();
+
+private:
+	// A range of items drawn with one draw call. instanceOffset is the offset of the data
+	// of the first item in the instance buffer, or -1 if the range is drawn without
+	// instancing. Multi-draw batches are drawn with the commandCount commands starting at
+	// commands[first].
+	struct Batch {
+		unsigned int first;
+		unsigned int count;
+		GLintptr instanceOffset;
+		bool multiDraw;
+		unsigned int commandCount;
+	};
+
+	std::vector<RenderItem> items;
+	std::vector<Batch> batches;
+	// Instance data and draw commands, indexed like the items.
+	std::vector<InstanceData> instanceData;
+	std::vector<DrawElementsIndirectCommand> commands;
+	GLuint instanceBuffer = 0;
+	GLsizeiptr instanceBufferSize = 0;
+	GLuint indirectBuffer = 0;
+	GLsizeiptr indirectBufferSize = 0;
+	ThreadPool * pool = NULL;
+	bool batchesValid = false;
+	// Number of layers the batches were built for, which is part of the commands.
+	unsigned int batchLayers = 0;
+	bool instancing = true;
+	bool multiDraw = true;
+
+	// Split the items into batches and upload the instance data and the draw commands.
+	void buildBatches(unsigned int layers);
+	// Orphan the buffer (bound to target) and upload size bytes of data, growing it if
+	// necessary.
+	static void upload(GLenum target, GLsizeiptr & bufferSize, GLsizeiptr size, const void * data);
+};
@@ -0,0 +1,49 @@
+#include "RenderStats.h"
+
+RenderStats renderStats;
+
+void RenderStats::endFrame()
+{
+	frames++;
+}
+
+void RenderStats::print(std::ostream & out)
+{
+	unsigned int n = frames ? frames : 1;
+	out << "Render stats (avg. per frame over " << frames << " frames):" << std::endl;
+	out << "  draw calls: " << drawCalls / n
+		<< ", triangles: " << trianglesDrawn / n
+		<< ", program binds: " << programBinds / n
+		<< ", texture binds: " << textureBinds / n << std::endl;
+	out << "  visible objects: " << visibleObjects / n
+		<< ", culled objects: " << culledObjects / n << std::endl;
+	out << "  shadow layers drawn: " << shadowLayersDrawn / n
+		<< ", skipped: " << shadowLayersSkipped / n
+		<< ", static cache layers drawn: " << shadowStaticLayersDrawn / n
+		<< ", GPU time: " << (shadowGpuSamples ? shadowGpuTime / shadowGpuSamples : 0.0) << " ms" << std::endl;
+	out << "  point shadow faces drawn: " << pointShadowFacesDrawn / n
+		<< ", skipped: " << pointShadowFacesSkipped / n
+		<< ", lights deferred: " << pointShadowLightsDeferred / n << std::endl;
+	out << "  cluster light indices: " << clusterLightIndices / n
+		<< ", light assignment: " << lightAssignmentTime / n << " ms"
+		<< ", buffer texture uploads: " << textureBufferUploads / n << std::endl;
+	out << "  vertex uploads: " << bufferBytesUploaded / n << " bytes"
+		<< ", " << bufferUploadTime / n << " ms"
+		<< ", stream waits: " << streamWaits / n
+		<< ", orphans: " << streamOrphans / n << std::endl;
+	out << "  instanced draw calls: " << instancedDrawCalls / n
+		<< " (" << instancedObjects / n << " objects)"
+		<< ", multi-draws: " << multiDrawCalls / n
+		<< " (" << multiDrawCommands / n << " commands)"
+		<< ", command building: " << drawCommandBuildTime / n << " ms" << std::endl;
+	out << "  uniform uploads: " << uniformUploads / n
+		<< ", by name: " << uniformLookups / n
+		<< ", glGetUniformLocation: " << uniformLocationQueries / n
+		<< ", uniform block uploads: " << uniformBlockUploads / n << std::endl;
+	reset();
+}
+
+void RenderStats::reset()
+{
+	*this = RenderStats();
+}
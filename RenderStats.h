@@ -0,0 +1,74 @@
+#pragma once
+
+#include <ostream>
+
+// Counters of the rendering work done by the engine. The counters are incremented by the
+// renderer on the main thread and accumulated until print() is called.
+struct RenderStats {
+	// Number of glUniform* calls.
+	unsigned long long uniformUploads = 0;
+	// Number of uniforms set by name (i.e. with a lookup in the location cache).
+	unsigned long long uniformLookups = 0;
+	// Number of glGetUniformLocation calls.
+	unsigned long long uniformLocationQueries = 0;
+	// Number of uniform buffer uploads.
+	unsigned long long uniformBlockUploads = 0;
+	// Number of draw calls.
+	unsigned long long drawCalls = 0;
+	// Number of triangles drawn (of the selected LODs).
+	unsigned long long trianglesDrawn = 0;
+	// Number of objects drawn by instanced draw calls, and the number of those calls.
+	unsigned long long instancedObjects = 0;
+	unsigned long long instancedDrawCalls = 0;
+	// Number of multi-draws (see GeometryArena::multiDraw()), the draw commands they
+	// submitted, and the CPU time in milliseconds spent building the commands and instance data.
+	unsigned long long multiDrawCalls = 0;
+	unsigned long long multiDrawCommands = 0;
+	double drawCommandBuildTime = 0.0;
+	// Number of PolygonModels inside and outside of the camera frustum.
+	unsigned long long visibleObjects = 0;
+	unsigned long long culledObjects = 0;
+	// Number of shadow map layers drawn, and skipped because nothing in them changed.
+	unsigned long long shadowLayersDrawn = 0;
+	unsigned long long shadowLayersSkipped = 0;
+	// Number of layers of the static shadow caches redrawn (see DirectionalLight).
+	unsigned long long shadowStaticLayersDrawn = 0;
+	// GPU time of the shadow maps in milliseconds, summed over shadowGpuSamples frames
+	// (timer results arrive a few frames late, so not every frame has one yet).
+	double shadowGpuTime = 0.0;
+	unsigned int shadowGpuSamples = 0;
+	// Number of point light shadow faces drawn and skipped, and of point lights whose
+	// update was deferred to a later frame by the face budget.
+	unsigned long long pointShadowFacesDrawn = 0;
+	unsigned long long pointShadowFacesSkipped = 0;
+	unsigned long long pointShadowLightsDeferred = 0;
+	// Number of light indices in the light lists of the clusters, and the CPU time in
+	// milliseconds spent assigning the point lights to the clusters.
+	unsigned long long clusterLightIndices = 0;
+	double lightAssignmentTime = 0.0;
+	// Bytes uploaded to vertex buffers and the CPU time in milliseconds spent on it (full
+	// uploads of static meshes and the changed ranges of streamed ones).
+	unsigned long long bufferBytesUploaded = 0;
+	double bufferUploadTime = 0.0;
+	// Number of StreamBuffer updates that had to wait for the GPU, and that orphaned the
+	// storage instead.
+	unsigned long long streamWaits = 0;
+	unsigned long long streamOrphans = 0;
+	// Number of buffer texture uploads.
+	unsigned long long textureBufferUploads = 0;
+	// Number of program and texture binds that were not skipped by GLState.
+	unsigned long long programBinds = 0;
+	unsigned long long textureBinds = 0;
+
+	// Number of frames the counters were accumulated over.
+	unsigned int frames = 0;
+
+	// Mark the end of a frame.
+	void endFrame();
+	// Print the average counts per frame since the last call and reset all counters.
+	void print(std::ostream & out);
+	void reset();
+};
+
+// Statistics of the renderer.
+extern RenderStats renderStats;
@@ -24,6 +24,7 @@ struct ContinuousForce {
 
 // Rigidbody object for physics calculations. All forces are declared in global space.
 class Rigidbody : public Component {
+	COMPONENT_TYPE(Rigidbody)
 public:
 	float mass;
 	glm::fmat3 inertiaTensor = glm::fmat3(1.0f);
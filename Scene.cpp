@@ -1,33 +1,82 @@
 #include "Scene.h"
 #include "Component.h"
+#include "Rigidbody.h"
+#include "SystemScheduler.h"
+#include "GLState.h"
+#include "RenderStats.h"
+#include "SceneCache.h"
+
+#include <algorithm>
+#include <chrono>
 
 Scene::Scene()
 {
 	cameras.push_back(new Camera());
 	matManager = new MaterialManager();
 	activeCamera = 0;
+	setupSystems();
+	setShadowRenderMode(SHADOW_RENDER_VERTEX_LAYER);
 }
 
 Scene::Scene(const aiScene * scene)
 {
-	loadScene(scene);
+	loadScene(scene, false);
+	setupSystems();
+	setShadowRenderMode(SHADOW_RENDER_VERTEX_LAYER);
 }
 
 Scene::Scene(const aiScene * scene, bool ambientFromDiffuse)
 {
 	loadScene(scene, ambientFromDiffuse);
+	setupSystems();
+	setShadowRenderMode(SHADOW_RENDER_VERTEX_LAYER);
+}
+
+Scene::Scene(const aiScene * scene, bool ambientFromDiffuse, const std::vector<Mesh *> & meshes)
+{
+	loadScene(scene, ambientFromDiffuse, meshes);
+	setupSystems();
+	setShadowRenderMode(SHADOW_RENDER_VERTEX_LAYER);
 }
 
+Scene::Scene(SceneCache & cache, bool ambientFromDiffuse, const std::vector<Mesh *> & meshes)
+{
+	loadScene(cache, ambientFromDiffuse, meshes);
+	setupSystems();
+	setShadowRenderMode(SHADOW_RENDER_VERTEX_LAYER);
+}
 
 Scene::~Scene()
 {
-	models.clear();
+	delete scheduler;
+	commands.clear();
+	delete cameraUBO;
+	delete lightUBO;
+	delete pointLightBuffer;
+	delete clusterBuffer;
+	delete clusterLightsBuffer;
+
+	// Destroy the entities first, since they return their components to the pools.
+	entities.clear();
+	for (unsigned int i = 0; i < MAX_COMPONENT_TYPES; i++) {
+		delete componentPools[i];
+		componentPools[i] = NULL;
+	}
+
+	for (Camera * c : cameras)
+		delete c;
 	cameras.clear();
+	for (Light * l : lights)
+		delete l;
 	lights.clear();
+	// Meshes are shared by the PolygonModels, so they are deleted after the entities.
+	for (Mesh * m : meshes)
+		delete m;
+	meshes.clear();
 	delete matManager;
 }
 
-void Scene::loadScene(const aiScene * scene)
+void Scene::loadScene(const aiScene * scene, bool ambientFromDiffuse, const std::vector<Mesh *> & meshes)
 {
 	// Load cameras:
 	if (scene->HasCameras())
@@ -47,38 +96,35 @@ void Scene::loadScene(const aiScene * scene)
 	if (scene->HasMaterials()) {
 		for (unsigned int i = 0; i < scene->mNumMaterials; i++)
 		{
-			matManager->loadFromAiMaterial(scene->mMaterials[i]);
+			if (ambientFromDiffuse) matManager->loadFromAiMaterial(scene->mMaterials[i], true);
+			else matManager->loadFromAiMaterial(scene->mMaterials[i]);
 		}
 	}
 
-	// Load meshes:
+	// Load meshes (uploaded once, shared by all nodes referencing them):
+	unsigned int meshOffset = this->meshes.size();
 	if (scene->HasMeshes()) {
+		this->meshes.reserve(this->meshes.size() + scene->mNumMeshes);
 		for (unsigned int i = 0; i < scene->mNumMeshes; i++)
 		{
-			Material * mat = matManager->getMaterial("default");
-			if (scene->HasMaterials())
-				 mat = matManager->getMaterial(scene->mMaterials[scene->mMeshes[i]->mMaterialIndex]->GetName().C_Str());
-
-			Entity3D * entity = new Entity3D();
-			entity->addComponent(new PolygonModel(scene->mMeshes[i], mat));
-			models.push_back(entity);
+			this->meshes.push_back(i < meshes.size() ? meshes[i] : new Mesh(scene->mMeshes[i]));
 		}
+		printOptimizationStats(meshOffset);
 	}
-	processNode(scene->mRootNode);
 
+	// Load the node hierarchy:
+	if (scene->mRootNode) processNode(scene, scene->mRootNode, NULL, meshOffset);
 }
 
-void Scene::loadScene(const aiScene * scene, bool ambientFromDiffuse)
+void Scene::loadScene(SceneCache & cache, bool ambientFromDiffuse, const std::vector<Mesh *> & meshes)
 {
-	if (!ambientFromDiffuse) {
-		loadScene(scene);
-		return;
-	}
 	// Load cameras:
-	if (scene->HasCameras())
-		for (unsigned int i = 0; i < scene->mNumCameras; i++)
+	if (cache.getNumCameras() > 0)
+		for (unsigned int i = 0; i < cache.getNumCameras(); i++)
 		{
-			cameras.push_back(loadCamera(scene->mCameras[i]));
+			aiCamera cam;
+			cache.getCamera(i, cam);
+			cameras.push_back(loadCamera(&cam));
 		}
 	else {
 		cameras.push_back(new Camera());
@@ -89,27 +135,74 @@ void Scene::loadScene(const aiScene * scene, bool ambientFromDiffuse)
 	if (!matManager) {
 		matManager = new MaterialManager();
 	}
-	if (scene->HasMaterials()) {
-		for (unsigned int i = 0; i < scene->mNumMaterials; i++)
-		{
-			matManager->loadFromAiMaterial(scene->mMaterials[i], true);
-		}
+	for (unsigned int i = 0; i < cache.getNumMaterials(); i++)
+	{
+		aiMaterial * mat = cache.createMaterial(i);
+		if (ambientFromDiffuse) matManager->loadFromAiMaterial(mat, true);
+		else matManager->loadFromAiMaterial(mat);
+		delete mat;
 	}
 
 	// Load meshes:
-	if (scene->HasMeshes()) {
-		for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+	unsigned int meshOffset = this->meshes.size();
+	if (cache.getNumMeshes() > 0) {
+		this->meshes.reserve(this->meshes.size() + cache.getNumMeshes());
+		for (unsigned int i = 0; i < cache.getNumMeshes(); i++)
 		{
+			this->meshes.push_back(i < meshes.size() ? meshes[i] : new Mesh(cache, i));
+		}
+		printOptimizationStats(meshOffset);
+	}
+
+	// Load the node hierarchy (every parent precedes its children):
+	std::vector<Transform3D *> transforms(cache.getNumNodes(), NULL);
+	for (unsigned int i = 0; i < cache.getNumNodes(); i++) {
+		const SceneCacheNode & node = cache.getNode(i);
+		glm::fmat4 transformNode;
+		for (int c = 0; c < 4; c++) {
+			for (int r = 0; r < 4; r++) {
+				transformNode[c][r] = node.transform[c * 4 + r];
+			}
+		}
+
+		EntityHandle h = createEntity3D();
+		Entity3D * entity = entities.get(h);
+		entity->setName(cache.getString(node.name));
+		entity->getTransform()->setParent(node.parent == SCENE_CACHE_NONE ? NULL : transforms[node.parent], false);
+		entity->getTransform()->setTransform(transformNode);
+		transforms[i] = entity->getTransform();
+
+		const unsigned int * nodeMeshes = cache.getNodeMeshes(node);
+		for (unsigned int j = 0; j < node.numMeshes; j++) {
+			unsigned int meshIndex = nodeMeshes[j];
+			unsigned int material = cache.getMesh(meshIndex).material;
 			Material * mat = matManager->getMaterial("default");
-			if (scene->HasMaterials())
-				mat = matManager->getMaterial(scene->mMaterials[scene->mMeshes[i]->mMaterialIndex]->GetName().C_Str());
+			if (material != SCENE_CACHE_NONE)
+				mat = matManager->getMaterial(cache.getString(cache.getMaterial(material).name));
 
-			Entity3D * entity = new Entity3D();
-			entity->addComponent(new PolygonModel(scene->mMeshes[i], mat));
-			models.push_back(entity);
+			addComponent<PolygonModel>(h, this->meshes[meshOffset + meshIndex], mat);
 		}
 	}
-	processNode(scene->mRootNode);
+}
+
+void Scene::printOptimizationStats(unsigned int firstMesh)
+{
+	// Averages over all triangles (ACMR) and vertices (ATVR) of the optimized meshes:
+	double triangles = 0.0, vertices = 0.0;
+	double acmrBefore = 0.0, acmrAfter = 0.0, atvrBefore = 0.0, atvrAfter = 0.0;
+	for (unsigned int i = firstMesh; i < meshes.size(); i++) {
+		const MeshOptimizationStats & stats = meshes[i]->getOptimizationStats();
+		triangles += stats.triangles;
+		vertices += stats.vertices;
+		acmrBefore += stats.acmrBefore * stats.triangles;
+		acmrAfter += stats.acmrAfter * stats.triangles;
+		atvrBefore += stats.atvrBefore * stats.vertices;
+		atvrAfter += stats.atvrAfter * stats.vertices;
+	}
+	if (triangles == 0.0 || vertices == 0.0) return;
+	std::cout << "Mesh optimization (" << (unsigned long long)triangles << " triangles): ACMR "
+		<< acmrBefore / triangles << " -> " << acmrAfter / triangles << ", ATVR "
+		<< atvrBefore / vertices << " -> " << atvrAfter / vertices << std::endl;
 }
 
 MaterialManager * Scene::getMaterialManager()
@@ -119,27 +212,68 @@ MaterialManager * Scene::getMaterialManager()
 
 int Scene::getNumEntities()
 {
-	return models.size();
+	return entities.size();
 }
 
-unsigned int Scene::addEntity3D(Entity3D * e)
+Entity3D * Scene::getEntity3D(unsigned int i)
 {
-	if (PolygonModel * m = e->getComponent<PolygonModel>()) {
-		if (m->getMaterial()->getShader()) {
-			matManager->addMaterial(m->getMaterial());
-			m->setMaterialUnique(false);
-		}
-		else {
-			m->setMaterial(matManager->getMaterial("default"));
-		}
-	}
-	models.push_back(e);
-	return models.size() - 1;
+	return entities.at(i);
 }
 
-Entity3D * Scene::getEntity3D(unsigned int i)
+Entity3D * Scene::getEntity3D(EntityHandle h)
+{
+	return entities.get(h);
+}
+
+EntityHandle Scene::createEntity3D()
+{
+	EntityHandle h = entities.create();
+	entities.get(h)->setHandle(h);
+	for (std::function<void(Scene *, EntityHandle)> & callback : entityCreatedCallbacks)
+		callback(this, h);
+	return h;
+}
+
+void Scene::destroyEntity3D(EntityHandle h)
 {
-	return models.at(i);
+	if (!entities.isAlive(h)) return;
+	for (std::function<void(Scene *, EntityHandle)> & callback : entityDestroyedCallbacks)
+		callback(this, h);
+	entities.destroy(h);
+}
+
+EntityHandle Scene::addEntity3D(Entity3D * e)
+{
+	if (e == NULL) return EntityHandle();
+
+	EntityHandle h = createEntity3D();
+	Entity3D * entity = entities.get(h);
+	// Take the place of e in the hierarchy. The entity pool never moves its entities, so the
+	// transformation stays a valid parent.
+	Transform3D * source = e->getTransform();
+	Transform3D * target = entity->getTransform();
+	target->setParent(source->getParent(), false);
+	target->setTransformGlobal(source->getTransform());
+	std::vector<Transform3D *> children = source->getChildren();
+	for (Transform3D * child : children)
+		child->setParent(target, true);
+
+	while (e->getNumComponents() > 0) {
+		Component * c = e->removeComponent((unsigned int) 0);
+		if (c->getTypeID() == ComponentType::get<PolygonModel>()) {
+			PolygonModel * m = static_cast<PolygonModel*>(c);
+			if (m->getMaterial()->getShader()) {
+				matManager->addMaterial(m->getMaterial());
+				m->setMaterialUnique(false);
+			}
+			else {
+				m->setMaterial(matManager->getMaterial("default"));
+			}
+		}
+		entity->addComponent(c);
+	}
+	delete e;
+	return h;
 }
 
 int Scene::getNumCameras()
@@ -192,77 +326,343 @@ unsigned int Scene::addCamera(Camera * c)
 	return(cameras.size() - 1);
 }
 
-unsigned int Scene::addMesh(PolygonModel * mesh)
+EntityHandle Scene::addMesh(PolygonModel * mesh)
 {
-	Entity3D * entity = new Entity3D();
-	entity->addComponent(mesh);
-	models.push_back(entity);
-	return(models.size() - 1);
+	EntityHandle h = createEntity3D();
+	entities.get(h)->addComponent(mesh);
+	return h;
+}
+
+unsigned int Scene::addMesh(Mesh * mesh)
+{
+	meshes.push_back(mesh);
+	return (meshes.size() - 1);
+}
+
+int Scene::getNumMeshes()
+{
+	return meshes.size();
+}
+
+Mesh * Scene::getMesh(unsigned int i)
+{
+	if (i >= meshes.size()) return NULL;
+	return meshes[i];
 }
 
 unsigned int Scene::addLight(Light * light)
 {
 	lights.push_back(light);
+	if (PointLight * p = dynamic_cast<PointLight *>(light)) pointLights.push_back(p);
 	return (lights.size() - 1);
 }
 
+void Scene::addEntityCreatedCallback(std::function<void(Scene*, EntityHandle)> callback)
+{
+	entityCreatedCallbacks.push_back(callback);
+}
+
+void Scene::addEntityDestroyedCallback(std::function<void(Scene*, EntityHandle)> callback)
+{
+	entityDestroyedCallbacks.push_back(callback);
+}
+
+void Scene::update(double delta)
+{
+	scheduler->run(this, delta);
+	flushCommands();
+}
+
+SystemScheduler * Scene::getSystemScheduler()
+{
+	return scheduler;
+}
+
+CommandBuffer * Scene::getCommandBuffer()
+{
+	return &commands;
+}
+
+void Scene::flushCommands()
+{
+	scheduler->flushCommands(this);
+	commands.execute(this);
+}
+
 void Scene::draw()
 {
+	// Code outside of the scene may have changed bindings without GLState.
+	GLState::invalidate();
+
+	if (cameraUBO == NULL) {
+		cameraUBO = new UniformBuffer(CAMERA_BLOCK_BINDING, sizeof(CameraBlock));
+		lightUBO = new UniformBuffer(LIGHT_BLOCK_BINDING, sizeof(LightBlock));
+		pointLightBuffer = new TextureBuffer(GL_RGBA32F);
+		clusterBuffer = new TextureBuffer(GL_RG32UI);
+		clusterLightsBuffer = new TextureBuffer(GL_R32UI);
+	}
+
+	// Upload the camera data once for all shaders:
+	CameraBlock cameraBlock;
+	cameras[activeCamera]->writeUniformBlock(cameraBlock);
+	cameraUBO->update(&cameraBlock, sizeof(CameraBlock));
+	// Shaders that do not use the camera uniform block still need their uniforms set.
 	matManager->updateShaders(cameras[activeCamera]);
 
+	// Collect and sort the draws of this frame:
+	glm::fvec3 cameraPos = cameraBlock.cameraPos;
+	Shader * depthShader = matManager->getShader("depthShader");
+	renderQueue.clear();
+	shadowCasters.clear();
+	cullModels.clear();
+	// Pixels per unit of bounding sphere radius at distance 1, for the LOD selection:
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	float lodScale = cameraBlock.projection[1][1] * viewport[3] * 0.5f;
+	for (unsigned int i = 0; i < entities.size(); i++) {
+		for (PolygonModel * model : entities.at(i)->getComponents<PolygonModel>()) {
+			if (model->getMesh() == NULL) continue;
+			// Also for models outside of the view, since they may still cast shadows.
+			BoundingSphere sphere = model->getWorldBoundingSphere();
+			float distance = glm::max(glm::length(sphere.center - cameraPos), 0.001f);
+			model->updateLod(sphere.radius * lodScale / distance, lodPixelError, lodHysteresis, lodShadowBias);
+
+			cullModels.push_back(model);
+			if (model->castsShadows()) shadowCasters.add(model);
+		}
+	}
+
+	Frustum frustum(cameraBlock.projection * cameraBlock.view);
+	cullModelsAgainst(frustum);
+	nVisibleModels = 0;
+	for (unsigned int i = 0; i < cullModels.size(); i++) {
+		if (!cullVisible[i]) continue;
+		Transform3D * tf = cullModels[i]->getTransform();
+		float depth = tf ? glm::length(tf->getPositionGlobal() - cameraPos) : 0.0f;
+		renderQueue.add(cullModels[i], depth);
+		nVisibleModels++;
+	}
+	nCulledModels = cullModels.size() - nVisibleModels;
+	renderStats.visibleObjects += nVisibleModels;
+	renderStats.culledObjects += nCulledModels;
+	renderQueue.sort();
 
 	// Calculate shadows
-	for (unsigned int i = 0; i < lights.size(); i++)
-		if (lights[i]->castsShadows()) lights[i]->drawShadows(this, matManager->getShader("depthShader"));
-
-	// Configure all shaders correctly
-	for (std::map<std::string, Shader *>::iterator it = matManager->getShaders()->begin(); it != matManager->getShaders()->end(); it++) {
-		unsigned int nPointLights = 0;
-		unsigned int nDirLights = 0;
-		for (Light * l : lights) {
-
-			if (dynamic_cast<PointLight*>(l)) {
-				l->configureShader((*it).second, nPointLights);
-				nPointLights++;
-			}
-			else if (dynamic_cast<DirectionalLight*>(l)) {
-				l->configureShader((*it).second, nDirLights);
-				nDirLights++;
-			}
-		}
-		(*it).second->setInt("nPointLights", nPointLights);
-		(*it).second->setInt("nDirLights", nDirLights);
+	shadowTimer.begin();
+	pointShadows.beginFrame();
+	for (unsigned int i = 0; i < lights.size(); i++) {
+		Light * light = lights[(firstShadowLight + i) % lights.size()];
+		if (light->castsShadows()) light->drawShadows(this, depthShader);
+	}
+	firstShadowLight = lights.empty() ? 0 : (firstShadowLight + 1) % lights.size();
+	shadowTimer.end();
+	for (double ms = shadowTimer.getResult(); ms >= 0.0; ms = shadowTimer.getResult()) {
+		renderStats.shadowGpuTime += ms;
+		renderStats.shadowGpuSamples++;
 	}
 
+	// Upload the light data once for all shaders:
+	lightBlock.nPointLights = 0;
+	lightBlock.nDirLights = 0;
+	for (Light * l : lights)
+		l->writeUniformBlock(lightBlock);
+	assignLights(cameraBlock);
+	lightUBO->update(&lightBlock, sizeof(LightBlock));
+	GLState::bindTexture(POINT_SHADOW_MAP_TEXTURE_UNIT, pointShadows.getTarget(), pointShadows.getTexture());
+	GLState::bindTexture(POINT_LIGHT_DATA_TEXTURE_UNIT, GL_TEXTURE_BUFFER, pointLightBuffer->getTexture());
+	GLState::bindTexture(CLUSTER_TEXTURE_UNIT, GL_TEXTURE_BUFFER, clusterBuffer->getTexture());
+	GLState::bindTexture(CLUSTER_LIGHTS_TEXTURE_UNIT, GL_TEXTURE_BUFFER, clusterLightsBuffer->getTexture());
+
 	// Finally, draw the entities
-	for (Entity3D * entity : models) {
-		entity->draw();
+	renderQueue.draw();
+}
+
+ShadowCasterList * Scene::getShadowCasters()
+{
+	return &shadowCasters;
+}
+
+PointShadowArray * Scene::getPointShadows()
+{
+	return &pointShadows;
+}
+
+void Scene::setFrustumCulling(bool enabled)
+{
+	frustumCulling = enabled;
+}
+
+bool Scene::getFrustumCulling()
+{
+	return frustumCulling;
+}
+
+void Scene::setHierarchicalCulling(bool enabled)
+{
+	hierarchicalCulling = enabled;
+}
+
+bool Scene::getHierarchicalCulling()
+{
+	return hierarchicalCulling;
+}
+
+unsigned int Scene::getNumVisibleModels()
+{
+	return nVisibleModels;
+}
+
+unsigned int Scene::getNumCulledModels()
+{
+	return nCulledModels;
+}
+
+void Scene::setShadowRenderMode(ShadowRenderMode mode)
+{
+	while (mode != SHADOW_RENDER_MULTI_PASS && !isShadowRenderModeSupported(mode))
+		mode = (ShadowRenderMode)(mode - 1);
+	shadowRenderMode = mode;
+}
+
+ShadowRenderMode Scene::getShadowRenderMode()
+{
+	return shadowRenderMode;
+}
+
+void Scene::setLodPixelError(float pixels)
+{
+	lodPixelError = pixels;
+}
+
+float Scene::getLodPixelError()
+{
+	return lodPixelError;
+}
+
+void Scene::setLodHysteresis(float hysteresis)
+{
+	lodHysteresis = glm::clamp(hysteresis, 0.0f, 1.0f);
+}
+
+float Scene::getLodHysteresis()
+{
+	return lodHysteresis;
+}
+
+void Scene::setLodShadowBias(unsigned int levels)
+{
+	lodShadowBias = levels;
+}
+
+unsigned int Scene::getLodShadowBias()
+{
+	return lodShadowBias;
+}
+
+bool Scene::isShadowRenderModeSupported(ShadowRenderMode mode)
+{
+	if (mode == SHADOW_RENDER_MULTI_PASS) return true;
+	return getLayeredDepthShader(mode) != NULL;
+}
+
+Shader * Scene::getLayeredDepthShader()
+{
+	return getLayeredDepthShader(shadowRenderMode);
+}
+
+Shader * Scene::getLayeredDepthShader(ShadowRenderMode mode)
+{
+	std::string name;
+	if (mode == SHADOW_RENDER_GEOMETRY_SHADER) name = "depthShaderLayered";
+	else if (mode == SHADOW_RENDER_VERTEX_LAYER) name = "depthShaderVertexLayer";
+	else return NULL;
+
+	// Not an error: the shader is only created if the driver supports it.
+	std::map<std::string, Shader *> * shaders = matManager->getShaders();
+	auto it = shaders->find(name);
+	if (it == shaders->end() || !it->second->isLinked()) return NULL;
+	return it->second;
+}
+
+void Scene::assignLights(const CameraBlock & cameraBlock)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	unsigned int n = pointLights.size();
+	pointLightData.resize(n);
+	lightX.resize(n);
+	lightY.resize(n);
+	lightZ.resize(n);
+	lightRadius.resize(n);
+	for (unsigned int i = 0; i < n; i++) {
+		pointLights[i]->writeLightData(pointLightData[i]);
+		glm::fvec4 viewPos = cameraBlock.view * glm::fvec4(pointLightData[i].pos, 1.0f);
+		lightX[i] = viewPos.x;
+		lightY[i] = viewPos.y;
+		lightZ[i] = viewPos.z;
+		lightRadius[i] = pointLightData[i].range;
 	}
+
+	Camera * camera = cameras[activeCamera];
+	clusterer.setProjection(cameraBlock.projection, camera->getNearPlane(), camera->getFarPlane());
+	if (n > 0) clusterer.assign(&lightX[0], &lightY[0], &lightZ[0], &lightRadius[0], n, scheduler->getThreadPool());
+	else clusterer.assign(NULL, NULL, NULL, NULL, 0);
+	lightBlock.clusterSliceScale = clusterer.getSliceScale();
+	lightBlock.clusterSliceBias = clusterer.getSliceBias();
+
+	const std::vector<unsigned int> & clusters = clusterer.getClusters();
+	const std::vector<unsigned int> & indices = clusterer.getIndices();
+	pointLightBuffer->update(n ? &pointLightData[0] : NULL, n * sizeof(PointLightData));
+	clusterBuffer->update(&clusters[0], clusters.size() * sizeof(unsigned int));
+	clusterLightsBuffer->update(indices.empty() ? NULL : &indices[0], indices.size() * sizeof(unsigned int));
+
+	renderStats.clusterLightIndices += indices.size();
+	renderStats.lightAssignmentTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
 }
 
-void Scene::processNode(aiNode * node, glm::fmat4 transformParent)
+void Scene::cullModelsAgainst(const Frustum & frustum)
 {
-	Entity3D * model = NULL;
-	glm::fmat4 transformNode;
-	for (int i = 0; i < 4; i++) {
-		for (int j = 0; j < 4; j++) {
-			transformNode[i][j] = node->mTransformation[j][i];
-		}
+	unsigned int n = cullModels.size();
+	cullVisible.resize(n);
+	if (!frustumCulling) {
+		std::fill(cullVisible.begin(), cullVisible.end(), 1);
+		return;
 	}
 
-	for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-		model = models[node->mMeshes[i]];
-		model->getTransform()->setTransformGlobal(transformParent * transformNode);
+	if (hierarchicalCulling) {
+		cullBoxes.resize(n);
+		for (unsigned int i = 0; i < n; i++)
+			cullBoxes[i] = cullModels[i]->getWorldBounds();
+		if (cullModels != bvhModels) {
+			bvh.build(cullBoxes);
+			bvhModels = cullModels;
+		}
+		else bvh.refit(cullBoxes);
+
+		cullResult.clear();
+		bvh.cull(frustum, cullResult);
+		std::fill(cullVisible.begin(), cullVisible.end(), 0);
+		for (unsigned int i : cullResult)
+			cullVisible[i] = 1;
+		return;
 	}
-	for (unsigned int i = 0; i < node->mNumChildren; i++) {
-		if (model) processNode(node->mChildren[i], model->getTransform());
-		else processNode(node->mChildren[i], transformParent * transformNode);
+
+	cullX.resize(n);
+	cullY.resize(n);
+	cullZ.resize(n);
+	cullRadius.resize(n);
+	for (unsigned int i = 0; i < n; i++) {
+		BoundingSphere sphere = cullModels[i]->getWorldBoundingSphere();
+		cullX[i] = sphere.center.x;
+		cullY[i] = sphere.center.y;
+		cullZ[i] = sphere.center.z;
+		cullRadius[i] = sphere.radius;
 	}
+	if (n > 0) frustum.cullSpheres(&cullX[0], &cullY[0], &cullZ[0], &cullRadius[0], n, &cullVisible[0]);
 }
 
-void Scene::processNode(aiNode * node, Transform3D * parent)
+EntityHandle Scene::processNode(const aiScene * scene, aiNode * node, Transform3D * parent, unsigned int meshOffset)
 {
-	Entity3D * model = NULL;
 	glm::fmat4 transformNode;
 	for (int i = 0; i < 4; i++) {
 		for (int j = 0; j < 4; j++) {
@@ -270,16 +670,38 @@ void Scene::processNode(aiNode * node, Transform3D * parent)
 		}
 	}
 
+	EntityHandle h = createEntity3D();
+	Entity3D * entity = entities.get(h);
+	entity->setName(node->mName.C_Str());
+	entity->getTransform()->setParent(parent, false);
+	entity->getTransform()->setTransform(transformNode);
+
 	for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-		model = models[i];
-		model->getTransform();
-		model->getTransform()->setParent(parent);
-		model->getTransform()->setTransform(transformNode);
+		unsigned int meshIndex = node->mMeshes[i];
+		Material * mat = matManager->getMaterial("default");
+		if (scene->HasMaterials())
+			mat = matManager->getMaterial(scene->mMaterials[scene->mMeshes[meshIndex]->mMaterialIndex]->GetName().C_Str());
+
+		addComponent<PolygonModel>(h, meshes[meshOffset + meshIndex], mat);
 	}
+
+	// The entity pool never moves its entities, so the transformation stays a valid parent.
 	for (unsigned int i = 0; i < node->mNumChildren; i++) {
-		if (model) processNode(node->mChildren[i], model->getTransform());
-		else processNode(node->mChildren[i], parent->getTransform() * transformNode);
+		processNode(scene, node->mChildren[i], entity->getTransform(), meshOffset);
 	}
+	return h;
+}
+
+void Scene::setupSystems()
+{
+	scheduler = new SystemScheduler();
+
+	// Default systems. Further systems (modifiers, animation, culling, ...) can be
+	// registered via getSystemScheduler()->addSystem().
+	scheduler->addSystem(new ComponentSystem<Rigidbody>("physics"));
+
+	// The render queue builds its instance data and draw commands on the same workers.
+	renderQueue.setThreadPool(scheduler->getThreadPool());
 }
 
 Camera * Scene::loadCamera(aiCamera * cam)
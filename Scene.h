@@ -12,6 +12,23 @@
 #include "Light.h"
 #include "Camera.h"
 #include "Entity3D.h"
+#include "Pool.h"
+#include "ComponentType.h"
+#include "CommandBuffer.h"
+#include "UniformBuffer.h"
+#include "RenderQueue.h"
+#include "Frustum.h"
+#include "BoundingVolumeHierarchy.h"
+#include "ShadowCasterList.h"
+#include "GpuTimer.h"
+#include "PointShadowArray.h"
+#include "LightClusterer.h"
+#include "TextureBuffer.h"
+
+#include <functional>
+
+class SystemScheduler;
+class SceneCache;
 
 class Scene
 {
@@ -19,16 +36,50 @@ public:
 	Scene();
 	Scene(const aiScene * scene);
 	Scene(const aiScene * scene, bool ambientFromDiffuse);
+	Scene(const aiScene * scene, bool ambientFromDiffuse, const std::vector<Mesh *> & meshes);
+	Scene(SceneCache & cache, bool ambientFromDiffuse, const std::vector<Mesh *> & meshes);
 	~Scene();
 
-	void loadScene(const aiScene * scene);
-	void loadScene(const aiScene * scene, bool ambientFromDiffuse);
+	// Import an aiScene. Every aiNode becomes an entity whose transformation is parented to
+	// the entity of its parent node. Every aiMesh becomes a shared Mesh, and every reference
+	// of a node to a mesh becomes a PolygonModel instance on the node's entity.
+	// If meshes is not empty, it holds the Meshes converted beforehand (one per aiMesh, in
+	// order, e.g. by AsyncSceneLoader), and the scene takes ownership of them.
+	void loadScene(const aiScene * scene, bool ambientFromDiffuse = false, const std::vector<Mesh *> & meshes = std::vector<Mesh *>());
+	// Load a scene baked into a SceneCache, with the same result as loading its source.
+	// Meshes not passed in are created from the cache, so it has to stay open until they
+	// are uploaded.
+	void loadScene(SceneCache & cache, bool ambientFromDiffuse = false, const std::vector<Mesh *> & meshes = std::vector<Mesh *>());
 
 	MaterialManager * getMaterialManager();
 
+	// Returns the number of entities in the scene.
 	int getNumEntities();
-	unsigned int addEntity3D(Entity3D * e);
+	// Returns the i-th entity (0 <= i < getNumEntities()). The order of the entities changes
+	// whenever an entity is destroyed, so only use this for iterating.
 	Entity3D * getEntity3D(unsigned int i);
+	// Returns the entity referred to by the handle, or NULL if it was destroyed.
+	Entity3D * getEntity3D(EntityHandle h);
+
+	// Create an empty entity in the scene's entity pool and return its handle.
+	EntityHandle createEntity3D();
+	// Destroy an entity and all of its components. Stale handles are ignored.
+	void destroyEntity3D(EntityHandle h);
+	// Move the components and the transformation of an entity allocated with new into a
+	// new pooled entity, which also takes over its parent and children. The passed entity
+	// is deleted afterwards.
+	EntityHandle addEntity3D(Entity3D * e);
+
+	// Construct a component of type T in the scene's component pool for T and attach it to
+	// the entity. Returns NULL if the entity does not exist.
+	template <typename T, typename... Args>
+	T * addComponent(EntityHandle e, Args&&... args);
+	// Returns the component of type T referred to by the handle, or NULL if it was destroyed.
+	template <typename T>
+	T * getComponent(ComponentHandle h);
+	// Returns the pool in which the scene stores components of type T.
+	template <typename T>
+	Pool<T> * getComponentPool();
 
 	int getNumCameras();
 	unsigned int getActiveCameraIndex();
@@ -37,23 +88,179 @@ public:
 	void setActiveCamera(unsigned int i);
 	void setActiveCamera(Camera * c);
 	
+	// Add a camera. The scene takes ownership of the camera.
 	unsigned int addCamera(Camera * c);
-	unsigned int addMesh(PolygonModel * mesh);
+	// Create an entity holding the mesh. The scene takes ownership of the mesh.
+	EntityHandle addMesh(PolygonModel * mesh);
+	// Add a mesh that can be shared by several PolygonModels. The scene takes ownership of
+	// the mesh.
+	unsigned int addMesh(Mesh * mesh);
+	int getNumMeshes();
+	Mesh * getMesh(unsigned int i);
+	// Add a light. The scene takes ownership of the light.
 	unsigned int addLight(Light * light);
 
+	// Register a function that is called whenever an entity has been created.
+	void addEntityCreatedCallback(std::function<void(Scene *, EntityHandle)> callback);
+	// Register a function that is called whenever an entity is about to be destroyed.
+	void addEntityDestroyedCallback(std::function<void(Scene *, EntityHandle)> callback);
+
+	// Run all Systems of the scene's SystemScheduler for one frame, then flush all
+	// recorded commands.
+	void update(double delta);
+	SystemScheduler * getSystemScheduler();
+
+	// Command buffer for deferred changes made from the main thread (e.g. while iterating
+	// over the entities). Systems use their own command buffers instead.
+	CommandBuffer * getCommandBuffer();
+	// Sync point: apply the commands recorded by the Systems (in registration order) and
+	// then the commands of the scene's own command buffer.
+	void flushCommands();
+
 	void draw();
 
+	// Returns the list of all shadow casters. It is built once at the beginning of draw()
+	// and culled by the lights against each of their shadow maps.
+	ShadowCasterList * getShadowCasters();
+	// Returns the shadow maps of the point lights (including their per-frame update budget).
+	PointShadowArray * getPointShadows();
+
+	// Skip PolygonModels outside of the active camera's view frustum (enabled by default).
+	// Shadow casters are still drawn into the shadow maps.
+	void setFrustumCulling(bool enabled);
+	bool getFrustumCulling();
+	// Cull with a bounding volume hierarchy over the models' world space boxes instead of
+	// testing every bounding sphere (disabled by default). Pays off for large scenes where
+	// most objects are outside the frustum. The hierarchy is only rebuilt when models are
+	// added, removed or change visibility; moving models just update its bounds.
+	void setHierarchicalCulling(bool enabled);
+	bool getHierarchicalCulling();
+	// Number of PolygonModels drawn and culled in the last call of draw().
+	unsigned int getNumVisibleModels();
+	unsigned int getNumCulledModels();
+
+	// How directional lights render the layers of their shadow maps. Unsupported modes fall
+	// back to the next simpler one; by default the fastest supported mode is used.
+	void setShadowRenderMode(ShadowRenderMode mode);
+	ShadowRenderMode getShadowRenderMode();
+	bool isShadowRenderModeSupported(ShadowRenderMode mode);
+	// Returns the depth shader of the current single pass mode, or NULL in multi-pass mode.
+	Shader * getLayeredDepthShader();
+
+	// Largest error in pixels that the LOD selection accepts (1 by default; 0 always draws
+	// the full meshes), the relative margin needed to switch to a coarser LOD, and how many
+	// levels coarser shadow casters are drawn than the camera would see them.
+	void setLodPixelError(float pixels);
+	float getLodPixelError();
+	void setLodHysteresis(float hysteresis);
+	float getLodHysteresis();
+	void setLodShadowBias(unsigned int levels);
+	unsigned int getLodShadowBias();
+
 private:
 	unsigned int activeCamera;
 
-	std::vector<Entity3D *> models;
+	Pool<Entity3D> entities;
+	// Component pools, indexed by ComponentTypeID.
+	PoolBase * componentPools[MAX_COMPONENT_TYPES] = {};
 	std::vector<Camera *> cameras;
 	std::vector<Light *> lights;
+	std::vector<Mesh *> meshes;
+
+	MaterialManager * matManager = NULL;
+	SystemScheduler * scheduler = NULL;
+	CommandBuffer commands;
+
+	// Per-frame data shared by all shaders, uploaded once per frame in draw().
+	UniformBuffer * cameraUBO = NULL;
+	UniformBuffer * lightUBO = NULL;
+	LightBlock lightBlock;
 
-	MaterialManager * matManager;
-	void processNode(aiNode * node, glm::fmat4 transformParent = glm::fmat4(1.0f));
-	void processNode(aiNode * node, Transform3D * parent);
+	// Clustered point lights. The lights' data and the clusters' light lists are uploaded
+	// to buffer textures every frame.
+	std::vector<PointLight *> pointLights;
+	LightClusterer clusterer;
+	std::vector<PointLightData> pointLightData;
+	std::vector<float> lightX, lightY, lightZ, lightRadius;
+	TextureBuffer * pointLightBuffer = NULL;
+	TextureBuffer * clusterBuffer = NULL;
+	TextureBuffer * clusterLightsBuffer = NULL;
+	// Assign the point lights to the clusters of the active camera and upload them.
+	void assignLights(const CameraBlock & cameraBlock);
+
+	// Draws of the current frame, rebuilt and sorted in draw().
+	RenderQueue renderQueue;
+	ShadowCasterList shadowCasters;
+
+	// Frustum culling. The candidates' bounds are packed into arrays that are reused
+	// every frame. The hierarchy is built when the candidates change and refitted to their
+	// bounds in the other frames.
+	bool frustumCulling = true;
+	bool hierarchicalCulling = false;
+	unsigned int nVisibleModels = 0;
+	unsigned int nCulledModels = 0;
+	BoundingVolumeHierarchy bvh;
+	// Candidates the hierarchy was built for.
+	std::vector<PolygonModel *> bvhModels;
+	std::vector<PolygonModel *> cullModels;
+	std::vector<float> cullX, cullY, cullZ, cullRadius;
+	std::vector<unsigned char> cullVisible;
+	std::vector<AABB> cullBoxes;
+	std::vector<unsigned int> cullResult;
+	// Set cullVisible for all models in cullModels.
+	void cullModelsAgainst(const Frustum & frustum);
+
+	float lodPixelError = 1.0f;
+	float lodHysteresis = 0.25f;
+	unsigned int lodShadowBias = 1;
+
+	ShadowRenderMode shadowRenderMode = SHADOW_RENDER_MULTI_PASS;
+	GpuTimer shadowTimer;
+	PointShadowArray pointShadows;
+	// The lights draw their shadows starting at a different light every frame, so lights
+	// deferred by the point shadow budget are not always the same.
+	unsigned int firstShadowLight = 0;
+	// Returns the depth shader of a single pass mode, or NULL if it is not available.
+	Shader * getLayeredDepthShader(ShadowRenderMode mode);
+
+	std::vector<std::function<void(Scene *, EntityHandle)>> entityCreatedCallbacks;
+	std::vector<std::function<void(Scene *, EntityHandle)>> entityDestroyedCallbacks;
+
+	void setupSystems();
+	// Create the entity of an aiNode and its children. meshOffset is the index of the
+	// aiScene's first mesh in the scene's mesh list.
+	EntityHandle processNode(const aiScene * scene, aiNode * node, Transform3D * parent, unsigned int meshOffset);
+	// Print the vertex cache statistics of the meshes optimized on import, starting at firstMesh.
+	void printOptimizationStats(unsigned int firstMesh);
 
 	Camera * loadCamera(aiCamera * cam);
 };
 
+template<typename T, typename ...Args>
+inline T * Scene::addComponent(EntityHandle e, Args && ...args)
+{
+	Entity3D * entity = entities.get(e);
+	if (entity == NULL) return NULL;
+
+	Pool<T> * pool = getComponentPool<T>();
+	ComponentHandle h = pool->create(std::forward<Args>(args)...);
+	T * c = pool->get(h);
+	c->setPool(pool, h);
+	entity->addComponent(c);
+	return c;
+}
+
+template<typename T>
+inline T * Scene::getComponent(ComponentHandle h)
+{
+	return getComponentPool<T>()->get(h);
+}
+
+template<typename T>
+inline Pool<T> * Scene::getComponentPool()
+{
+	ComponentTypeID id = ComponentType::get<T>();
+	if (componentPools[id] == NULL)
+		componentPools[id] = new Pool<T>();
+	return static_cast<Pool<T> *>(componentPools[id]);
+}
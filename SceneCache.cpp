@@ -0,0 +1,392 @@
+#include "SceneCache.h"
+#include "Utils.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+	// Texture types in the order of SceneCacheMaterial::textures.
+	const aiTextureType textureTypes[SCENE_CACHE_TEXTURES] = { aiTextureType_AMBIENT, aiTextureType_DIFFUSE, aiTextureType_SPECULAR, aiTextureType_NORMALS, aiTextureType_HEIGHT };
+
+	// Builds the file in memory.
+	struct Writer {
+		std::vector<unsigned char> data;
+		std::vector<char> strings;
+
+		// Reserve size bytes at an aligned offset and return the offset.
+		unsigned long long reserve(size_t size)
+		{
+			size_t offset = (data.size() + SCENE_CACHE_ALIGNMENT - 1) / SCENE_CACHE_ALIGNMENT * SCENE_CACHE_ALIGNMENT;
+			data.resize(offset + size);
+			return offset;
+		}
+
+		unsigned long long append(const void * src, size_t size)
+		{
+			unsigned long long offset = reserve(size);
+			if (size > 0) memcpy(&data[offset], src, size);
+			return offset;
+		}
+
+		unsigned int addString(const char * s)
+		{
+			unsigned int offset = strings.size();
+			strings.insert(strings.end(), s, s + strlen(s) + 1);
+			return offset;
+		}
+	};
+
+	void addNode(Writer & writer, const aiNode * node, unsigned int parent, std::vector<SceneCacheNode> & nodes, std::vector<unsigned int> & nodeMeshes)
+	{
+		SceneCacheNode n;
+		n.name = writer.addString(node->mName.C_Str());
+		n.parent = parent;
+		n.firstMesh = nodeMeshes.size();
+		n.numMeshes = node->mNumMeshes;
+		// aiMatrix4x4 is row-major.
+		for (int i = 0; i < 4; i++) {
+			for (int j = 0; j < 4; j++)
+				n.transform[i * 4 + j] = node->mTransformation[j][i];
+		}
+		nodeMeshes.insert(nodeMeshes.end(), node->mMeshes, node->mMeshes + node->mNumMeshes);
+
+		unsigned int index = nodes.size();
+		nodes.push_back(n);
+		for (unsigned int i = 0; i < node->mNumChildren; i++)
+			addNode(writer, node->mChildren[i], index, nodes, nodeMeshes);
+	}
+}
+
+SceneCache::SceneCache()
+{
+}
+
+SceneCache::~SceneCache()
+{
+	close();
+}
+
+std::string SceneCache::getCachePath(const std::string & source)
+{
+	return source + SCENE_CACHE_EXTENSION;
+}
+
+unsigned long long SceneCache::hashFile(const std::string & path)
+{
+	MappedFile f;
+	if (!f.open(path)) return 0;
+	return Utils::HashFNV1a(f.getData(), f.getSize());
+}
+
+unsigned long long SceneCache::hashSettings(unsigned int flags, bool ambientFromDiffuse)
+{
+	const VertexLayout & layout = Mesh::getDefaultVertexLayout();
+	unsigned int settings[] = {
+		flags, ambientFromDiffuse, layout.isPacked(), (unsigned int)layout.getPositionFormat(), layout.hasColors(),
+		layout.getStride(), Mesh::getOptimizeOnImport(), Mesh::getBuildLodsOnImport(), MESH_MAX_LODS
+	};
+	unsigned long long hash = Utils::HashFNV1a(settings, sizeof(settings));
+	float lodMaxError = MESH_LOD_MAX_ERROR;
+	return Utils::HashFNV1a(&lodMaxError, sizeof(float), hash);
+}
+
+bool SceneCache::bake(const std::string & path, const aiScene * scene, const std::vector<Mesh *> & meshes,
+	unsigned long long sourceHash, unsigned long long settingsHash)
+{
+	if (meshes.size() != scene->mNumMeshes) {
+		std::cerr << "SceneCache.cpp: ERROR when baking " << path << ". The meshes do not match the scene." << std::endl;
+		return false;
+	}
+
+	Writer writer;
+	writer.addString("");
+	SceneCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SCENE_CACHE_MAGIC, sizeof(header.magic));
+	header.version = SCENE_CACHE_VERSION;
+	header.headerSize = sizeof(SceneCacheHeader);
+	header.sourceHash = sourceHash;
+	header.settingsHash = settingsHash;
+	writer.reserve(sizeof(SceneCacheHeader));
+
+	// Meshes (value-initialized, which zeroes them including their padding):
+	std::vector<SceneCacheMesh> meshRecords(meshes.size());
+	header.numMeshes = meshes.size();
+	header.meshes = writer.reserve(meshes.size() * sizeof(SceneCacheMesh));
+	std::vector<unsigned char> vertexData, indexData;
+	for (unsigned int i = 0; i < meshes.size(); i++) {
+		Mesh * mesh = meshes[i];
+		SceneCacheMesh & m = meshRecords[i];
+		GLenum indexType = mesh->getEncodedData(vertexData, indexData);
+		m.name = writer.addString(mesh->getName().c_str());
+		m.material = scene->HasMaterials() ? scene->mMeshes[i]->mMaterialIndex : SCENE_CACHE_NONE;
+		m.vertexCount = mesh->getNumVertices();
+		m.indexCount = mesh->getNumIndices();
+		m.indexType = indexType;
+		unsigned int indexSize = m.indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+		m.lodIndexCount = indexData.size() / indexSize - m.indexCount;
+		m.numLods = mesh->getNumLods() - 1;
+		m.encodedVertexBytes = vertexData.size();
+		m.encodedIndexBytes = indexData.size();
+		if (m.vertexCount > 0) m.vertices = writer.append(&mesh->getVertices()[0], m.vertexCount * sizeof(Vertex));
+		// Meshes without triangles are not encoded.
+		if (!vertexData.empty()) m.encodedVertices = writer.append(&vertexData[0], vertexData.size());
+		if (!indexData.empty()) m.encodedIndices = writer.append(&indexData[0], indexData.size());
+		m.lods = writer.reserve(m.numLods * sizeof(MeshLod));
+		for (unsigned int l = 0; l < m.numLods; l++) {
+			MeshLod lod = mesh->getLod(l + 1);
+			memcpy(&writer.data[m.lods + l * sizeof(MeshLod)], &lod, sizeof(MeshLod));
+		}
+		m.bounds = mesh->getBounds();
+		m.boundingSphere = mesh->getBoundingSphere();
+		m.optimizationStats = mesh->getOptimizationStats();
+	}
+	if (!meshRecords.empty()) memcpy(&writer.data[header.meshes], &meshRecords[0], meshRecords.size() * sizeof(SceneCacheMesh));
+
+	// Materials:
+	std::vector<SceneCacheMaterial> materials(scene->mNumMaterials);
+	for (unsigned int i = 0; i < scene->mNumMaterials; i++) {
+		aiMaterial * mat = scene->mMaterials[i];
+		SceneCacheMaterial & m = materials[i];
+		memset(&m, 0, sizeof(m));
+		m.name = writer.addString(mat->GetName().C_Str());
+		aiColor3D color;
+		if (mat->Get(AI_MATKEY_COLOR_AMBIENT, color) == AI_SUCCESS) {
+			m.flags |= SCENE_CACHE_MATERIAL_AMBIENT;
+			m.ambient[0] = color.r; m.ambient[1] = color.g; m.ambient[2] = color.b;
+		}
+		if (mat->Get(AI_MATKEY_COLOR_DIFFUSE, color) == AI_SUCCESS) {
+			m.flags |= SCENE_CACHE_MATERIAL_DIFFUSE;
+			m.diffuse[0] = color.r; m.diffuse[1] = color.g; m.diffuse[2] = color.b;
+		}
+		if (mat->Get(AI_MATKEY_COLOR_SPECULAR, color) == AI_SUCCESS) {
+			m.flags |= SCENE_CACHE_MATERIAL_SPECULAR;
+			m.specular[0] = color.r; m.specular[1] = color.g; m.specular[2] = color.b;
+		}
+		if (mat->Get(AI_MATKEY_SHININESS, m.shininess) == AI_SUCCESS)
+			m.flags |= SCENE_CACHE_MATERIAL_SHININESS;
+		for (unsigned int t = 0; t < SCENE_CACHE_TEXTURES; t++) {
+			m.textures[t] = SCENE_CACHE_NONE;
+			if (mat->GetTextureCount(textureTypes[t]) == 0) continue;
+			aiString str;
+			mat->GetTexture(textureTypes[t], 0, &str);
+			m.textures[t] = writer.addString(str.C_Str());
+		}
+	}
+	header.numMaterials = materials.size();
+	if (!materials.empty()) header.materials = writer.append(&materials[0], materials.size() * sizeof(SceneCacheMaterial));
+
+	// Nodes:
+	std::vector<SceneCacheNode> nodes;
+	std::vector<unsigned int> nodeMeshes;
+	if (scene->mRootNode) addNode(writer, scene->mRootNode, SCENE_CACHE_NONE, nodes, nodeMeshes);
+	header.numNodes = nodes.size();
+	if (!nodes.empty()) header.nodes = writer.append(&nodes[0], nodes.size() * sizeof(SceneCacheNode));
+	header.numNodeMeshes = nodeMeshes.size();
+	if (!nodeMeshes.empty()) header.nodeMeshes = writer.append(&nodeMeshes[0], nodeMeshes.size() * sizeof(unsigned int));
+
+	// Cameras:
+	std::vector<SceneCacheCamera> cameras(scene->mNumCameras);
+	for (unsigned int i = 0; i < scene->mNumCameras; i++) {
+		const aiCamera * cam = scene->mCameras[i];
+		SceneCacheCamera & c = cameras[i];
+		memset(&c, 0, sizeof(c));
+		memcpy(c.position, &cam->mPosition, sizeof(c.position));
+		memcpy(c.lookAt, &cam->mLookAt, sizeof(c.lookAt));
+		memcpy(c.up, &cam->mUp, sizeof(c.up));
+		c.horizontalFOV = cam->mHorizontalFOV;
+		c.aspect = cam->mAspect;
+		c.clipNear = cam->mClipPlaneNear;
+		c.clipFar = cam->mClipPlaneFar;
+	}
+	header.numCameras = cameras.size();
+	if (!cameras.empty()) header.cameras = writer.append(&cameras[0], cameras.size() * sizeof(SceneCacheCamera));
+
+	header.stringsSize = writer.strings.size();
+	header.strings = writer.append(&writer.strings[0], writer.strings.size());
+	header.fileSize = writer.data.size();
+	memcpy(&writer.data[0], &header, sizeof(header));
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write((const char *)&writer.data[0], writer.data.size());
+	if (!out) {
+		std::cerr << "SceneCache.cpp: ERROR when writing " << path << "." << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool SceneCache::open(const std::string & path, unsigned long long sourceHash, unsigned long long settingsHash)
+{
+	close();
+	if (!file.open(path)) return false;
+	if (file.getSize() < sizeof(SceneCacheHeader)) {
+		close();
+		return false;
+	}
+	header = (const SceneCacheHeader *)file.getData();
+	if (memcmp(header->magic, SCENE_CACHE_MAGIC, sizeof(header->magic)) != 0 || header->version != SCENE_CACHE_VERSION
+		|| header->headerSize != sizeof(SceneCacheHeader) || header->sourceHash != sourceHash
+		|| header->settingsHash != settingsHash || !validate()) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool SceneCache::contains(unsigned long long offset, unsigned long long size)
+{
+	return offset <= file.getSize() && size <= file.getSize() - offset;
+}
+
+bool SceneCache::validate()
+{
+	// A file cut short, e.g. by a crash while baking, has the wrong size.
+	if (header->fileSize != file.getSize()) return false;
+	if (!contains(header->meshes, (unsigned long long)header->numMeshes * sizeof(SceneCacheMesh))
+		|| !contains(header->materials, (unsigned long long)header->numMaterials * sizeof(SceneCacheMaterial))
+		|| !contains(header->nodes, (unsigned long long)header->numNodes * sizeof(SceneCacheNode))
+		|| !contains(header->cameras, (unsigned long long)header->numCameras * sizeof(SceneCacheCamera))
+		|| !contains(header->nodeMeshes, (unsigned long long)header->numNodeMeshes * sizeof(unsigned int))
+		|| !contains(header->strings, header->stringsSize) || header->stringsSize == 0
+		|| *getString(header->stringsSize - 1) != '\0') {
+		return false;
+	}
+	for (unsigned int i = 0; i < header->numMeshes; i++) {
+		const SceneCacheMesh & m = getMesh(i);
+		if (!contains(m.vertices, (unsigned long long)m.vertexCount * sizeof(Vertex))
+			|| !contains(m.encodedVertices, m.encodedVertexBytes) || !contains(m.encodedIndices, m.encodedIndexBytes)
+			|| !contains(m.lods, (unsigned long long)m.numLods * sizeof(MeshLod)) || m.name >= header->stringsSize
+			|| (m.material != SCENE_CACHE_NONE && m.material >= header->numMaterials)) {
+			return false;
+		}
+		// Mesh reads the indices of all LODs from the encoded blob.
+		if (m.indexType != GL_UNSIGNED_SHORT && m.indexType != GL_UNSIGNED_INT) return false;
+		unsigned long long indexSize = m.indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+		if (((unsigned long long)m.indexCount + m.lodIndexCount) * indexSize != m.encodedIndexBytes) return false;
+		// The LODs are drawn straight from their ranges.
+		const MeshLod * lods = (const MeshLod *)getData(m.lods);
+		for (unsigned int l = 0; l < m.numLods; l++) {
+			if ((unsigned long long)lods[l].firstIndex + lods[l].indexCount > (unsigned long long)m.indexCount + m.lodIndexCount) return false;
+		}
+	}
+	for (unsigned int i = 0; i < header->numMaterials; i++) {
+		const SceneCacheMaterial & m = getMaterial(i);
+		if (m.name >= header->stringsSize) return false;
+		for (unsigned int t = 0; t < SCENE_CACHE_TEXTURES; t++) {
+			if (m.textures[t] != SCENE_CACHE_NONE && m.textures[t] >= header->stringsSize) return false;
+		}
+	}
+	const unsigned int * nodeMeshes = (const unsigned int *)getData(header->nodeMeshes);
+	for (unsigned int i = 0; i < header->numNodeMeshes; i++) {
+		if (nodeMeshes[i] >= header->numMeshes) return false;
+	}
+	for (unsigned int i = 0; i < header->numNodes; i++) {
+		const SceneCacheNode & n = getNode(i);
+		if ((unsigned long long)n.firstMesh + n.numMeshes > header->numNodeMeshes || n.name >= header->stringsSize) return false;
+		if (n.parent != SCENE_CACHE_NONE && n.parent >= i) return false;
+	}
+	return true;
+}
+
+void SceneCache::close()
+{
+	file.close();
+	header = NULL;
+}
+
+bool SceneCache::isOpen()
+{
+	return header != NULL;
+}
+
+unsigned int SceneCache::getNumMeshes()
+{
+	return header->numMeshes;
+}
+
+unsigned int SceneCache::getNumMaterials()
+{
+	return header->numMaterials;
+}
+
+unsigned int SceneCache::getNumNodes()
+{
+	return header->numNodes;
+}
+
+unsigned int SceneCache::getNumCameras()
+{
+	return header->numCameras;
+}
+
+const SceneCacheMesh & SceneCache::getMesh(unsigned int i)
+{
+	return ((const SceneCacheMesh *)getData(header->meshes))[i];
+}
+
+const SceneCacheMaterial & SceneCache::getMaterial(unsigned int i)
+{
+	return ((const SceneCacheMaterial *)getData(header->materials))[i];
+}
+
+const SceneCacheNode & SceneCache::getNode(unsigned int i)
+{
+	return ((const SceneCacheNode *)getData(header->nodes))[i];
+}
+
+const unsigned int * SceneCache::getNodeMeshes(const SceneCacheNode & node)
+{
+	return (const unsigned int *)getData(header->nodeMeshes) + node.firstMesh;
+}
+
+const char * SceneCache::getString(unsigned int offset)
+{
+	return (const char *)getData(header->strings) + offset;
+}
+
+const void * SceneCache::getData(unsigned long long offset)
+{
+	return file.getData() + offset;
+}
+
+aiMaterial * SceneCache::createMaterial(unsigned int i)
+{
+	const SceneCacheMaterial & m = getMaterial(i);
+	aiMaterial * mat = new aiMaterial();
+	aiString name(getString(m.name));
+	mat->AddProperty(&name, AI_MATKEY_NAME);
+	if (m.flags & SCENE_CACHE_MATERIAL_AMBIENT) {
+		aiColor3D color(m.ambient[0], m.ambient[1], m.ambient[2]);
+		mat->AddProperty(&color, 1, AI_MATKEY_COLOR_AMBIENT);
+	}
+	if (m.flags & SCENE_CACHE_MATERIAL_DIFFUSE) {
+		aiColor3D color(m.diffuse[0], m.diffuse[1], m.diffuse[2]);
+		mat->AddProperty(&color, 1, AI_MATKEY_COLOR_DIFFUSE);
+	}
+	if (m.flags & SCENE_CACHE_MATERIAL_SPECULAR) {
+		aiColor3D color(m.specular[0], m.specular[1], m.specular[2]);
+		mat->AddProperty(&color, 1, AI_MATKEY_COLOR_SPECULAR);
+	}
+	if (m.flags & SCENE_CACHE_MATERIAL_SHININESS)
+		mat->AddProperty(&m.shininess, 1, AI_MATKEY_SHININESS);
+	for (unsigned int t = 0; t < SCENE_CACHE_TEXTURES; t++) {
+		if (m.textures[t] == SCENE_CACHE_NONE) continue;
+		aiString path(getString(m.textures[t]));
+		mat->AddProperty(&path, AI_MATKEY_TEXTURE(textureTypes[t], 0));
+	}
+	return mat;
+}
+
+void SceneCache::getCamera(unsigned int i, aiCamera & camera)
+{
+	const SceneCacheCamera & c = ((const SceneCacheCamera *)getData(header->cameras))[i];
+	camera.mPosition = aiVector3D(c.position[0], c.position[1], c.position[2]);
+	camera.mLookAt = aiVector3D(c.lookAt[0], c.lookAt[1], c.lookAt[2]);
+	camera.mUp = aiVector3D(c.up[0], c.up[1], c.up[2]);
+	camera.mHorizontalFOV = c.horizontalFOV;
+	camera.mAspect = c.aspect;
+	camera.mClipPlaneNear = c.clipNear;
+	camera.mClipPlaneFar = c.clipFar;
+}
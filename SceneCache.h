@@ -0,0 +1,169 @@
+#pragma once
+
+#include "assimp\scene.h"
+
+#include "MappedFile.h"
+#include "Mesh.h"
+
+#include <string>
+#include <vector>
+
+// Identification of the file format. Files of other versions are rebaked.
+#define SCENE_CACHE_MAGIC "OGLSCENE"
+#define SCENE_CACHE_VERSION 1
+// Alignment of all tables and blobs in the file in bytes.
+#define SCENE_CACHE_ALIGNMENT 16
+// Appended to the path of the source file to get the path of its cache.
+#define SCENE_CACHE_EXTENSION ".bake"
+// Index or string offset that refers to nothing.
+#define SCENE_CACHE_NONE 0xFFFFFFFFu
+
+// Textures of a material, in the order of SceneCacheMaterial::textures.
+#define SCENE_CACHE_TEXTURES 5
+// Properties present in a material (SceneCacheMaterial::flags).
+#define SCENE_CACHE_MATERIAL_AMBIENT 1
+#define SCENE_CACHE_MATERIAL_DIFFUSE 2
+#define SCENE_CACHE_MATERIAL_SPECULAR 4
+#define SCENE_CACHE_MATERIAL_SHININESS 8
+
+// Records of the file. Offsets are in bytes from the start of the file, strings are offsets
+// into the string table (NUL terminated).
+struct SceneCacheHeader {
+	char magic[8];
+	unsigned int version;
+	unsigned int headerSize;
+	unsigned long long fileSize;
+	// Hashes of the source file and of the import settings (see SceneCache::hashSettings()).
+	unsigned long long sourceHash;
+	unsigned long long settingsHash;
+	unsigned int numMeshes;
+	unsigned int numMaterials;
+	unsigned int numNodes;
+	unsigned int numCameras;
+	unsigned int numNodeMeshes;
+	unsigned int stringsSize;
+	unsigned long long meshes;
+	unsigned long long materials;
+	unsigned long long nodes;
+	unsigned long long cameras;
+	unsigned long long nodeMeshes;
+	unsigned long long strings;
+};
+
+// A mesh as converted by Mesh (optimized, with its LODs). The encoded blobs are exactly the
+// contents of its buffers, so they are uploaded without touching them.
+struct SceneCacheMesh {
+	unsigned int name;
+	unsigned int material;
+	unsigned int vertexCount;
+	// Indices of the full mesh, and of all further LODs.
+	unsigned int indexCount;
+	unsigned int lodIndexCount;
+	unsigned int numLods;
+	unsigned int indexType;
+	unsigned int encodedVertexBytes;
+	unsigned int encodedIndexBytes;
+	unsigned int padding;
+	// Vertex[vertexCount] in full precision, kept on the CPU.
+	unsigned long long vertices;
+	// The vertices encoded with the vertex layout, relative to bounds.
+	unsigned long long encodedVertices;
+	// The indices of the full mesh followed by the LODs, of indexType.
+	unsigned long long encodedIndices;
+	// MeshLod[numLods] of the levels 1 and up.
+	unsigned long long lods;
+	AABB bounds;
+	BoundingSphere boundingSphere;
+	MeshOptimizationStats optimizationStats;
+};
+
+// The properties of an aiMaterial used by Material.
+struct SceneCacheMaterial {
+	unsigned int name;
+	unsigned int flags;
+	float ambient[3];
+	float diffuse[3];
+	float specular[3];
+	float shininess;
+	// Paths of the ambient, diffuse, specular, normal and height textures as in the source.
+	unsigned int textures[SCENE_CACHE_TEXTURES];
+};
+
+// The nodes are stored depth first, so every parent precedes its children.
+struct SceneCacheNode {
+	unsigned int name;
+	unsigned int parent;
+	// Range of the node's mesh indices in the node mesh table.
+	unsigned int firstMesh;
+	unsigned int numMeshes;
+	// Column-major, like glm.
+	float transform[16];
+};
+
+struct SceneCacheCamera {
+	float position[3];
+	float lookAt[3];
+	float up[3];
+	float horizontalFOV;
+	float aspect;
+	float clipNear;
+	float clipFar;
+};
+
+// Baked version of an imported scene: meshes with their vertex and index data ready to
+// upload, and tables of the materials, nodes and cameras. The file is mapped (see
+// MappedFile) and used in place, without parsing; Mesh uploads the blobs straight from the
+// mapping. A cache is only valid for the source file and import settings it was baked
+// from, which are identified by hashes stored in the header.
+class SceneCache
+{
+public:
+	SceneCache();
+	~SceneCache();
+
+	// Path of the cache of a source file.
+	static std::string getCachePath(const std::string & source);
+	// 64-bit FNV-1a hash of the file's contents, or 0 if it cannot be read.
+	static unsigned long long hashFile(const std::string & path);
+	// Hash of everything besides the source the baked data depends on: the assimp
+	// post-processing flags, ambientFromDiffuse (see Scene::loadScene()), and the default
+	// vertex layout, optimization and LOD settings of Mesh.
+	static unsigned long long hashSettings(unsigned int flags, bool ambientFromDiffuse);
+	// Write the scene and its converted meshes (one per aiMesh, in order) to path.
+	static bool bake(const std::string & path, const aiScene * scene, const std::vector<Mesh *> & meshes,
+		unsigned long long sourceHash, unsigned long long settingsHash);
+
+	// Map the cache at path. Fails if it does not exist, was written by another version,
+	// is damaged, or does not match the hashes.
+	bool open(const std::string & path, unsigned long long sourceHash, unsigned long long settingsHash);
+	// Unmap the file. Meshes created from the cache must have been uploaded before.
+	void close();
+	bool isOpen();
+
+	unsigned int getNumMeshes();
+	unsigned int getNumMaterials();
+	unsigned int getNumNodes();
+	unsigned int getNumCameras();
+	const SceneCacheMesh & getMesh(unsigned int i);
+	const SceneCacheMaterial & getMaterial(unsigned int i);
+	const SceneCacheNode & getNode(unsigned int i);
+	// Indices of the meshes of a node.
+	const unsigned int * getNodeMeshes(const SceneCacheNode & node);
+	const char * getString(unsigned int offset);
+	// Pointer into the mapped file.
+	const void * getData(unsigned long long offset);
+
+	// An aiMaterial with the stored properties (to be deleted by the caller), so materials
+	// are created exactly like from the source (see MaterialManager::loadFromAiMaterial()).
+	aiMaterial * createMaterial(unsigned int i);
+	// Fill an aiCamera with the stored properties (see Scene::loadCamera()).
+	void getCamera(unsigned int i, aiCamera & camera);
+
+private:
+	MappedFile file;
+	const SceneCacheHeader * header = NULL;
+
+	// Whether the size bytes at offset lie within the file.
+	bool contains(unsigned long long offset, unsigned long long size);
+	bool validate();
+};
@@ -9,16 +9,80 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <unordered_map>
+
+#include "RenderStats.h"
+#include "GLState.h"
 
 /* 
  * This is the Shader.h file as provided by the excellent OpenGL tutorial at learnopengl.com, barring some minor modifications. 
  */
 
 
+// Binding points of the uniform blocks shared by all shaders.
+#define CAMERA_BLOCK_BINDING 0
+#define LIGHT_BLOCK_BINDING 1
+
+// Texture units of the material textures and of the directional lights' shadow maps
+// ("dLightShadowMap[i]" uses SHADOW_MAP_TEXTURE_UNIT + i), followed by the point lights'
+// shadow array ("pLightShadowMap", after the MAX_NUM_DIR_LIGHTS shadow maps) and the buffer
+// textures of the clustered point lights ("pLightData", "clusters" and "clusterLights").
+#define MATERIAL_TEXTURE_UNIT 0
+#define SHADOW_MAP_TEXTURE_UNIT 5
+#define POINT_SHADOW_MAP_TEXTURE_UNIT 9
+#define POINT_LIGHT_DATA_TEXTURE_UNIT 10
+#define CLUSTER_TEXTURE_UNIT 11
+#define CLUSTER_LIGHTS_TEXTURE_UNIT 12
+
+// Handle of a uniform of type T in a specific shader program. Setting a uniform via its
+// handle requires neither a string nor a lookup. Handles of inactive uniforms are invalid,
+// setting them does nothing.
+template <typename T>
+struct Uniform {
+	GLint location = -1;
+
+	bool isValid() const { return location >= 0; }
+};
+
+// Handles of the uniforms used by most shaders of the engine. They are resolved once when
+// the program is linked.
+struct ShaderUniforms {
+	Uniform<glm::mat4> model;
+	// True if the model matrix is read from the per-instance attributes instead of model.
+	Uniform<bool> instanced;
+	Uniform<glm::mat4> view;
+	Uniform<glm::mat4> projection;
+	Uniform<glm::mat4> projectionView;
+	// Projection * view matrices of the layers of layered (single pass) shadow map shaders.
+	Uniform<glm::mat4> layerProjectionView;
+	// Bit i is set if layer i of a layered shadow map shader is drawn, and the texture layer
+	// the shader's first layer is written to.
+	Uniform<int> layerMask;
+	Uniform<int> layerOffset;
+	Uniform<glm::vec3> cameraPos;
+	Uniform<int> nPointLights;
+	Uniform<int> nDirLights;
+
+	Uniform<int> matTexAmbient;
+	Uniform<int> matTexDiffuse;
+	Uniform<int> matTexSpecular;
+	Uniform<int> matNormalMap;
+	Uniform<int> matParallaxMap;
+	Uniform<glm::vec3> matAmbientColor;
+	Uniform<glm::vec3> matDiffuseColor;
+	Uniform<glm::vec3> matSpecularColor;
+	Uniform<float> matSpecularIntensity;
+	Uniform<bool> matNormalMapping;
+	Uniform<bool> matParallaxMapping;
+};
+
 class Shader
 {
 public:
 	unsigned int ID;
+	// Handles of the common uniforms of this program.
+	ShaderUniforms uniforms;
 	// constructor generates the shader on the fly
 	// ------------------------------------------------------------------------
 	Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
@@ -95,6 +159,11 @@ public:
 			glAttachShader(ID, geometry);
 		glLinkProgram(ID);
 		checkCompileErrors(ID, "PROGRAM");
+		GLint linkStatus;
+		glGetProgramiv(ID, GL_LINK_STATUS, &linkStatus);
+		linked = linkStatus == GL_TRUE;
+		cacheUniformLocations();
+		setupBindings();
 		// delete the shaders as they're linked into our program now and no longer necessery
 		glDeleteShader(vertex);
 		glDeleteShader(fragment);
@@ -102,73 +171,250 @@ public:
 			glDeleteShader(geometry);
 
 	}
-	// activate the shader
+	// activate the shader (skipped if it is already active)
 	// ------------------------------------------------------------------------
 	void use()
 	{
-		glUseProgram(ID);
+		GLState::useProgram(ID);
+	}
+	// Returns whether the program was compiled and linked successfully.
+	bool isLinked() const
+	{
+		return linked;
+	}
+	// Returns the location of a uniform, or -1 if the program has no active uniform of
+	// that name. The locations are cached at link time, so this does not query GL.
+	GLint getUniformLocation(const std::string &name) const
+	{
+		renderStats.uniformLookups++;
+		std::unordered_map<std::string, GLint>::const_iterator it = uniformLocations.find(name);
+		if (it == uniformLocations.end()) return -1;
+		return it->second;
+	}
+	// Returns a handle of the uniform. Resolve handles once and keep them for hot code.
+	template <typename T>
+	Uniform<T> getUniform(const std::string &name) const
+	{
+		Uniform<T> u;
+		u.location = getUniformLocation(name);
+		return u;
+	}
+	// set uniforms by handle (the program has to be in use)
+	// ------------------------------------------------------------------------
+	void set(Uniform<bool> u, bool value) const
+	{
+		if (!u.isValid()) return;
+		glUniform1i(u.location, (int)value);
+		renderStats.uniformUploads++;
+	}
+	void set(Uniform<int> u, int value) const
+	{
+		if (!u.isValid()) return;
+		glUniform1i(u.location, value);
+		renderStats.uniformUploads++;
+	}
+	void set(Uniform<float> u, float value) const
+	{
+		if (!u.isValid()) return;
+		glUniform1f(u.location, value);
+		renderStats.uniformUploads++;
+	}
+	void set(Uniform<glm::vec2> u, const glm::vec2 &value) const
+	{
+		if (!u.isValid()) return;
+		glUniform2fv(u.location, 1, &value[0]);
+		renderStats.uniformUploads++;
+	}
+	void set(Uniform<glm::vec3> u, const glm::vec3 &value) const
+	{
+		if (!u.isValid()) return;
+		glUniform3fv(u.location, 1, &value[0]);
+		renderStats.uniformUploads++;
 	}
-	// utility uniform functions
+	void set(Uniform<glm::vec4> u, const glm::vec4 &value) const
+	{
+		if (!u.isValid()) return;
+		glUniform4fv(u.location, 1, &value[0]);
+		renderStats.uniformUploads++;
+	}
+	void set(Uniform<glm::mat2> u, const glm::mat2 &mat) const
+	{
+		if (!u.isValid()) return;
+		glUniformMatrix2fv(u.location, 1, GL_FALSE, &mat[0][0]);
+		renderStats.uniformUploads++;
+	}
+	void set(Uniform<glm::mat3> u, const glm::mat3 &mat) const
+	{
+		if (!u.isValid()) return;
+		glUniformMatrix3fv(u.location, 1, GL_FALSE, &mat[0][0]);
+		renderStats.uniformUploads++;
+	}
+	void set(Uniform<glm::mat4> u, const glm::mat4 &mat) const
+	{
+		if (!u.isValid()) return;
+		glUniformMatrix4fv(u.location, 1, GL_FALSE, &mat[0][0]);
+		renderStats.uniformUploads++;
+	}
+	// Set count elements of a uniform array (u is the handle of its first element).
+	void set(Uniform<glm::mat4> u, const glm::mat4 * mats, GLsizei count) const
+	{
+		if (!u.isValid()) return;
+		glUniformMatrix4fv(u.location, count, GL_FALSE, &mats[0][0][0]);
+		renderStats.uniformUploads++;
+	}
+	// utility uniform functions (set by name; prefer handles in code that runs every frame)
 	// ------------------------------------------------------------------------
 	void setBool(const std::string &name, bool value) const
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+		set(getUniform<bool>(name), value);
 	}
 	// ------------------------------------------------------------------------
 	void setInt(const std::string &name, int value) const
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+		set(getUniform<int>(name), value);
 	}
 	// ------------------------------------------------------------------------
 	void setFloat(const std::string &name, float value) const
 	{
-		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+		set(getUniform<float>(name), value);
 	}
 	// ------------------------------------------------------------------------
 	void setVec2(const std::string &name, const glm::vec2 &value) const
 	{
-		glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		set(getUniform<glm::vec2>(name), value);
 	}
 	void setVec2(const std::string &name, float x, float y) const
 	{
-		glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+		set(getUniform<glm::vec2>(name), glm::vec2(x, y));
 	}
 	// ------------------------------------------------------------------------
 	void setVec3(const std::string &name, const glm::vec3 &value) const
 	{
-		GLint id = glGetUniformLocation(ID, name.c_str());
-		glUniform3fv(id, 1, &value[0]);
+		set(getUniform<glm::vec3>(name), value);
 	}
 	void setVec3(const std::string &name, float x, float y, float z) const
 	{
-		glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+		set(getUniform<glm::vec3>(name), glm::vec3(x, y, z));
 	}
 	// ------------------------------------------------------------------------
 	void setVec4(const std::string &name, const glm::vec4 &value) const
 	{
-		glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		set(getUniform<glm::vec4>(name), value);
 	}
 	void setVec4(const std::string &name, float x, float y, float z, float w)
 	{
-		glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+		set(getUniform<glm::vec4>(name), glm::vec4(x, y, z, w));
 	}
 	// ------------------------------------------------------------------------
 	void setMat2(const std::string &name, const glm::mat2 &mat) const
 	{
-		glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		set(getUniform<glm::mat2>(name), mat);
 	}
 	// ------------------------------------------------------------------------
 	void setMat3(const std::string &name, const glm::mat3 &mat) const
 	{
-		glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		set(getUniform<glm::mat3>(name), mat);
 	}
 	// ------------------------------------------------------------------------
 	void setMat4(const std::string &name, const glm::mat4 &mat) const
 	{
-		glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		set(getUniform<glm::mat4>(name), mat);
 	}
 
 private:
+	bool linked = false;
+	std::unordered_map<std::string, GLint> uniformLocations;
+
+	// Query the locations of all active uniforms of the linked program. Arrays are reported
+	// by GL as a single uniform "name[0]", so every element is registered separately.
+	// ------------------------------------------------------------------------
+	void cacheUniformLocations()
+	{
+		uniformLocations.clear();
+		GLint count = 0, maxLength = 0;
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+		std::vector<GLchar> buffer(maxLength + 1);
+		for (GLint i = 0; i < count; i++)
+		{
+			GLsizei length = 0;
+			GLint size = 0;
+			GLenum type;
+			glGetActiveUniform(ID, (GLuint)i, maxLength + 1, &length, &size, &type, &buffer[0]);
+			std::string name(&buffer[0], length);
+			GLint location = glGetUniformLocation(ID, name.c_str());
+			renderStats.uniformLocationQueries++;
+			// Members of uniform blocks have no location.
+			if (location < 0) continue;
+			uniformLocations[name] = location;
+
+			if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+			{
+				std::string base = name.substr(0, name.size() - 3);
+				uniformLocations[base] = location;
+				for (GLint j = 1; j < size; j++)
+				{
+					std::string element = base + "[" + std::to_string(j) + "]";
+					GLint elementLocation = glGetUniformLocation(ID, element.c_str());
+					renderStats.uniformLocationQueries++;
+					if (elementLocation >= 0) uniformLocations[element] = elementLocation;
+				}
+			}
+		}
+
+		uniforms.model = getUniform<glm::mat4>("model");
+		uniforms.instanced = getUniform<bool>("instanced");
+		uniforms.view = getUniform<glm::mat4>("view");
+		uniforms.projection = getUniform<glm::mat4>("projection");
+		uniforms.projectionView = getUniform<glm::mat4>("projectionView");
+		uniforms.layerProjectionView = getUniform<glm::mat4>("layerProjectionView");
+		uniforms.layerMask = getUniform<int>("layerMask");
+		uniforms.layerOffset = getUniform<int>("layerOffset");
+		uniforms.cameraPos = getUniform<glm::vec3>("cameraPos");
+		uniforms.nPointLights = getUniform<int>("nPointLights");
+		uniforms.nDirLights = getUniform<int>("nDirLights");
+		uniforms.matTexAmbient = getUniform<int>("mat.texAmbient");
+		uniforms.matTexDiffuse = getUniform<int>("mat.texDiffuse");
+		uniforms.matTexSpecular = getUniform<int>("mat.texSpecular");
+		uniforms.matNormalMap = getUniform<int>("mat.normalMap");
+		uniforms.matParallaxMap = getUniform<int>("mat.parallaxMap");
+		uniforms.matAmbientColor = getUniform<glm::vec3>("mat.ambientColor");
+		uniforms.matDiffuseColor = getUniform<glm::vec3>("mat.diffuseColor");
+		uniforms.matSpecularColor = getUniform<glm::vec3>("mat.specularColor");
+		uniforms.matSpecularIntensity = getUniform<float>("mat.specularIntensity");
+		uniforms.matNormalMapping = getUniform<bool>("mat.normalMapping");
+		uniforms.matParallaxMapping = getUniform<bool>("mat.parallaxMapping");
+	}
+	// Assign the shared uniform blocks to their binding points and the samplers to their
+	// texture units. Both never change, so they are set once after linking.
+	// ------------------------------------------------------------------------
+	void setupBindings()
+	{
+		GLuint cameraBlock = glGetUniformBlockIndex(ID, "CameraBlock");
+		if (cameraBlock != GL_INVALID_INDEX) glUniformBlockBinding(ID, cameraBlock, CAMERA_BLOCK_BINDING);
+		GLuint lightBlock = glGetUniformBlockIndex(ID, "LightBlock");
+		if (lightBlock != GL_INVALID_INDEX) glUniformBlockBinding(ID, lightBlock, LIGHT_BLOCK_BINDING);
+
+		GLint programOld;
+		glGetIntegerv(GL_CURRENT_PROGRAM, &programOld);
+		use();
+		set(uniforms.matTexAmbient, MATERIAL_TEXTURE_UNIT + 0);
+		set(uniforms.matTexDiffuse, MATERIAL_TEXTURE_UNIT + 1);
+		set(uniforms.matTexSpecular, MATERIAL_TEXTURE_UNIT + 2);
+		set(uniforms.matNormalMap, MATERIAL_TEXTURE_UNIT + 3);
+		set(uniforms.matParallaxMap, MATERIAL_TEXTURE_UNIT + 4);
+		for (int i = 0; ; i++)
+		{
+			Uniform<int> shadowMap = getUniform<int>("dLightShadowMap[" + std::to_string(i) + "]");
+			if (!shadowMap.isValid()) break;
+			set(shadowMap, SHADOW_MAP_TEXTURE_UNIT + i);
+		}
+		set(getUniform<int>("pLightShadowMap"), POINT_SHADOW_MAP_TEXTURE_UNIT);
+		set(getUniform<int>("pLightData"), POINT_LIGHT_DATA_TEXTURE_UNIT);
+		set(getUniform<int>("clusters"), CLUSTER_TEXTURE_UNIT);
+		set(getUniform<int>("clusterLights"), CLUSTER_LIGHTS_TEXTURE_UNIT);
+		GLState::useProgram(programOld);
+	}
 	// utility function for checking shader compilation/linking errors.
 	// ------------------------------------------------------------------------
 	void checkCompileErrors(GLuint shader, std::string type)
@@ -5,6 +5,9 @@ layout (location = 2) in vec2 InTexCoord;
 layout (location = 3) in vec4 InColor;
 layout (location = 4) in vec3 InTangent;
 layout (location = 5) in vec3 InBitangent;
+// Decoding of packed vertices (see VertexLayout.h), set per mesh.
+layout (location = 10) in vec4 InPosScale;
+layout (location = 11) in vec3 InPosOffset;
 
 struct PointLight {
 	vec3 pos;
@@ -49,15 +52,24 @@ uniform PointLight pLight[MAX_NUM_POINT_LIGHTS];
 uniform int nDirLights;
 uniform DirectionalLight dLight[MAX_NUM_DIR_LIGHTS];
 
+vec3 octahedralDecode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+	if (n.z < 0.0f) n.xy = (1.0f - abs(e.yx)) * vec2(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+	return normalize(n);
+}
+
 void main()
 {
+	vec3 pos = InPos * InPosScale.xyz + InPosOffset;
+	vec3 normal = InPosScale.w > 0.5f ? octahedralDecode(InNormal.xy) : InNormal;
 	TexCoord = vec2(InTexCoord.x, InTexCoord.y);
-	Normal = mat3(transpose(inverse(model))) * InNormal;
-	FragmentPos = vec3(model * vec4(InPos, 1.0f));
+	Normal = mat3(transpose(inverse(model))) * normal;
+	FragmentPos = vec3(model * vec4(pos, 1.0f));
 	Color = InColor;
 	
 	for(int i = 0; i < nDirLights; i++)
 		FragPosLS[i] = dLight[i].lightSpace * vec4(FragmentPos, 1.0f);
 	
-	gl_Position = projection * view * model * vec4(InPos, 1.0f);
+	gl_Position = projection * view * model * vec4(pos, 1.0f);
 }
\ No newline at end of file
@@ -1,11 +1,14 @@
 #version 330 core
 
 layout (location = 0) in vec3 InPos;
+// Decoding of packed vertices (see VertexLayout.h), set per mesh.
+layout (location = 10) in vec4 InPosScale;
+layout (location = 11) in vec3 InPosOffset;
 
 uniform mat4 projectionView;
 uniform mat4 model;
 
 void main()
 {
-	gl_Position = projectionView * model * vec4(InPos, 1.0f);
+	gl_Position = projectionView * model * vec4(InPos * InPosScale.xyz + InPosOffset, 1.0f);
 }
\ No newline at end of file
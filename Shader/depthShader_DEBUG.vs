@@ -1,11 +1,14 @@
 #version 330 core
 layout (location = 0) in vec3 InPos;
 layout (location = 2) in vec2 InTexCoords;
+// Decoding of packed vertices (see VertexLayout.h), set per mesh.
+layout (location = 10) in vec4 InPosScale;
+layout (location = 11) in vec3 InPosOffset;
 
 out vec2 TexCoords;
 
 void main()
 {
     TexCoords = InTexCoords;
-	gl_Position = vec4(InPos, 1.0f);
+	gl_Position = vec4(InPos * InPosScale.xyz + InPosOffset, 1.0f);
 }
\ No newline at end of file
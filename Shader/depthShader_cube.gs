@@ -0,0 +1,45 @@
+#version 330 core
+
+#define NUM_FACES 6
+
+layout (triangles) in;
+// 3 * NUM_FACES
+layout (triangle_strip, max_vertices = 18) out;
+
+// Projection * view matrices of the faces of a point light's shadow cube map. Only the
+// faces in layerMask are drawn, to the layers layerOffset + face.
+uniform mat4 layerProjectionView[NUM_FACES];
+uniform int layerMask;
+uniform int layerOffset;
+
+void main()
+{
+	for(int face = 0; face < NUM_FACES; face++)
+	{
+		if((layerMask & (1 << face)) == 0)
+			continue;
+
+		vec4 p[3];
+		for(int i = 0; i < 3; i++)
+			p[i] = layerProjectionView[face] * gl_in[i].gl_Position;
+
+		// Skip triangles completely outside of the face's frustum (clip space, so the
+		// test also works for vertices behind the light).
+		vec3 x = vec3(p[0].x, p[1].x, p[2].x);
+		vec3 y = vec3(p[0].y, p[1].y, p[2].y);
+		vec3 z = vec3(p[0].z, p[1].z, p[2].z);
+		vec3 w = vec3(p[0].w, p[1].w, p[2].w);
+		if(all(lessThan(x, -w)) || all(greaterThan(x, w))
+			|| all(lessThan(y, -w)) || all(greaterThan(y, w))
+			|| all(lessThan(z, -w)) || all(greaterThan(z, w)))
+			continue;
+
+		for(int i = 0; i < 3; i++)
+		{
+			gl_Layer = layerOffset + face;
+			gl_Position = p[i];
+			EmitVertex();
+		}
+		EndPrimitive();
+	}
+}
@@ -0,0 +1,38 @@
+#version 330 core
+
+#define NUM_SHADOWMAP_LAYERS 3
+
+layout (triangles) in;
+// 3 * NUM_SHADOWMAP_LAYERS
+layout (triangle_strip, max_vertices = 9) out;
+
+uniform mat4 layerProjectionView[NUM_SHADOWMAP_LAYERS];
+
+void main()
+{
+	for(int layer = 0; layer < NUM_SHADOWMAP_LAYERS; layer++)
+	{
+		vec4 p[3];
+		for(int i = 0; i < 3; i++)
+			p[i] = layerProjectionView[layer] * gl_in[i].gl_Position;
+
+		// Skip triangles completely outside of the layer's volume. The near plane is not
+		// tested, since casters in front of it are clamped to it below.
+		vec3 x = vec3(p[0].x, p[1].x, p[2].x);
+		vec3 y = vec3(p[0].y, p[1].y, p[2].y);
+		vec3 z = vec3(p[0].z, p[1].z, p[2].z);
+		if(all(lessThan(x, vec3(-1.0f))) || all(greaterThan(x, vec3(1.0f)))
+			|| all(lessThan(y, vec3(-1.0f))) || all(greaterThan(y, vec3(1.0f)))
+			|| all(greaterThan(z, vec3(1.0f))))
+			continue;
+
+		for(int i = 0; i < 3; i++)
+		{
+			gl_Layer = layer;
+			gl_Position = p[i];
+			if(gl_Position.z < -1) gl_Position.z = -1;
+			EmitVertex();
+		}
+		EndPrimitive();
+	}
+}
@@ -1,12 +1,23 @@
 #version 330 core
 
 layout (location = 0) in vec3 InPos;
+layout (location = 6) in mat4 InInstanceModel;
+// Decoding of packed vertices (see VertexLayout.h), set per mesh.
+layout (location = 10) in vec4 InPosScale;
+layout (location = 11) in vec3 InPosOffset;
+// Decoding of the instance's mesh (see InstanceData), used if instanced is set.
+layout (location = 12) in vec4 InInstancePosScale;
+layout (location = 13) in vec3 InInstancePosOffset;
 
 uniform mat4 projectionView;
 uniform mat4 model;
+uniform bool instanced;
 
 void main()
 {
-	gl_Position = projectionView * model * vec4(InPos, 1.0f);
+	mat4 M = instanced ? InInstanceModel : model;
+	vec4 posScale = instanced ? InInstancePosScale : InPosScale;
+	vec3 posOffset = instanced ? InInstancePosOffset : InPosOffset;
+	gl_Position = projectionView * M * vec4(InPos * posScale.xyz + posOffset, 1.0f);
 	if(gl_Position.z < -1) gl_Position.z = -1;
 }
@@ -0,0 +1,33 @@
+#version 330 core
+// Writing gl_Layer in the vertex shader needs one of these extensions.
+#extension GL_ARB_shader_viewport_layer_array : enable
+#extension GL_AMD_vertex_shader_layer : enable
+
+#define NUM_SHADOWMAP_LAYERS 3
+
+layout (location = 0) in vec3 InPos;
+layout (location = 6) in mat4 InInstanceModel;
+// Decoding of packed vertices (see VertexLayout.h), set per mesh.
+layout (location = 10) in vec4 InPosScale;
+layout (location = 11) in vec3 InPosOffset;
+// Decoding of the instance's mesh (see InstanceData), used if instanced is set.
+layout (location = 12) in vec4 InInstancePosScale;
+layout (location = 13) in vec3 InInstancePosOffset;
+
+uniform mat4 model;
+uniform bool instanced;
+uniform mat4 layerProjectionView[NUM_SHADOWMAP_LAYERS];
+
+void main()
+{
+	// Every object is drawn as NUM_SHADOWMAP_LAYERS instances, one per layer. The instance
+	// attributes only advance every NUM_SHADOWMAP_LAYERS instances.
+	int layer = gl_InstanceID % NUM_SHADOWMAP_LAYERS;
+	mat4 M = instanced ? InInstanceModel : model;
+	vec4 posScale = instanced ? InInstancePosScale : InPosScale;
+	vec3 posOffset = instanced ? InInstancePosOffset : InPosOffset;
+
+	gl_Position = layerProjectionView[layer] * M * vec4(InPos * posScale.xyz + posOffset, 1.0f);
+	if(gl_Position.z < -1) gl_Position.z = -1;
+	gl_Layer = layer;
+}
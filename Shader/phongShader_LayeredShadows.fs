@@ -1,8 +1,13 @@
 #version 330 core
+// Point light shadows are stored in a cube map array if it is supported (see PointShadowArray.h).
+#extension GL_ARB_texture_cube_map_array : enable
 
-#define MAX_NUM_POINT_LIGHTS 16
 #define MAX_NUM_DIR_LIGHTS 4
 #define NUM_SHADOWMAP_LAYERS 3
+// Size of the light cluster grid (see LightClusterer.h).
+#define CLUSTER_GRID_X 16
+#define CLUSTER_GRID_Y 9
+#define CLUSTER_GRID_Z 24
 
 struct Material {
 	vec3 ambientColor;
@@ -21,34 +26,34 @@ struct Material {
 	bool parallaxMapping;
 };
 
+// Point lights are read from pLightData (see getPointLight()).
 struct PointLight {
 	vec3 pos;
-	vec3 color;
 	float intensity;
+	vec3 color;
+	// First layer of the light's six faces in pLightShadowMap, or -1 without shadows.
+	int shadowLayer;
+	float shadowNear;
+	float shadowFar;
+	float range;
 };
 
+// The directional lights are stored in a std140 uniform block, so their layout has to match
+// the struct in Light.h.
+
 struct DirectionalLight {
 	vec3 dir;
-	vec3 color;
 	float intensity;
+	vec3 color;
 	float ambientIntensity;
 
-	int index;
-	
-	#if NUM_SHADOWMAP_LAYERS > 1
-		mat4 lightSpace[NUM_SHADOWMAP_LAYERS];
-	#else
-		mat4 lightSpace;
-	#endif
-	sampler2DArray shadowMap;
-};
+	mat4 lightSpace[NUM_SHADOWMAP_LAYERS];
 
-struct Flashlight {
-	vec3 pos;
-	vec3 dir;
-	vec3 color;
-	float intensity;
-	float ambientIntensity;
+	int index;
+	int castShadows;
+	vec2 texelSize;
+	// View space depth where each layer ends (unused components are very large).
+	vec4 cascadeSplits;
 };
 
 out vec4 FragColor;
@@ -57,35 +62,60 @@ in vec3 FragmentPos;
 in vec3 Normal;
 in vec2 TexCoord;
 in vec4 Color;
-in vec4 FragPosDirLS[MAX_NUM_DIR_LIGHTS * NUM_SHADOWMAP_LAYERS];
 
-uniform vec3 cameraPos;
+layout (std140) uniform CameraBlock {
+	mat4 projection;
+	mat4 view;
+	vec3 cameraPos;
+};
 
-uniform Material mat;
+layout (std140) uniform LightBlock {
+	int nPointLights;
+	int nDirLights;
+	float clusterSliceScale;
+	float clusterSliceBias;
+	DirectionalLight dLight[MAX_NUM_DIR_LIGHTS];
+};
 
-uniform int nPointLights;
-uniform PointLight pLight[MAX_NUM_POINT_LIGHTS];
+uniform Material mat;
 
-uniform int nDirLights;
-uniform DirectionalLight dLight[MAX_NUM_DIR_LIGHTS];
+// Samplers cannot be stored in uniform blocks. The texture units are assigned once when
+// the program is linked.
+uniform sampler2DArray dLightShadowMap[MAX_NUM_DIR_LIGHTS];
+// Faces +X, -X, +Y, -Y, +Z, -Z of all point lights.
+#ifdef GL_ARB_texture_cube_map_array
+uniform samplerCubeArray pLightShadowMap;
+#else
+uniform sampler2DArray pLightShadowMap;
+#endif
+// Point lights (three texels each, see PointLightData in Light.h), the offset and number of
+// the lights of every cluster in clusterLights, and the light indices of all clusters.
+uniform samplerBuffer pLightData;
+uniform usamplerBuffer clusters;
+uniform usamplerBuffer clusterLights;
 
 // Prototypes:
 vec3 calcDirectionalLight(int i, vec3 normal, vec3 fragmentPos, vec3 viewDirection, vec2 texCoord);
+PointLight getPointLight(int i);
+int getCluster(vec3 fragmentPos);
 vec3 calcPointLight(PointLight light, vec3 normal, vec3 fragmentPos, vec3 viewDirection, vec2 texCoord);
 vec3 quantify(vec3 color, int q);
-#if NUM_SHADOWMAP_LAYERS > 1
-float shadow(vec4 fragPosLS[NUM_SHADOWMAP_LAYERS], DirectionalLight light);
-#else
-float shadow(vec4 fragPosLS, DirectionalLight light);
-#endif
+float sampleShadowMap(int light, vec3 coords);
+float shadow(vec3 fragmentPos, int light);
+float pointShadow(vec3 fragmentPos, PointLight light);
 
 void main()
 {
 	vec3 viewDir = normalize(cameraPos - FragmentPos);
 	vec3 result = vec3(0.0f, 0.0f, 0.0f);
 
-	//for(int i = 0; i < nPointLights; i++) 
-	//	result += calcPointLight(pLight[i], Normal, FragmentPos, viewDir, TexCoord); 
+	// Only the point lights of the fragment's cluster can reach it:
+	uvec2 cluster = texelFetch(clusters, getCluster(FragmentPos)).xy;
+	for(uint i = 0u; i < cluster.y; i++)
+	{
+		int light = int(texelFetch(clusterLights, int(cluster.x + i)).r);
+		result += calcPointLight(getPointLight(light), Normal, FragmentPos, viewDir, TexCoord);
+	}
 		
 	for(int i = 0; i < nDirLights; i++)
 		result += calcDirectionalLight(i, Normal, FragmentPos, viewDir, TexCoord);
@@ -110,23 +140,45 @@ vec3 calcDirectionalLight(int i, vec3 normal, vec3 fragmentPos, vec3 viewDirecti
 	vec3 specular = spec * (texture(mat.texSpecular, texCoord).xyz * mat.specularColor * dLight[i].color);
 	
 	// Return sum:
-	#if NUM_SHADOWMAP_LAYERS > 1
-	vec4 fragPosLS[NUM_SHADOWMAP_LAYERS];
-	for(int index = 0; index < NUM_SHADOWMAP_LAYERS; index++){
-		fragPosLS[index] = FragPosDirLS[NUM_SHADOWMAP_LAYERS * i + index];
-	}
-	#else
-	vec4 fragPosLS = FragPosDirLS[i];
-	#endif
-
-	float s = shadow(fragPosLS, dLight[i]);
+	float s = dLight[i].castShadows != 0 ? shadow(fragmentPos, i) : 0.0f;
 	return (ambient + ( 1.0f - s ) * (diffuse + specular));
 }
 
+PointLight getPointLight(int i)
+{
+	vec4 t0 = texelFetch(pLightData, 3 * i);
+	vec4 t1 = texelFetch(pLightData, 3 * i + 1);
+	vec4 t2 = texelFetch(pLightData, 3 * i + 2);
+
+	PointLight light;
+	light.pos = t0.xyz;
+	light.intensity = t0.w;
+	light.color = t1.xyz;
+	light.shadowLayer = floatBitsToInt(t1.w);
+	light.shadowNear = t2.x;
+	light.shadowFar = t2.y;
+	light.range = t2.z;
+	return light;
+}
+
+int getCluster(vec3 fragmentPos)
+{
+	vec4 viewPos = view * vec4(fragmentPos, 1.0f);
+	vec4 clipPos = projection * viewPos;
+	vec2 tile = floor((clipPos.xy / clipPos.w * 0.5f + 0.5f) * vec2(CLUSTER_GRID_X, CLUSTER_GRID_Y));
+	tile = clamp(tile, vec2(0.0f), vec2(CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1));
+	float slice = floor(log(max(-viewPos.z, 1e-6f)) * clusterSliceScale + clusterSliceBias);
+	slice = clamp(slice, 0.0f, CLUSTER_GRID_Z - 1);
+	return int((slice * CLUSTER_GRID_Y + tile.y) * CLUSTER_GRID_X + tile.x);
+}
+
 vec3 calcPointLight(PointLight light, vec3 normal, vec3 fragmentPos, vec3 viewDirection, vec2 texCoord)
 {
-	// Attenuation from light travelling (proportional to distance squared)
-	float attenuation = light.intensity / pow(length(light.pos - fragmentPos), 2);
+	// Attenuation from light travelling (proportional to distance squared), faded out
+	// smoothly towards the light's range:
+	float dist = length(light.pos - fragmentPos);
+	float fade = clamp(1.0f - pow(dist / light.range, 4), 0.0f, 1.0f);
+	float attenuation = light.intensity / (dist * dist) * fade * fade;
 	
 	// Ambient lighting:
 	vec3 ambient = (texture(mat.texAmbient, texCoord).xyz * mat.diffuseColor * light.color) * attenuation;
@@ -141,7 +193,8 @@ vec3 calcPointLight(PointLight light, vec3 normal, vec3 fragmentPos, vec3 viewDi
 	vec3 specular = spec * (texture(mat.texSpecular, texCoord).xyz * mat.specularColor * light.color);
 	
 	// Return sum:
-	return (ambient + (1.0f) * (diffuse + specular));
+	float s = light.shadowLayer >= 0 ? pointShadow(fragmentPos, light) : 0.0f;
+	return (ambient + (1.0f - s) * (diffuse + specular));
 }
 
 vec3 quantify(vec3 color, int q)
@@ -153,42 +206,51 @@ vec3 quantify(vec3 color, int q)
 	return color;
 }
 
-#if NUM_SHADOWMAP_LAYERS > 1
-float shadow(vec4 fragPosLS[NUM_SHADOWMAP_LAYERS], DirectionalLight light)
-#else
-float shadow(vec4 fragPosLS, DirectionalLight light)
-#endif
+// Arrays of samplers may only be indexed with constant expressions in GLSL 3.30.
+float sampleShadowMap(int light, vec3 coords)
+{
+	if(light == 0) return texture(dLightShadowMap[0], coords).r;
+	#if MAX_NUM_DIR_LIGHTS > 1
+	if(light == 1) return texture(dLightShadowMap[1], coords).r;
+	#endif
+	#if MAX_NUM_DIR_LIGHTS > 2
+	if(light == 2) return texture(dLightShadowMap[2], coords).r;
+	#endif
+	#if MAX_NUM_DIR_LIGHTS > 3
+	if(light == 3) return texture(dLightShadowMap[3], coords).r;
+	#endif
+	return 1.0f;
+}
+
+float shadow(vec3 fragmentPos, int light)
 {
 	float eps = 0.0000125f;
 
-	int i = 0;
+	// The layer is the number of splits in front of the fragment.
+	float viewDepth = -(view * vec4(fragmentPos, 1.0f)).z;
+	int i = int(dot(step(dLight[light].cascadeSplits, vec4(viewDepth)), vec4(1.0f)));
+	if(i >= NUM_SHADOWMAP_LAYERS)
+	return 0.0f;
 
-	#if NUM_SHADOWMAP_LAYERS > 1
-	vec3 projCoords = fragPosLS[i].xyz / fragPosLS[i].w;
-	while((abs(projCoords.x) > 1 || abs(projCoords.y) > 1 || abs(projCoords.z) > 1) && i < NUM_SHADOWMAP_LAYERS - 1) {
-		i++;
-		projCoords = fragPosLS[i].xyz / fragPosLS[i].w;
-	}
-	#else
+	vec4 fragPosLS = dLight[light].lightSpace[i] * vec4(fragmentPos, 1.0f);
 	vec3 projCoords = fragPosLS.xyz / fragPosLS.w;
-	#endif
 
 	if(abs(projCoords.x) > 1 || abs(projCoords.y) > 1 || abs(projCoords.z) > 1)
 	return 0.0f;
 
 	projCoords = projCoords * 0.5 + 0.5;
-	float closestDepth = texture(light.shadowMap, vec3(projCoords.xy, i)).r;  
+	float closestDepth = sampleShadowMap(light, vec3(projCoords.xy, i));
 	float currentDepth = projCoords.z;
 	
 	float shadow = 0.0f;
-    vec2 texelSize = 1.0 / textureSize(light.shadowMap, 0).xy;
+    vec2 texelSize = dLight[light].texelSize;
 
 	int vals = 0;
     for(int x = -1; x <= 1; ++x)
     {
         for(int y = -1; y <= 1; ++y)
         {
-            float pcfDepth = texture(light.shadowMap, vec3(projCoords.xy + vec2(x * texelSize.x, y * texelSize.y), i)).r; 
+            float pcfDepth = sampleShadowMap(light, vec3(projCoords.xy + vec2(x * texelSize.x, y * texelSize.y), i)); 
             shadow += currentDepth - eps > pcfDepth ? 1.0 : 0.0;
 			vals++;
         }    
@@ -196,4 +258,47 @@ float shadow(vec4 fragPosLS, DirectionalLight light)
     shadow /= vals;
 	
 	return shadow;
-}
\ No newline at end of file
+}
+
+float pointShadow(vec3 fragmentPos, PointLight light)
+{
+	vec3 d = fragmentPos - light.pos;
+	vec3 a = abs(d);
+	// The face is the one of the major axis, and the distance along that axis is the view
+	// depth in that face.
+	float ma = max(a.x, max(a.y, a.z));
+	float n = light.shadowNear;
+	float f = light.shadowFar;
+	if(ma >= f)
+	return 0.0f;
+
+#ifdef GL_ARB_texture_cube_map_array
+	float closestDepth = texture(pLightShadowMap, vec4(d, light.shadowLayer / 6)).r;
+#else
+	// Face and coordinates as for cube map lookups:
+	int face;
+	vec2 uv;
+	if(a.x >= a.y && a.x >= a.z)
+	{
+		face = d.x > 0.0f ? 0 : 1;
+		uv = vec2(d.x > 0.0f ? -d.z : d.z, -d.y) / a.x;
+	}
+	else if(a.y >= a.z)
+	{
+		face = d.y > 0.0f ? 2 : 3;
+		uv = vec2(d.x, d.y > 0.0f ? d.z : -d.z) / a.y;
+	}
+	else
+	{
+		face = d.z > 0.0f ? 4 : 5;
+		uv = vec2(d.z > 0.0f ? d.x : -d.x, -d.y) / a.z;
+	}
+	float closestDepth = texture(pLightShadowMap, vec3(uv * 0.5f + 0.5f, light.shadowLayer + face)).r;
+#endif
+
+	// Window space depth of the fragment in its face (perspective projection), moved towards
+	// the light by a bias that grows with the texel size:
+	ma *= 0.985f;
+	float currentDepth = 0.5f * ((f + n) / (f - n) - 2.0f * f * n / ((f - n) * ma)) + 0.5f;
+	return currentDepth > closestDepth ? 1.0f : 0.0f;
+}
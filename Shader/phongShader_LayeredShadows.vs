@@ -5,75 +5,47 @@ layout (location = 2) in vec2 InTexCoord;
 layout (location = 3) in vec4 InColor;
 layout (location = 4) in vec3 InTangent;
 layout (location = 5) in vec3 InBitangent;
-
-#define MAX_NUM_POINT_LIGHTS 16
-#define MAX_NUM_DIR_LIGHTS 4
-#define NUM_SHADOWMAP_LAYERS 3
-
-struct PointLight {
-	vec3 pos;
-	vec3 color;
-	float intensity;
-};
-
-struct DirectionalLight {
-	vec3 dir;
-	vec3 color;
-	float intensity;
-	float ambientIntensity;
-
-	int index;
-	
-	#if NUM_SHADOWMAP_LAYERS > 1
-		mat4 lightSpace[NUM_SHADOWMAP_LAYERS];
-	#else
-		mat4 lightSpace;
-	#endif
-	sampler2DArray shadowMap;
-};
-
-struct Flashlight {
-	vec3 pos;
-	vec3 dir;
-	vec3 color;
-	float intensity;
-	float ambientIntensity;
-};
+// Model matrix of the instance (locations 6 to 9), used if instanced is set.
+layout (location = 6) in mat4 InInstanceModel;
+// Decoding of packed vertices (see VertexLayout.h), set per mesh.
+layout (location = 10) in vec4 InPosScale;
+layout (location = 11) in vec3 InPosOffset;
+// Decoding of the instance's mesh (see InstanceData), used if instanced is set.
+layout (location = 12) in vec4 InInstancePosScale;
+layout (location = 13) in vec3 InInstancePosOffset;
 
 out vec3 FragmentPos;
 out vec3 Normal;
 out vec4 Color;
 out vec2 TexCoord;
-out vec4 FragPosDirLS[MAX_NUM_DIR_LIGHTS * NUM_SHADOWMAP_LAYERS];
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
+layout (std140) uniform CameraBlock {
+	mat4 projection;
+	mat4 view;
+	vec3 cameraPos;
+};
 
-uniform int nPointLights;
-uniform PointLight pLight[MAX_NUM_POINT_LIGHTS];
+uniform mat4 model;
+uniform bool instanced;
 
-uniform int nDirLights;
-uniform DirectionalLight dLight[MAX_NUM_DIR_LIGHTS];
+vec3 octahedralDecode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+	if (n.z < 0.0f) n.xy = (1.0f - abs(e.yx)) * vec2(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+	return normalize(n);
+}
 
 void main()
 {
+	mat4 M = instanced ? InInstanceModel : model;
+	vec4 posScale = instanced ? InInstancePosScale : InPosScale;
+	vec3 posOffset = instanced ? InInstancePosOffset : InPosOffset;
+	vec3 pos = InPos * posScale.xyz + posOffset;
+	vec3 normal = posScale.w > 0.5f ? octahedralDecode(InNormal.xy) : InNormal;
 	TexCoord = vec2(InTexCoord.x, InTexCoord.y);
-	Normal = mat3(transpose(inverse(model))) * InNormal;
-	FragmentPos = vec3(model * vec4(InPos, 1.0f));
+	Normal = mat3(transpose(inverse(M))) * normal;
+	FragmentPos = vec3(M * vec4(pos, 1.0f));
 	Color = InColor;
 
-	for(int i = 0; i < nDirLights; i++)
-	{
-		#if NUM_SHADOWMAP_LAYERS > 1
-		for(int j = 0; j < NUM_SHADOWMAP_LAYERS; j++)
-		{
-			FragPosDirLS[NUM_SHADOWMAP_LAYERS * i + j] = dLight[i].lightSpace[j] * vec4(FragmentPos, 1.0f);
-		}
-		#else
-		FragPosDirLS[i] = dLight[i].lightSpace * vec4(FragmentPos, 1.0f);
-		#endif
-	}
-
 	gl_Position = projection * view * vec4(FragmentPos, 1.0f);
 }
\ No newline at end of file
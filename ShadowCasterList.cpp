@@ -0,0 +1,129 @@
+#include "ShadowCasterList.h"
+#include "Utils.h"
+
+ShadowCasterList::ShadowCasterList()
+{
+}
+
+ShadowCasterList::~ShadowCasterList()
+{
+}
+
+void ShadowCasterList::add(PolygonModel * model)
+{
+	if (model->getMesh() == NULL) return;
+	BoundingSphere sphere = model->getWorldBoundingSphere();
+
+	unsigned int transformVersion = model->getTransform() ? model->getTransform()->getVersion() : 0;
+	unsigned int meshVersion = model->getMesh()->getVersion();
+	std::unordered_map<PolygonModel *, Mobility>::iterator it = mobility.find(model);
+	if (it == mobility.end()) {
+		Mobility m = { transformVersion, meshVersion, 0, frame };
+		it = mobility.insert(std::make_pair(model, m)).first;
+	}
+	else {
+		Mobility & m = it->second;
+		if (m.transformVersion != transformVersion || m.meshVersion != meshVersion) {
+			m.transformVersion = transformVersion;
+			m.meshVersion = meshVersion;
+			m.stableFrames = 0;
+		}
+		else if (m.lastFrame != frame && m.stableFrames < SHADOW_STATIC_FRAMES) {
+			m.stableFrames++;
+		}
+		m.lastFrame = frame;
+	}
+	bool stat = it->second.stableFrames >= SHADOW_STATIC_FRAMES;
+	isStatic.push_back(stat ? 1 : 0);
+	if (stat) nStatic++;
+
+	models.push_back(model);
+	x.push_back(sphere.center.x);
+	y.push_back(sphere.center.y);
+	z.push_back(sphere.center.z);
+	radius.push_back(sphere.radius);
+}
+
+void ShadowCasterList::clear()
+{
+	// Forget the casters that were not added in the last frame:
+	for (std::unordered_map<PolygonModel *, Mobility>::iterator it = mobility.begin(); it != mobility.end();) {
+		if (it->second.lastFrame != frame) it = mobility.erase(it);
+		else ++it;
+	}
+	frame++;
+
+	isStatic.clear();
+	nStatic = 0;
+	models.clear();
+	x.clear();
+	y.clear();
+	z.clear();
+	radius.clear();
+}
+
+unsigned int ShadowCasterList::size()
+{
+	return models.size();
+}
+
+unsigned int ShadowCasterList::getNumStatic()
+{
+	return nStatic;
+}
+
+bool ShadowCasterList::matches(unsigned int i, ShadowCasterFilter filter)
+{
+	if (filter == SHADOW_CASTERS_STATIC) return isStatic[i] != 0;
+	if (filter == SHADOW_CASTERS_DYNAMIC) return isStatic[i] == 0;
+	return true;
+}
+
+unsigned long long ShadowCasterList::cull(const Frustum & frustum, Shader * depthShader, RenderQueue * queue,
+	ShadowCasterFilter filter)
+{
+	unsigned long long signature = FNV_OFFSET_BASIS;
+	if (models.empty()) return signature;
+
+	visible.resize(models.size());
+	frustum.cullSpheres(&x[0], &y[0], &z[0], &radius[0], models.size(), &visible[0]);
+
+	for (unsigned int i = 0; i < models.size(); i++) {
+		if (!visible[i] || !matches(i, filter)) continue;
+		PolygonModel * model = models[i];
+		if (queue) queue->add(model, depthShader, 0.0f);
+
+		// Versions are unique, so they also tell apart casters reusing the memory of
+		// deleted ones.
+		// The LOD is part of the signature, so switching it redraws the shadow.
+		unsigned int versions[3];
+		versions[0] = model->getTransform() ? model->getTransform()->getVersion() : 0;
+		versions[1] = model->getMesh()->getVersion();
+		versions[2] = model->getShadowLod();
+		signature = Utils::HashFNV1a(&model, sizeof(model), signature);
+		signature = Utils::HashFNV1a(versions, sizeof(versions), signature);
+	}
+	return signature;
+}
+
+unsigned int ShadowCasterList::cullUnion(const Frustum * frustums, unsigned int count, Shader * depthShader, RenderQueue & queue,
+	ShadowCasterFilter filter)
+{
+	if (models.empty() || count == 0) return 0;
+
+	visible.resize(models.size());
+	visibleAny.assign(models.size(), 0);
+	for (unsigned int f = 0; f < count; f++) {
+		frustums[f].cullSpheres(&x[0], &y[0], &z[0], &radius[0], models.size(), &visible[0]);
+		for (unsigned int i = 0; i < models.size(); i++)
+			visibleAny[i] |= visible[i];
+	}
+
+	unsigned int added = 0;
+	for (unsigned int i = 0; i < models.size(); i++) {
+		if (!visibleAny[i] || !matches(i, filter)) continue;
+		queue.add(models[i], depthShader, 0.0f);
+		added++;
+	}
+	return added;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "PolygonModel.h"
+#include "RenderQueue.h"
+#include "Frustum.h"
+#include "Shader.h"
+
+#include <vector>
+#include <unordered_map>
+
+// Number of consecutive frames in which neither the transform nor the mesh of a caster may
+// change before it counts as static.
+#define SHADOW_STATIC_FRAMES 30
+
+// Which casters ShadowCasterList::cull() considers.
+enum ShadowCasterFilter {
+	SHADOW_CASTERS_ALL = 0,
+	SHADOW_CASTERS_STATIC = 1,
+	SHADOW_CASTERS_DYNAMIC = 2
+};
+
+// The shadow casters of a frame with their world space bounding spheres packed for culling.
+// The list is built once per frame by the Scene; every shadow map (layer) then culls it
+// against its own volume.
+// Casters are classified as static or dynamic by watching the versions of their transforms
+// and meshes across frames, so lights can cache the shadows of the static ones.
+class ShadowCasterList
+{
+public:
+	ShadowCasterList();
+	~ShadowCasterList();
+
+	void add(PolygonModel * model);
+	// Start a new frame: remove all casters.
+	void clear();
+	unsigned int size();
+	// Number of static casters in the list.
+	unsigned int getNumStatic();
+
+	// Add the casters intersecting the frustum to queue (drawn with depthShader) and
+	// return a signature of them: it only stays the same as long as the same casters are
+	// found, and neither their transforms, meshes nor shadow LODs change. If queue is NULL, only
+	// the signature is computed.
+	unsigned long long cull(const Frustum & frustum, Shader * depthShader, RenderQueue * queue,
+		ShadowCasterFilter filter = SHADOW_CASTERS_ALL);
+	// Add the casters intersecting any of the frustums to queue (each caster once) and
+	// return how many were added.
+	unsigned int cullUnion(const Frustum * frustums, unsigned int count, Shader * depthShader, RenderQueue & queue,
+		ShadowCasterFilter filter = SHADOW_CASTERS_ALL);
+
+private:
+	std::vector<PolygonModel *> models;
+	std::vector<float> x, y, z, radius;
+	std::vector<unsigned char> visible, visibleAny;
+	std::vector<unsigned char> isStatic;
+	unsigned int nStatic = 0;
+
+	// Versions of the casters seen in recent frames and for how many frames they did not
+	// change. Versions are unique, so a new caster at the address of a deleted one starts
+	// over. Entries of casters not seen for a frame are removed.
+	struct Mobility {
+		unsigned int transformVersion;
+		unsigned int meshVersion;
+		unsigned int stableFrames;
+		unsigned int lastFrame;
+	};
+	std::unordered_map<PolygonModel *, Mobility> mobility;
+	unsigned int frame = 0;
+
+	bool matches(unsigned int i, ShadowCasterFilter filter);
+};
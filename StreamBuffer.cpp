@@ -0,0 +1,193 @@
+#include "StreamBuffer.h"
+#include "RenderStats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+// Time to wait for a fence at once in nanoseconds, before checking it again.
+#define STREAM_BUFFER_WAIT_TIMEOUT 1000000
+
+StreamBuffer::StreamBuffer(GLsizeiptr size, const void * data, unsigned int regions)
+{
+	this->size = size;
+	this->regions = regions > 0 ? regions : 1;
+	fences.assign(this->regions, (GLsync)NULL);
+	regionVersions.assign(this->regions, 0);
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	if (GLAD_GL_ARB_buffer_storage) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, size * this->regions, NULL, flags);
+		mapping = (unsigned char *)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size * this->regions, flags);
+		persistent = mapping != NULL;
+		if (!persistent) {
+			// Immutable storage cannot be reallocated, so start over with a new buffer.
+			std::cerr << "StreamBuffer.cpp: ERROR persistent mapping failed, falling back to glBufferSubData" << std::endl;
+			glDeleteBuffers(1, &buffer);
+			glGenBuffers(1, &buffer);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		}
+	}
+	if (!persistent)
+		glBufferData(GL_COPY_WRITE_BUFFER, size * this->regions, NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	// The first update writes region 0.
+	current = this->regions - 1;
+	invalidate(0, size);
+	update(data);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	for (GLsync fence : fences) {
+		if (fence) glDeleteSync(fence);
+	}
+	if (buffer) {
+		if (persistent) {
+			glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+			glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		}
+		glDeleteBuffers(1, &buffer);
+	}
+}
+
+void StreamBuffer::invalidate(GLintptr offset, GLsizeiptr size)
+{
+	GLintptr begin = std::max(offset, (GLintptr)0);
+	GLintptr end = std::min(offset + size, (GLintptr)this->size);
+	addRange(pending, 0, begin, end);
+}
+
+void StreamBuffer::update(const void * data)
+{
+	if (pending.empty()) return;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	// All draws since the last update read the current region.
+	if (fences[current]) glDeleteSync(fences[current]);
+	fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	version++;
+	for (const Range & r : pending) {
+		Range changed = { version, r.begin, r.end };
+		history.push_back(changed);
+	}
+	pending.clear();
+	// The next region was written regions updates ago at the earliest, so older ranges are
+	// never needed again.
+	unsigned int versions = regions;
+	unsigned int newest = version;
+	history.erase(std::remove_if(history.begin(), history.end(), [versions, newest](const Range & r) {
+		return r.version + versions <= newest;
+	}), history.end());
+
+	unsigned int next = (current + 1) % regions;
+	if (!persistent) glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	acquire(next);
+
+	// Everything changed since the region was written, or all of it if its contents are
+	// undefined or too old for the history:
+	std::vector<Range> ranges;
+	unsigned int held = regionVersions[next];
+	if (held == 0 || held + regions < version) {
+		addRange(ranges, version, 0, size);
+	}
+	else {
+		for (const Range & r : history) {
+			if (r.version > held) addRange(ranges, r.version, r.begin, r.end);
+		}
+	}
+
+	GLintptr offset = (GLintptr)next * size;
+	for (const Range & r : ranges) {
+		if (persistent)
+			memcpy(mapping + offset + r.begin, (const unsigned char *)data + r.begin, r.end - r.begin);
+		else
+			glBufferSubData(GL_COPY_WRITE_BUFFER, offset + r.begin, r.end - r.begin, (const unsigned char *)data + r.begin);
+		renderStats.bufferBytesUploaded += r.end - r.begin;
+	}
+	if (!persistent) glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	regionVersions[next] = version;
+	current = next;
+	renderStats.bufferUploadTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+GLuint StreamBuffer::getBuffer()
+{
+	return buffer;
+}
+
+GLsizeiptr StreamBuffer::getSize()
+{
+	return size;
+}
+
+unsigned int StreamBuffer::getRegion()
+{
+	return current;
+}
+
+GLintptr StreamBuffer::getOffset()
+{
+	return (GLintptr)current * size;
+}
+
+bool StreamBuffer::isPersistent()
+{
+	return persistent;
+}
+
+bool StreamBuffer::acquire(unsigned int region)
+{
+	GLsync fence = fences[region];
+	if (fence == NULL) return true;
+	fences[region] = NULL;
+
+	GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (status == GL_TIMEOUT_EXPIRED && persistent) {
+		// The mapping cannot be orphaned, so wait for the GPU.
+		renderStats.streamWaits++;
+		do {
+			status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, STREAM_BUFFER_WAIT_TIMEOUT);
+		} while (status == GL_TIMEOUT_EXPIRED);
+	}
+	glDeleteSync(fence);
+	if (status != GL_TIMEOUT_EXPIRED) return true;
+
+	// The GPU still reads the region: give the buffer new storage instead of waiting. The
+	// driver keeps the old one alive until the pending draws are done. All regions are
+	// undefined afterwards. The buffer is bound to GL_COPY_WRITE_BUFFER by update().
+	renderStats.streamOrphans++;
+	glBufferData(GL_COPY_WRITE_BUFFER, size * regions, NULL, GL_STREAM_DRAW);
+	for (unsigned int i = 0; i < regions; i++) {
+		if (fences[i]) glDeleteSync(fences[i]);
+		fences[i] = NULL;
+		regionVersions[i] = 0;
+	}
+	return false;
+}
+
+void StreamBuffer::addRange(std::vector<Range> & ranges, unsigned int version, GLintptr begin, GLintptr end)
+{
+	if (end <= begin) return;
+
+	// Merge with all ranges overlapping or touching [begin, end):
+	std::vector<Range>::iterator first = ranges.begin();
+	while (first != ranges.end() && first->end < begin) first++;
+	std::vector<Range>::iterator last = first;
+	while (last != ranges.end() && last->begin <= end) {
+		begin = std::min(begin, last->begin);
+		end = std::max(end, last->end);
+		version = std::max(version, last->version);
+		last++;
+	}
+	Range merged = { version, begin, end };
+	first = ranges.erase(first, last);
+	ranges.insert(first, merged);
+}
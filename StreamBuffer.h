@@ -0,0 +1,71 @@
+#pragma once
+
+#include <glad\glad.h>
+
+#include <cstddef>
+#include <vector>
+
+// Number of copies of the contents a StreamBuffer cycles through. With three, the CPU can
+// write one while the GPU still reads the two frames before it.
+#define STREAM_BUFFER_REGIONS 3
+
+// Buffer object for contents that change often, such as vertices animated on the CPU.
+// The buffer holds several copies (regions) of the contents, and every update() writes the
+// next one, so the CPU never overwrites data that draws of previous frames may still read.
+// A fence after the draws of a region tells when it can be written again.
+// Only the ranges that changed since a region was last written are uploaded to it.
+// With GL_ARB_buffer_storage, the buffer is mapped persistently and updates are copies to
+// the mapping (waiting for the fence if necessary). Otherwise updates use glBufferSubData(),
+// and if the GPU may still read the next region, the storage is orphaned instead of waiting,
+// which costs a full upload.
+class StreamBuffer
+{
+public:
+	// The buffer has regions * size bytes. Uploads data (size bytes) to the first region.
+	StreamBuffer(GLsizeiptr size, const void * data, unsigned int regions = STREAM_BUFFER_REGIONS);
+	~StreamBuffer();
+
+	// Mark size bytes of the contents, starting at offset, as changed.
+	void invalidate(GLintptr offset, GLsizeiptr size);
+	// Write the changed ranges of the contents (size bytes at data) to the next region,
+	// which becomes the current one. Does nothing if nothing changed since the last update.
+	// Call it before the draws reading the contents, never between them.
+	void update(const void * data);
+
+	GLuint getBuffer();
+	// Size of the contents (of one region) in bytes.
+	GLsizeiptr getSize();
+	// Index of the region written by the last update, which draws have to read.
+	unsigned int getRegion();
+	// Offset of the current region in the buffer in bytes.
+	GLintptr getOffset();
+	bool isPersistent();
+
+private:
+	// Byte range [begin, end) of the contents changed by the update to version.
+	struct Range {
+		unsigned int version;
+		GLintptr begin;
+		GLintptr end;
+	};
+
+	GLuint buffer = 0;
+	GLsizeiptr size = 0;
+	unsigned int regions = 0;
+	unsigned int current = 0;
+	bool persistent = false;
+	unsigned char * mapping = NULL;
+	std::vector<GLsync> fences;
+	// Version of the contents held by every region (0: undefined).
+	std::vector<unsigned int> regionVersions;
+	unsigned int version = 0;
+	// Ranges changed since the last update, and by the updates of the last regions versions.
+	std::vector<Range> pending;
+	std::vector<Range> history;
+
+	// Make sure the GPU does not read the region anymore. Returns false if the storage was
+	// orphaned instead.
+	bool acquire(unsigned int region);
+	// Add [begin, end) to sorted, non-overlapping ranges.
+	static void addRange(std::vector<Range> & ranges, unsigned int version, GLintptr begin, GLintptr end);
+};
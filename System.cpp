@@ -0,0 +1,45 @@
+#include "System.h"
+
+System::System(std::string name)
+{
+	this->name = name;
+}
+
+System::~System()
+{
+}
+
+bool System::conflictsWith(System * other)
+{
+	return (writeMask & (other->readMask | other->writeMask)) || (other->writeMask & readMask);
+}
+
+CommandBuffer * System::getCommandBuffer()
+{
+	return &commands;
+}
+
+const std::string & System::getName()
+{
+	return name;
+}
+
+ComponentMask System::getReadMask()
+{
+	return readMask;
+}
+
+ComponentMask System::getWriteMask()
+{
+	return writeMask;
+}
+
+FunctionSystem::FunctionSystem(std::string name, std::function<void(Scene*, double)> func) : System(name)
+{
+	this->func = func;
+}
+
+void FunctionSystem::update(Scene * scene, double delta)
+{
+	if (func) func(scene, delta);
+}
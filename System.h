@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Entity3D.h"
+#include "ComponentType.h"
+#include "CommandBuffer.h"
+
+#include <string>
+#include <functional>
+
+class Scene;
+
+// A System updates one aspect of the scene once per frame (e.g. physics). Every System
+// declares which component types it reads and which it writes, so that the
+// SystemScheduler can run Systems that do not conflict with each other in parallel.
+// Systems must not create or destroy entities or components directly; they record such
+// changes in their command buffer, which is flushed once all Systems of the frame are done.
+class System
+{
+public:
+	System(std::string name);
+	virtual ~System();
+
+	// Update the System. This is called once per frame by the SystemScheduler, possibly
+	// on a worker thread.
+	virtual void update(Scene * scene, double delta) = 0;
+
+	// Declare that this System reads components (or other data) of type T.
+	template <typename T>
+	void declareRead() {
+		readMask |= ComponentType::mask<T>();
+	}
+
+	// Declare that this System writes components (or other data) of type T.
+	template <typename T>
+	void declareWrite() {
+		writeMask |= ComponentType::mask<T>();
+	}
+
+	// Returns whether this System and the other System may not run at the same time, i.e.
+	// whether one of them writes a type the other one reads or writes.
+	bool conflictsWith(System * other);
+
+	// Returns the System's own command buffer. Only use it from within update().
+	CommandBuffer * getCommandBuffer();
+
+	const std::string & getName();
+	ComponentMask getReadMask();
+	ComponentMask getWriteMask();
+
+protected:
+	std::string name;
+
+	ComponentMask readMask = 0;
+	ComponentMask writeMask = 0;
+
+	CommandBuffer commands;
+};
+
+// System that calls update() on every component of type T in the scene. The component
+// type T is declared as written, as are the entities' Transform3Ds.
+template <typename T>
+class ComponentSystem : public System
+{
+public:
+	ComponentSystem(std::string name) : System(name) {
+		declareWrite<T>();
+		declareWrite<Transform3D>();
+	}
+
+	virtual void update(Scene * scene, double delta);
+};
+
+// System that executes an arbitrary function. The read and write declarations have to
+// be made by the caller.
+class FunctionSystem : public System
+{
+public:
+	FunctionSystem(std::string name, std::function<void(Scene *, double)> func);
+
+	virtual void update(Scene * scene, double delta);
+
+private:
+	std::function<void(Scene *, double)> func;
+};
+
+#include "Scene.h"
+
+template<typename T>
+inline void ComponentSystem<T>::update(Scene * scene, double delta)
+{
+	for (int i = 0; i < scene->getNumEntities(); i++) {
+		for (T * c : scene->getEntity3D(i)->getComponents<T>())
+			c->update(delta);
+	}
+}
@@ -0,0 +1,127 @@
+#include "SystemScheduler.h"
+
+#include <chrono>
+#include <mutex>
+#include <algorithm>
+
+SystemScheduler::SystemScheduler(unsigned int nThreads)
+{
+	pool = new ThreadPool(nThreads);
+}
+
+SystemScheduler::~SystemScheduler()
+{
+	delete pool;
+	for (System * s : systems)
+		delete s;
+	systems.clear();
+}
+
+void SystemScheduler::addSystem(System * system)
+{
+	if (system == NULL) return;
+	systems.push_back(system);
+	timings.push_back(SystemTiming());
+	graphValid = false;
+}
+
+void SystemScheduler::removeSystem(System * system)
+{
+	std::vector<System *>::iterator it = std::find(systems.begin(), systems.end(), system);
+	if (it == systems.end()) return;
+	timings.erase(timings.begin() + std::distance(systems.begin(), it));
+	systems.erase(it);
+	delete system;
+	graphValid = false;
+}
+
+unsigned int SystemScheduler::getNumSystems()
+{
+	return systems.size();
+}
+
+System * SystemScheduler::getSystem(unsigned int i)
+{
+	if (i >= systems.size()) return NULL;
+	return systems[i];
+}
+
+void SystemScheduler::run(Scene * scene, double delta)
+{
+	if (systems.empty()) return;
+	if (!graphValid) buildGraph();
+
+	std::vector<unsigned int> pending(numDependencies);
+	std::mutex mutex;
+
+	std::function<void(unsigned int)> execute = [&](unsigned int i) {
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		systems[i]->update(scene, delta);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		std::unique_lock<std::mutex> lock(mutex);
+		timings[i].last = ms;
+		timings[i].total += ms;
+		timings[i].samples++;
+
+		// Release all Systems that only waited for this one:
+		for (unsigned int d : dependents[i]) {
+			if (--pending[d] == 0)
+				pool->submit([&execute, d] { execute(d); });
+		}
+	};
+
+	for (unsigned int i = 0; i < systems.size(); i++) {
+		if (pending[i] == 0)
+			pool->submit([&execute, i] { execute(i); });
+	}
+
+	// Dependent Systems are submitted before the job that released them finishes, so the
+	// pool only runs dry once every System is done.
+	pool->wait();
+}
+
+void SystemScheduler::flushCommands(Scene * scene)
+{
+	for (System * s : systems)
+		s->getCommandBuffer()->execute(scene);
+}
+
+SystemTiming SystemScheduler::getTiming(unsigned int i)
+{
+	if (i >= timings.size()) return SystemTiming();
+	return timings[i];
+}
+
+void SystemScheduler::printTimings(std::ostream & out)
+{
+	for (unsigned int i = 0; i < systems.size(); i++) {
+		double avg = timings[i].samples ? timings[i].total / timings[i].samples : 0.0;
+		out << "System '" << systems[i]->getName() << "': " << avg << " ms (avg. over " << timings[i].samples << " frames)" << std::endl;
+		timings[i].total = 0.0;
+		timings[i].samples = 0;
+	}
+}
+
+ThreadPool * SystemScheduler::getThreadPool()
+{
+	return pool;
+}
+
+void SystemScheduler::buildGraph()
+{
+	dependents.assign(systems.size(), std::vector<unsigned int>());
+	numDependencies.assign(systems.size(), 0);
+
+	// Systems registered later wait for earlier Systems they conflict with. This keeps
+	// the graph acyclic and the results deterministic.
+	for (unsigned int i = 0; i < systems.size(); i++) {
+		for (unsigned int j = i + 1; j < systems.size(); j++) {
+			if (systems[i]->conflictsWith(systems[j])) {
+				dependents[i].push_back(j);
+				numDependencies[j]++;
+			}
+		}
+	}
+	graphValid = true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "System.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <ostream>
+
+// Timing information of a single System.
+struct SystemTiming {
+	// Duration of the last update in milliseconds.
+	double last = 0.0;
+	// Accumulated duration since the last call of SystemScheduler::printTimings().
+	double total = 0.0;
+	unsigned int samples = 0;
+};
+
+// Runs all registered Systems once per frame. From the read and write declarations of the
+// Systems, a dependency graph is built: a System depends on every System registered before
+// it with which it conflicts. Systems without pending dependencies run in parallel on a
+// ThreadPool, so the result is the same as running them in registration order.
+class SystemScheduler
+{
+public:
+	// Create a scheduler with nThreads worker threads (0 = choose automatically).
+	SystemScheduler(unsigned int nThreads = 0);
+	~SystemScheduler();
+
+	// Register a System. The scheduler takes ownership of the System.
+	void addSystem(System * system);
+	// Remove and delete a System.
+	void removeSystem(System * system);
+	unsigned int getNumSystems();
+	System * getSystem(unsigned int i);
+
+	// Run all Systems for one frame and block until they are done. Changes recorded by the
+	// Systems are not applied until flushCommands() is called.
+	void run(Scene * scene, double delta);
+	// Execute the command buffers of all Systems in registration order. Must be called
+	// from the thread that owns the scene while no System is running.
+	void flushCommands(Scene * scene);
+
+	// Returns the timing information of the i-th System.
+	SystemTiming getTiming(unsigned int i);
+	// Print the average update duration of every System since the last call and reset
+	// the accumulated timings.
+	void printTimings(std::ostream & out);
+
+	ThreadPool * getThreadPool();
+
+private:
+	ThreadPool * pool;
+
+	std::vector<System *> systems;
+	std::vector<SystemTiming> timings;
+
+	// dependents[i] contains all Systems that have to wait for System i.
+	std::vector<std::vector<unsigned int>> dependents;
+	std::vector<unsigned int> numDependencies;
+	bool graphValid = false;
+
+	void buildGraph();
+};
@@ -5,9 +5,31 @@
 #include "..\ogl-engine\include\glm\glm.hpp"
 #include "..\ogl-engine\include\glm\gtc\matrix_transform.hpp"
 #include "..\ogl-engine\Utils.h"
+#include "..\ogl-engine\Pool.h"
+#include "..\ogl-engine\Entity3D.h"
+#include "..\ogl-engine\CommandBuffer.h"
+#include "..\ogl-engine\SystemScheduler.h"
+#include "..\ogl-engine\RenderQueue.h"
+#include "..\ogl-engine\Frustum.h"
+#include "..\ogl-engine\BoundingVolumeHierarchy.h"
+#include "..\ogl-engine\LightClusterer.h"
+#include "..\ogl-engine\MeshOptimizer.h"
+#include "..\ogl-engine\MeshSimplifier.h"
+#include "..\ogl-engine\Mesh.h"
+#include "..\ogl-engine\FreeListAllocator.h"
+#include "..\ogl-engine\SceneCache.h"
+#include "..\ogl-engine\ObjParser.h"
 
 #include <cmath>
 #include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <atomic>
+#include <thread>
 
 #define PI 3.14159265f
 #define PI_2 PI/2.0f
@@ -43,6 +65,47 @@ double simpleODE(double x, double t) {
 	return 1 + x;
 }
 
+struct TestComponentA : Component {
+	COMPONENT_TYPE(TestComponentA)
+public:
+	int value = 0;
+	virtual void update(double delta) {};
+};
+
+struct TestComponentB : Component {
+	COMPONENT_TYPE(TestComponentB)
+public:
+	int value = 0;
+	virtual void update(double delta) {};
+};
+
+struct TestComponentC : Component {
+	COMPONENT_TYPE(TestComponentC)
+public:
+	int value = 0;
+	virtual void update(double delta) {};
+};
+
+// Component lookup as it was done before component type IDs were introduced.
+template <typename T>
+T * getComponentDynamicCast(Entity3D * e) {
+	for (unsigned int i = 0; i < e->getNumComponents(); i++) {
+		if (T * ret = dynamic_cast<T*>(e->getComponent(i)))
+			return ret;
+	}
+	return NULL;
+}
+
+template <typename T>
+int getNumComponentsOfTypeDynamicCast(Entity3D * e) {
+	int n = 0;
+	for (unsigned int i = 0; i < e->getNumComponents(); i++) {
+		if (dynamic_cast<T*>(e->getComponent(i)))
+			n++;
+	}
+	return n;
+}
+
 namespace UnitTestEntities
 {
 	TEST_CLASS(UtilsTest)
@@ -145,5 +208,813 @@ namespace UnitTestEntities
 			assertVec3(glm::fvec3(-1.0f, 2.0f, 0.0f), child.getPositionGlobal());
 			assertMatrix4(expected, actual);
 		}
+
+		TEST_METHOD(DeleteParent)
+		{
+			// All children are detached from a deleted parent and keep their global transformation.
+			Transform3D * parent = new Transform3D();
+			parent->translate(0.0f, 1.0f, 0.0f);
+			std::vector<Transform3D *> children;
+			for (int i = 0; i < 3; i++) {
+				children.push_back(new Transform3D());
+				children[i]->setParent(parent, false);
+				children[i]->translate((float)i, 0.0f, 0.0f);
+			}
+			delete parent;
+			for (int i = 0; i < 3; i++) {
+				assertVec3(glm::fvec3((float)i, 1.0f, 0.0f), children[i]->getPositionGlobal());
+				delete children[i];
+			}
+		}
 	};
-}
+	TEST_CLASS(PoolTest)
+	{
+	public:
+
+		TEST_METHOD(CreateAndDestroy)
+		{
+			Pool<glm::fvec3> pool;
+
+			Handle a = pool.create(1.0f, 2.0f, 3.0f);
+			Handle b = pool.create(4.0f, 5.0f, 6.0f);
+			Assert::AreEqual(2U, pool.size());
+			assertVec3(glm::fvec3(1.0f, 2.0f, 3.0f), *pool.get(a));
+			assertVec3(glm::fvec3(4.0f, 5.0f, 6.0f), *pool.get(b));
+
+			// Destroying an object makes its handle stale, while other handles stay valid.
+			pool.destroy(a);
+			Assert::AreEqual(1U, pool.size());
+			Assert::IsFalse(pool.isAlive(a));
+			Assert::IsTrue(pool.get(a) == NULL);
+			assertVec3(glm::fvec3(4.0f, 5.0f, 6.0f), *pool.get(b));
+
+			// The freed slot is reused, but the old handle must not refer to the new object.
+			Handle c = pool.create(7.0f, 8.0f, 9.0f);
+			Assert::AreEqual(a.index, c.index);
+			Assert::AreNotEqual(a.generation, c.generation);
+			Assert::IsTrue(pool.get(a) == NULL);
+			assertVec3(glm::fvec3(7.0f, 8.0f, 9.0f), *pool.get(c));
+
+			// Destroying a stale handle twice must not affect the pool.
+			pool.destroy(a);
+			Assert::AreEqual(2U, pool.size());
+		}
+
+		TEST_METHOD(StableMemory)
+		{
+			Pool<glm::fvec3, 64> pool;
+			std::vector<Handle> handles;
+
+			// Spawn and despawn many short-lived objects (e.g. particles). The pool must not
+			// grow beyond the maximum number of objects alive at the same time.
+			for (int frame = 0; frame < 100; frame++) {
+				for (int i = 0; i < 50; i++)
+					handles.push_back(pool.create(float(frame), float(i), 0.0f));
+				for (Handle h : handles)
+					pool.destroy(h);
+				handles.clear();
+			}
+			Assert::AreEqual(0U, pool.size());
+			Assert::AreEqual(64U, pool.capacity());
+
+			// Pointers to existing objects stay valid when further objects are created.
+			Handle first = pool.create(1.0f, 1.0f, 1.0f);
+			glm::fvec3 * ptr = pool.get(first);
+			for (int i = 0; i < 1000; i++)
+				pool.create(0.0f, 0.0f, 0.0f);
+			Assert::IsTrue(ptr == pool.get(first));
+			Assert::AreEqual(1001U, pool.size());
+		}
+	};
+	TEST_CLASS(ComponentLookupTest)
+	{
+	public:
+
+		TEST_METHOD(TypedLookup)
+		{
+			Entity3D e;
+			TestComponentC * c0 = new TestComponentC();
+			TestComponentA * a = new TestComponentA();
+			TestComponentC * c1 = new TestComponentC();
+			e.addComponent(c0);
+			e.addComponent(a);
+			e.addComponent(c1);
+
+			Assert::IsTrue(e.getComponent<TestComponentA>() == a);
+			Assert::IsTrue(e.getComponent<TestComponentB>() == NULL);
+			Assert::IsTrue(e.getComponent<TestComponentC>() == c0);
+			Assert::AreEqual(1, e.getNumComponentsOfType<TestComponentA>());
+			Assert::AreEqual(0, e.getNumComponentsOfType<TestComponentB>());
+			Assert::AreEqual(2, e.getNumComponentsOfType<TestComponentC>());
+			Assert::IsTrue(e.hasComponents(ComponentType::mask<TestComponentA>() | ComponentType::mask<TestComponentC>()));
+			Assert::IsFalse(e.hasComponents(ComponentType::mask<TestComponentB>()));
+
+			ComponentSpan<TestComponentC> span = e.getComponents<TestComponentC>();
+			Assert::AreEqual(2U, span.size());
+			Assert::IsTrue(span[0] == c0);
+			Assert::IsTrue(span[1] == c1);
+
+			// Removing a component updates the lookup tables.
+			e.removeComponent(c0);
+			delete c0;
+			Assert::IsTrue(e.getComponent<TestComponentC>() == c1);
+			Assert::AreEqual(1, e.getNumComponentsOfType<TestComponentC>());
+			Assert::IsTrue(e.getComponents<TestComponentB>().empty());
+		}
+
+		TEST_METHOD(LookupBenchmark)
+		{
+			const int nEntities = 10000;
+			const int nRepetitions = 100;
+
+			std::vector<Entity3D *> entities;
+			for (int i = 0; i < nEntities; i++) {
+				Entity3D * e = new Entity3D();
+				e->addComponent(new TestComponentA());
+				e->addComponent(new TestComponentB());
+				e->addComponent(new TestComponentC());
+				e->addComponent(new TestComponentC());
+				entities.push_back(e);
+			}
+
+			long long sumOld = 0, sumNew = 0;
+
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			for (int r = 0; r < nRepetitions; r++) {
+				for (Entity3D * e : entities) {
+					sumOld += getComponentDynamicCast<TestComponentC>(e)->value;
+					sumOld += getNumComponentsOfTypeDynamicCast<TestComponentC>(e);
+				}
+			}
+			double msOld = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			start = std::chrono::high_resolution_clock::now();
+			for (int r = 0; r < nRepetitions; r++) {
+				for (Entity3D * e : entities) {
+					sumNew += e->getComponent<TestComponentC>()->value;
+					sumNew += e->getNumComponentsOfType<TestComponentC>();
+				}
+			}
+			double msNew = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			Assert::AreEqual(sumOld, sumNew);
+
+			std::string msg = "Component lookup on " + std::to_string(nEntities) + " entities (x" + std::to_string(nRepetitions) + "): dynamic_cast "
+				+ std::to_string(msOld) + " ms, type IDs " + std::to_string(msNew) + " ms\n";
+			Logger::WriteMessage(msg.c_str());
+
+			for (Entity3D * e : entities)
+				delete e;
+		}
+	};
+	TEST_CLASS(CommandBufferTest)
+	{
+	public:
+
+		TEST_METHOD(RecordWhileExecuting)
+		{
+			// Commands recording into the buffer they are executed from, like an init function
+			// calling scene->getCommandBuffer(). Custom commands do not need a scene.
+			CommandBuffer buffer;
+			std::vector<int> order;
+			buffer.record([&](Scene *) {
+				order.push_back(1);
+				for (int i = 0; i < 100; i++)
+					buffer.record([&, i](Scene *) { order.push_back(3 + i); });
+			});
+			buffer.record([&](Scene *) {
+				order.push_back(2);
+				buffer.record([&](Scene *) {
+					order.push_back(103);
+					buffer.record([&](Scene *) { order.push_back(104); });
+				});
+			});
+			buffer.execute(NULL);
+
+			Assert::IsTrue(buffer.empty());
+			Assert::AreEqual(104U, (unsigned int)order.size());
+			for (unsigned int i = 0; i < order.size(); i++)
+				Assert::AreEqual((int)i + 1, order[i]);
+		}
+	};
+
+	TEST_CLASS(SchedulerTest)
+	{
+	public:
+
+		// Data types the test Systems declare to read and write.
+		struct Position {};
+		struct Velocity {};
+		struct Health {};
+
+		TEST_METHOD(DependencyOrder)
+		{
+			// Every System stamps when it starts and ends with a shared clock.
+			std::atomic<unsigned int> clock(0);
+			const unsigned int n = 6;
+			unsigned int starts[n], ends[n], runs[n] = {};
+			SystemScheduler scheduler(4);
+			for (unsigned int i = 0; i < n; i++) {
+				scheduler.addSystem(new FunctionSystem("System " + std::to_string(i), [&, i](Scene *, double) {
+					starts[i] = ++clock;
+					// Long enough that a System running too early would overlap.
+					std::this_thread::sleep_for(std::chrono::milliseconds(5));
+					runs[i]++;
+					ends[i] = ++clock;
+				}));
+			}
+			// 0 writes Position, 1 and 2 only read it, 3 writes it again. 4 and 5 touch
+			// Velocity and Health only.
+			System * s[n];
+			for (unsigned int i = 0; i < n; i++)
+				s[i] = scheduler.getSystem(i);
+			s[0]->declareWrite<Position>();
+			s[1]->declareRead<Position>();
+			s[2]->declareRead<Position>();
+			s[2]->declareWrite<Velocity>();
+			s[3]->declareRead<Velocity>();
+			s[3]->declareWrite<Position>();
+			s[4]->declareWrite<Health>();
+			s[5]->declareRead<Health>();
+
+			Assert::IsTrue(s[0]->conflictsWith(s[1]));
+			Assert::IsFalse(s[1]->conflictsWith(s[2]));
+			Assert::IsFalse(s[0]->conflictsWith(s[4]));
+			Assert::IsTrue(s[4]->conflictsWith(s[5]));
+
+			for (unsigned int frame = 1; frame <= 3; frame++) {
+				scheduler.run(NULL, 0.0);
+				for (unsigned int i = 0; i < n; i++)
+					Assert::AreEqual(frame, runs[i]);
+
+				// Readers wait for the writer registered before them, the second writer
+				// waits for all of them.
+				Assert::IsTrue(starts[1] > ends[0]);
+				Assert::IsTrue(starts[2] > ends[0]);
+				Assert::IsTrue(starts[3] > ends[1]);
+				Assert::IsTrue(starts[3] > ends[2]);
+				Assert::IsTrue(starts[5] > ends[4]);
+				// The disjoint chain runs alongside the first one.
+				Assert::IsTrue(starts[4] < ends[0]);
+			}
+		}
+
+		TEST_METHOD(ParallelForInSystem)
+		{
+			// Systems splitting their work on the scheduler's pool, with fewer threads than
+			// Systems, must not wait for each other's jobs.
+			SystemScheduler scheduler(1);
+			std::atomic<unsigned int> sum(0);
+			for (unsigned int i = 0; i < 3; i++) {
+				scheduler.addSystem(new FunctionSystem("System " + std::to_string(i), [&](Scene *, double) {
+					ThreadPool::parallelFor(scheduler.getThreadPool(), 100, [&](unsigned int j) { sum += j; });
+				}));
+			}
+			scheduler.run(NULL, 0.0);
+			Assert::AreEqual(3U * 4950U, sum.load());
+		}
+	};
+
+	TEST_CLASS(RenderQueueTest)
+	{
+	public:
+
+		TEST_METHOD(KeyOrder)
+		{
+			// State changes are more significant than depth.
+			Assert::IsTrue(RenderQueue::makeKey(RENDER_PASS_OPAQUE, 1, 7, 3, 1000.0f) < RenderQueue::makeKey(RENDER_PASS_OPAQUE, 2, 1, 1, 0.0f));
+			Assert::IsTrue(RenderQueue::makeKey(RENDER_PASS_OPAQUE, 1, 1, 9, 1000.0f) < RenderQueue::makeKey(RENDER_PASS_OPAQUE, 1, 2, 1, 0.0f));
+			Assert::IsTrue(RenderQueue::makeKey(RENDER_PASS_OPAQUE, 9, 9, 9, 1000.0f) < RenderQueue::makeKey(RENDER_PASS_TRANSPARENT, 1, 1, 1, 0.0f));
+
+			// Opaque draws are sorted front to back, transparent draws back to front.
+			Assert::IsTrue(RenderQueue::makeKey(RENDER_PASS_OPAQUE, 1, 1, 1, 2.0f) < RenderQueue::makeKey(RENDER_PASS_OPAQUE, 1, 1, 1, 3.0f));
+			Assert::IsTrue(RenderQueue::makeKey(RENDER_PASS_TRANSPARENT, 1, 1, 1, 3.0f) < RenderQueue::makeKey(RENDER_PASS_TRANSPARENT, 1, 1, 1, 2.0f));
+		}
+	};
+
+	TEST_CLASS(FrustumTest)
+	{
+	public:
+
+		TEST_METHOD(Culling)
+		{
+			Frustum frustum(glm::perspective(PI_2, 1.0f, 0.1f, 100.0f));
+
+			// Camera looks down -z.
+			Assert::IsTrue(frustum.intersects(glm::fvec3(0.0f, 0.0f, -10.0f), 1.0f));
+			Assert::IsFalse(frustum.intersects(glm::fvec3(0.0f, 0.0f, 10.0f), 1.0f));
+			Assert::IsFalse(frustum.intersects(glm::fvec3(0.0f, 0.0f, -200.0f), 1.0f));
+			// Center outside, but the sphere reaches into the frustum.
+			Assert::IsTrue(frustum.intersects(glm::fvec3(12.0f, 0.0f, -10.0f), 3.0f));
+
+			AABB box;
+			box.min = glm::fvec3(-1.0f, -1.0f, -11.0f);
+			box.max = glm::fvec3(1.0f, 1.0f, -9.0f);
+			Assert::IsTrue(frustum.test(box) == FRUSTUM_INSIDE);
+			box.min.x = -50.0f;
+			Assert::IsTrue(frustum.test(box) == FRUSTUM_INTERSECTS);
+
+			// The packed (SIMD) test has to agree with the scalar test.
+			const unsigned int n = 1003;
+			std::vector<float> x(n), y(n), z(n), r(n);
+			for (unsigned int i = 0; i < n; i++) {
+				x[i] = (float)(i % 37) - 18.0f;
+				y[i] = (float)(i % 11) - 5.0f;
+				z[i] = -(float)(i % 131) + 10.0f;
+				r[i] = (float)(i % 5) * 0.5f;
+			}
+			std::vector<unsigned char> visible(n), visibleScalar(n);
+			unsigned int nVisible = frustum.cullSpheres(&x[0], &y[0], &z[0], &r[0], n, &visible[0]);
+			Assert::AreEqual(frustum.cullSpheresScalar(&x[0], &y[0], &z[0], &r[0], n, &visibleScalar[0]), nVisible);
+			Assert::IsTrue(visible == visibleScalar);
+
+			// The hierarchy has to find the same boxes as testing them one by one.
+			std::vector<AABB> boxes(n);
+			unsigned int nVisibleBoxes = 0;
+			for (unsigned int i = 0; i < n; i++) {
+				boxes[i].min = glm::fvec3(x[i], y[i], z[i]) - r[i];
+				boxes[i].max = glm::fvec3(x[i], y[i], z[i]) + r[i];
+				if (frustum.intersects(boxes[i])) nVisibleBoxes++;
+			}
+			BoundingVolumeHierarchy bvh;
+			bvh.build(boxes);
+			std::vector<unsigned int> visibleBoxes;
+			bvh.cull(frustum, visibleBoxes);
+			Assert::AreEqual(nVisibleBoxes, (unsigned int)visibleBoxes.size());
+
+			// After moving the boxes, refitting has to give the same result as rebuilding.
+			nVisibleBoxes = 0;
+			for (unsigned int i = 0; i < n; i++) {
+				boxes[i].min.x += (float)(i % 7) * 3.0f - 9.0f;
+				boxes[i].max.x += (float)(i % 7) * 3.0f - 9.0f;
+				if (frustum.intersects(boxes[i])) nVisibleBoxes++;
+			}
+			unsigned int nNodes = bvh.getNumNodes();
+			bvh.refit(boxes);
+			Assert::AreEqual(nNodes, bvh.getNumNodes());
+			visibleBoxes.clear();
+			bvh.cull(frustum, visibleBoxes);
+			Assert::AreEqual(nVisibleBoxes, (unsigned int)visibleBoxes.size());
+		}
+	};
+
+	TEST_CLASS(LightClustererTest)
+	{
+	public:
+
+		// Random lights in front of a camera looking down -z.
+		void makeLights(unsigned int n, std::vector<float> & x, std::vector<float> & y, std::vector<float> & z, std::vector<float> & r)
+		{
+			x.resize(n);
+			y.resize(n);
+			z.resize(n);
+			r.resize(n);
+			for (unsigned int i = 0; i < n; i++) {
+				x[i] = (float)((i * 7919) % 1201) * 0.1f - 60.0f;
+				y[i] = (float)((i * 104729) % 601) * 0.1f - 30.0f;
+				z[i] = -(float)((i * 1299709) % 1101) * 0.1f + 5.0f;
+				r[i] = 0.5f + (float)(i % 8) * 0.5f;
+			}
+		}
+
+		TEST_METHOD(Assignment)
+		{
+			LightClusterer clusterer;
+			clusterer.setProjection(glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f), 0.1f, 100.0f);
+			std::vector<float> x, y, z, r;
+			makeLights(1000, x, y, z, r);
+			clusterer.assign(&x[0], &y[0], &z[0], &r[0], 1000);
+
+			// Every point inside a light's sphere has to find the light in its cluster.
+			const std::vector<unsigned int> & clusters = clusterer.getClusters();
+			const std::vector<unsigned int> & indices = clusterer.getIndices();
+			glm::fvec3 offsets[7] = { glm::fvec3(0.0f), glm::fvec3(1.0f, 0.0f, 0.0f), glm::fvec3(-1.0f, 0.0f, 0.0f),
+				glm::fvec3(0.0f, 1.0f, 0.0f), glm::fvec3(0.0f, -1.0f, 0.0f), glm::fvec3(0.0f, 0.0f, 1.0f), glm::fvec3(0.0f, 0.0f, -1.0f) };
+			for (unsigned int i = 0; i < 1000; i++) {
+				for (glm::fvec3 offset : offsets) {
+					int c = clusterer.findCluster(glm::fvec3(x[i], y[i], z[i]) + 0.99f * r[i] * offset);
+					if (c < 0 || clusters[2 * c + 1] >= CLUSTER_MAX_LIGHTS) continue;
+					std::vector<unsigned int>::const_iterator first = indices.begin() + clusters[2 * c];
+					std::vector<unsigned int>::const_iterator last = first + clusters[2 * c + 1];
+					Assert::IsTrue(std::find(first, last, i) != last);
+				}
+			}
+		}
+
+		TEST_METHOD(AssignmentBenchmark)
+		{
+			LightClusterer clusterer;
+			clusterer.setProjection(glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f), 0.1f, 100.0f);
+			ThreadPool pool;
+			const int nRepetitions = 20;
+
+			for (unsigned int n : { 1000, 2500, 5000, 10000 }) {
+				std::vector<float> x, y, z, r;
+				makeLights(n, x, y, z, r);
+				double ms[2];
+				for (int threaded = 0; threaded < 2; threaded++) {
+					std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+					for (int i = 0; i < nRepetitions; i++)
+						clusterer.assign(&x[0], &y[0], &z[0], &r[0], n, threaded ? &pool : NULL);
+					ms[threaded] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / nRepetitions;
+				}
+
+				std::string msg = "Light assignment of " + std::to_string(n) + " lights: " + std::to_string(ms[0]) + " ms, "
+					+ std::to_string(pool.getNumThreads()) + " threads " + std::to_string(ms[1]) + " ms ("
+					+ std::to_string(clusterer.getIndices().size()) + " indices)\n";
+				Logger::WriteMessage(msg.c_str());
+			}
+		}
+	};
+
+	TEST_CLASS(MeshOptimizerTest)
+	{
+	public:
+
+		// Grid of n x n quads with the triangles in a scrambled order.
+		void makeGrid(unsigned int n, std::vector<Vertex> & vertices, std::vector<unsigned int> & indices)
+		{
+			vertices.clear();
+			indices.clear();
+			for (unsigned int y = 0; y <= n; y++) {
+				for (unsigned int x = 0; x <= n; x++) {
+					Vertex v = Vertex();
+					v.position = glm::fvec3((float)x, (float)y, 0.0f);
+					v.normal = glm::fvec3(0.0f, 0.0f, 1.0f);
+					vertices.push_back(v);
+				}
+			}
+			unsigned int nQuads = n * n;
+			for (unsigned int i = 0; i < nQuads; i++) {
+				unsigned int q = (i * 7919) % nQuads;
+				unsigned int v = (q / n) * (n + 1) + q % n;
+				unsigned int quad[6] = { v, v + 1, v + n + 2, v, v + n + 2, v + n + 1 };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+
+		// Triangles as sorted position keys, independent of the vertex and triangle order.
+		std::vector<std::vector<float>> getTriangles(const std::vector<Vertex> & vertices, const std::vector<unsigned int> & indices)
+		{
+			std::vector<std::vector<float>> triangles;
+			for (unsigned int t = 0; t < indices.size(); t += 3) {
+				std::vector<float> tri;
+				for (unsigned int k = 0; k < 3; k++) {
+					const glm::fvec3 & p = vertices[indices[t + k]].position;
+					tri.push_back(p.x * 1000.0f + p.y);
+				}
+				std::sort(tri.begin(), tri.end());
+				triangles.push_back(tri);
+			}
+			std::sort(triangles.begin(), triangles.end());
+			return triangles;
+		}
+
+		TEST_METHOD(Optimize)
+		{
+			std::vector<Vertex> vertices;
+			std::vector<unsigned int> indices;
+			makeGrid(64, vertices, indices);
+			std::vector<std::vector<float>> triangles = getTriangles(vertices, indices);
+
+			MeshOptimizationStats stats = MeshOptimizer::optimize(vertices, indices);
+			std::string msg = "Grid: ACMR " + std::to_string(stats.acmrBefore) + " -> " + std::to_string(stats.acmrAfter)
+				+ ", ATVR " + std::to_string(stats.atvrBefore) + " -> " + std::to_string(stats.atvrAfter) + "\n";
+			Logger::WriteMessage(msg.c_str());
+
+			Assert::IsTrue(stats.acmrAfter < 1.0f);
+			Assert::IsTrue(stats.acmrAfter < stats.acmrBefore);
+			Assert::IsTrue(stats.atvrAfter < stats.atvrBefore);
+			Assert::IsTrue(getTriangles(vertices, indices) == triangles);
+			// The vertices are stored in the order of their first use:
+			unsigned int next = 0;
+			for (unsigned int i : indices) {
+				Assert::IsTrue(i <= next);
+				if (i == next) next++;
+			}
+			Assert::AreEqual((unsigned int)vertices.size(), next);
+		}
+	};
+
+	TEST_CLASS(MeshSimplifierTest)
+	{
+	public:
+
+		// Grid of n x n quads in the xy plane, displaced along z by height(x, y). With a seam,
+		// the quads right of x = n / 2 use copies of the vertices on that column, which are
+		// appended after the grid.
+		template <typename H>
+		void makeGrid(unsigned int n, bool seam, H height, std::vector<Vertex> & vertices, std::vector<unsigned int> & indices)
+		{
+			vertices.clear();
+			indices.clear();
+			for (unsigned int y = 0; y <= n; y++) {
+				for (unsigned int x = 0; x <= n; x++) {
+					Vertex v = Vertex();
+					v.position = glm::fvec3((float)x, (float)y, height((float)x, (float)y));
+					v.normal = glm::fvec3(0.0f, 0.0f, 1.0f);
+					v.uv = glm::fvec2((float)x / n, (float)y / n);
+					vertices.push_back(v);
+				}
+			}
+			unsigned int copies = vertices.size();
+			for (unsigned int y = 0; seam && y <= n; y++) {
+				Vertex copy = vertices[y * (n + 1) + n / 2];
+				copy.uv.x += 0.5f;
+				vertices.push_back(copy);
+			}
+			for (unsigned int y = 0; y < n; y++) {
+				for (unsigned int x = 0; x < n; x++) {
+					unsigned int v = y * (n + 1) + x;
+					unsigned int quad[6] = { v, v + 1, v + n + 2, v, v + n + 2, v + n + 1 };
+					for (unsigned int & i : quad) {
+						if (seam && x >= n / 2 && i % (n + 1) == n / 2) i = copies + i / (n + 1);
+					}
+					indices.insert(indices.end(), quad, quad + 6);
+				}
+			}
+		}
+
+		TEST_METHOD(PlaneKeepsBordersAndSeams)
+		{
+			const unsigned int n = 32;
+			std::vector<Vertex> vertices;
+			std::vector<unsigned int> indices, result;
+			makeGrid(n, true, [](float, float) { return 0.0f; }, vertices, indices);
+
+			unsigned int target = indices.size() / 4;
+			float error = MeshSimplifier::simplify(&vertices[0], vertices.size(), &indices[0], indices.size(), target, 0.001f, result);
+			Assert::IsTrue(result.size() <= target);
+			Assert::IsTrue(result.size() > 0);
+			Assert::IsTrue(error <= 0.001f);
+
+			// The triangles still tile the square without flipping, so the borders did not
+			// move inwards.
+			float area = 0.0f;
+			for (unsigned int t = 0; t < result.size(); t += 3) {
+				glm::fvec3 a = vertices[result[t]].position, b = vertices[result[t + 1]].position, c = vertices[result[t + 2]].position;
+				float signedArea = 0.5f * glm::cross(b - a, c - a).z;
+				Assert::IsTrue(signedArea > 0.0f);
+				area += signedArea;
+			}
+			Assert::IsTrue(fabsf(area - (float)(n * n)) < 0.01f);
+
+			// The corners and both sides of the seam are kept.
+			std::vector<bool> used(vertices.size(), false);
+			for (unsigned int i : result)
+				used[i] = true;
+			unsigned int corners[4] = { 0, n, n * (n + 1), (n + 1) * (n + 1) - 1 };
+			for (unsigned int c : corners)
+				Assert::IsTrue(used[c]);
+			for (unsigned int y = 0; y <= n; y++)
+				Assert::IsTrue(used[y * (n + 1) + n / 2]);
+			for (unsigned int i = (n + 1) * (n + 1); i < vertices.size(); i++)
+				Assert::IsTrue(used[i]);
+		}
+
+		TEST_METHOD(LodHysteresis)
+		{
+			Mesh mesh;
+			makeGrid(32, false, [](float x, float y) { return 2.0f * sinf(x * 0.3f) * cosf(y * 0.3f); },
+				mesh.getVertices(), mesh.getIndices());
+			mesh.invalidate();
+			Assert::IsTrue(mesh.buildLods() >= 2);
+			for (unsigned int l = 1; l < mesh.getNumLods(); l++) {
+				Assert::IsTrue(mesh.getLod(l).indexCount < mesh.getLod(l - 1).indexCount);
+				Assert::IsTrue(mesh.getLod(l).error >= mesh.getLod(l - 1).error);
+			}
+			float e1 = mesh.getLod(1).error;
+			Assert::IsTrue(e1 > 0.0f);
+
+			// Screen radii at which the error of level 1 is the given fraction of pixelError.
+			const float pixelError = 1.0f, hysteresis = 0.25f;
+			float inBand = pixelError * (1.0f - hysteresis * 0.5f) / e1;
+			float belowBand = pixelError * (1.0f - hysteresis * 1.5f) / e1;
+			float above = pixelError * 1.1f / e1;
+
+			// Inside the hysteresis band the current level is kept in both directions.
+			Assert::AreEqual(0U, mesh.selectLod(inBand, pixelError, 0, hysteresis));
+			Assert::AreEqual(1U, mesh.selectLod(inBand, pixelError, 1, hysteresis));
+			// Below it, the coarser level is selected, above pixelError the finer one.
+			Assert::IsTrue(mesh.selectLod(belowBand, pixelError, 0, hysteresis) >= 1);
+			Assert::AreEqual(0U, mesh.selectLod(above, pixelError, 1, hysteresis));
+			// Without hysteresis, the band disappears.
+			Assert::AreEqual(1U, mesh.selectLod(inBand, pixelError, 0, 0.0f));
+		}
+	};
+
+	TEST_CLASS(FreeListAllocatorTest)
+	{
+	public:
+
+		TEST_METHOD(AllocateAndFree)
+		{
+			FreeListAllocator allocator(100);
+			unsigned int a = allocator.allocate(10);
+			unsigned int b = allocator.allocate(20, 8);
+			unsigned int c = allocator.allocate(30);
+			Assert::AreEqual(0u, a);
+			Assert::AreEqual(16u, b);
+			Assert::AreEqual(36u, c);
+			Assert::AreEqual(60u, allocator.getUsed());
+			Assert::AreEqual(FREE_LIST_INVALID, allocator.allocate(50));
+
+			// Freed ranges merge with their free neighbours:
+			allocator.free(b, 20);
+			Assert::AreEqual(2u, allocator.getNumFreeBlocks());
+			allocator.free(a, 10);
+			Assert::AreEqual(2u, allocator.getNumFreeBlocks());
+			Assert::AreEqual(0u, allocator.allocate(36));
+			allocator.free(0, 36);
+			allocator.free(c, 30);
+			Assert::AreEqual(1u, allocator.getNumFreeBlocks());
+			Assert::AreEqual(100u, allocator.getLargestFreeBlock());
+
+			// Growing extends the free block at the end:
+			unsigned int d = allocator.allocate(90);
+			allocator.grow(200);
+			Assert::AreEqual(1u, allocator.getNumFreeBlocks());
+			Assert::AreEqual(90u, allocator.allocate(110));
+			allocator.free(d, 90);
+			Assert::AreEqual(110u, allocator.getUsed());
+		}
+	};
+
+	TEST_CLASS(SceneCacheTest)
+	{
+	public:
+
+		TEST_METHOD(BakeAndLoad)
+		{
+			const std::string path = "..\\ogl-engine\\res\\Pool2.fbx";
+			const unsigned int flags = aiProcess_Triangulate | aiProcess_CalcTangentSpace | aiProcess_JoinIdenticalVertices | aiProcess_ValidateDataStructure;
+			typedef std::chrono::high_resolution_clock Clock;
+
+			// The import as without a cache: parse and convert the meshes.
+			Clock::time_point start = Clock::now();
+			Assimp::Importer importer;
+			const aiScene * scene = importer.ReadFile(path, flags);
+			if (scene == NULL) {
+				Logger::WriteMessage("Pool2.fbx not found, skipped.\n");
+				return;
+			}
+			std::vector<Mesh *> meshes;
+			for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+				meshes.push_back(new Mesh(scene->mMeshes[i], false));
+			double importTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+			start = Clock::now();
+			unsigned long long sourceHash = SceneCache::hashFile(path);
+			unsigned long long settingsHash = SceneCache::hashSettings(flags, true);
+			std::string cachePath = SceneCache::getCachePath(path) + ".test";
+			Assert::IsTrue(SceneCache::bake(cachePath, scene, meshes, sourceHash, settingsHash));
+			double bakeTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+			// Loading twice: the first load maps the file, the second one reuses its pages.
+			double loadTime[2];
+			for (int run = 0; run < 2; run++) {
+				start = Clock::now();
+				SceneCache cache;
+				Assert::IsTrue(cache.open(cachePath, sourceHash, settingsHash));
+				std::vector<Mesh *> loaded;
+				for (unsigned int i = 0; i < cache.getNumMeshes(); i++)
+					loaded.push_back(new Mesh(cache, i, false));
+				loadTime[run] = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+				Assert::AreEqual(scene->mNumMeshes, cache.getNumMeshes());
+				Assert::AreEqual(scene->mNumMaterials, cache.getNumMaterials());
+				Assert::AreEqual(scene->mNumCameras, cache.getNumCameras());
+				for (unsigned int i = 0; i < loaded.size(); i++) {
+					Assert::AreEqual(meshes[i]->getNumVertices(), loaded[i]->getNumVertices());
+					Assert::IsTrue(meshes[i]->getIndices() == loaded[i]->getIndices());
+					Assert::AreEqual(meshes[i]->getNumLods(), loaded[i]->getNumLods());
+					Assert::AreEqual(meshes[i]->getName(), loaded[i]->getName());
+					delete loaded[i];
+				}
+			}
+
+			// A cache of another source or other settings is not used:
+			SceneCache cache;
+			Assert::IsFalse(cache.open(cachePath, sourceHash + 1, settingsHash));
+			Assert::IsFalse(cache.open(cachePath, sourceHash, SceneCache::hashSettings(flags, false)));
+			for (Mesh * m : meshes)
+				delete m;
+			std::remove(cachePath.c_str());
+
+			std::string msg = "Import " + std::to_string(importTime) + " ms, bake " + std::to_string(bakeTime)
+				+ " ms, load from cache " + std::to_string(loadTime[0]) + " ms (first), " + std::to_string(loadTime[1]) + " ms (second)\n";
+			Logger::WriteMessage(msg.c_str());
+		}
+	};
+
+	TEST_CLASS(ObjParserTest)
+	{
+	public:
+
+		TEST_METHOD(PolygonsAndRelativeIndices)
+		{
+			const std::string obj =
+				"# Quad with texture coordinates and normals\n"
+				"v 0 0 0\nv 1 0 0\r\nv 1 1 0\nv 0 1 0\n"
+				"vt 0 0\nvt 1 1\nvn 0 0 1\n"
+				"f 1/1/1 2/2/1 3/1/1 4/2/1\n"
+				"f -4 -3 -2 # relative, without texture coordinates and normals\n"
+				"f 1//1 3//1 4//1\n";
+			ObjParser parser;
+			Assert::IsTrue(parser.parse(obj.c_str(), obj.size()));
+			Assert::AreEqual(4u, parser.getNumPositions());
+			Assert::AreEqual(3u, parser.getNumFaces());
+
+			std::vector<Vertex3D> & vertices = parser.getVertices();
+			std::vector<unsigned int> & indices = parser.getIndices();
+			// The quad becomes two triangles, the corners of equal indices are welded, and the
+			// same position with other attributes is another vertex:
+			Assert::AreEqual(12u, (unsigned int)indices.size());
+			Assert::AreEqual(0u, indices[3]);
+			Assert::AreEqual(2u, indices[4]);
+			Assert::AreNotEqual(indices[0], indices[9]);
+			Assert::AreEqual(10u, (unsigned int)vertices.size());
+			// The triangle without normals gets its face normal:
+			Assert::IsTrue(vertices[indices[6]].pos == glm::fvec3(0.0f, 0.0f, 0.0f));
+			Assert::IsTrue(vertices[indices[7]].pos == glm::fvec3(1.0f, 0.0f, 0.0f));
+			Assert::IsTrue(vertices[indices[6]].normal == glm::fvec3(0.0f, 0.0f, 1.0f));
+
+			// Indices out of range fail:
+			const std::string bad = "v 0 0 0\nf 1 2 -2\n";
+			Assert::IsFalse(parser.parse(bad.c_str(), bad.size()));
+
+			const char * numbers[] = { "0.037332", "-1.5e-3", "3.4028235e38", "123456789012345678901234", "1e-30", "+2.5" };
+			for (const char * n : numbers) {
+				float value;
+				ObjParser::parseFloat(n, n + strlen(n), value);
+				Assert::AreEqual(strtof(n, NULL), value);
+			}
+		}
+
+		TEST_METHOD(Benchmark)
+		{
+			typedef std::chrono::high_resolution_clock Clock;
+			ObjParser parser;
+			Clock::time_point start = Clock::now();
+			if (parser.parse("..\\ogl-engine\\res\\Pool.obj")) {
+				double time = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+				std::string msg = "Pool.obj: " + std::to_string(parser.getNumFaces()) + " faces, "
+					+ std::to_string(parser.getVertices().size()) + " vertices in " + std::to_string(time) + " ms\n";
+				Logger::WriteMessage(msg.c_str());
+			}
+		}
+
+		// A grid of 10M triangles (as quads with texture coordinates, about 550 MB), parsed on
+		// one thread and in chunks on a pool. Needs over 1 GB of memory, so it only runs when
+		// selected explicitly.
+		BEGIN_TEST_METHOD_ATTRIBUTE(LargeFileBenchmark)
+			TEST_IGNORE()
+		END_TEST_METHOD_ATTRIBUTE()
+		TEST_METHOD(LargeFileBenchmark)
+		{
+			typedef std::chrono::high_resolution_clock Clock;
+			ObjParser parser;
+			const int n = 2237;
+			std::string obj;
+			obj.reserve(600 << 20);
+			char line[128];
+			for (int y = 0; y <= n; y++) {
+				for (int x = 0; x <= n; x++) {
+					int length = snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", x * 0.01f, y * 0.01f, sinf(x * 0.1f) * 0.1f);
+					obj.append(line, length);
+				}
+			}
+			for (int y = 0; y <= n; y++) {
+				for (int x = 0; x <= n; x++) {
+					int length = snprintf(line, sizeof(line), "vt %.6f %.6f\n", x / float(n), y / float(n));
+					obj.append(line, length);
+				}
+			}
+			for (int y = 0; y < n; y++) {
+				for (int x = 0; x < n; x++) {
+					int a = y * (n + 1) + x + 1, b = a + 1, c = a + n + 1, d = c + 1;
+					int length = snprintf(line, sizeof(line), "f %d/%d %d/%d %d/%d %d/%d\n", a, a, b, b, d, d, c, c);
+					obj.append(line, length);
+				}
+			}
+
+			Clock::time_point start = Clock::now();
+			Assert::IsTrue(parser.parse(obj.c_str(), obj.size()));
+			double serialTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			Assert::AreEqual((unsigned int)((n + 1) * (n + 1)), (unsigned int)parser.getVertices().size());
+			Assert::AreEqual((unsigned int)(n * n * 6), (unsigned int)parser.getIndices().size());
+			std::vector<unsigned int> indices;
+			indices.swap(parser.getIndices());
+
+			ThreadPool pool;
+			start = Clock::now();
+			Assert::IsTrue(parser.parse(obj.c_str(), obj.size(), &pool));
+			double parallelTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			Assert::IsTrue(indices == parser.getIndices());
+
+			std::string msg = std::to_string(obj.size() >> 20) + " MB, " + std::to_string(n * n * 2) + " triangles: "
+				+ std::to_string(serialTime) + " ms, " + std::to_string(parallelTime) + " ms on " + std::to_string(pool.getNumThreads()) + " threads\n";
+			Logger::WriteMessage(msg.c_str());
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#include "TextureBuffer.h"
+#include "RenderStats.h"
+
+// Smallest buffer allocated, so the texture always has storage.
+#define TEXTURE_BUFFER_MIN_SIZE 16
+
+TextureBuffer::TextureBuffer(GLenum format)
+{
+	glGenBuffers(1, &TBO);
+	glBindBuffer(GL_TEXTURE_BUFFER, TBO);
+	glBufferData(GL_TEXTURE_BUFFER, TEXTURE_BUFFER_MIN_SIZE, NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, format, TBO);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+TextureBuffer::~TextureBuffer()
+{
+	if (texture) glDeleteTextures(1, &texture);
+	if (TBO) glDeleteBuffers(1, &TBO);
+}
+
+void TextureBuffer::update(const void * data, GLsizeiptr size)
+{
+	this->size = size;
+	glBindBuffer(GL_TEXTURE_BUFFER, TBO);
+	glBufferData(GL_TEXTURE_BUFFER, size > TEXTURE_BUFFER_MIN_SIZE ? size : TEXTURE_BUFFER_MIN_SIZE, NULL, GL_STREAM_DRAW);
+	if (size > 0) glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	renderStats.textureBufferUploads++;
+}
+
+GLuint TextureBuffer::getTexture()
+{
+	return texture;
+}
+
+GLuint TextureBuffer::getBuffer()
+{
+	return TBO;
+}
+
+GLsizeiptr TextureBuffer::getSize()
+{
+	return size;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <glad\glad.h>
+
+// Buffer object read by shaders through a buffer texture (samplerBuffer / usamplerBuffer and
+// texelFetch). Unlike uniform buffers, buffer textures can hold millions of elements, so
+// they are used for data of variable length such as the light lists of the clusters.
+class TextureBuffer
+{
+public:
+	// format is the internal format of the texels, e.g. GL_RGBA32F or GL_R32UI.
+	TextureBuffer(GLenum format);
+	~TextureBuffer();
+
+	// Replace the contents with size bytes of data. The old storage is orphaned, so the
+	// upload does not have to wait for draws that still read the previous contents.
+	void update(const void * data, GLsizeiptr size);
+
+	// The buffer texture, to be bound to GL_TEXTURE_BUFFER.
+	GLuint getTexture();
+	GLuint getBuffer();
+	GLsizeiptr getSize();
+
+private:
+	GLuint TBO = 0;
+	GLuint texture = 0;
+	GLsizeiptr size = 0;
+};
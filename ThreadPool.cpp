@@ -0,0 +1,66 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int nThreads)
+{
+	if (nThreads == 0) {
+		unsigned int hw = std::thread::hardware_concurrency();
+		nThreads = hw > 1 ? hw - 1 : 1;
+	}
+	for (unsigned int i = 0; i < nThreads; i++)
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	jobAvailable.notify_all();
+	for (std::thread & t : workers)
+		t.join();
+}
+
+void ThreadPool::submit(std::function<void()> job)
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		jobs.push_back(job);
+	}
+	jobAvailable.notify_one();
+}
+
+void ThreadPool::wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	jobsDone.wait(lock, [this] { return jobs.empty() && active == 0; });
+}
+
+unsigned int ThreadPool::getNumThreads()
+{
+	return workers.size();
+}
+
+void ThreadPool::workerLoop()
+{
+	while (true) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+			if (stopping && jobs.empty()) return;
+
+			job = jobs.front();
+			jobs.pop_front();
+			active++;
+		}
+
+		job();
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			active--;
+			if (jobs.empty() && active == 0) jobsDone.notify_all();
+		}
+	}
+}
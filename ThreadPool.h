@@ -0,0 +1,85 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+// Fixed-size pool of worker threads that execute submitted jobs in FIFO order.
+class ThreadPool
+{
+public:
+	// Create a pool with nThreads workers. If 0 is passed, one worker per hardware
+	// thread (minus the calling thread) is created, but at least one.
+	ThreadPool(unsigned int nThreads = 0);
+	~ThreadPool();
+
+	// Queue a job for execution on one of the worker threads.
+	void submit(std::function<void()> job);
+
+	// Block the calling thread until the queue is empty and no job is running.
+	void wait();
+
+	// Returns the number of worker threads.
+	unsigned int getNumThreads();
+
+	// Run fn(i) for i = 0 to count - 1 on the pool's threads and wait for all of them. Runs
+	// on the calling thread if pool is NULL. The calling thread takes part in the work and
+	// only waits for the calls of fn, not for other jobs of the pool, so this may also be
+	// called from a job of the same pool (e.g. from System::update()).
+	template <typename F>
+	static void parallelFor(ThreadPool * pool, unsigned int count, F fn)
+	{
+		if (pool == NULL || count < 2) {
+			for (unsigned int i = 0; i < count; i++)
+				fn(i);
+			return;
+		}
+		// Helpers that only start after all indices are taken return without touching fn,
+		// so the state they share outlives this call, but fn does not have to.
+		std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>();
+		std::function<void()> work = [state, &fn, count] {
+			unsigned int i;
+			while ((i = state->next++) < count) {
+				fn(i);
+				if (++state->done == count) {
+					std::unique_lock<std::mutex> lock(state->mutex);
+					state->finished.notify_all();
+				}
+			}
+		};
+		unsigned int helpers = std::min(count - 1, pool->getNumThreads());
+		for (unsigned int i = 0; i < helpers; i++)
+			pool->submit(work);
+		work();
+
+		std::unique_lock<std::mutex> lock(state->mutex);
+		state->finished.wait(lock, [&state, count] { return state->done == count; });
+	}
+
+private:
+	// Progress of a parallelFor() call.
+	struct ParallelForState {
+		std::atomic<unsigned int> next{0};
+		std::atomic<unsigned int> done{0};
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+
+	std::mutex mutex;
+	std::condition_variable jobAvailable;
+	std::condition_variable jobsDone;
+
+	unsigned int active = 0;
+	bool stopping = false;
+
+	void workerLoop();
+};
@@ -4,6 +4,8 @@
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtx/matrix_decompose.hpp"
 
+std::atomic<unsigned int> Transform3D::nextVersion(1);
+
 Transform3D::Transform3D()
 {
 }
@@ -15,7 +17,9 @@ Transform3D::~Transform3D()
 		std::vector<Transform3D *>::iterator it = std::find(this->parent->children.begin(), this->parent->children.end(), this);
 		this->parent->children.erase(it);
 	}
-	for (Transform3D * tf : children) {
+	// setParent() removes the child from children, so iterate over a copy.
+	std::vector<Transform3D *> kids = children;
+	for (Transform3D * tf : kids) {
 		tf->setParent(NULL, true);
 	}
 
@@ -338,11 +342,17 @@ glm::fvec3 Transform3D::getScaleGlobal()
 void Transform3D::invalidate()
 {
 	valid = false;
+	version = nextVersion++;
 	for (Transform3D * tf : children) {
 		tf->invalidate();
 	}
 }
 
+unsigned int Transform3D::getVersion()
+{
+	return version;
+}
+
 void Transform3D::setParent(Transform3D * parent, bool keepGlobalTF)
 {
 	glm::fmat4 oldTF = this->getTransform();
@@ -360,6 +370,16 @@ void Transform3D::setParent(Transform3D * parent, bool keepGlobalTF)
 	invalidate();
 }
 
+Transform3D * Transform3D::getParent()
+{
+	return parent;
+}
+
+const std::vector<Transform3D *> & Transform3D::getChildren()
+{
+	return children;
+}
+
 void Transform3D::validate()
 {
 	// This function is used to not recalculate the transformation matrix with every
@@ -5,6 +5,7 @@
 #include "glm\gtx\quaternion.hpp"
 
 #include <vector>
+#include <atomic>
 
 class Transform3D
 {
@@ -262,6 +263,11 @@ public:
 	// recalculated on the next call of getTransform() or getTransformInverted().
 	void invalidate();
 
+	// Get the version of the (global) transformation. It changes whenever the Transform3D
+	// or one of its parents is altered, and no two states of any Transform3Ds share the
+	// same version, so it can be used to detect changes (e.g. to reuse cached shadow maps).
+	unsigned int getVersion();
+
 	// Set the Transform3D's parent. If the global position, orientation, and scale
 	// should be kept, set keepGlobalTF = true. If instead the Transform3D's relative
 	// transformation to its parent object should stay constant, set keepGlobalTF = false.
@@ -270,6 +276,9 @@ public:
 	// Pass a pointer to a parent object (can be NULL), and optionally a boolean whether
 	// the global transformation should be kept.
 	void setParent(Transform3D * parent, bool keepGlobalTF = true);
+	// The parent (NULL if there is none) and the children of the Transform3D.
+	Transform3D * getParent();
+	const std::vector<Transform3D *> & getChildren();
 
 private:
 	//Does this transform have a parent?
@@ -281,6 +290,9 @@ private:
 	// Are the current transformation matrices still valid?
 	bool valid = true;
 
+	unsigned int version = nextVersion++;
+	static std::atomic<unsigned int> nextVersion;
+
 	glm::fmat4 transformation = glm::fmat4(1.0f);
 	glm::fmat4 inverseT = glm::fmat4(1.0f);
 
@@ -1,12 +1,12 @@
 #include "TriangleModel.h"
+#include "GLState.h"
+#include "RenderStats.h"
 #include <glm/gtc/type_ptr.hpp>
 
 #include <stdio.h>
 #include <iostream>
-#include <sstream>
-#include <fstream>
 #include <string>
-#include <unordered_map>
+#include <algorithm>
 
 TriangleModel::TriangleModel()
 {
@@ -14,163 +14,79 @@ TriangleModel::TriangleModel()
 
 TriangleModel::~TriangleModel()
 {
+	delete stream;
 }
 
-TriangleModel* TriangleModel::loadOBJ(const char * filePath)
+TriangleModel* TriangleModel::loadOBJ(const char * filePath, ThreadPool * pool)
 {
-	TriangleModel * res = new TriangleModel();
-	std::ifstream infile(filePath);
-	std::string line;
-
-	int i_normals = 1;
-	int i_vertices = 1;
-	int i_texCoords = 1;
-
-	std::unordered_map<int, int> mapVertices;
-
-	while (infile.good() && std::getline(infile, line))
-	{
-		std::stringstream ssin(line);
-
-		// Parse vertex data:
-		if (line.at(0) == 'v') {
-			// Texture (UV) coordinates:
-			if (line.at(1) == 't') {
-				char d;
-				float x, y;
-				ssin >> d >> d >> x >> y;
-				glm::fvec2 texCoord(x, y);
-
-				res->texCoords.insert(std::pair<int, glm::fvec2>(i_texCoords, texCoord));
-				i_texCoords++;
-			}
-			// Vertex normals:
-			else if (line.at(1) == 'n') {
-				char d;
-				float x, y, z;
-				ssin >> d >> d >> x >> y >> z;
-				glm::fvec3 normal(x, y, z);
-
-				res->vertexNormals.insert(std::pair<int, glm::fvec3>(i_normals, normal));
-				i_normals++;
-			}
-			// Vertices:
-			else {
-				char d;
-				float x, y, z;
-				ssin >> d >> x >> y >> z;
-				glm::fvec3 vertex(x, y, z);
-
-				res->vertices.insert(std::pair<int, glm::fvec3>(i_vertices, vertex));
-				i_vertices++;
-			}
-		}
-		// Parse faces:
-		else if (line.at(0) == 'f') {
-			char d;
-			std::string set0, set1, set2;
-			ssin >> d >> set0 >> set1 >> set2;
-
-			Triangle tri;
-
-			// OBJ face format: f [Vertex]/[TexCoord]/[Normal]
-			std::stringstream ss0(set0);
-			ss0 >> tri.v0 >> d >> tri.tex0 >> d >> tri.n0;
-			std::stringstream ss1(set1);
-			ss1 >> tri.v1 >> d >> tri.tex1 >> d >> tri.n1;
-			std::stringstream ss2(set2);
-			ss2 >> tri.v2 >> d >> tri.tex2 >> d >> tri.n2;
-
-			res->tris.push_back(tri);
-
-		}
+	ObjParser parser;
+	if (!parser.parse(filePath, pool)) {
+		std::cerr << "TriangleModel.cpp: ERROR when loading " << filePath << ". " << parser.getError() << std::endl;
+		return NULL;
 	}
-	unsigned int i = 0;
-	for (Triangle tri : res->tris) {
-		Vertex3D u, v, w;
-		
-		u.pos = res->vertices.at(tri.v0);
-		u.normal = res->vertexNormals.at(tri.n0);
-		u.tex = res->texCoords.at(tri.tex0);
-		
-		int index;
-		if (res->isVertexKnown(u, index)) {
-			res->indices.push_back(index);
-		}
-		else {
-			res->indices.push_back(res->faceVertices.size());
-			res->faceVertices.push_back(u);
-		}
-
-		v.pos = res->vertices.at(tri.v1);
-		v.normal = res->vertexNormals.at(tri.n1);
-		v.tex = res->texCoords.at(tri.tex1);
-
-		if (res->isVertexKnown(v, index)) {
-			res->indices.push_back(index);
-		}
-		else {
-			res->indices.push_back(res->faceVertices.size());
-			res->faceVertices.push_back(v);
-		}
-
-		w.pos = res->vertices.at(tri.v2);
-		w.normal = res->vertexNormals.at(tri.n2);
-		w.tex = res->texCoords.at(tri.tex2);
-
-		if (res->isVertexKnown(w, index)) {
-			res->indices.push_back(index);
-		}
-		else {
-			res->indices.push_back(res->faceVertices.size());
-			res->faceVertices.push_back(w);
-		}
-
-	}
-	res->setupBuffers();
+	TriangleModel * res = new TriangleModel();
+	res->faceVertices.swap(parser.getVertices());
+	res->indices.swap(parser.getIndices());
+	if (!res->faceVertices.empty()) res->setupBuffers();
 	return res;
 }
 
+void TriangleModel::draw(Shader & s)
+{
+	// A file without faces has no buffers.
+	if (indices.empty()) return;
+	updateBuffers();
 
+	s.set(s.uniforms.model, transform.getTransform());
 
-void TriangleModel::draw(Shader s)
-{
-	if (!valid) {
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		//Array buffer for all vertices:
-		glBufferData(GL_ARRAY_BUFFER, faceVertices.size() * sizeof(Vertex3D), &faceVertices[0], GL_STATIC_DRAW);
+	GLState::bindTexture(0, GL_TEXTURE_2D, texture);
 
-		valid = true;
-	}
+	glDrawElementsBaseVertex(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0, getBaseVertex());
+	renderStats.drawCalls++;
 
-	s.setMat4("model", transform.getTransform());
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texture);
+}
 
-	glBindVertexArray(VAO);
-	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+void TriangleModel::draw(GLenum mode, Shader & s)
+{
+	if (indices.empty()) return;
+	updateBuffers();
 
+	GLState::bindTexture(0, GL_TEXTURE_2D, texture);
 
+	GLint baseVertex = getBaseVertex();
+	for (int i = 0; i < indices.size(); i += 3)
+		glDrawElementsBaseVertex(mode, 3, GL_UNSIGNED_INT, (void*)(i * sizeof(GLuint)), baseVertex);
+	renderStats.drawCalls += indices.size() / 3;
 }
 
-void TriangleModel::draw(GLenum mode, Shader s)
+void TriangleModel::updateBuffers()
 {
-	if (!valid) {
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		//Array buffer for all vertices:
-		glBufferData(GL_ARRAY_BUFFER, faceVertices.size() * sizeof(Vertex3D), &faceVertices[0], GL_STATIC_DRAW);
-
-		valid = true;
+	GLState::bindVertexArray(VAO);
+	if (valid) return;
+
+	GLsizeiptr size = faceVertices.size() * sizeof(Vertex3D);
+	if (stream == NULL || stream->getSize() != size) {
+		// The vertices change after their first upload: stream them from now on instead of
+		// reallocating the vertex buffer on every change.
+		delete stream;
+		stream = new StreamBuffer(size, &faceVertices[0]);
+		glBindBuffer(GL_ARRAY_BUFFER, stream->getBuffer());
+		setupAttributes();
+		if (VBO) glDeleteBuffers(1, &VBO);
+		VBO = 0;
+	}
+	else if (dirtyEnd > dirtyBegin) {
+		stream->invalidate((GLintptr)dirtyBegin * sizeof(Vertex3D), (GLsizeiptr)(dirtyEnd - dirtyBegin) * sizeof(Vertex3D));
+		stream->update(&faceVertices[0]);
 	}
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texture);
+	dirtyBegin = dirtyEnd = 0;
+	valid = true;
+}
 
-	glBindVertexArray(VAO);
-	for (int i = 0; i < indices.size(); i += 3)
-		glDrawElements(mode, 3, GL_UNSIGNED_INT, (void*)(i * sizeof(GLuint)));
-	glBindVertexArray(0);
+GLint TriangleModel::getBaseVertex()
+{
+	return stream ? (GLint)(stream->getRegion() * faceVertices.size()) : 0;
 }
 
 void TriangleModel::setTexture(GLuint tex)
@@ -180,6 +96,22 @@ void TriangleModel::setTexture(GLuint tex)
 
 void TriangleModel::invalidate()
 {
+	invalidate(0, faceVertices.size());
+}
+
+void TriangleModel::invalidate(unsigned int firstVertex, unsigned int count)
+{
+	unsigned int end = std::min(firstVertex + count, (unsigned int)faceVertices.size());
+	if (firstVertex < end) {
+		if (dirtyEnd > dirtyBegin) {
+			dirtyBegin = std::min(dirtyBegin, firstVertex);
+			dirtyEnd = std::max(dirtyEnd, end);
+		}
+		else {
+			dirtyBegin = firstVertex;
+			dirtyEnd = end;
+		}
+	}
 	valid = false;
 }
 
@@ -212,11 +144,21 @@ void TriangleModel::setupBuffers()
 
 	//Array buffer for all vertices:
 	glBufferData(GL_ARRAY_BUFFER, faceVertices.size() * sizeof(Vertex3D), &faceVertices[0], GL_STATIC_DRAW);
+	renderStats.bufferBytesUploaded += faceVertices.size() * sizeof(Vertex3D);
 
 	//Element buffer for all triangles:
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
 
+	setupAttributes();
+
+	glBindVertexArray(0);
+
+	valid = true;
+}
+
+void TriangleModel::setupAttributes()
+{
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex3D), (void*)offsetof(Vertex3D, pos));
 
@@ -225,20 +167,4 @@ void TriangleModel::setupBuffers()
 
 	glEnableVertexAttribArray(2);
 	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex3D), (void*)offsetof(Vertex3D, tex));
-
-	glBindVertexArray(0);
-
-	valid = true;
-}
-
-bool TriangleModel::isVertexKnown(Vertex3D v, int& index)
-{
-	for (int i = 0; i < faceVertices.size(); ++i) {
-		Vertex3D u = faceVertices.at(i);
-		if (u == v) {
-			index = i;
-			return true;
-		}
-	}
-	return false;
 }
@@ -4,28 +4,11 @@
 #include <glm/glm.hpp>
 
 #include <vector>
-#include <map>
 
 #include "Shader.h"
 #include "Transform3D.h"
-
-struct Vertex3D {
-	glm::fvec3 pos;
-	glm::fvec3 normal;
-	glm::fvec2 tex;
-
-	inline bool operator==(const Vertex3D & u) const {
-		bool comparison = (u.pos == pos && u.normal == normal && u.tex == tex);
-		return comparison;
-	}
-};
-
-
-struct Triangle {
-	int v0, v1, v2;
-	int n0, n1, n2;
-	int tex0, tex1, tex2;
-};
+#include "StreamBuffer.h"
+#include "ObjParser.h"
 
 class TriangleModel
 {
@@ -33,13 +16,18 @@ public:
 	TriangleModel();
 	~TriangleModel();
 
-	static TriangleModel* loadOBJ(const char * filePath);
+	// Load the geometry of an OBJ file (see ObjParser), parsed in parallel on pool if given.
+	// Returns NULL if the file cannot be read or is invalid.
+	static TriangleModel* loadOBJ(const char * filePath, ThreadPool * pool = NULL);
 
-	void draw(Shader s);
-	void draw(GLenum mode, Shader s);
+	void draw(Shader & s);
+	void draw(GLenum mode, Shader & s);
 	void setTexture(GLuint tex);
 
 	void invalidate();
+	// Mark count vertices starting at firstVertex as changed. Once the vertices changed,
+	// they are streamed (see StreamBuffer) and only the changed ones are uploaded.
+	void invalidate(unsigned int firstVertex, unsigned int count);
 
 	Transform3D * getTransform();
 	void setTransformGlobal(glm::fmat4 model);
@@ -48,31 +36,25 @@ public:
 
 private:
 	GLuint texture = 0;
-	GLuint VAO, VBO, EBO;
+	GLuint VAO = 0, VBO = 0, EBO = 0;
 
 	bool valid = false;
+	// Replaces the VBO once the vertices change. [dirtyBegin, dirtyEnd) are the vertices
+	// changed since the last upload.
+	StreamBuffer * stream = NULL;
+	unsigned int dirtyBegin = 0, dirtyEnd = 0;
 
 	Transform3D transform = Transform3D();
 
 	void setupBuffers();
-
-	std::map<int, glm::fvec3> vertices;
-	std::map<int, glm::fvec3> vertexNormals;
-	std::map<int, glm::fvec2> texCoords;
-
-	std::vector<Triangle> tris;
+	// Source the vertex attributes from the bound GL_ARRAY_BUFFER. The vertex array must be bound.
+	void setupAttributes();
+	// Upload the changed vertices and bind the vertex array.
+	void updateBuffers();
+	// First vertex of the stream region to draw.
+	GLint getBaseVertex();
 
 	std::vector<unsigned int> indices;
 	std::vector<Vertex3D> faceVertices;
-
-	bool isVertexKnown(Vertex3D v, int& index);
-
-	static int hashVertex3D(Vertex3D v) {
-		std::hash<int> intHash;
-		size_t v1 = intHash(v.pos.x) ^ (intHash(v.pos.y) << 1) ^ (intHash(v.pos.z) << 2);
-		size_t v2 = intHash(v.normal.x) ^ (intHash(v.normal.y) << 1) ^ (intHash(v.normal.z) << 2);
-		size_t v3 = intHash(v.tex.x) ^ (intHash(v.tex.y) << 1);
-		return (int) (v1 ^ (v2 << 1) ^ (v3 << 2));
-	}
 };
 
@@ -0,0 +1,51 @@
+#include "UniformBuffer.h"
+#include "RenderStats.h"
+
+#include <iostream>
+
+UniformBuffer::UniformBuffer(GLuint binding, GLsizeiptr size)
+{
+	this->binding = binding;
+	this->size = size;
+
+	glGenBuffers(1, &UBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+	glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, binding, UBO);
+}
+
+UniformBuffer::~UniformBuffer()
+{
+	if (UBO) glDeleteBuffers(1, &UBO);
+}
+
+void UniformBuffer::update(const void * data, GLsizeiptr size, GLintptr offset)
+{
+	if (offset + size > this->size) {
+		std::cerr << "UniformBuffer.cpp: ERROR while updating buffer. Data exceeds the buffer size." << std::endl;
+		return;
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+	if (offset == 0 && size == this->size)
+		glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	renderStats.uniformBlockUploads++;
+}
+
+GLuint UniformBuffer::getID()
+{
+	return UBO;
+}
+
+GLuint UniformBuffer::getBinding()
+{
+	return binding;
+}
+
+GLsizeiptr UniformBuffer::getSize()
+{
+	return size;
+}
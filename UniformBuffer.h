@@ -0,0 +1,28 @@
+#pragma once
+
+#include <glad\glad.h>
+
+// Uniform buffer object attached to a fixed binding point. All shader programs whose
+// uniform block is assigned to the same binding point read from it, so its contents only
+// have to be uploaded once per frame, no matter how many programs use them.
+class UniformBuffer
+{
+public:
+	// Create a buffer of the given size in bytes and attach it to the binding point.
+	UniformBuffer(GLuint binding, GLsizeiptr size);
+	~UniformBuffer();
+
+	// Upload size bytes of data, starting at offset bytes into the buffer. When the whole
+	// buffer is replaced, its old storage is orphaned so the upload does not have to wait
+	// for draws that still read the previous contents.
+	void update(const void * data, GLsizeiptr size, GLintptr offset = 0);
+
+	GLuint getID();
+	GLuint getBinding();
+	GLsizeiptr getSize();
+
+private:
+	GLuint UBO = 0;
+	GLuint binding;
+	GLsizeiptr size;
+};
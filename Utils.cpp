@@ -1,9 +1,36 @@
 #include "Utils.h"
 
+#include <map>
+
+#define TEXTURE_FLAGS (SOIL_FLAG_MIPMAPS | SOIL_FLAG_INVERT_Y)
+
+static std::map<std::string, GLuint> preloadedTextures;
+
 void Utils::LoadTextureFromImage(GLuint * inTexID, const char * path)
+{
+	std::map<std::string, GLuint>::iterator it = preloadedTextures.find(path);
+	if (it != preloadedTextures.end()) {
+		*inTexID = it->second;
+		return;
+	}
+	glGenTextures(1, inTexID);
+	*inTexID = SOIL_load_OGL_texture(path, SOIL_LOAD_AUTO, *inTexID, TEXTURE_FLAGS);
+}
+
+void Utils::LoadTextureFromImageData(GLuint * inTexID, const unsigned char * data, int width, int height, int channels)
 {
 	glGenTextures(1, inTexID);
-	*inTexID = SOIL_load_OGL_texture(path, SOIL_LOAD_AUTO, *inTexID, SOIL_FLAG_MIPMAPS | SOIL_FLAG_INVERT_Y);
+	*inTexID = SOIL_create_OGL_texture(data, &width, &height, channels, *inTexID, TEXTURE_FLAGS);
+}
+
+void Utils::AddPreloadedTexture(const std::string & path, GLuint tex)
+{
+	preloadedTextures[path] = tex;
+}
+
+void Utils::ClearPreloadedTextures()
+{
+	preloadedTextures.clear();
 }
 
 bool Utils::GenerateDepthFBO(GLuint * fb, GLuint * texId, GLsizei width, GLsizei height)
@@ -36,3 +63,13 @@ bool Utils::GenerateDepthFBO(GLuint * fb, GLuint * texId, GLsizei width, GLsizei
 	glBindFramebuffer(GL_FRAMEBUFFER, framebufferOld);
 	return true;
 }
+
+unsigned long long Utils::HashFNV1a(const void * data, size_t size, unsigned long long hash)
+{
+	const unsigned char * bytes = (const unsigned char *)data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
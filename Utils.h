@@ -4,8 +4,12 @@
 #include "SOIL2/SOIL2.h"
 
 #include <functional>
+#include <string>
 #include <vector>
 
+// Start value of a FNV-1a hash (see Utils::HashFNV1a).
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+
 class Utils
 {
 public:
@@ -24,6 +28,24 @@ public:
 	static void LoadTextureFromImage(GLuint * inTexID, const char * path);
 
 
+	/** void LoadTextureFromImageData(GLuint * inTexID, const unsigned char * data, int width, int height, int channels)
+	*
+	*   Use: Create a texture from an image decoded with SOIL_load_image()
+	*   (e.g. on a loader thread), with the same settings as LoadTextureFromImage().
+	*/
+	static void LoadTextureFromImageData(GLuint * inTexID, const unsigned char * data, int width, int height, int channels);
+
+
+	/** void AddPreloadedTexture(const std::string & path, GLuint tex)
+	*
+	*   Use: Register a texture uploaded ahead of time for the image at path.
+	*   LoadTextureFromImage() returns it instead of loading the file again,
+	*   until ClearPreloadedTextures() is called (which does not delete them).
+	*/
+	static void AddPreloadedTexture(const std::string & path, GLuint tex);
+	static void ClearPreloadedTextures();
+
+
 	/** bool InitFBO(GLuint * fb, GLint * texId, GLsizei width, GLsizei height, GLint format)
 	*
 	*   Use: Generate Framebuffer Object.
@@ -31,6 +53,14 @@ public:
 	static bool GenerateDepthFBO(GLuint * fb, GLuint * texId, GLsizei width, GLsizei height);
 
 
+	/** unsigned long long HashFNV1a(const void * data, size_t size, unsigned long long hash)
+	*
+	*   Use: 64-bit FNV-1a hash of size bytes. To hash several pieces of data,
+	*   pass the previous result as hash.
+	*/
+	static unsigned long long HashFNV1a(const void * data, size_t size, unsigned long long hash = FNV_OFFSET_BASIS);
+
+
 	template <typename StateType>
 	static StateType RungeKutta2(StateType x0, double t0, double dt, std::function<StateType(StateType x, double t)> dxdt);
 
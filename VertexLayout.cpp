@@ -0,0 +1,184 @@
+#include "VertexLayout.h"
+
+#include <glm\gtc\packing.hpp>
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+namespace {
+	float signNotZero(float f)
+	{
+		return f >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	void writeSnorm16(unsigned char * dst, float f)
+	{
+		glm::uint16 v = glm::packSnorm1x16(f);
+		memcpy(dst, &v, sizeof(v));
+	}
+
+	void writeHalf(unsigned char * dst, float f)
+	{
+		glm::uint16 v = glm::packHalf1x16(f);
+		memcpy(dst, &v, sizeof(v));
+	}
+}
+
+VertexLayout::VertexLayout()
+{
+	VertexAttribute full[] = {
+		{ 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, position) },
+		{ 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, normal) },
+		{ 2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, uv) },
+		{ 3, 4, GL_FLOAT, GL_FALSE, offsetof(Vertex, color) },
+		{ 4, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, tangent) },
+		{ 5, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, bitangent) }
+	};
+	attributes.assign(full, full + 6);
+	stride = sizeof(Vertex);
+}
+
+VertexLayout VertexLayout::packed(VertexPositionFormat positions, bool colors)
+{
+	VertexLayout layout;
+	layout.packedLayout = true;
+	layout.positionFormat = positions;
+	layout.colors = colors;
+	layout.stride = 0;
+	layout.attributes.clear();
+
+	if (positions == VERTEX_POSITION_FLOAT16) layout.addAttribute(0, 4, GL_HALF_FLOAT, GL_FALSE, 8);
+	else layout.addAttribute(0, 4, GL_SHORT, GL_TRUE, 8);
+	layout.addAttribute(1, 2, GL_SHORT, GL_TRUE, 4);
+	layout.addAttribute(2, 2, GL_HALF_FLOAT, GL_FALSE, 4);
+	layout.addAttribute(4, 2, GL_SHORT, GL_TRUE, 4);
+	if (colors) layout.addAttribute(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, 4);
+	return layout;
+}
+
+bool VertexLayout::isPacked() const
+{
+	return packedLayout;
+}
+
+VertexPositionFormat VertexLayout::getPositionFormat() const
+{
+	return positionFormat;
+}
+
+bool VertexLayout::hasColors() const
+{
+	return colors;
+}
+
+unsigned int VertexLayout::getStride() const
+{
+	return stride;
+}
+
+const std::vector<VertexAttribute> & VertexLayout::getAttributes() const
+{
+	return attributes;
+}
+
+void VertexLayout::setupAttributes(GLintptr offset) const
+{
+	for (const VertexAttribute & a : attributes) {
+		glEnableVertexAttribArray(a.location);
+		glVertexAttribPointer(a.location, a.size, a.type, a.normalized, stride, (void*)(offset + a.offset));
+	}
+}
+
+void VertexLayout::encode(const Vertex * vertices, unsigned int count, const AABB & bounds, void * dst) const
+{
+	if (!packedLayout) {
+		memcpy(dst, vertices, count * sizeof(Vertex));
+		return;
+	}
+
+	glm::fvec3 scale, offset;
+	getPositionDecode(bounds, scale, offset);
+	glm::fvec3 invScale = 1.0f / scale;
+
+	unsigned char * out = (unsigned char *)dst;
+	for (unsigned int i = 0; i < count; i++, out += stride) {
+		const Vertex & v = vertices[i];
+
+		glm::fvec3 p = glm::clamp((v.position - offset) * invScale, glm::fvec3(-1.0f), glm::fvec3(1.0f));
+		float sign = glm::dot(glm::cross(v.normal, v.tangent), v.bitangent) < 0.0f ? -1.0f : 1.0f;
+		for (int c = 0; c < 3; c++) {
+			if (positionFormat == VERTEX_POSITION_FLOAT16) writeHalf(out + 2 * c, p[c]);
+			else writeSnorm16(out + 2 * c, p[c]);
+		}
+		if (positionFormat == VERTEX_POSITION_FLOAT16) writeHalf(out + 6, sign);
+		else writeSnorm16(out + 6, sign);
+
+		glm::fvec2 n = encodeOctahedral(v.normal);
+		writeSnorm16(out + 8, n.x);
+		writeSnorm16(out + 10, n.y);
+		writeHalf(out + 12, v.uv.x);
+		writeHalf(out + 14, v.uv.y);
+		glm::fvec2 t = encodeOctahedral(v.tangent);
+		writeSnorm16(out + 16, t.x);
+		writeSnorm16(out + 18, t.y);
+		if (colors) {
+			glm::uint32 c = glm::packUnorm4x8(v.color);
+			memcpy(out + 20, &c, sizeof(c));
+		}
+	}
+}
+
+void VertexLayout::getPositionDecode(const AABB & bounds, glm::fvec3 & scale, glm::fvec3 & offset) const
+{
+	if (!packedLayout) {
+		scale = glm::fvec3(1.0f);
+		offset = glm::fvec3(0.0f);
+		return;
+	}
+	offset = bounds.getCenter();
+	scale = bounds.getHalfSize();
+	// Flat meshes would divide by zero.
+	for (int c = 0; c < 3; c++) {
+		if (scale[c] <= 0.0f) scale[c] = 1.0f;
+	}
+}
+
+bool VertexLayout::operator==(const VertexLayout & other) const
+{
+	if (packedLayout != other.packedLayout) return false;
+	return !packedLayout || (positionFormat == other.positionFormat && colors == other.colors);
+}
+
+bool VertexLayout::operator!=(const VertexLayout & other) const
+{
+	return !(*this == other);
+}
+
+glm::fvec2 VertexLayout::encodeOctahedral(glm::fvec3 n)
+{
+	float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	if (l1 <= 0.0f) return glm::fvec2(0.0f);
+	n /= l1;
+	glm::fvec2 e(n.x, n.y);
+	// Fold the lower hemisphere over the diagonals:
+	if (n.z < 0.0f) e = glm::fvec2((1.0f - std::abs(n.y)) * signNotZero(n.x), (1.0f - std::abs(n.x)) * signNotZero(n.y));
+	return e;
+}
+
+glm::fvec3 VertexLayout::decodeOctahedral(glm::fvec2 e)
+{
+	glm::fvec3 n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+	if (n.z < 0.0f) {
+		n.x = (1.0f - std::abs(e.y)) * signNotZero(e.x);
+		n.y = (1.0f - std::abs(e.x)) * signNotZero(e.y);
+	}
+	return glm::normalize(n);
+}
+
+void VertexLayout::addAttribute(GLuint location, GLint size, GLenum type, GLboolean normalized, unsigned int bytes)
+{
+	VertexAttribute a = { location, size, type, normalized, stride };
+	attributes.push_back(a);
+	stride += bytes;
+}
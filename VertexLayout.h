@@ -0,0 +1,89 @@
+#pragma once
+
+#include <glad\glad.h>
+#include <glm\glm.hpp>
+
+#include "Bounds.h"
+
+#include <vector>
+
+// Locations of the constant (not array sourced) attributes that decode a mesh's vertices in
+// the vertex shaders: position = InPos * InPosScale.xyz + InPosOffset, and the normals are
+// octahedral encoded if InPosScale.w is 1. Set by Mesh before every draw.
+#define POSITION_SCALE_ATTRIB_LOCATION 10
+#define POSITION_OFFSET_ATTRIB_LOCATION 11
+
+// Vertex as it is kept on the CPU.
+struct Vertex {
+	glm::fvec3 position;
+	glm::fvec3 normal;
+	glm::fvec2 uv;
+	glm::fvec4 color;
+	glm::fvec3 tangent;
+	glm::fvec3 bitangent;
+};
+
+// Storage of the positions in packed layouts. Both are normalized to the mesh's bounds.
+enum VertexPositionFormat {
+	VERTEX_POSITION_FLOAT16 = 0,
+	VERTEX_POSITION_SNORM16 = 1
+};
+
+// One vertex attribute of a layout, as passed to glVertexAttribPointer().
+struct VertexAttribute {
+	GLuint location;
+	GLint size;
+	GLenum type;
+	GLboolean normalized;
+	unsigned int offset;
+};
+
+// Describes how the vertices of a Mesh are stored in its vertex buffer, and sets up the
+// attributes for it.
+// The default layout stores the Vertex struct as it is (72 bytes). The packed layout needs
+// 20 bytes (24 with colors):
+// - position: 4 x fp16 or snorm16, relative to the mesh bounds. w holds the sign of the
+//   bitangent, which is cross(normal, tangent) * sign.
+// - normal and tangent: octahedral encoded, 2 x snorm16 each.
+// - uv: 2 x fp16.
+// - color (optional): 4 x unorm8. Without colors, the attribute is not sourced at all.
+class VertexLayout
+{
+public:
+	VertexLayout();
+
+	static VertexLayout packed(VertexPositionFormat positions = VERTEX_POSITION_SNORM16, bool colors = false);
+
+	bool isPacked() const;
+	VertexPositionFormat getPositionFormat() const;
+	bool hasColors() const;
+	// Size of one vertex in bytes.
+	unsigned int getStride() const;
+	const std::vector<VertexAttribute> & getAttributes() const;
+
+	// Enable the attributes and source them from the bound GL_ARRAY_BUFFER, starting offset
+	// bytes into it. The vertex array must be bound.
+	void setupAttributes(GLintptr offset = 0) const;
+	// Write count vertices to dst (count * getStride() bytes). bounds must contain all
+	// positions; see getPositionDecode().
+	void encode(const Vertex * vertices, unsigned int count, const AABB & bounds, void * dst) const;
+	// Scale and offset that turn the stored positions of vertices within bounds back into
+	// model space.
+	void getPositionDecode(const AABB & bounds, glm::fvec3 & scale, glm::fvec3 & offset) const;
+
+	bool operator==(const VertexLayout & other) const;
+	bool operator!=(const VertexLayout & other) const;
+
+	// Octahedral encoding of a unit vector in [-1, 1]^2, and its inverse.
+	static glm::fvec2 encodeOctahedral(glm::fvec3 n);
+	static glm::fvec3 decodeOctahedral(glm::fvec2 e);
+
+private:
+	bool packedLayout = false;
+	VertexPositionFormat positionFormat = VERTEX_POSITION_SNORM16;
+	bool colors = true;
+	unsigned int stride = 0;
+	std::vector<VertexAttribute> attributes;
+
+	void addAttribute(GLuint location, GLint size, GLenum type, GLboolean normalized, unsigned int bytes);
+};
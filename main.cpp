@@ -18,6 +18,10 @@
 #include "ModifierVertexGroup.h"
 
 #include "Scene.h"
+#include "SystemScheduler.h"
+#include "RenderStats.h"
+#include "GeometryArena.h"
+#include "AsyncSceneLoader.h"
 
 #include "assimp\Importer.hpp"
 #include "assimp\scene.h"
@@ -28,6 +32,7 @@ int windowWidth = 1280, windowHeight = 720;
 double delta;
 bool running = true;
 bool debugGrid = false;
+bool geometryStats = false;
 int debugDepth = NUM_SHADOW_LAYERS;
 
 bool cameraInit = false;
@@ -150,6 +155,9 @@ Camera * c;
 // This is a pointer to a light so that it can be controlled for debugging purposes
 DirectionalLight* lightDebugPtr;
 
+// This is a pointer to the scene so that its render settings can be toggled for debugging purposes
+Scene * sceneDebugPtr;
+
 // Initial direction of the directional light (e.g. position of the sun)
 float light_degX = 1.0f, light_degZ = 1.0f;
 
@@ -199,21 +207,52 @@ int main(void) {
 	// Generate the default textures
 	Material::setupDefaultTextures();
 
-	// Use ASSIMP to import the scene. The parsing is done in the respective classes:
-	Assimp::Importer importer;
-
 	// Main Scene handle:
 	Scene * scene;
 
-	// Load Scene:
-	if (const aiScene* sn = importer.ReadFile("res\\Pool2.fbx", aiProcess_Triangulate | aiProcess_CalcTangentSpace | aiProcess_JoinIdenticalVertices | aiProcess_ValidateDataStructure)) {
-		scene = new Scene(sn, true);
-		std::cout << "File loaded." << std::endl;
+	// Store the imported meshes with the packed vertex layout (about a quarter of the memory):
+	Mesh::setDefaultVertexLayout(VertexLayout::packed(VERTEX_POSITION_SNORM16, false));
+
+	// Load the scene in the background (ASSIMP parses it, the respective classes convert it).
+	// The window stays responsive meanwhile: every frame, the loader gets a time budget for
+	// the GPU uploads. The loader holds GL resources until the scene is created, so it is
+	// deleted before the context.
+	double loadStart = glfwGetTime();
+	AsyncSceneLoader * loader = new AsyncSceneLoader();
+	loader->load("res\\Pool2.fbx", aiProcess_Triangulate | aiProcess_CalcTangentSpace | aiProcess_JoinIdenticalVertices | aiProcess_ValidateDataStructure, true);
+	int lastProgress = -1;
+	while (!loader->pump()) {
+		if (glfwWindowShouldClose(window)) {
+			delete loader;
+			GeometryArena::deleteAll();
+			glfwDestroyWindow(window);
+			glfwTerminate();
+			return 0;
+		}
+		int progress = int(loader->getProgress() * 10.0f) * 10;
+		if (progress != lastProgress) {
+			std::cout << "Loading: " << progress << "%" << std::endl;
+			lastProgress = progress;
+		}
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glfwSwapBuffers(window);
+		glfwPollEvents();
 	}
-	else {
-		std::cerr << importer.GetErrorString() << std::endl;
+	if (!loader->isDone()) {
+		std::cerr << loader->getError() << std::endl;
+		delete loader;
+		GeometryArena::deleteAll();
+		glfwDestroyWindow(window);
+		glfwTerminate();
 		return 0;
 	}
+	scene = loader->getScene();
+	sceneDebugPtr = scene;
+	if (loader->isFromCache()) std::cout << "File loaded from cache (opened in " << loader->getParseTime() << " ms, loaded in " << loader->getLoadTime() << " ms)." << std::endl;
+	else std::cout << "File loaded (parsed in " << loader->getParseTime() << " ms, loaded in " << loader->getLoadTime() << " ms, cache baked in " << loader->getBakeTime() << " ms)." << std::endl;
+	delete loader;
+	bool firstFrame = true;
 
 	// Load the necessary shader programs for debugging purposes
 	Shader * shaderGrid = new Shader("Shader\\shaderGrid.vs", "Shader\\shaderGrid.fs");
@@ -274,6 +313,9 @@ int main(void) {
 		// Update the mouse position
 		inputHandler->updateMouseData(window);
 
+		// Update the scene's systems (physics, ...)
+		scene->update(delta);
+
 		int width, height;
 		glfwGetFramebufferSize(window, &width, &height);
 		glViewport(0, 0, width, height);
@@ -292,16 +334,20 @@ int main(void) {
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 			quad->getComponent<PolygonModel>()->getMaterial()->getShader()->use();
 			quad->getComponent<PolygonModel>()->getMaterial()->getShader()->setInt("depthMaps", 0);
-			glActiveTexture(GL_TEXTURE0); 
-			glBindTexture(GL_TEXTURE_2D_ARRAY, quad->getComponent<PolygonModel>()->getMaterial()->getTexAmbient());
+			GLState::bindTexture(0, GL_TEXTURE_2D_ARRAY, quad->getComponent<PolygonModel>()->getMaterial()->getTexAmbient());
 			quad->getComponent<PolygonModel>()->getMaterial()->getShader()->setInt("layer", debugDepth);
 			quad->getComponent<PolygonModel>()->drawRaw();
-			glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+			GLState::bindTexture(0, GL_TEXTURE_2D_ARRAY, 0);
 		}
 
 
 		// Swap buffers:
 		glfwSwapBuffers(window);
+		renderStats.endFrame();
+		if (firstFrame) {
+			std::cout << "Time to first frame: " << (glfwGetTime() - loadStart) * 1000.0 << " ms" << std::endl;
+			firstFrame = false;
+		}
 
 		// Poll events:
 		glfwPollEvents();
@@ -316,6 +362,9 @@ int main(void) {
 		if (time - oldTime > 1) {
 			fps = fps_counter / (time - oldTime);
 			std::cout << "FPS: " << fps << std::endl;
+			scene->getSystemScheduler()->printTimings(std::cout);
+			renderStats.print(std::cout);
+			if (geometryStats) GeometryArena::printStats(std::cout);
 			fps_counter = 0;
 			oldTime = time;
 
@@ -332,6 +381,7 @@ int main(void) {
 	}
 	// When done, delete resources
 	delete scene;
+	GeometryArena::deleteAll();
 	deleteGridBuffers();
 	glfwDestroyWindow(window);
 	glfwTerminate();
@@ -400,6 +450,19 @@ void inputHandling() {
 		debugDepth = debugDepth % (NUM_SHADOW_LAYERS + 1);
 		std::cout << "Depth level: " << debugDepth << std::endl;
 	}
+	if (inputHandler->getKeyState(GLFW_KEY_F3) & INPUT_PRESSED) {
+		// Cycle through the supported shadow render modes:
+		int mode = sceneDebugPtr->getShadowRenderMode();
+		do {
+			mode = (mode + 1) % (SHADOW_RENDER_VERTEX_LAYER + 1);
+		} while (!sceneDebugPtr->isShadowRenderModeSupported((ShadowRenderMode)mode));
+		sceneDebugPtr->setShadowRenderMode((ShadowRenderMode)mode);
+		const char * names[] = { "multi-pass", "geometry shader", "vertex shader layer" };
+		std::cout << "Shadow render mode: " << names[mode] << std::endl;
+	}
+	if (inputHandler->getKeyState(GLFW_KEY_F4) & INPUT_PRESSED) {
+		geometryStats = !geometryStats;
+	}
 
 	if (inputHandler->getKeyState(GLFW_KEY_1) & INPUT_PRESSED) {
 		c->setView(glm::lookAt(glm::vec3(0.0f, 0.5f, 3.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
@@ -435,9 +498,9 @@ void drawAxises(Shader * s)
 
 	glLineWidth(4.0f);
 
-	glBindVertexArray(VAO_Axises);
+	GLState::bindVertexArray(VAO_Axises);
 	glDrawArrays(GL_LINES, 0, 6);
-	glBindVertexArray(0);
+	GLState::bindVertexArray(0);
 }
 
 void drawGrid(Shader * s)
@@ -450,7 +513,7 @@ void drawGrid(Shader * s)
 
 	glLineWidth(1.0f);
 
-	glBindVertexArray(VAO_Grid);
+	GLState::bindVertexArray(VAO_Grid);
 	glDrawArrays(GL_LINES, 0, 36);
-	glBindVertexArray(0);
+	GLState::bindVertexArray(0);
 }